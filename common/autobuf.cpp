@@ -1,5 +1,66 @@
+#include <stdlib.h>
+#include <atomic>
+#include <new>
 #include "autobuf.h"
 
+// header of a refcounted block. the content follows the header
+struct autobuf::refcounted_block {
+	atomic<uint32_t> references;
+	uint32_t         block_size;	// including the header
+
+	uint8_t* get_data() { return (uint8_t*) (this + 1); }
+	uint32_t get_capacity() const { return block_size - sizeof(refcounted_block); }
+};
+
+// per-thread cache of freed blocks, one free list per power-of-two size class.
+// serialization creates and drops buffers of the same few sizes all the time,
+// so after warmup these come off a free list instead of going to malloc. a
+// block released on another thread than the one that allocated it simply
+// joins that thread's list. the cache is plain data so that it stays usable
+// while thread-local destructors run; the drain object frees the cached
+// blocks when the thread exits and turns the cache off.
+namespace {
+
+const uint32_t MIN_BLOCK_SHIFT = 8;
+const uint32_t NUM_SIZE_CLASSES = 9;
+const uint32_t CACHE_BYTES_PER_CLASS = 256 * 1024;
+
+struct free_block {
+	free_block* next;
+};
+
+struct block_cache {
+	free_block* head[NUM_SIZE_CLASSES];
+	uint32_t    count[NUM_SIZE_CLASSES];
+	bool        drain_registered;
+	bool        disabled;
+};
+
+__thread block_cache cache;
+
+struct block_cache_drain {
+	~block_cache_drain() {
+		for (uint32_t index = 0; index < NUM_SIZE_CLASSES; ++index) {
+			while (cache.head[index] != nullptr) {
+				free_block* block = cache.head[index];
+				cache.head[index] = block->next;
+				free(block);
+			}
+			cache.count[index] = 0;
+		}
+		cache.disabled = true;
+	}
+};
+
+thread_local block_cache_drain drain;
+
+// gets the free list index of a power-of-two block size
+inline uint32_t get_size_class(uint32_t block_size) {
+	return __builtin_ctz(block_size) - MIN_BLOCK_SHIFT;
+}
+
+}
+
 // default constructor
 autobuf::autobuf() {
 	init();
@@ -46,7 +107,7 @@ autobuf autobuf::copy_as_shared() {
 	result.owns_memory = false;
 	result.writeable_buf = get_content_ptr_mutable();
 	result.content_size = size();
-	result.buf_size = reserve_size();
+	result.buf_size = reserve_size() - begin_offset;
 	return result;
 }
 
@@ -60,6 +121,32 @@ autobuf autobuf::copy_as_read_only() const {
 	return result;
 }
 
+// makes a refcounted copy of this autobuf
+autobuf autobuf::copy_as_refcounted() const {
+	return slice(0, content_size);
+}
+
+// makes a refcounted autobuf holding a range of the content
+autobuf autobuf::slice(uint32_t offset, uint32_t len) const {
+	if ((uint64_t) offset + len > content_size) {
+		printf("autobuf::slice() error -- range error. requested %u bytes from "
+			"offset %u, only %u bytes available.\n", len, offset, content_size);
+		abort();
+	}
+
+	autobuf result;
+	if (block != nullptr) {
+		result.constructor_copy(*this);
+		result.begin_offset += offset;
+		result.content_size = len;
+		return result;
+	}
+
+	result.attach_new_block(len);
+	memcpy(result.writeable_buf, (const uint8_t*) get_content_ptr() + offset, len);
+	return result;
+}
+
 // makes a complete, owned copy of this autobuf to another autobuf
 void autobuf::full_copy_to(autobuf& dest) const {
 	dest.reset();
@@ -97,9 +184,7 @@ void autobuf::clear() {
 
 // deallocates all resources and resets the object to the uninitialized state
 void autobuf::reset() {
-	if (owns_memory && writeable_buf != nullptr) {
-		free(writeable_buf);
-	}
+	release();
 	init();
 }
 
@@ -109,11 +194,12 @@ void autobuf::set_content(const void* src_buf, uint32_t size) {
 		printf("autobuf::set_content() error -- buffer is read-only!\n");
 		abort();
 	} else {
-		if (!alloc(size)) {
-			if (owns_memory) {
+		begin_offset = 0;
+		if (!alloc(size, false)) {
+			if (!owns_memory) {
 				printf("autobuf::set_content() error -- shared buffer is not big "
 					"enough. requested %u bytes, available %u bytes.\n", size,
-					buf_size - begin_offset);
+					buf_size);
 			} else {
 				printf("autobuf::set_content() error -- unable to allocate space "
 					"for %u bytes.\n", size);
@@ -123,7 +209,6 @@ void autobuf::set_content(const void* src_buf, uint32_t size) {
 
 		memcpy(get_content_ptr_mutable(), src_buf, size);
 		content_size = size;
-		begin_offset = 0;
 	}
 }
 
@@ -201,6 +286,7 @@ uint8_t& autobuf::operator[](int offset) {
 		return dummy_ret;
 	}
 
+	copy_on_write();
 	return ((uint8_t*)writeable_buf)[begin_offset+offset];
 }
 
@@ -307,6 +393,7 @@ void* autobuf::get_content_ptr_mutable() {
 			"read-only buffer.\n");
 		abort();
 	}
+	copy_on_write();
 	return (uint8_t*)writeable_buf + begin_offset;
 }
 
@@ -321,6 +408,7 @@ void* autobuf::ptr_offset_mutable(int offset) {
 			offset);
 		abort();
 	}
+	copy_on_write();
 	return (uint8_t*)writeable_buf + begin_offset + offset;
 }
 
@@ -425,6 +513,9 @@ void autobuf::prepend(const void* buf, uint32_t len) {
 	}
 
 	if (len == 0) return;
+
+	// the headroom of a shared block may be part of someone else's content
+	copy_on_write();
 	if (begin_offset >= len) {
 		begin_offset -= len;
 		memcpy(get_content_ptr_mutable(), buf, len);
@@ -435,8 +526,12 @@ void autobuf::prepend(const void* buf, uint32_t len) {
 			printf("autobuf::prepend() error -- unable to allocate memory.\n");
 			abort();
 		}
-		memmove(ptr_offset_mutable(len), get_content_ptr(), content_size);
-		memcpy(get_content_ptr_mutable(), buf, len);
+
+		// the content can't go through ptr_offset_mutable() here because that
+		// checks against the old content size.
+		uint8_t* content = (uint8_t*) get_content_ptr_mutable();
+		memmove(content + len, content, content_size);
+		memcpy(content, buf, len);
 		content_size += len;
 	}
 }
@@ -509,6 +604,8 @@ bool autobuf::save(const string& filename) const {
 autobuf::ownership autobuf::get_ownership_type() const {
 	if (read_only) {
 		return autobuf::ownership::READ_ONLY;
+	} else if (block != nullptr) {
+		return autobuf::ownership::REFCOUNTED;
 	} else if (owns_memory) {
 		return autobuf::ownership::OWNED;
 	} else {
@@ -523,7 +620,7 @@ bool autobuf::is_read_only() const {
 
 // check if memory is shared
 bool autobuf::is_shared() const {
-	return !read_only && !owns_memory;
+	return !read_only && !owns_memory && block == nullptr;
 }
 
 // check if memory is owned
@@ -531,6 +628,11 @@ bool autobuf::is_owned() const {
 	return !read_only && owns_memory;
 }
 
+// check if memory is refcounted
+bool autobuf::is_refcounted() const {
+	return block != nullptr;
+}
+
 // conversion to string
 string autobuf::to_string() const {
 	string result;
@@ -578,6 +680,17 @@ void autobuf::create_empty_buffer(uint32_t size, bool zero) {
 	}
 }
 
+// creates an empty buffer in a refcounted block of its own
+void autobuf::create_empty_refcounted_buffer(uint32_t size) {
+	if (block != nullptr && !read_only && block->references.load(memory_order_acquire) == 1 &&
+		size <= block->get_capacity()) {
+		begin_offset = 0;
+		content_size = size;
+		return;
+	}
+	attach_new_block(size);
+}
+
 // grows a buffer without altering current contents
 void autobuf::grow_buffer(uint32_t size, bool zero) {
 	uint32_t old_size = content_size;
@@ -590,7 +703,7 @@ void autobuf::grow_buffer(uint32_t size, bool zero) {
 
 // attempts to shrink the buffer allocation, making the allocation tight
 void autobuf::shrink() {
-	if (read_only) {
+	if (read_only || block != nullptr) {
 		return;
 	}
 
@@ -604,25 +717,25 @@ void autobuf::shrink() {
 		return;
 	}
 
-	uint32_t number_of_pages = content_size / BUFFER_INCREMENT_SIZE +
-		(content_size % BUFFER_INCREMENT_SIZE > 0 ? 1 : 0);
-	uint32_t actual_pages = buf_size / BUFFER_INCREMENT_SIZE +
-		(buf_size % BUFFER_INCREMENT_SIZE > 0 ? 1 : 0);
+	if (is_inline()) {
+		return;
+	}
 
-	if (number_of_pages > actual_pages) {
-		if (begin_offset > 0) {
-			memmove(writeable_buf, get_content_ptr(), content_size);
-			begin_offset = 0;
-		}
-		void* new_ptr = nullptr;
-		uint32_t total_bytes = number_of_pages * BUFFER_INCREMENT_SIZE;
-		new_ptr = realloc(writeable_buf, total_bytes);
-		if (new_ptr == nullptr) {
-			printf("autobuf::shrink() error -- failed to allocate memory.\n");
-			abort();
-		}
-		buf_size = total_bytes;
+	uint32_t new_size = (content_size <= INLINE_SIZE ? INLINE_SIZE : get_block_size(content_size));
+	if (new_size >= buf_size) {
+		return;
+	}
+
+	void* new_ptr = (new_size == INLINE_SIZE ? inline_buf : allocate_block(new_size));
+	if (new_ptr == nullptr) {
+		printf("autobuf::shrink() error -- failed to allocate memory.\n");
+		abort();
 	}
+	memcpy(new_ptr, get_content_ptr(), content_size);
+	release_block(writeable_buf, buf_size);
+	writeable_buf = new_ptr;
+	buf_size = new_size;
+	begin_offset = 0;
 }
 
 // gets the content size
@@ -652,18 +765,31 @@ void autobuf::init() {
 	read_only_buf = nullptr;
 
 	owns_memory = true;
-	writeable_buf = nullptr;
+	writeable_buf = inline_buf;
 
-	buf_size = 0;
+	buf_size = INLINE_SIZE;
 	content_size = 0;
 	begin_offset = 0;
 	dummy_ret = 0;
+
+	block = nullptr;
 }
 
 // used by copy constructor and assignment operator to perform copies
 void autobuf::constructor_copy(const autobuf& original) {
 
-	if (original.owns_memory) {
+	if (original.block != nullptr) {
+		// refcounted copy
+
+		block = original.block;
+		block->references.fetch_add(1, memory_order_relaxed);
+		owns_memory = false;
+		writeable_buf = original.writeable_buf;
+		buf_size = original.buf_size;
+		content_size = original.content_size;
+		begin_offset = original.begin_offset;
+
+	} else if (original.owns_memory) {
 		// complete copy
 
 		owns_memory = true;
@@ -693,53 +819,219 @@ void autobuf::constructor_copy(const autobuf& original) {
 	}
 }
 
-// used to allocate memory for the autobuf. automatically realigns contents
-// if memory is owned and begin_offset is nonzero. does not update content
-// size.
-bool autobuf::alloc(uint32_t size) {
+// used to make room for size bytes of content. content stays where it is if
+// it fits behind its current offset; otherwise the headroom in front of it is
+// reclaimed, or (if memory is owned) it is moved to a bigger block. the
+// content is only carried over if keep_content is set. does not update
+// content size.
+bool autobuf::alloc(uint32_t size, bool keep_content) {
 	if (read_only) {
 		printf("autobuf::alloc() failed -- cannot alloc for a read-only "
 			"buffer!\n");
 		return false;
 	}
-	
-	if (!owns_memory) {
 
-		// shared memory
-		if (begin_offset + size > buf_size) {
-			printf("autobuf::alloc() failed -- shared buffer is too small.\n");
-			return false;
-		} else {
+	// a shared block is copied before it is written
+	if (block != nullptr && block->references.load(memory_order_acquire) > 1) {
+		return unshare(size, keep_content);
+	}
+
+	// fits as is
+	if ((uint64_t) begin_offset + size <= buf_size) {
+		return true;
+	}
+
+	// a block of our own can be compacted, but is not grown in place
+	if (block != nullptr) {
+		if (size <= buf_size) {
+			if (keep_content) {
+				memmove(writeable_buf, (uint8_t*)writeable_buf + begin_offset,
+					content_size);
+			}
+			begin_offset = 0;
 			return true;
 		}
+		return unshare(size, keep_content);
+	}
 
-	} else {
+	if (!owns_memory) {
+		printf("autobuf::alloc() failed -- shared buffer is too small.\n");
+		return false;
+	}
 
-		// move memory contents if possible
-		if (begin_offset > 0) {
+	// fits once the headroom is reclaimed
+	if (size <= buf_size) {
+		if (keep_content) {
 			memmove(writeable_buf, (uint8_t*)writeable_buf + begin_offset,
 				content_size);
-			begin_offset = 0;
 		}
+		begin_offset = 0;
+		return true;
+	}
 
-		// owned memory
-		if (begin_offset + size <= buf_size) {
-			return true;
-		} else {
-			void* new_ptr = nullptr;
-			uint32_t required_pages = (size / BUFFER_INCREMENT_SIZE) + 
-				(size % BUFFER_INCREMENT_SIZE > 0 ? 1 : 0);
-			uint32_t required_size = required_pages * BUFFER_INCREMENT_SIZE;
-			new_ptr = realloc(writeable_buf, required_size);
-
-			if (new_ptr == nullptr) {
-				printf("autobuf::alloc() failed -- could not allocate memory.\n");
-				return false;
-			}
+	// needs a bigger block
+	uint32_t new_size = get_block_size(size);
+	if (new_size == 0) {
+		printf("autobuf::alloc() failed -- %u bytes is too large.\n", size);
+		return false;
+	}
 
-			writeable_buf = new_ptr;
-			buf_size = required_size;
-			return true;
+	void* new_ptr = nullptr;
+	if (buf_size > MAX_BLOCK_SIZE && begin_offset == 0) {
+
+		// large blocks are not cached, so they can grow in place
+		new_ptr = realloc(writeable_buf, new_size);
+		if (new_ptr == nullptr) {
+			printf("autobuf::alloc() failed -- could not allocate memory.\n");
+			return false;
+		}
+
+	} else {
+
+		new_ptr = allocate_block(new_size);
+		if (new_ptr == nullptr) {
+			printf("autobuf::alloc() failed -- could not allocate memory.\n");
+			return false;
 		}
+		if (keep_content) {
+			memcpy(new_ptr, (uint8_t*)writeable_buf + begin_offset, content_size);
+		}
+		release();
+	}
+
+	writeable_buf = new_ptr;
+	buf_size = new_size;
+	begin_offset = 0;
+	return true;
+}
+
+// checks if the content is held in the object itself
+bool autobuf::is_inline() const {
+	return writeable_buf == inline_buf;
+}
+
+// gives back the block of an owned buffer, or drops the reference to a
+// refcounted block (does not reset the fields)
+void autobuf::release() {
+	if (block != nullptr) {
+		if (block->references.fetch_sub(1, memory_order_acq_rel) == 1) {
+			uint32_t block_size = block->block_size;
+			block->~refcounted_block();
+			release_block(block, block_size);
+		}
+	} else if (owns_memory && !read_only && !is_inline()) {
+		release_block(writeable_buf, buf_size);
 	}
 }
+
+// makes sure a refcounted buffer is the only user of its block before the
+// content is modified
+void autobuf::copy_on_write() {
+	if (block != nullptr && block->references.load(memory_order_acquire) > 1) {
+		if (!unshare(content_size, true)) {
+			printf("autobuf::copy_on_write() error -- unable to allocate memory.\n");
+			abort();
+		}
+	}
+}
+
+// turns a refcounted buffer into an owned one with room for size bytes of
+// content, dropping its reference to the block
+bool autobuf::unshare(uint32_t size, bool keep_content) {
+	uint32_t new_size = (size > content_size ? size : content_size);
+	void* new_ptr = inline_buf;
+	if (new_size > INLINE_SIZE) {
+		new_size = get_block_size(new_size);
+		new_ptr = (new_size == 0 ? nullptr : allocate_block(new_size));
+		if (new_ptr == nullptr) {
+			printf("autobuf::unshare() failed -- could not allocate memory.\n");
+			return false;
+		}
+	} else {
+		new_size = INLINE_SIZE;
+	}
+
+	if (keep_content) {
+		memcpy(new_ptr, get_content_ptr(), content_size);
+	}
+	release();
+	block = nullptr;
+	owns_memory = true;
+	writeable_buf = new_ptr;
+	buf_size = new_size;
+	begin_offset = 0;
+	return true;
+}
+
+// replaces the buffer with a new refcounted block holding size bytes of
+// (uninitialized) content
+void autobuf::attach_new_block(uint32_t size) {
+	uint32_t block_size = get_block_size(sizeof(refcounted_block) + size);
+	void* memory = (block_size == 0 ? nullptr : allocate_block(block_size));
+	if (memory == nullptr) {
+		printf("autobuf::attach_new_block() error -- unable to allocate %u bytes.\n", size);
+		abort();
+	}
+
+	release();
+	init();
+	block = new (memory) refcounted_block();
+	block->references.store(1, memory_order_relaxed);
+	block->block_size = block_size;
+	owns_memory = false;
+	writeable_buf = block->get_data();
+	buf_size = block->get_capacity();
+	content_size = size;
+}
+
+// gets the block size used to hold size bytes. returns 0 if too large
+uint32_t autobuf::get_block_size(uint32_t size) {
+	if (size <= MIN_BLOCK_SIZE) {
+		return MIN_BLOCK_SIZE;
+	} else if (size <= MAX_BLOCK_SIZE) {
+		return 1U << (32 - __builtin_clz(size - 1));
+	}
+
+	uint64_t required_size = ((uint64_t) size + BUFFER_INCREMENT_SIZE - 1) /
+		BUFFER_INCREMENT_SIZE * BUFFER_INCREMENT_SIZE;
+	return (required_size > UINT32_MAX ? 0 : (uint32_t) required_size);
+}
+
+// allocates a block, reusing a cached one of the same size class if possible
+void* autobuf::allocate_block(uint32_t block_size) {
+	if (block_size <= MAX_BLOCK_SIZE) {
+		uint32_t index = get_size_class(block_size);
+		free_block* block = cache.head[index];
+		if (block != nullptr) {
+			cache.head[index] = block->next;
+			--cache.count[index];
+			return block;
+		}
+	}
+	return malloc(block_size);
+}
+
+// returns a block to the cache of this thread, or frees it if that is full
+void autobuf::release_block(void* block, uint32_t block_size) {
+	if (block_size > MAX_BLOCK_SIZE || cache.disabled) {
+		free(block);
+		return;
+	}
+
+	uint32_t index = get_size_class(block_size);
+	if (cache.count[index] >= CACHE_BYTES_PER_CLASS / block_size) {
+		free(block);
+		return;
+	}
+
+	// touching the drain object registers its destructor for this thread
+	if (!cache.drain_registered) {
+		cache.drain_registered = true;
+		(void) &drain;
+	}
+
+	free_block* entry = (free_block*) block;
+	entry->next = cache.head[index];
+	cache.head[index] = entry;
+	++cache.count[index];
+}
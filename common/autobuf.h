@@ -13,12 +13,17 @@ class autobuf {
 public:
 
 	// defines the memory ownership of the autobuf
-	// owned    : buffer was dynamically allocated and needs to be freed
+	// owned    : buffer belongs to the autobuf (held inline in the object for
+	//            small contents, allocated otherwise) and is released in the
+	//            dtor.
 	// shared   : buffer is writeable but may not be flexibly extended or shrunk.
 	//            someone else owns the buffer so this is not freed in the dtor.
 	// read-only: buffer cannot be modified, extended or shrunk. someone else
 	//            owns the buffer.
-	enum class ownership { READ_ONLY, SHARED, OWNED };
+	// refcounted: buffer is a reference-counted block that copies and slices
+	//            share. copying is O(1); the content is copied the first time
+	//            it is modified while the block is shared (copy-on-write).
+	enum class ownership { READ_ONLY, SHARED, OWNED, REFCOUNTED };
 
 	// various constructors and destructors
 	autobuf();
@@ -31,6 +36,12 @@ public:
 	autobuf copy_as_owned() const;
 	autobuf copy_as_shared();
 	autobuf copy_as_read_only() const;
+	autobuf copy_as_refcounted() const;
+
+	// makes a refcounted buffer holding a range of the content. slicing a
+	// refcounted buffer only shares its block; any other buffer is copied
+	// once into a new block.
+	autobuf slice(uint32_t offset, uint32_t len) const;
 
 	void full_copy_to(autobuf& dest) const;
 	void full_copy_from(const autobuf& src);
@@ -93,6 +104,7 @@ public:
 	bool is_read_only() const;
 	bool is_shared() const;
 	bool is_owned() const;
+	bool is_refcounted() const;
 
 	// conversion to string
 	string to_string() const;
@@ -112,6 +124,12 @@ public:
 	// memset to 0 before use (turn off for higher speed; but less safe).
 	void create_empty_buffer(uint32_t size, bool zero=true);
 
+	// creates an empty buffer of a given size in a refcounted block, so that
+	// slices of it are shared rather than copied. the current block is reused
+	// if nothing else holds it; otherwise a new one is allocated, leaving the
+	// earlier slices intact. the memory is not zeroed.
+	void create_empty_refcounted_buffer(uint32_t size);
+
 	// grows a buffer to a new size (buffer can later be shrunk without changing
 	// reserve size) without altering current contents. zero flag controls if
 	// the newly-grown region should be memset to 0 before use.
@@ -135,6 +153,13 @@ public:
 
 private:
 
+	// owned contents of up to INLINE_SIZE bytes are kept in the object itself.
+	// larger buffers are rounded up to a power of two between MIN_BLOCK_SIZE
+	// and MAX_BLOCK_SIZE and recycled through a per-thread cache; anything
+	// bigger is rounded up to BUFFER_INCREMENT_SIZE and comes from malloc.
+	static const uint32_t INLINE_SIZE = 128;
+	static const uint32_t MIN_BLOCK_SIZE = 256;
+	static const uint32_t MAX_BLOCK_SIZE = 65536;
 	static const uint32_t BUFFER_INCREMENT_SIZE = 4096;
 
 	bool read_only;
@@ -149,8 +174,23 @@ private:
 	uint32_t begin_offset;
 	uint8_t dummy_ret;
 
+	struct refcounted_block;
+	refcounted_block* block;
+
+	alignas(8) uint8_t inline_buf[INLINE_SIZE];
+
 	// helper functions
 	void init();
 	void constructor_copy(const autobuf& original);
-	bool alloc(uint32_t size);
+	bool alloc(uint32_t size, bool keep_content=true);
+	bool is_inline() const;
+	void release();
+	void copy_on_write();
+	bool unshare(uint32_t size, bool keep_content);
+	void attach_new_block(uint32_t size);
+
+	// block management for owned buffers that do not fit inline
+	static uint32_t get_block_size(uint32_t size);
+	static void* allocate_block(uint32_t block_size);
+	static void release_block(void* block, uint32_t block_size);
 };
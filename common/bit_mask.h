@@ -0,0 +1,178 @@
+#ifndef __BIT_MASK
+#define __BIT_MASK
+
+#include <set>
+#include <stdint.h>
+#include <string.h>
+
+// fixed-width bit mask
+//
+// a set of small integers (vlan ids, port numbers) stored as an array of 64-bit
+// words. membership tests and set operations (and, or, and-not) are a few
+// word operations and never allocate; iteration walks the set bits in
+// ascending order using count-trailing-zeros.
+//
+// bits at or beyond the width of the mask cannot be set and always test false.
+
+using namespace std;
+template <uint32_t BITS> class bit_mask {
+public:
+
+	static const uint32_t WIDTH = BITS;
+	static const uint32_t WORDS = (BITS + 63) / 64;
+
+	// constructor creates an empty mask
+	bit_mask() {
+		clear();
+	}
+
+	// returns a mask with a single bit set
+	static bit_mask single(uint32_t bit) {
+		bit_mask result;
+		result.set(bit);
+		return result;
+	}
+
+	// builds a mask from a set (members beyond the width are ignored)
+	static bit_mask from_set(const std::set<uint16_t>& members) {
+		bit_mask result;
+		for (const auto& it : members) {
+			result.set(it);
+		}
+		return result;
+	}
+
+	// clears all bits
+	void clear() {
+		memset(words, 0, sizeof(words));
+	}
+
+	// sets a bit. returns false if the bit is beyond the width of the mask
+	bool set(uint32_t bit) {
+		if (bit >= BITS) return false;
+		words[bit / 64] |= ((uint64_t) 1) << (bit % 64);
+		return true;
+	}
+
+	// clears a bit
+	void reset(uint32_t bit) {
+		if (bit >= BITS) return;
+		words[bit / 64] &= ~(((uint64_t) 1) << (bit % 64));
+	}
+
+	// checks if a bit is set
+	bool test(uint32_t bit) const {
+		if (bit >= BITS) return false;
+		return (words[bit / 64] >> (bit % 64)) & 1;
+	}
+
+	// checks if any/no bits are set
+	bool any() const {
+		for (uint32_t counter = 0; counter < WORDS; ++counter) {
+			if (words[counter] != 0) return true;
+		}
+		return false;
+	}
+
+	bool none() const {
+		return !any();
+	}
+
+	// returns the number of bits set
+	uint32_t count() const {
+		uint32_t result = 0;
+		for (uint32_t counter = 0; counter < WORDS; ++counter) {
+			result += __builtin_popcountll(words[counter]);
+		}
+		return result;
+	}
+
+	// returns the lowest bit set, or -1 if none
+	int first() const {
+		return next(-1);
+	}
+
+	// returns the lowest bit set above a given bit, or -1 if none
+	int next(int after) const {
+		uint32_t bit = (uint32_t) (after + 1);
+		if (bit >= BITS) return -1;
+
+		uint32_t index = bit / 64;
+		uint64_t word = words[index] & (~((uint64_t) 0) << (bit % 64));
+		while (true) {
+			if (word != 0) {
+				return index * 64 + __builtin_ctzll(word);
+			}
+			if (++index >= WORDS) return -1;
+			word = words[index];
+		}
+	}
+
+	// calls callback(bit) for every bit set, in ascending order
+	template <class callback_t> void for_each(callback_t callback) const {
+		for (uint32_t index = 0; index < WORDS; ++index) {
+			uint64_t word = words[index];
+			while (word != 0) {
+				callback((uint16_t) (index * 64 + __builtin_ctzll(word)));
+				word &= word - 1;
+			}
+		}
+	}
+
+	// set operations
+	bit_mask& operator&=(const bit_mask& other) {
+		for (uint32_t counter = 0; counter < WORDS; ++counter) {
+			words[counter] &= other.words[counter];
+		}
+		return *this;
+	}
+
+	bit_mask& operator|=(const bit_mask& other) {
+		for (uint32_t counter = 0; counter < WORDS; ++counter) {
+			words[counter] |= other.words[counter];
+		}
+		return *this;
+	}
+
+	bit_mask operator&(const bit_mask& other) const {
+		bit_mask result(*this);
+		result &= other;
+		return result;
+	}
+
+	bit_mask operator|(const bit_mask& other) const {
+		bit_mask result(*this);
+		result |= other;
+		return result;
+	}
+
+	// returns the bits of this mask that are not set in another
+	bit_mask and_not(const bit_mask& other) const {
+		bit_mask result;
+		for (uint32_t counter = 0; counter < WORDS; ++counter) {
+			result.words[counter] = words[counter] & ~other.words[counter];
+		}
+		return result;
+	}
+
+	// comparators
+	bool operator==(const bit_mask& other) const {
+		return memcmp(words, other.words, sizeof(words)) == 0;
+	}
+
+	bool operator!=(const bit_mask& other) const {
+		return !(*this == other);
+	}
+
+	// converts the mask to a set (allocates; for the non-critical paths)
+	std::set<uint16_t> to_set() const {
+		std::set<uint16_t> result;
+		for_each([&result](uint16_t bit) { result.insert(result.end(), bit); });
+		return result;
+	}
+
+private:
+	uint64_t words[WORDS];
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef __LATENCY_HISTOGRAM
+#define __LATENCY_HISTOGRAM
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+// cheap monotonic clock for latency measurements
+//
+// on x86 this reads the timestamp counter (a few nanoseconds, no system call);
+// elsewhere it falls back to the steady clock in nanoseconds. convert tick
+// counts to time with get_ns_per_tick().
+
+using namespace std;
+class cycle_clock {
+public:
+
+	// returns the current tick count
+	static uint64_t now() {
+		#if __x86_64__ || __i386__
+		return __builtin_ia32_rdtsc();
+		#else
+		return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+		#endif
+	}
+
+	// returns the length of one tick in nanoseconds. the first call calibrates
+	// the counter against the steady clock (spinning for a few milliseconds).
+	static double get_ns_per_tick() {
+		#if __x86_64__ || __i386__
+		static const double ns_per_tick = calibrate();
+		return ns_per_tick;
+		#else
+		return 1.0;
+		#endif
+	}
+
+	// converts a tick count to nanoseconds
+	static uint64_t to_ns(uint64_t ticks) {
+		return (uint64_t) (ticks * get_ns_per_tick());
+	}
+
+private:
+
+	static double calibrate() {
+		auto start_time = chrono::steady_clock::now();
+		uint64_t start_ticks = now();
+		chrono::steady_clock::time_point end_time;
+		do {
+			end_time = chrono::steady_clock::now();
+		} while (end_time - start_time < chrono::milliseconds(5));
+		uint64_t ticks = now() - start_ticks;
+		double ns = chrono::duration<double, nano>(end_time - start_time).count();
+		return ticks > 0 ? ns / ticks : 1.0;
+	}
+};
+
+// log-bucketed latency histogram
+//
+// values are counted in buckets that double in width every four buckets (each
+// power of two is split into four sub-buckets), so percentiles are accurate to
+// within 25% over the whole 64-bit range. recording is a handful of relaxed
+// atomic operations and never allocates or locks; readers may see a histogram
+// that is being updated.
+
+class latency_histogram {
+public:
+
+	static const uint32_t SUB_BITS = 2;
+	static const uint32_t SUB_BUCKETS = 1u << SUB_BITS;
+	static const uint32_t BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+	// constructor creates an empty histogram
+	latency_histogram() {
+		clear();
+	}
+
+	// records a value
+	void record(uint64_t value) {
+		buckets[get_bucket(value)].fetch_add(1, memory_order_relaxed);
+		count.fetch_add(1, memory_order_relaxed);
+		sum.fetch_add(value, memory_order_relaxed);
+		uint64_t current_max = max.load(memory_order_relaxed);
+		while (value > current_max && !max.compare_exchange_weak(current_max, value, memory_order_relaxed));
+	}
+
+	// resets all counts
+	void clear() {
+		for (uint32_t counter = 0; counter < BUCKETS; ++counter) {
+			buckets[counter].store(0, memory_order_relaxed);
+		}
+		count.store(0, memory_order_relaxed);
+		sum.store(0, memory_order_relaxed);
+		max.store(0, memory_order_relaxed);
+	}
+
+	// summary statistics
+	uint64_t get_count() const {
+		return count.load(memory_order_relaxed);
+	}
+
+	uint64_t get_max() const {
+		return max.load(memory_order_relaxed);
+	}
+
+	double get_mean() const {
+		uint64_t current_count = get_count();
+		return current_count == 0 ? 0.0 : (double) sum.load(memory_order_relaxed) / current_count;
+	}
+
+	// returns the value below which a fraction (0..1) of the recorded values
+	// fall (the upper bound of the bucket holding that percentile)
+	uint64_t get_percentile(double fraction) const {
+		uint64_t current_count = get_count();
+		if (current_count == 0) return 0;
+
+		uint64_t target = (uint64_t) (fraction * current_count);
+		if (target >= current_count) target = current_count-1;
+		uint64_t seen = 0;
+		for (uint32_t counter = 0; counter < BUCKETS; ++counter) {
+			seen += buckets[counter].load(memory_order_relaxed);
+			if (seen > target) {
+				uint64_t upper = counter+1 < BUCKETS ? get_bucket_lower_bound(counter+1)-1 : ~((uint64_t) 0);
+				return upper < get_max() ? upper : get_max();
+			}
+		}
+		return get_max();
+	}
+
+	// bucket arithmetic
+	static uint32_t get_bucket(uint64_t value) {
+		if (value < SUB_BUCKETS) return (uint32_t) value;
+		uint32_t msb = 63 - __builtin_clzll(value);
+		return (msb - SUB_BITS + 1) * SUB_BUCKETS + (uint32_t) ((value >> (msb - SUB_BITS)) & (SUB_BUCKETS-1));
+	}
+
+	static uint64_t get_bucket_lower_bound(uint32_t bucket) {
+		if (bucket < SUB_BUCKETS) return bucket;
+		uint32_t msb = bucket / SUB_BUCKETS + SUB_BITS - 1;
+		return ((uint64_t) (SUB_BUCKETS + bucket % SUB_BUCKETS)) << (msb - SUB_BITS);
+	}
+
+private:
+
+	atomic<uint64_t> buckets[BUCKETS];
+	atomic<uint64_t> count;
+	atomic<uint64_t> sum;
+	atomic<uint64_t> max;
+};
+
+#endif
@@ -107,6 +107,23 @@ void mac_address::get(uint8_t* dest) const {
 	memcpy(dest, addr, 6);
 }
 
+// setter method (packed 48-bit format)
+void mac_address::set_from_uint64(uint64_t val) {
+	for (int counter = 5; counter >= 0; --counter) {
+		addr[counter] = (uint8_t) (val & 0xff);
+		val >>= 8;
+	}
+}
+
+// getter method (packed 48-bit format)
+uint64_t mac_address::get_as_uint64() const {
+	uint64_t result = 0;
+	for (int counter = 0; counter < 6; ++counter) {
+		result = (result << 8) | addr[counter];
+	}
+	return result;
+}
+
 // generates a readable version of the mac address
 std::string mac_address::to_string() const {
 	std::string result;
@@ -47,6 +47,11 @@ public:
 	void set(const std::string& addr_in);
 	void get(uint8_t* dest) const;
 
+	// packed form: the 48-bit address in the low bits of a uint64_t, first
+	// octet most significant (useful as a compact hash key)
+	void     set_from_uint64(uint64_t val);
+	uint64_t get_as_uint64() const;
+
 	// tostring method -- returns just the address in a string
 	// no extra debug info
 	std::string to_string() const;
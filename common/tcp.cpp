@@ -1,5 +1,11 @@
 #include "tcp.h"
 
+// from <netinet/tcp.h>, which can't be included here because its struct
+// tcp_info clashes with the class of the same name
+#ifndef TCP_NODELAY
+#define TCP_NODELAY 1
+#endif
+
 // static initializers here
 mutex tcp::lock;
 tcp_global_info tcp::global_info;
@@ -439,6 +445,16 @@ bool tcp::recv_until_token(autobuf& buf, const void* token, int token_size, int
 	return recv_until_token(buf, _token, timeout_ms);
 }
 
+// disables or enables nagle's algorithm on the connection
+bool tcp::set_no_delay(bool enabled) {
+	int value = enabled ? 1 : 0;
+	if (setsockopt(socket_id, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value)) == -1) {
+		printf("tcp::set_no_delay() failed. reason: %s\n", strerror(errno));
+		return false;
+	}
+	return true;
+}
+
 // returns the raw socket descriptior
 int tcp::get_fd() const {
 	return socket_id;
@@ -154,6 +154,9 @@ public:
 	bool        recv_until_token(autobuf& buf, const autobuf& token, int timeout_ms=-1);
 	bool        recv_until_token(autobuf& buf, const void* token, int token_len, int timeout_ms=-1);
 
+	// disables nagle's algorithm so that small messages are sent immediately
+	bool        set_no_delay(bool enabled);
+
 	// for advanced use -- directly gets the socket file descriptor
 	int         get_fd() const;
 
@@ -0,0 +1,118 @@
+#ifndef __TIMER_WHEEL
+#define __TIMER_WHEEL
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+// hierarchical timer wheel
+//
+// items are scheduled to expire at an absolute tick. the wheel has four levels
+// of 64 buckets each; level n buckets span 64^n ticks, so the total horizon is
+// 64^4 ticks (later expiries are clamped). advancing the wheel only touches the
+// buckets that became due, cascading coarser buckets down as their time comes,
+// so the cost of expiry is proportional to the number of items expiring rather
+// than the number of items scheduled.
+//
+// not thread safe: the caller provides locking.
+
+using namespace std;
+template <class T> class timer_wheel {
+public:
+
+	// constructor
+	timer_wheel(uint32_t start_tick=0):current_tick(start_tick), count(0) {}
+
+	// drops all scheduled items and restarts the wheel at a given tick
+	void clear(uint32_t start_tick) {
+		for (uint32_t level = 0; level < LEVELS; ++level) {
+			for (uint32_t slot = 0; slot < SLOTS; ++slot) {
+				buckets[level][slot].clear();
+			}
+		}
+		current_tick = start_tick;
+		count = 0;
+	}
+
+	// schedules an item. items due at or before the current tick fire on the
+	// next advance. returns the (possibly clamped) tick the item will fire at.
+	uint32_t schedule(const T& item, uint32_t expiry_tick) {
+		if ((int32_t) (expiry_tick - current_tick) <= 0) {
+			expiry_tick = current_tick+1;
+		}
+		return place(item, expiry_tick);
+	}
+
+	// advances the wheel up to and including now_tick, calling
+	// callback(item, expiry_tick) for every item that became due
+	template <class callback_t> void advance(uint32_t now_tick, callback_t callback) {
+		vector<pair<T, uint32_t>> due;
+		while ((int32_t) (now_tick - current_tick) > 0) {
+			++current_tick;
+
+			// cascade coarser levels whose bucket boundary was reached
+			for (uint32_t level = 1; level < LEVELS; ++level) {
+				if ((current_tick & ((1u << (BITS*level))-1)) != 0) break;
+				vector<pair<T, uint32_t>> cascaded;
+				cascaded.swap(buckets[level][(current_tick >> (BITS*level)) & (SLOTS-1)]);
+				count -= cascaded.size();
+				for (const auto& it : cascaded) {
+					place(it.first, it.second);
+				}
+			}
+
+			// fire the items of this tick
+			due.clear();
+			due.swap(buckets[0][current_tick & (SLOTS-1)]);
+			count -= due.size();
+			for (const auto& it : due) {
+				callback(it.first, it.second);
+			}
+		}
+	}
+
+	// returns the tick up to which the wheel has been advanced
+	uint32_t get_current_tick() const {
+		return current_tick;
+	}
+
+	// returns the number of scheduled items
+	size_t size() const {
+		return count;
+	}
+
+private:
+
+	static const uint32_t LEVELS = 4;
+	static const uint32_t BITS = 6;
+	static const uint32_t SLOTS = 1u << BITS;
+
+	vector<pair<T, uint32_t>> buckets[LEVELS][SLOTS];
+	uint32_t                  current_tick;
+	size_t                    count;
+
+	// puts an item in the bucket matching its distance from the current tick.
+	// items due now go into the bucket that is about to fire (used when
+	// cascading).
+	uint32_t place(const T& item, uint32_t expiry_tick) {
+		uint32_t delta = expiry_tick - current_tick;
+		if ((int32_t) delta < 0) {
+			delta = 0;
+			expiry_tick = current_tick;
+		}
+
+		uint32_t level = 0;
+		while (level < LEVELS-1 && delta >= (1u << (BITS*(level+1)))) {
+			++level;
+		}
+		if (level == LEVELS-1 && delta >= (1u << (BITS*LEVELS))) {
+			expiry_tick = current_tick + (1u << (BITS*LEVELS)) - 1;
+		}
+
+		buckets[level][(expiry_tick >> (BITS*level)) & (SLOTS-1)].push_back(make_pair(item, expiry_tick));
+		++count;
+		return expiry_tick;
+	}
+};
+
+#endif
@@ -0,0 +1,161 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "services/cam_table.h"
+using namespace std;
+
+// cam table benchmark
+//
+// fills the flat cam table with a working set of macs spread across vlans,
+// then measures learn (new and refresh) and lookup rates, single-threaded and
+// with concurrent readers running against a writer that keeps moving macs
+// between ports, and the cost of flushing one port.
+//
+// the concurrent readers share the machine with the writer, so their wall clock
+// rate drops whenever there are fewer cores than threads. the rate per cpu
+// second of the readers is the one to compare with the single-threaded lookups.
+
+// generates the mac address for a given index (locally administered range)
+static mac_address make_mac(uint32_t index) {
+	mac_address result;
+	result.set_from_uint64(0x020000000000ULL | ((uint64_t) index * 2654435761ULL & 0xffffffffffULL));
+	return result;
+}
+
+// returns the cpu time used by the calling thread, in seconds
+static double thread_cpu_seconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// returns seconds elapsed since a starting time
+static double seconds_since(const chrono::steady_clock::time_point& start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+
+	uint32_t num_macs = 100000;
+	uint32_t num_vlans = 50;
+	uint32_t num_threads = thread::hardware_concurrency() > 1 ? thread::hardware_concurrency()-1 : 1;
+	uint32_t rounds = 20;
+	if (argc > 1) num_macs = atoi(argv[1]);
+	if (argc > 2) num_vlans = atoi(argv[2]);
+	if (argc > 3) num_threads = atoi(argv[3]);
+	if (num_macs == 0 || num_vlans == 0 || num_vlans > 4094 || num_threads == 0) {
+		printf("usage: %s [number of macs] [number of vlans] [reader threads]\n", argv[0]);
+		return 1;
+	}
+
+	// build the working set
+	vector<mac_address> macs;
+	vector<uint16_t> vlans;
+	for (uint32_t counter = 0; counter < num_macs; ++counter) {
+		macs.push_back(make_mac(counter));
+		vlans.push_back((uint16_t) (counter % num_vlans) + 1);
+	}
+
+	cam_table table(num_macs * 2);
+	for (uint32_t vlan_id = 1; vlan_id <= num_vlans; ++vlan_id) {
+		table.enable_vlan(vlan_id);
+	}
+	printf("cam benchmark: %u macs across %u vlans, %u reader threads.\n", num_macs, num_vlans, num_threads);
+
+	// 1. learn new entries
+	auto start = chrono::steady_clock::now();
+	for (uint32_t counter = 0; counter < num_macs; ++counter) {
+		table.insert(macs[counter], vlans[counter], (uint16_t) (counter % 48) + 1);
+	}
+	double elapsed = seconds_since(start);
+	printf("learn (new)       : %12.0f ops/s  (%u entries)\n", num_macs / elapsed, table.size());
+
+	// 2. refresh existing entries (the common case for the cam filter)
+	start = chrono::steady_clock::now();
+	for (uint32_t round = 0; round < rounds; ++round) {
+		for (uint32_t counter = 0; counter < num_macs; ++counter) {
+			table.insert(macs[counter], vlans[counter], (uint16_t) (counter % 48) + 1);
+		}
+	}
+	elapsed = seconds_since(start);
+	printf("learn (refresh)   : %12.0f ops/s\n", (double) num_macs * rounds / elapsed);
+
+	// 3. single-threaded lookups
+	uint64_t checksum = 0;
+	start = chrono::steady_clock::now();
+	for (uint32_t round = 0; round < rounds; ++round) {
+		for (uint32_t counter = 0; counter < num_macs; ++counter) {
+			checksum += table.lookup_port_for(macs[counter], vlans[counter]);
+		}
+	}
+	elapsed = seconds_since(start);
+	printf("lookup (1 thread) : %12.0f ops/s\n", (double) num_macs * rounds / elapsed);
+
+	// 4. lookups that miss (wrong vlan)
+	start = chrono::steady_clock::now();
+	for (uint32_t round = 0; round < rounds; ++round) {
+		for (uint32_t counter = 0; counter < num_macs; ++counter) {
+			checksum += table.lookup_port_for(macs[counter], 4095);
+		}
+	}
+	elapsed = seconds_since(start);
+	printf("lookup (miss)     : %12.0f ops/s\n", (double) num_macs * rounds / elapsed);
+
+	// 5. concurrent lookups with a writer refreshing and moving entries
+	atomic<bool> stop(false);
+	atomic<uint64_t> total_lookups(0);
+	atomic<uint64_t> total_checksum(0);
+	atomic<uint64_t> reader_cpu_us(0);
+	vector<thread> readers;
+	start = chrono::steady_clock::now();
+	for (uint32_t thread_id = 0; thread_id < num_threads; ++thread_id) {
+		readers.push_back(thread([&, thread_id]() {
+			uint64_t local_lookups = 0;
+			uint64_t local_checksum = 0;
+			uint32_t index = thread_id * 7919;
+			double cpu_start = thread_cpu_seconds();
+			while (!stop.load(memory_order_relaxed)) {
+				for (uint32_t counter = 0; counter < 1024; ++counter) {
+					index = (index + 1) % num_macs;
+					local_checksum += table.lookup_port_for(macs[index], vlans[index]);
+				}
+				local_lookups += 1024;
+			}
+			total_lookups += local_lookups;
+			total_checksum += local_checksum;
+			reader_cpu_us += (uint64_t) ((thread_cpu_seconds() - cpu_start) * 1e6);
+		}));
+	}
+
+	uint64_t writes = 0;
+	while (seconds_since(start) < 2.0) {
+		for (uint32_t counter = 0; counter < 1024; ++counter) {
+			uint32_t index = (uint32_t) (writes % num_macs);
+			table.insert(macs[index], vlans[index], (uint16_t) ((writes / num_macs) % 48) + 1);
+			++writes;
+		}
+	}
+	stop = true;
+	for (auto& reader : readers) {
+		reader.join();
+	}
+	elapsed = seconds_since(start);
+	checksum += total_checksum;
+	printf("lookup (%2u threads): %11.0f ops/s  (%.0f ops per reader cpu second, writer: %.0f port moves/s)\n", num_threads,
+		total_lookups.load() / elapsed, total_lookups.load() / (reader_cpu_us.load() / 1e6), writes / elapsed);
+
+	// 6. port flush (e.g. a trunk port going down)
+	uint32_t entries_before = table.size();
+	start = chrono::steady_clock::now();
+	table.remove((uint16_t) 1);
+	elapsed = seconds_since(start);
+	printf("port flush        : %12.3f ms  (%u entries removed)\n", elapsed * 1000, entries_before - table.size());
+
+	printf("sampled lookups: %" PRIu64 ", misses: %" PRIu64 ". checksum %" PRIu64 ".\n",
+		table.get_lookup_count(), table.get_lookup_miss_count(), checksum);
+	return 0;
+}
@@ -0,0 +1,441 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include "hal/hal.h"
+#include "gui/output.h"
+#include "emulator/emulated_switch.h"
+#include "services/arp.h"
+#include "services/cam.h"
+#include "services/flow_service.h"
+#include "services/flow_policy_checker.h"
+#include "services/switch_state.h"
+#include "services/dell_s48xx_l2_table.h"
+#include "../common/std_packet.h"
+using namespace std;
+
+// controller throughput benchmark (cbench-style)
+//
+// runs the real hal, packet_in_processor, cam and flow_policy_checker stack in
+// this process and connects an emulated switch to it over localhost. every
+// packet_in carries a source mac that has never been seen, so the l2
+// accelerator answers each one with a flow_mod (dl_dst=src, vlan -> in_port)
+// and floods the packet with a packet_out.
+//
+// latency mode keeps one packet_in outstanding and times packet_in -> flow_mod.
+// throughput mode sends packet_ins as fast as the connection accepts them and
+// counts the responses that arrive within the same window (like cbench). the
+// results are written as json so that builds can be compared.
+
+// needed by the flow tables (normally defined by the ironstack executive)
+string switch_name = "benchmark";
+
+// results of one benchmark mode
+class mode_result {
+public:
+	mode_result():packet_ins_sent(0), flow_mods_received(0), packet_outs_received(0), lost(0), elapsed_sec(0.0) {}
+
+	string           name;
+	uint64_t         packet_ins_sent;
+	uint64_t         flow_mods_received;
+	uint64_t         packet_outs_received;
+	uint64_t         lost;                  // packet_ins without a flow_mod in time (latency mode)
+	double           elapsed_sec;
+	vector<uint64_t> latencies_ns;          // packet_in -> flow_mod (one per handled packet_in)
+};
+
+// tracks packet_in send times and matches them to flow_mods as they arrive
+class response_tracker {
+public:
+
+	response_tracker(uint64_t max_sources):send_times(new atomic<uint64_t>[max_sources]),
+		max_sources(max_sources),
+		waiting_for(-1),
+		flow_mods(0),
+		packet_outs(0) {
+		for (uint64_t counter = 0; counter < max_sources; ++counter) {
+			send_times[counter] = 0;
+		}
+	}
+
+	// the source mac for a given packet index (locally administered range)
+	static mac_address get_source_mac(uint64_t index) {
+		mac_address result;
+		result.set_from_uint64(0x020000000000ULL | index);
+		return result;
+	}
+
+	// called right before a packet_in is sent
+	void sent(uint64_t index) {
+		send_times[index] = get_time_ns();
+	}
+
+	// flow_mod observer (runs on the emulated switch receive thread)
+	void on_flow_mod(const of_message_modify_flow& flow_mod) {
+		++flow_mods;
+		uint64_t index = flow_mod.flow_description.criteria.ethernet_dest.get_as_uint64() & 0xffffffffffULL;
+		if (index >= max_sources) {
+			return;
+		}
+		uint64_t start = send_times[index].exchange(0);
+		if (start == 0) {
+			return;
+		}
+		uint64_t now = get_time_ns();
+		lock_guard<mutex> g(lock);
+		latencies_ns.push_back(now - start);
+		if (waiting_for == (int64_t) index) {
+			waiting_for = -1;
+			cond.notify_one();
+		}
+	}
+
+	// packet_out observer (runs on the emulated switch receive thread)
+	void on_packet_out(const of_message_packet_out& packet_out) {
+		++packet_outs;
+	}
+
+	// latency mode: sends through the given function and waits for the flow_mod
+	bool send_and_wait(uint64_t index, const function<bool()>& send, int timeout_ms) {
+		unique_lock<mutex> g(lock);
+		waiting_for = index;
+		g.unlock();
+		sent(index);
+		if (!send()) {
+			return false;
+		}
+		g.lock();
+		bool answered = cond.wait_for(g, chrono::milliseconds(timeout_ms), [&]() { return waiting_for == -1; });
+		if (!answered) {
+			waiting_for = -1;
+			send_times[index] = 0;
+		}
+		return answered;
+	}
+
+	// moves the collected latencies out
+	vector<uint64_t> take_latencies() {
+		lock_guard<mutex> g(lock);
+		vector<uint64_t> result;
+		result.swap(latencies_ns);
+		return result;
+	}
+
+	static uint64_t get_time_ns() {
+		return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	unique_ptr<atomic<uint64_t>[]> send_times;
+	uint64_t                       max_sources;
+	mutex                          lock;
+	condition_variable             cond;
+	int64_t                        waiting_for;
+	vector<uint64_t>               latencies_ns;
+	atomic<uint64_t>               flow_mods;
+	atomic<uint64_t>               packet_outs;
+};
+
+// returns seconds elapsed since a starting time
+static double seconds_since(const chrono::steady_clock::time_point& start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// builds the frame that every packet_in carries (the source mac is patched in)
+static void build_template_frame(autobuf& frame, uint16_t vlan_id) {
+	udp_packet packet;
+	packet.has_vlan_tag = true;
+	packet.vlan_id = vlan_id;
+	packet.src_mac = response_tracker::get_source_mac(0);
+	packet.dest_mac.set_from_uint64(0x04000000beefULL);
+	packet.src_ip = ip_address("10.0.0.1");
+	packet.dest_ip = ip_address("10.0.0.2");
+	packet.src_port = 1024;
+	packet.dest_port = 9;
+	packet.udp_payload.create_empty_buffer(18, true);
+	packet.serialize(frame);
+}
+
+// patches the source mac of the template frame
+static void set_frame_source(autobuf& frame, uint64_t index) {
+	response_tracker::get_source_mac(index).get((uint8_t*) frame.ptr_offset_mutable(6));
+}
+
+// gets a percentile from sorted samples
+static uint64_t get_percentile(const vector<uint64_t>& sorted, double percentile) {
+	if (sorted.empty()) {
+		return 0;
+	}
+	size_t index = (size_t) (percentile / 100.0 * (sorted.size()-1) + 0.5);
+	return sorted[min(index, sorted.size()-1)];
+}
+
+// writes the results of one mode as a json object
+static void write_mode_json(FILE* fp, const mode_result& result, bool last) {
+	vector<uint64_t> sorted(result.latencies_ns);
+	sort(sorted.begin(), sorted.end());
+	double mean = 0.0;
+	for (const auto& value : sorted) {
+		mean += value;
+	}
+	mean = sorted.empty() ? 0.0 : mean / sorted.size();
+	double elapsed = result.elapsed_sec > 0.0 ? result.elapsed_sec : 1.0;
+
+	fprintf(fp, "    \"%s\": {\n", result.name.c_str());
+	fprintf(fp, "      \"elapsed_sec\": %.3f,\n", result.elapsed_sec);
+	fprintf(fp, "      \"packet_ins_sent\": %" PRIu64 ",\n", result.packet_ins_sent);
+	fprintf(fp, "      \"flow_mods_received\": %" PRIu64 ",\n", result.flow_mods_received);
+	fprintf(fp, "      \"packet_outs_received\": %" PRIu64 ",\n", result.packet_outs_received);
+	fprintf(fp, "      \"lost\": %" PRIu64 ",\n", result.lost);
+	fprintf(fp, "      \"packet_ins_sent_per_sec\": %.1f,\n", result.packet_ins_sent / elapsed);
+	fprintf(fp, "      \"packet_ins_per_sec\": %.1f,\n", sorted.size() / elapsed);
+	fprintf(fp, "      \"flow_mods_per_sec\": %.1f,\n", result.flow_mods_received / elapsed);
+	fprintf(fp, "      \"latency_us\": {\n");
+	fprintf(fp, "        \"samples\": %zu,\n", sorted.size());
+	fprintf(fp, "        \"min\": %.1f,\n", sorted.empty() ? 0.0 : sorted.front() / 1000.0);
+	fprintf(fp, "        \"mean\": %.1f,\n", mean / 1000.0);
+	fprintf(fp, "        \"p50\": %.1f,\n", get_percentile(sorted, 50) / 1000.0);
+	fprintf(fp, "        \"p90\": %.1f,\n", get_percentile(sorted, 90) / 1000.0);
+	fprintf(fp, "        \"p99\": %.1f,\n", get_percentile(sorted, 99) / 1000.0);
+	fprintf(fp, "        \"p999\": %.1f,\n", get_percentile(sorted, 99.9) / 1000.0);
+	fprintf(fp, "        \"max\": %.1f\n", sorted.empty() ? 0.0 : sorted.back() / 1000.0);
+	fprintf(fp, "      }\n");
+	fprintf(fp, "    }%s\n", last ? "" : ",");
+}
+
+// prints a one-line summary of a mode
+static void print_mode(const mode_result& result) {
+	vector<uint64_t> sorted(result.latencies_ns);
+	sort(sorted.begin(), sorted.end());
+	double elapsed = result.elapsed_sec > 0.0 ? result.elapsed_sec : 1.0;
+	printf("%-10s: %10.0f packet_ins/s  %10.0f flow_mods/s  latency p50 %8.1f us  p99 %8.1f us  (%" PRIu64 " sent, %" PRIu64 " lost)\n",
+		result.name.c_str(), sorted.size() / elapsed, result.flow_mods_received / elapsed,
+		get_percentile(sorted, 50) / 1000.0, get_percentile(sorted, 99) / 1000.0,
+		result.packet_ins_sent, result.lost);
+}
+
+static void usage(const char* name) {
+	printf("usage: %s [options]\n"
+		"  --port [n]             local openflow port (default 16633)\n"
+		"  --duration [n]         seconds per mode (default 5)\n"
+		"  --packets [n]          maximum packet_ins per mode (default 200000)\n"
+		"  --ports [n]            number of switch ports (default 48)\n"
+		"  --mode [latency|throughput|both] (default both)\n"
+		"  --output [file]        json results (default controller_benchmark.json)\n"
+		"  --capture [file]       record the openflow session (replay with session_replay)\n"
+		"  --capture-size [n]     capture ring size in MiB (default 64)\n", name);
+}
+
+int main(int argc, char** argv) {
+
+	uint16_t port = 16633;
+	uint32_t duration = 5;
+	uint64_t max_packets = 200000;
+	uint32_t num_ports = 48;
+	string mode = "both";
+	string output_filename = "controller_benchmark.json";
+	string capture_filename;
+	uint64_t capture_bytes = session_capture::DEFAULT_MAX_BYTES;
+	const uint16_t vlan_id = 1;
+
+	for (int counter = 1; counter < argc; ++counter) {
+		const char* option = argv[counter];
+		if (counter+1 >= argc) {
+			usage(argv[0]);
+			return 1;
+		}
+		const char* value = argv[++counter];
+		if (strcmp(option, "--port") == 0) {
+			port = atoi(value);
+		} else if (strcmp(option, "--duration") == 0) {
+			duration = atoi(value);
+		} else if (strcmp(option, "--packets") == 0) {
+			max_packets = strtoull(value, nullptr, 0);
+		} else if (strcmp(option, "--ports") == 0) {
+			num_ports = atoi(value);
+		} else if (strcmp(option, "--mode") == 0) {
+			mode = value;
+		} else if (strcmp(option, "--output") == 0) {
+			output_filename = value;
+		} else if (strcmp(option, "--capture") == 0) {
+			capture_filename = value;
+		} else if (strcmp(option, "--capture-size") == 0) {
+			capture_bytes = strtoull(value, nullptr, 0) << 20;
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (port == 0 || duration == 0 || max_packets == 0 || num_ports == 0 || num_ports > 0xff00 ||
+		(mode != "latency" && mode != "throughput" && mode != "both")) {
+		usage(argv[0]);
+		return 1;
+	}
+	bool run_latency = (mode != "throughput");
+	bool run_throughput = (mode != "latency");
+
+	// per-flow installation messages would dominate the run
+	output::set_log_level(output::loglevel::WARNING);
+
+	// controller and services, set up as the ironstack executive does (without
+	// the switch database and telnet configuration)
+	shared_ptr<hal> controller(new hal());
+	shared_ptr<cam> cam_service = make_shared<cam>(controller->get_service_catalog());
+	shared_ptr<arp> arp_service = make_shared<arp>(controller->get_service_catalog());
+	shared_ptr<switch_state> sw_state = make_shared<switch_state>(controller->get_service_catalog());
+	shared_ptr<flow_service> flow_svc = make_shared<flow_service>(controller->get_service_catalog());
+	shared_ptr<flow_policy_checker> flow_policy_svc = make_shared<flow_policy_checker>(controller->get_service_catalog());
+	set<shared_ptr<service>> services = { cam_service, arp_service, sw_state, flow_svc, flow_policy_svc };
+
+	sw_state->set_switch_ip(ip_address("10.255.255.254"));
+	sw_state->set_name("ironstack_benchmark");
+	set<uint16_t> all_ports;
+	for (uint16_t counter = 1; counter <= num_ports; ++counter) {
+		all_ports.insert(counter);
+	}
+	sw_state->set_vlan_ports(all_ports, vlan_id);
+	sw_state->set_vlan_port_tagging(all_ports, true);
+	sw_state->set_vlan_flood_ports(all_ports, vlan_id);
+	cam_service->create_cam_table(vlan_id);
+	arp_service->create_arp_table(vlan_id);
+
+	// every packet_in installs one flow
+	uint64_t max_sources = max_packets * 2;
+	shared_ptr<dell_s48xx_l2_table> l2_table = make_shared<dell_s48xx_l2_table>();
+	l2_table->set_max_capacity(max_sources + 1000);
+	flow_svc->attach_flow_table(l2_table);
+
+	if (!capture_filename.empty() && !controller->start_capture(capture_filename, capture_bytes)) {
+		printf("error: unable to create capture file %s.\n", capture_filename.c_str());
+		return 1;
+	}
+
+	// the controller blocks in init() until the switch connects
+	atomic<bool> init_ok(false);
+	thread init_tid([&]() {
+		init_ok = controller->init(port, services, set<ip_address>{ ip_address("127.0.0.1") });
+	});
+
+	// the emulated switch only counts flow_mods (like cbench) so that the switch
+	// side stays cheap
+	emulated_switch::config switch_settings;
+	switch_settings.num_ports = num_ports;
+	switch_settings.keep_flow_table = false;
+	emulated_switch sw(switch_settings);
+	response_tracker tracker(max_sources);
+	sw.set_flow_mod_observer([&](const of_message_modify_flow& flow_mod) { tracker.on_flow_mod(flow_mod); });
+	sw.set_packet_out_observer([&](const of_message_packet_out& packet_out) { tracker.on_packet_out(packet_out); });
+
+	bool connected = false;
+	for (int attempt = 0; attempt < 50 && !connected; ++attempt) {
+		this_thread::sleep_for(chrono::milliseconds(100));
+		connected = sw.connect("127.0.0.1", port);
+	}
+	if (!connected || !sw.start(nullptr, 0)) {
+		printf("error: the emulated switch could not connect to the controller on port %hu.\n", port);
+		_exit(1);
+	}
+	init_tid.join();
+	if (!init_ok) {
+		printf("error: controller initialization failed.\n");
+		sw.shutdown();
+		return 1;
+	}
+	printf("controller benchmark: %u ports, %u s per mode, up to %" PRIu64 " packet_ins per mode.\n",
+		num_ports, duration, max_packets);
+
+	autobuf frame;
+	build_template_frame(frame, vlan_id);
+	uint64_t next_index = 1;
+	vector<mode_result> results;
+
+	// 1. latency mode: one packet_in outstanding
+	if (run_latency) {
+		mode_result result;
+		result.name = "latency";
+		uint64_t flow_mods_before = tracker.flow_mods, packet_outs_before = tracker.packet_outs;
+		tracker.take_latencies();
+
+		auto start = chrono::steady_clock::now();
+		uint64_t last_index = next_index + max_packets;
+		while (next_index < last_index && seconds_since(start) < duration && sw.is_connected()) {
+			uint64_t index = next_index++;
+			set_frame_source(frame, index);
+			if (!tracker.send_and_wait(index, [&]() { return sw.send_packet_in(frame, (uint16_t) (index % num_ports) + 1); }, 1000)) {
+				++result.lost;
+			}
+			++result.packet_ins_sent;
+		}
+		result.elapsed_sec = seconds_since(start);
+		result.flow_mods_received = tracker.flow_mods - flow_mods_before;
+		result.packet_outs_received = tracker.packet_outs - packet_outs_before;
+		result.latencies_ns = tracker.take_latencies();
+		print_mode(result);
+		results.push_back(result);
+	}
+
+	// 2. throughput mode: as many packet_ins as the connection accepts
+	if (run_throughput) {
+		mode_result result;
+		result.name = "throughput";
+		uint64_t flow_mods_before = tracker.flow_mods, packet_outs_before = tracker.packet_outs;
+		tracker.take_latencies();
+
+		auto start = chrono::steady_clock::now();
+		uint64_t last_index = next_index + max_packets;
+		while (next_index < last_index && seconds_since(start) < duration && sw.is_connected()) {
+			for (uint32_t counter = 0; counter < 64 && next_index < last_index; ++counter) {
+				uint64_t index = next_index++;
+				set_frame_source(frame, index);
+				tracker.sent(index);
+				sw.send_packet_in(frame, (uint16_t) (index % num_ports) + 1);
+				++result.packet_ins_sent;
+			}
+		}
+
+		// responses are counted over the same window (the backlog is not drained)
+		result.elapsed_sec = seconds_since(start);
+		result.flow_mods_received = tracker.flow_mods - flow_mods_before;
+		result.packet_outs_received = tracker.packet_outs - packet_outs_before;
+		result.latencies_ns = tracker.take_latencies();
+		print_mode(result);
+		results.push_back(result);
+	}
+
+	// write results
+	FILE* fp = fopen(output_filename.c_str(), "w");
+	if (fp == nullptr) {
+		printf("error: unable to write %s.\n", output_filename.c_str());
+	} else {
+		fprintf(fp, "{\n");
+		fprintf(fp, "  \"benchmark\": \"controller\",\n");
+		fprintf(fp, "  \"build\": \"%s %s\",\n", __DATE__, __TIME__);
+		fprintf(fp, "  \"ports\": %u,\n", num_ports);
+		fprintf(fp, "  \"duration_sec\": %u,\n", duration);
+		fprintf(fp, "  \"max_packets\": %" PRIu64 ",\n", max_packets);
+		fprintf(fp, "  \"modes\": {\n");
+		for (size_t counter = 0; counter < results.size(); ++counter) {
+			write_mode_json(fp, results[counter], counter+1 == results.size());
+		}
+		fprintf(fp, "  }\n");
+		fprintf(fp, "}\n");
+		fclose(fp);
+		printf("results written to %s.\n", output_filename.c_str());
+	}
+
+	// the controller is not shut down: it would first work through the backlog
+	// that throughput mode leaves in its queues
+	controller->stop_capture();
+	fflush(stdout);
+	_exit(0);
+}
@@ -0,0 +1,335 @@
+#include <arpa/inet.h>
+#include <string.h>
+#include "emulated_flow_table.h"
+#include "../../common/openflow.h"
+
+// constructor
+emulated_flow_table::emulated_flow_table(uint32_t max_entries_):max_entries(max_entries_),
+	lookup_count(0),
+	matched_count(0) {
+}
+
+// applies a flow_mod to the table
+emulated_flow_table::mod_result emulated_flow_table::apply(const of_message_modify_flow& flow_mod,
+	vector<of_message_flow_removed>& removed) {
+
+	const openflow_flow_description& description = flow_mod.flow_description;
+	of_packed_match criteria(description.criteria);
+	lock_guard<mutex> g(lock);
+
+	switch (flow_mod.command) {
+		case OFPFC_ADD:
+		{
+			// an identical flow is replaced (and its counters reset)
+			for (uint32_t counter = 0; counter < flows.size(); ++counter) {
+				const flow_entry& current = flows[counter];
+				if (current.description.priority == description.priority && current.criteria == criteria) {
+					flows.erase(flows.begin() + counter);
+					insert_flow(flow_mod, criteria);
+					return mod_result::APPLIED;
+				}
+			}
+
+			// overlap is approximated as one match being a subset of the other
+			if (flow_mod.flag_check_overlap) {
+				for (const auto& flow : flows) {
+					if (flow.description.priority == description.priority &&
+						(flow.criteria < criteria || criteria < flow.criteria)) {
+						return mod_result::OVERLAP;
+					}
+				}
+			}
+
+			if (flows.size() >= max_entries) {
+				return mod_result::TABLE_FULL;
+			}
+			insert_flow(flow_mod, criteria);
+			return mod_result::APPLIED;
+		}
+
+		case OFPFC_MODIFY:
+		case OFPFC_MODIFY_STRICT:
+		{
+			// modifies keep the counters of the flows they update
+			bool strict = (flow_mod.command == OFPFC_MODIFY_STRICT);
+			bool found = false;
+			for (auto& flow : flows) {
+				if (strict ? (flow.description.priority == description.priority && flow.criteria == criteria)
+					: (flow.criteria < criteria)) {
+					flow.description.action_list = description.action_list;
+					flow.description.cookie = description.cookie;
+					found = true;
+				}
+			}
+
+			// a modify that matches nothing behaves like an add
+			if (!found) {
+				if (flows.size() >= max_entries) {
+					return mod_result::TABLE_FULL;
+				}
+				insert_flow(flow_mod, criteria);
+			}
+			return mod_result::APPLIED;
+		}
+
+		case OFPFC_DELETE:
+		case OFPFC_DELETE_STRICT:
+		{
+			bool strict = (flow_mod.command == OFPFC_DELETE_STRICT);
+			for (uint32_t counter = 0; counter < flows.size();) {
+				const flow_entry& flow = flows[counter];
+				bool selected = strict ? (flow.description.priority == description.priority && flow.criteria == criteria)
+					: (flow.criteria < criteria);
+				if (selected && (!flow_mod.use_out_port || outputs_to_port(flow.description.action_list, flow_mod.out_port))) {
+					remove_flow(counter, (uint8_t) OFPRR_DELETE, &removed);
+				} else {
+					++counter;
+				}
+			}
+			return mod_result::APPLIED;
+		}
+
+		default:
+			return mod_result::BAD_COMMAND;
+	}
+}
+
+// looks up a packet and updates the flow counters
+bool emulated_flow_table::lookup(const of_packed_match& packet, uint32_t packet_len, openflow_action_list& actions) {
+	lock_guard<mutex> g(lock);
+	++lookup_count;
+
+	// flows are kept in descending priority, so the first hit wins
+	for (auto& flow : flows) {
+		if (packet < flow.criteria) {
+			++matched_count;
+			++flow.packet_count;
+			flow.byte_count += packet_len;
+			flow.last_used = chrono::steady_clock::now();
+			actions = flow.description.action_list;
+			return true;
+		}
+	}
+	return false;
+}
+
+// removes flows whose idle or hard timeout elapsed
+void emulated_flow_table::expire(vector<of_message_flow_removed>& removed) {
+	time_point now = chrono::steady_clock::now();
+	lock_guard<mutex> g(lock);
+
+	for (uint32_t counter = 0; counter < flows.size();) {
+		const flow_entry& flow = flows[counter];
+		if (flow.hard_timeout != 0 && now - flow.created >= chrono::seconds(flow.hard_timeout)) {
+			remove_flow(counter, (uint8_t) OFPRR_HARD_TIMEOUT, &removed);
+		} else if (flow.idle_timeout != 0 && now - flow.last_used >= chrono::seconds(flow.idle_timeout)) {
+			remove_flow(counter, (uint8_t) OFPRR_IDLE_TIMEOUT, &removed);
+		} else {
+			++counter;
+		}
+	}
+}
+
+// removes all flows
+void emulated_flow_table::clear() {
+	lock_guard<mutex> g(lock);
+	flows.clear();
+}
+
+// gets the statistics of every flow selected by the criteria
+vector<openflow_flow_description_and_stats> emulated_flow_table::get_flow_stats(const of_match& criteria_,
+	bool restrict_out_port, uint16_t out_port) const {
+
+	vector<openflow_flow_description_and_stats> result;
+	of_packed_match criteria(criteria_);
+	time_point now = chrono::steady_clock::now();
+	lock_guard<mutex> g(lock);
+
+	for (const auto& flow : flows) {
+		if (flow.criteria < criteria && (!restrict_out_port || outputs_to_port(flow.description.action_list, out_port))) {
+			result.push_back(get_stats(flow, now));
+		}
+	}
+	return result;
+}
+
+// gets the aggregate statistics of the flows selected by the criteria
+openflow_aggregate_stats emulated_flow_table::get_aggregate_stats(const of_match& criteria_,
+	bool restrict_out_port, uint16_t out_port) const {
+
+	openflow_aggregate_stats result;
+	of_packed_match criteria(criteria_);
+	result.clear();
+	lock_guard<mutex> g(lock);
+
+	for (const auto& flow : flows) {
+		if (flow.criteria < criteria && (!restrict_out_port || outputs_to_port(flow.description.action_list, out_port))) {
+			result.packet_count += flow.packet_count;
+			result.byte_count += flow.byte_count;
+			++result.flow_count;
+		}
+	}
+	return result;
+}
+
+// returns the number of installed flows
+uint32_t emulated_flow_table::size() const {
+	lock_guard<mutex> g(lock);
+	return flows.size();
+}
+
+// returns the capacity of the table
+uint32_t emulated_flow_table::get_max_entries() const {
+	return max_entries;
+}
+
+// returns the number of packets looked up
+uint64_t emulated_flow_table::get_lookup_count() const {
+	lock_guard<mutex> g(lock);
+	return lookup_count;
+}
+
+// returns the number of packets that hit a flow
+uint64_t emulated_flow_table::get_matched_count() const {
+	lock_guard<mutex> g(lock);
+	return matched_count;
+}
+
+// builds the exact match of an ethernet frame as received on a port. follows
+// the openflow 1.0 conventions: arp opcode and addresses are matched as the ip
+// protocol and addresses, icmp type and code as the transport ports. the match
+// is filled in wire order, so most fields are copied straight from the frame.
+of_packed_match emulated_flow_table::get_packet_match(const autobuf& frame, uint16_t in_port) {
+	const uint8_t* data = (const uint8_t*) frame.get_content_ptr();
+	uint32_t len = frame.size();
+	uint32_t offset = 12;
+	struct ofp_match result;
+
+	memset(&result, 0, sizeof(result));
+	result.in_port = htons(in_port);
+	result.dl_vlan = htons((uint16_t) OFP_VLAN_NONE);
+	if (len < 14) {
+		return of_packed_match(result);
+	}
+
+	memcpy(result.dl_dst, data, OFP_ETH_ALEN);
+	memcpy(result.dl_src, data+6, OFP_ETH_ALEN);
+	uint16_t ethertype = (data[offset] << 8) | data[offset+1];
+	if (ethertype == 0x8100 && len >= 18) {
+		uint16_t tci = (data[offset+2] << 8) | data[offset+3];
+		result.dl_vlan = htons(tci & 0x0fff);
+		result.dl_vlan_pcp = tci >> 13;
+		offset += 4;
+		ethertype = (data[offset] << 8) | data[offset+1];
+	}
+	memcpy(&result.dl_type, data+offset, sizeof(result.dl_type));
+	offset += 2;
+
+	if (ethertype == 0x0806 && len >= offset + 28) {
+
+		// arp
+		result.nw_proto = data[offset+7];
+		memcpy(&result.nw_src, data+offset+14, sizeof(result.nw_src));
+		memcpy(&result.nw_dst, data+offset+24, sizeof(result.nw_dst));
+
+	} else if (ethertype == 0x0800 && len >= offset + 20) {
+
+		// ipv4 (and tcp/udp/icmp if this is the first fragment)
+		uint32_t ihl = (data[offset] & 0x0f) * 4;
+		uint16_t fragment_offset = ((data[offset+6] & 0x1f) << 8) | data[offset+7];
+		result.nw_tos = data[offset+1] & 0xfc;
+		result.nw_proto = data[offset+9];
+		memcpy(&result.nw_src, data+offset+12, sizeof(result.nw_src));
+		memcpy(&result.nw_dst, data+offset+16, sizeof(result.nw_dst));
+
+		offset += ihl;
+		if (fragment_offset == 0 && len >= offset + 4) {
+			if (result.nw_proto == 6 || result.nw_proto == 17) {
+				memcpy(&result.tp_src, data+offset, sizeof(result.tp_src));
+				memcpy(&result.tp_dst, data+offset+2, sizeof(result.tp_dst));
+			} else if (result.nw_proto == 1) {
+				result.tp_src = htons(data[offset]);
+				result.tp_dst = htons(data[offset+1]);
+			}
+		}
+	}
+	return of_packed_match(result);
+}
+
+// inserts a flow at its priority position (lock must be held)
+void emulated_flow_table::insert_flow(const of_message_modify_flow& flow_mod, const of_packed_match& criteria) {
+	flow_entry flow;
+	flow.description = flow_mod.flow_description;
+	flow.criteria = criteria;
+	flow.idle_timeout = flow_mod.idle_timeout;
+	flow.hard_timeout = flow_mod.hard_timeout;
+	flow.send_flow_removed = flow_mod.flag_send_flow_removal_message;
+	flow.created = chrono::steady_clock::now();
+	flow.last_used = flow.created;
+	flow.packet_count = 0;
+	flow.byte_count = 0;
+
+	auto iterator = flows.begin();
+	while (iterator != flows.end() && iterator->description.priority >= flow.description.priority) {
+		++iterator;
+	}
+	flows.insert(iterator, flow);
+}
+
+// removes a flow, generating a flow_removed message if it asked for one (lock
+// must be held)
+void emulated_flow_table::remove_flow(uint32_t index, uint8_t reason, vector<of_message_flow_removed>* removed) {
+	if (removed != nullptr && flows[index].send_flow_removed) {
+		removed->push_back(get_flow_removed(flows[index], reason, chrono::steady_clock::now()));
+	}
+	flows.erase(flows.begin() + index);
+}
+
+// checks if an action list outputs to a port
+bool emulated_flow_table::outputs_to_port(const openflow_action_list& actions, uint16_t port) {
+	of_action_output_to_port output;
+	for (uint32_t index = 0; index < actions.size(); ++index) {
+		if (!actions.get_action(index, output)) {
+			continue;
+		}
+		if (output.send_to_controller ? (port == (uint16_t) OFPP_CONTROLLER) : (output.port == port)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// generates the flow_removed message for a flow
+of_message_flow_removed emulated_flow_table::get_flow_removed(const flow_entry& flow, uint8_t reason, const time_point& now) {
+	of_message_flow_removed result;
+	chrono::nanoseconds alive = chrono::duration_cast<chrono::nanoseconds>(now - flow.created);
+
+	result.match = flow.description.criteria;
+	result.cookie = flow.description.cookie;
+	result.priority = flow.description.priority;
+	result.reason_idle_timeout = (reason == (uint8_t) OFPRR_IDLE_TIMEOUT);
+	result.reason_hard_timeout = (reason == (uint8_t) OFPRR_HARD_TIMEOUT);
+	result.reason_manually_removed = (reason == (uint8_t) OFPRR_DELETE);
+	result.duration_alive_sec = alive.count() / 1000000000;
+	result.duration_alive_nsec = alive.count() % 1000000000;
+	result.original_idle_timeout = flow.idle_timeout;
+	result.packet_count = flow.packet_count;
+	result.byte_count = flow.byte_count;
+	return result;
+}
+
+// generates the flow stats entry for a flow
+openflow_flow_description_and_stats emulated_flow_table::get_stats(const flow_entry& flow, const time_point& now) {
+	openflow_flow_description_and_stats result;
+	chrono::nanoseconds alive = chrono::duration_cast<chrono::nanoseconds>(now - flow.created);
+
+	result.flow_description = flow.description;
+	result.table_id = 0;
+	result.duration_alive_sec = alive.count() / 1000000000;
+	result.duration_alive_nsec = alive.count() % 1000000000;
+	result.duration_to_idle_timeout = flow.idle_timeout;
+	result.duration_to_hard_timeout = flow.hard_timeout;
+	result.packet_count = flow.packet_count;
+	result.byte_count = flow.byte_count;
+	return result;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+#include "../../common/autobuf.h"
+#include "../openflow_types/of_match.h"
+#include "../openflow_types/of_packed_match.h"
+#include "../ironstack_types/openflow_flow_description.h"
+#include "../ironstack_types/openflow_flow_description_and_stats.h"
+#include "../ironstack_types/openflow_aggregate_stats.h"
+#include "../openflow_messages/of_message_modify_flow.h"
+#include "../openflow_messages/of_message_flow_removed.h"
+using namespace std;
+
+// in-memory openflow 1.0 flow table used by the switch emulator
+//
+// a single table that applies flow_mods the way an openflow 1.0 switch does:
+// non-strict modify/delete select every flow whose criteria is a subset of the
+// flow_mod's match, strict variants require identical criteria and priority,
+// and delete honors out_port. packets are looked up by building an exact match
+// for the frame and returning the highest priority flow it falls under. idle
+// and hard timeouts are enforced by expire().
+//
+// every flow keeps its criteria as an of_packed_match, so the per-flow checks
+// in lookup() and apply() are masked compares of five 64-bit words, and the
+// packet match is built straight into the wire layout.
+//
+// revision 1 (10/19/26)
+
+class emulated_flow_table {
+public:
+
+	// constructor
+	emulated_flow_table(uint32_t max_entries=4096);
+
+	// result of applying a flow_mod
+	enum class mod_result { APPLIED, TABLE_FULL, OVERLAP, BAD_COMMAND };
+
+	// applies a flow_mod. flows removed by a delete that asked to be notified are
+	// appended to removed.
+	mod_result apply(const of_message_modify_flow& flow_mod, vector<of_message_flow_removed>& removed);
+
+	// looks up a packet and updates the flow counters. returns false on a table
+	// miss; otherwise the matching flow's actions are copied into actions.
+	bool lookup(const of_packed_match& packet, uint32_t packet_len, openflow_action_list& actions);
+
+	// removes flows whose idle or hard timeout elapsed
+	void expire(vector<of_message_flow_removed>& removed);
+
+	// removes all flows
+	void clear();
+
+	// statistics queries
+	vector<openflow_flow_description_and_stats> get_flow_stats(const of_match& criteria, bool restrict_out_port, uint16_t out_port) const;
+	openflow_aggregate_stats get_aggregate_stats(const of_match& criteria, bool restrict_out_port, uint16_t out_port) const;
+
+	uint32_t size() const;
+	uint32_t get_max_entries() const;
+	uint64_t get_lookup_count() const;
+	uint64_t get_matched_count() const;
+
+	// builds the exact match of an ethernet frame as received on a port
+	// (untagged frames have vlan id OFP_VLAN_NONE)
+	static of_packed_match get_packet_match(const autobuf& frame, uint16_t in_port);
+
+private:
+
+	typedef chrono::steady_clock::time_point time_point;
+
+	// a single installed flow
+	class flow_entry {
+	public:
+		openflow_flow_description description;
+		of_packed_match criteria;     // description.criteria, packed
+		uint16_t   idle_timeout;
+		uint16_t   hard_timeout;
+		bool       send_flow_removed;
+		time_point created;
+		time_point last_used;
+		uint64_t   packet_count;
+		uint64_t   byte_count;
+	};
+
+	mutable mutex      lock;
+	vector<flow_entry> flows;       // sorted by descending priority
+	uint32_t           max_entries;
+	uint64_t           lookup_count;
+	uint64_t           matched_count;
+
+	// helpers (lock must be held)
+	void insert_flow(const of_message_modify_flow& flow_mod, const of_packed_match& criteria);
+	void remove_flow(uint32_t index, uint8_t reason, vector<of_message_flow_removed>* removed);
+
+	static bool outputs_to_port(const openflow_action_list& actions, uint16_t port);
+	static of_message_flow_removed get_flow_removed(const flow_entry& flow, uint8_t reason, const time_point& now);
+	static openflow_flow_description_and_stats get_stats(const flow_entry& flow, const time_point& now);
+};
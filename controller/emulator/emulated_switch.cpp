@@ -0,0 +1,588 @@
+#include <chrono>
+#include <sys/socket.h>
+#include "emulated_switch.h"
+#include "../gui/output.h"
+
+// default switch parameters
+emulated_switch::config::config():datapath_id(0x0000020000000001ULL),
+	num_ports(48),
+	max_flows(4096),
+	keep_flow_table(true),
+	manufacturer("ironstack"),
+	hardware_description("emulated openflow 1.0 switch") {
+}
+
+// resets the counters
+void emulated_switch::stats::clear() {
+	packets_generated = 0;
+	packet_ins_sent = 0;
+	packets_matched = 0;
+	packet_outs_received = 0;
+	flow_mods_received = 0;
+	flow_mods_rejected = 0;
+	flows_removed = 0;
+	stats_requests_received = 0;
+	barriers_received = 0;
+	echoes_received = 0;
+	messages_sent = 0;
+	messages_received = 0;
+}
+
+// generates a readable summary of the counters
+string emulated_switch::stats::to_string() const {
+	char buf[512];
+	snprintf(buf, sizeof(buf), "packets generated %" PRIu64 ", packet_ins %" PRIu64 ", table hits %" PRIu64
+		", packet_outs %" PRIu64 ", flow_mods %" PRIu64 " (%" PRIu64 " rejected), flows removed %" PRIu64
+		", stats requests %" PRIu64 ", barriers %" PRIu64 ", echoes %" PRIu64,
+		packets_generated.load(), packet_ins_sent.load(), packets_matched.load(),
+		packet_outs_received.load(), flow_mods_received.load(), flow_mods_rejected.load(), flows_removed.load(),
+		stats_requests_received.load(), barriers_received.load(), echoes_received.load());
+	return buf;
+}
+
+// constructor
+emulated_switch::emulated_switch(const config& settings_):settings(settings_),
+	flow_table(settings_.max_flows),
+	next_xid(1),
+	connected(false),
+	configured(false),
+	features_requested(false),
+	shutdown_requested(false),
+	miss_send_len(128),
+	packets_per_sec(0) {
+}
+
+// destructor
+emulated_switch::~emulated_switch() {
+	shutdown();
+}
+
+// connects to the controller and completes the hello handshake
+bool emulated_switch::connect(const string& address, uint16_t port) {
+	if (!connection.connect(address, port)) {
+		output::log(output::loglevel::ERROR, "emulated_switch::connect() -- unable to connect to %s:%hu.\n", address.c_str(), port);
+		return false;
+	}
+	connection.set_no_delay(true);
+	connected = true;
+
+	of_message_hello hello;
+	if (!send_message(hello, false)) {
+		output::log(output::loglevel::ERROR, "emulated_switch::connect() -- unable to send hello.\n");
+		return false;
+	}
+
+	autobuf buf;
+	shared_ptr<of_message> message;
+	if (!read_message(buf, message, 10000) || message->msg_type != OFPT_HELLO) {
+		output::log(output::loglevel::ERROR, "emulated_switch::connect() -- no hello received from the controller.\n");
+		connection.close();
+		connected = false;
+		return false;
+	}
+	return true;
+}
+
+// starts the receive and generator threads
+bool emulated_switch::start(const shared_ptr<host_population>& population_, uint32_t packets_per_sec_) {
+	if (!connected) {
+		return false;
+	}
+	population = population_;
+	packets_per_sec = (population == nullptr ? 0 : packets_per_sec_);
+	shutdown_requested = false;
+	recv_tid = thread(&emulated_switch::recv_loop, this);
+	generator_tid = thread(&emulated_switch::generator_loop, this);
+	return true;
+}
+
+// stops all threads and closes the connection
+void emulated_switch::shutdown() {
+	shutdown_requested = true;
+	if (connected) {
+		::shutdown(connection.get_fd(), SHUT_RDWR);
+	}
+	if (recv_tid.joinable()) {
+		recv_tid.join();
+	}
+	if (generator_tid.joinable()) {
+		generator_tid.join();
+	}
+	connection.close();
+	connected = false;
+}
+
+// checks if the connection to the controller is up
+bool emulated_switch::is_connected() const {
+	return connected;
+}
+
+// checks if the controller has configured the switch
+bool emulated_switch::is_configured() const {
+	return configured && features_requested;
+}
+
+// runs a frame through the flow table as if it arrived on a port
+bool emulated_switch::inject(const autobuf& frame, uint16_t in_port) {
+	++counters.packets_generated;
+	bool reason_action = false;
+	if (!needs_controller(frame, in_port, reason_action)) {
+		return true;
+	}
+	return send_packet_in(frame, in_port, reason_action);
+}
+
+// runs a frame through the flow table without sending anything
+bool emulated_switch::needs_controller(const autobuf& frame, uint16_t in_port, bool& reason_action) {
+	openflow_action_list actions;
+	reason_action = false;
+	if (!flow_table.lookup(emulated_flow_table::get_packet_match(frame, in_port), frame.size(), actions)) {
+		return true;
+	}
+	++counters.packets_matched;
+
+	// a matching flow may still send the packet to the controller
+	of_action_output_to_port output;
+	for (uint32_t index = 0; index < actions.size(); ++index) {
+		if (actions.get_action(index, output) && output.send_to_controller) {
+			reason_action = true;
+			return true;
+		}
+	}
+	return false;
+}
+
+// sends a packet_in directly
+bool emulated_switch::send_packet_in(const autobuf& frame, uint16_t in_port, bool reason_action) {
+	of_message_packet_in packet_in;
+	packet_in.buffer_id = 0xffffffff;
+	packet_in.in_port = in_port;
+	packet_in.reason_no_match = !reason_action;
+	packet_in.reason_action = reason_action;
+
+	// frames longer than miss_send_len are truncated (nothing is buffered, so
+	// the controller must not rely on the buffer id)
+	uint16_t max_len = miss_send_len;
+	if (frame.size() > max_len) {
+		packet_in.pkt_data.set_content(frame.get_content_ptr(), max_len);
+		packet_in.actual_message_len = frame.size();
+		packet_in.summarized = true;
+	} else {
+		packet_in.pkt_data.inherit_read_only(frame.get_content_ptr(), frame.size());
+		packet_in.actual_message_len = frame.size();
+	}
+
+	if (!send_message(packet_in, false)) {
+		return false;
+	}
+	++counters.packet_ins_sent;
+	return true;
+}
+
+// registers the flow_mod observer
+void emulated_switch::set_flow_mod_observer(const flow_mod_observer& observer) {
+	on_flow_mod = observer;
+}
+
+// registers the packet_out observer
+void emulated_switch::set_packet_out_observer(const packet_out_observer& observer) {
+	on_packet_out = observer;
+}
+
+// gets the counters
+const emulated_switch::stats& emulated_switch::get_stats() const {
+	return counters;
+}
+
+// gets the flow table
+const emulated_flow_table& emulated_switch::get_flow_table() const {
+	return flow_table;
+}
+
+// gets the packet_in truncation length set by the controller
+uint16_t emulated_switch::get_miss_send_len() const {
+	return miss_send_len;
+}
+
+// receives and handles messages from the controller
+void emulated_switch::recv_loop() {
+	autobuf buf;
+	shared_ptr<of_message> message;
+
+	while (!shutdown_requested) {
+		if (!read_message(buf, message, -1)) {
+			if (!connection.get_connection_info().is_connected()) {
+				if (!shutdown_requested) {
+					output::log(output::loglevel::WARNING, "emulated_switch::recv_loop() -- connection to the controller lost.\n");
+				}
+				connected = false;
+				break;
+			}
+			continue;
+		}
+		++counters.messages_received;
+		handle_message(message, buf);
+	}
+}
+
+// generates packets at the configured rate and expires flows
+void emulated_switch::generator_loop() {
+	typedef chrono::steady_clock clock;
+	autobuf frame;
+	auto next_expiry = clock::now() + chrono::seconds(1);
+	auto next_packet = clock::now();
+	chrono::nanoseconds interval(packets_per_sec == 0 ? 0 : 1000000000ULL / packets_per_sec);
+	vector<of_message_flow_removed> removed;
+
+	while (!shutdown_requested && connected) {
+		auto now = clock::now();
+
+		// flow timeouts are checked once a second
+		if (now >= next_expiry) {
+			flow_table.expire(removed);
+			send_flow_removed(removed);
+			next_expiry = now + chrono::seconds(1);
+		}
+
+		// traffic starts once the controller has configured the switch
+		if (packets_per_sec == 0 || !is_configured()) {
+			this_thread::sleep_for(chrono::milliseconds(10));
+			next_packet = clock::now();
+			continue;
+		}
+
+		// send every packet that is due (the generator catches up in bursts
+		// when the sleep granularity is coarser than the interval)
+		uint32_t sent = 0;
+		while (next_packet <= now && sent < 10000) {
+			uint16_t in_port = population->next_packet(frame);
+			if (!inject(frame, in_port)) {
+				break;
+			}
+			next_packet += interval;
+			++sent;
+		}
+		if (next_packet < now - chrono::seconds(1)) {
+			next_packet = now;
+		}
+
+		auto sleep_until = min(next_packet, next_expiry);
+		if (sleep_until > clock::now()) {
+			this_thread::sleep_until(sleep_until);
+		}
+	}
+}
+
+// serializes and sends a message. requests initiated by the switch get a new
+// transaction id; replies keep the one they were given.
+bool emulated_switch::send_message(of_message& message, bool reply) {
+	if (!reply) {
+		message.xid = next_xid++;
+	}
+
+	lock_guard<mutex> g(send_lock);
+	message.serialize(send_buf);
+	if (!connection.send_raw(send_buf)) {
+		return false;
+	}
+	++counters.messages_sent;
+	return true;
+}
+
+// reads and deserializes the next message from the controller
+bool emulated_switch::read_message(autobuf& buf, shared_ptr<of_message>& message, int timeout_ms) {
+	if (!connection.recv_fixed_bytes(buf, sizeof(struct ofp_header), timeout_ms)) {
+		return false;
+	}
+
+	uint16_t length = ntohs(((const struct ofp_header*) buf.get_content_ptr())->length);
+	if (length < sizeof(struct ofp_header)) {
+		output::log(output::loglevel::ERROR, "emulated_switch::read_message() -- invalid message length %hu.\n", length);
+		connection.close();
+		return false;
+	}
+	if (length > sizeof(struct ofp_header)) {
+		buf.create_empty_buffer(length, false);
+		if (!connection.recv_fixed_bytes(buf.ptr_offset_mutable(sizeof(struct ofp_header)), length - sizeof(struct ofp_header), timeout_ms)) {
+			return false;
+		}
+	}
+
+	message = ironstack::of_message_factory::deserialize_message(buf);
+	if (message == nullptr) {
+		const struct ofp_header* hdr = (const struct ofp_header*) buf.get_content_ptr();
+		output::log(output::loglevel::WARNING, "emulated_switch::read_message() -- unable to decode message type %u.\n", hdr->type);
+		of_message request;
+		request.xid = ntohl(hdr->xid);
+		send_error(request, (uint16_t) OFPET_BAD_REQUEST, (uint16_t) OFPBRC_BAD_TYPE);
+		return false;
+	}
+	return true;
+}
+
+// handles a single message from the controller
+void emulated_switch::handle_message(const shared_ptr<of_message>& message, const autobuf& raw) {
+
+	switch (message->msg_type) {
+		case OFPT_HELLO:
+			break;
+
+		case OFPT_ECHO_REQUEST:
+		{
+			++counters.echoes_received;
+			of_message_echo_reply reply;
+			reply.xid = message->xid;
+			reply.data = static_pointer_cast<of_message_echo_request>(message)->data;
+			send_message(reply, true);
+			break;
+		}
+
+		case OFPT_ECHO_REPLY:
+			++counters.echoes_received;
+			break;
+
+		case OFPT_FEATURES_REQUEST:
+		{
+			of_message_features_reply reply;
+			reply.xid = message->xid;
+			reply.switch_features.datapath_id = htobe64(settings.datapath_id);
+			reply.switch_features.n_buffers = 0;
+			reply.switch_features.n_tables = 1;
+			reply.switch_features.capabilities.switch_flow_stats_supported = true;
+			reply.switch_features.capabilities.switch_table_stats_supported = true;
+			reply.switch_features.capabilities.switch_port_stats_supported = true;
+			reply.switch_features.actions_supported.output_to_switch_port = true;
+			reply.switch_features.actions_supported.set_vlan_vid = true;
+			reply.switch_features.actions_supported.strip_vlan_hdr = true;
+			reply.switch_features.actions_supported.set_ethernet_src = true;
+			reply.switch_features.actions_supported.set_ethernet_dest = true;
+
+			for (uint32_t counter = 1; counter <= settings.num_ports; ++counter) {
+				openflow_port port;
+				char name[16];
+				snprintf(name, sizeof(name), "emu%u", counter);
+				port.port_number = counter;
+				port.dl_addr.set_from_uint64(((settings.datapath_id & 0xffffffffULL) << 8 | counter) & 0xffffffffffffULL);
+				port.name = name;
+				port.current_features.bandwidth_1gb_full_duplex = true;
+				port.current_features.medium_copper = true;
+				port.advertised_features = port.current_features;
+				port.supported_features = port.current_features;
+				reply.physical_ports.push_back(port);
+			}
+			send_message(reply, true);
+			features_requested = true;
+			break;
+		}
+
+		case OFPT_GET_CONFIG_REQUEST:
+		{
+			of_message_get_config_reply reply;
+			reply.xid = message->xid;
+			reply.config.frag_normal = true;
+			reply.config.max_msg_send_len = miss_send_len;
+			send_message(reply, true);
+			break;
+		}
+
+		case OFPT_SET_CONFIG:
+			miss_send_len = static_pointer_cast<of_message_set_config>(message)->max_msg_send_len;
+			configured = true;
+			break;
+
+		case OFPT_PACKET_OUT:
+			++counters.packet_outs_received;
+			if (on_packet_out) {
+				on_packet_out(*static_pointer_cast<of_message_packet_out>(message));
+			}
+			break;
+
+		case OFPT_FLOW_MOD:
+			handle_flow_mod(*static_pointer_cast<of_message_modify_flow>(message));
+			break;
+
+		case OFPT_PORT_MOD:
+			break;
+
+		case OFPT_STATS_REQUEST:
+			++counters.stats_requests_received;
+			handle_stats_request(message, raw);
+			break;
+
+		case OFPT_BARRIER_REQUEST:
+		{
+			// messages are handled in order, so everything before the barrier is done
+			++counters.barriers_received;
+			of_message_barrier_reply reply;
+			reply.xid = message->xid;
+			send_message(reply, true);
+			break;
+		}
+
+		default:
+			output::log(output::loglevel::WARNING, "emulated_switch::handle_message() -- unsupported message type %u.\n", (uint32_t) message->msg_type);
+			send_error(*message, (uint16_t) OFPET_BAD_REQUEST, (uint16_t) OFPBRC_BAD_TYPE);
+			break;
+	}
+}
+
+// answers a stats request
+void emulated_switch::handle_stats_request(const shared_ptr<of_message>& message, const autobuf& raw) {
+	uint16_t type = ntohs(((const struct ofp_stats_request*) raw.get_content_ptr())->type);
+
+	if (type == (uint16_t) OFPST_DESC) {
+		of_message_stats_reply_switch_description reply;
+		reply.xid = message->xid;
+		reply.description.manufacturer = settings.manufacturer;
+		reply.description.hardware_description = settings.hardware_description;
+		reply.description.software_description = "switch_emulator";
+		reply.description.serial_number = "0";
+		reply.description.general_description = "localhost";
+		send_message(reply, true);
+
+	} else if (type == (uint16_t) OFPST_FLOW) {
+		const of_message_stats_request_flow_stats& request = *static_pointer_cast<of_message_stats_request_flow_stats>(message);
+		vector<openflow_flow_description_and_stats> flows = flow_table.get_flow_stats(request.fields_to_match,
+			request.restrict_out_port, request.out_port);
+
+		// large tables are split over several replies to stay within the
+		// 64kb openflow message limit
+		const uint32_t flows_per_reply = 256;
+		uint32_t offset = 0;
+		do {
+			of_message_stats_reply_flow_stats reply;
+			reply.xid = message->xid;
+			uint32_t end = min((uint32_t) flows.size(), offset + flows_per_reply);
+			reply.flow_stats.assign(flows.begin() + offset, flows.begin() + end);
+			reply.more_to_follow = (end < flows.size());
+			send_message(reply, true);
+			offset = end;
+		} while (offset < flows.size());
+
+	} else if (type == (uint16_t) OFPST_AGGREGATE) {
+		const of_message_stats_request_aggregate_stats& request = *static_pointer_cast<of_message_stats_request_aggregate_stats>(message);
+		of_message_stats_reply_aggregate_stats reply;
+		reply.xid = message->xid;
+		reply.aggregate_stats = flow_table.get_aggregate_stats(request.fields_to_match, request.restrict_out_port, request.out_port);
+		send_message(reply, true);
+
+	} else if (type == (uint16_t) OFPST_TABLE) {
+		of_message_stats_reply_table_stats reply;
+		openflow_table_stats table;
+		reply.xid = message->xid;
+		table.table_id = 0;
+		table.name = "emulated";
+		table.all_wildcards_supported = true;
+		table.wildcard_in_port_supported = true;
+		table.wildcard_ethernet_src_supported = true;
+		table.wildcard_ethernet_dest_supported = true;
+		table.wildcard_vlan_id_supported = true;
+		table.wildcard_vlan_pcp_supported = true;
+		table.wildcard_ethernet_frame_type_supported = true;
+		table.wildcard_ip_type_of_service_supported = true;
+		table.wildcard_ip_protocol_supported = true;
+		table.wildcard_ip_src_lsb_supported = 32;
+		table.wildcard_ip_dest_lsb_supported = 32;
+		table.wildcard_tcpudp_src_port_supported = true;
+		table.wildcard_tcpudp_dest_port_supported = true;
+		table.max_entries_supported = flow_table.get_max_entries();
+		table.active_entries = flow_table.size();
+		table.lookup_count = flow_table.get_lookup_count();
+		table.matched_count = flow_table.get_matched_count();
+		reply.table_stats.push_back(table);
+		send_message(reply, true);
+
+	} else if (type == (uint16_t) OFPST_PORT) {
+		const of_message_stats_request_port_stats& request = *static_pointer_cast<of_message_stats_request_port_stats>(message);
+		of_message_stats_reply_port_stats reply;
+		reply.xid = message->xid;
+
+		// ports carry no traffic of their own; counters are reported as zero
+		for (uint32_t counter = 1; counter <= settings.num_ports; ++counter) {
+			if (!request.all_ports && request.port != counter) continue;
+			openflow_port_stats port;
+			port.port = counter;
+			port.rx_packets_supported = port.tx_packets_supported = true;
+			port.rx_bytes_supported = port.tx_bytes_supported = true;
+			reply.port_stats.push_back(port);
+		}
+		send_message(reply, true);
+
+	} else if (type == (uint16_t) OFPST_QUEUE) {
+		of_message_stats_reply_queue_stats reply;
+		reply.xid = message->xid;
+		send_message(reply, true);
+
+	} else {
+		send_error(*message, (uint16_t) OFPET_BAD_REQUEST, (uint16_t) OFPBRC_BAD_STAT);
+	}
+}
+
+// applies a flow_mod to the flow table
+void emulated_switch::handle_flow_mod(const of_message_modify_flow& flow_mod) {
+	vector<of_message_flow_removed> removed;
+	++counters.flow_mods_received;
+
+	// like cbench, the table can be skipped so that the switch side stays cheap
+	if (!settings.keep_flow_table) {
+		if (on_flow_mod) {
+			on_flow_mod(flow_mod);
+		}
+		return;
+	}
+
+	switch (flow_table.apply(flow_mod, removed)) {
+		case emulated_flow_table::mod_result::APPLIED:
+			break;
+		case emulated_flow_table::mod_result::TABLE_FULL:
+			++counters.flow_mods_rejected;
+			send_error(flow_mod, (uint16_t) OFPET_FLOW_MOD_FAILED, (uint16_t) OFPFMFC_ALL_TABLES_FULL);
+			break;
+		case emulated_flow_table::mod_result::OVERLAP:
+			++counters.flow_mods_rejected;
+			send_error(flow_mod, (uint16_t) OFPET_FLOW_MOD_FAILED, (uint16_t) OFPFMFC_OVERLAP);
+			break;
+		case emulated_flow_table::mod_result::BAD_COMMAND:
+			++counters.flow_mods_rejected;
+			send_error(flow_mod, (uint16_t) OFPET_FLOW_MOD_FAILED, (uint16_t) OFPFMFC_BAD_COMMAND);
+			break;
+	}
+	send_flow_removed(removed);
+
+	if (on_flow_mod) {
+		on_flow_mod(flow_mod);
+	}
+}
+
+// sends (and clears) a batch of flow_removed notifications
+void emulated_switch::send_flow_removed(vector<of_message_flow_removed>& removed) {
+	for (auto& message : removed) {
+		send_message(message, false);
+		++counters.flows_removed;
+	}
+	removed.clear();
+}
+
+// sends an error message carrying the header of the offending request (of_message_error
+// only decodes, so the error is written directly)
+void emulated_switch::send_error(const of_message& request, uint16_t type, uint16_t code) {
+	autobuf request_hdr;
+	request.of_message::serialize(request_hdr);
+
+	uint32_t size_required = sizeof(struct ofp_error_msg) + request_hdr.size();
+	autobuf buf;
+	buf.create_empty_buffer(size_required, true);
+	struct ofp_error_msg* hdr = (struct ofp_error_msg*) buf.get_content_ptr_mutable();
+	hdr->header.version = OFP_VERSION;
+	hdr->header.type = (uint8_t) OFPT_ERROR;
+	hdr->header.length = htons(size_required);
+	hdr->header.xid = htonl(request.xid);
+	hdr->type = htons(type);
+	hdr->code = htons(code);
+	request_hdr.memcpy_to(hdr->data, request_hdr.size());
+
+	lock_guard<mutex> g(send_lock);
+	if (connection.send_raw(buf)) {
+		++counters.messages_sent;
+	}
+}
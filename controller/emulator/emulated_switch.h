@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include "../../common/autobuf.h"
+#include "../../common/tcp.h"
+#include "../openflow_messages/of_message_factory.h"
+#include "emulated_flow_table.h"
+#include "host_population.h"
+using namespace std;
+
+// emulated openflow 1.0 switch
+//
+// connects to a controller (normally the hal on localhost:6633), completes the
+// hello handshake and then behaves like a single-table switch: it answers
+// echo, features, configuration, stats and barrier requests, applies flow_mods
+// to an emulated_flow_table and accepts packet_outs. a generator thread draws
+// packets from a host_population at a fixed rate, looks them up in the flow
+// table and sends a packet_in to the controller on a miss (or when a flow
+// outputs to the controller).
+//
+// observers can be registered to see every flow_mod and packet_out the
+// controller sends; they run on the receive thread.
+//
+// revision 1 (10/19/26)
+
+class emulated_switch {
+public:
+
+	// switch parameters
+	class config {
+	public:
+		config();
+
+		uint64_t datapath_id;
+		uint32_t num_ports;
+		uint32_t max_flows;
+		bool     keep_flow_table;       // apply flow_mods (false: only count them)
+		string   manufacturer;
+		string   hardware_description;
+	};
+
+	// counters (all cumulative)
+	class stats {
+	public:
+		stats() { clear(); }
+		void clear();
+		string to_string() const;
+
+		atomic<uint64_t> packets_generated;
+		atomic<uint64_t> packet_ins_sent;
+		atomic<uint64_t> packets_matched;
+		atomic<uint64_t> packet_outs_received;
+		atomic<uint64_t> flow_mods_received;
+		atomic<uint64_t> flow_mods_rejected;
+		atomic<uint64_t> flows_removed;
+		atomic<uint64_t> stats_requests_received;
+		atomic<uint64_t> barriers_received;
+		atomic<uint64_t> echoes_received;
+		atomic<uint64_t> messages_sent;
+		atomic<uint64_t> messages_received;
+	};
+
+	typedef function<void(const of_message_modify_flow&)> flow_mod_observer;
+	typedef function<void(const of_message_packet_out&)> packet_out_observer;
+
+	// constructor and destructor
+	emulated_switch(const config& settings);
+	~emulated_switch();
+
+	// connects to the controller and completes the hello handshake
+	bool connect(const string& address, uint16_t port);
+
+	// starts the receive and packet generator threads. a rate of zero disables
+	// the generator (packet_ins can still be injected with send_packet_in()).
+	bool start(const shared_ptr<host_population>& population, uint32_t packets_per_sec);
+
+	// stops all threads and closes the connection
+	void shutdown();
+
+	// checks if the connection to the controller is up
+	bool is_connected() const;
+
+	// checks if the controller has configured the switch (set_config received
+	// and at least one features request answered)
+	bool is_configured() const;
+
+	// runs a frame through the flow table as if it arrived on a port; sends a
+	// packet_in on a table miss. returns false if the send failed.
+	bool inject(const autobuf& frame, uint16_t in_port);
+
+	// runs a frame through the flow table without sending anything. returns
+	// true if the frame would reach the controller (a table miss, or a flow
+	// that outputs to the controller, in which case reason_action is set).
+	bool needs_controller(const autobuf& frame, uint16_t in_port, bool& reason_action);
+
+	// sends a packet_in directly (bypassing the flow table)
+	bool send_packet_in(const autobuf& frame, uint16_t in_port, bool reason_action=false);
+
+	// registers observers (set before start())
+	void set_flow_mod_observer(const flow_mod_observer& observer);
+	void set_packet_out_observer(const packet_out_observer& observer);
+
+	// accessors
+	const stats&               get_stats() const;
+	const emulated_flow_table& get_flow_table() const;
+	uint16_t                   get_miss_send_len() const;
+
+private:
+
+	config              settings;
+	stats               counters;
+	emulated_flow_table flow_table;
+
+	tcp                 connection;
+	mutex               send_lock;
+	autobuf             send_buf;
+	atomic<uint32_t>    next_xid;
+
+	atomic<bool>        connected;
+	atomic<bool>        configured;
+	atomic<bool>        features_requested;
+	atomic<bool>        shutdown_requested;
+	atomic<uint16_t>    miss_send_len;
+
+	shared_ptr<host_population> population;
+	uint32_t            packets_per_sec;
+	thread              recv_tid;
+	thread              generator_tid;
+
+	flow_mod_observer   on_flow_mod;
+	packet_out_observer on_packet_out;
+
+	// threads
+	void recv_loop();
+	void generator_loop();
+
+	// message handling
+	bool send_message(of_message& message, bool reply);
+	bool read_message(autobuf& buf, shared_ptr<of_message>& message, int timeout_ms);
+	void handle_message(const shared_ptr<of_message>& message, const autobuf& raw);
+	void handle_stats_request(const shared_ptr<of_message>& message, const autobuf& raw);
+	void handle_flow_mod(const of_message_modify_flow& flow_mod);
+	void send_flow_removed(vector<of_message_flow_removed>& removed);
+	void send_error(const of_message& request, uint16_t type, uint16_t code);
+};
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include "host_population.h"
+#include "../../common/std_packet.h"
+
+// default population parameters
+host_population::config::config():num_hosts(1000),
+	num_ports(48),
+	first_vlan(1),
+	num_vlans(1),
+	tagged(true),
+	host_distribution(distribution::UNIFORM),
+	vlan_distribution(distribution::UNIFORM),
+	zipf_exponent(1.0),
+	arp_fraction(0.1),
+	seed(1) {
+}
+
+// constructor
+host_population::host_population():udp_port(1024) {
+}
+
+// creates the population
+bool host_population::init(const config& settings_) {
+	if (settings_.num_hosts == 0 || settings_.num_ports == 0 || settings_.num_vlans == 0 ||
+		settings_.first_vlan == 0 || settings_.first_vlan + settings_.num_vlans > 4095 ||
+		settings_.arp_fraction < 0.0 || settings_.arp_fraction > 1.0) {
+		return false;
+	}
+
+	settings = settings_;
+	generator.seed(settings.seed);
+	hosts.clear();
+	hosts_by_vlan.assign(settings.num_vlans, vector<uint32_t>());
+
+	vector<double> vlan_cdf;
+	if (settings.vlan_distribution == distribution::ZIPF) {
+		vlan_cdf = get_zipf_cdf(settings.num_vlans, settings.zipf_exponent);
+	}
+
+	for (uint32_t counter = 0; counter < settings.num_hosts; ++counter) {
+		host current;
+
+		// locally administered macs, spread over the address space
+		current.mac.set_from_uint64(0x020000000000ULL | ((uint64_t) (counter+1) * 2654435761ULL & 0xffffffffffULL));
+		current.ip.set(10, (uint8_t) ((counter+1) >> 16), (uint8_t) ((counter+1) >> 8), (uint8_t) (counter+1));
+
+		uint32_t vlan_offset = vlan_cdf.empty() ? counter % settings.num_vlans : pick(vlan_cdf, settings.num_vlans);
+		current.vlan_id = settings.first_vlan + vlan_offset;
+		current.port = (counter % settings.num_ports) + 1;
+
+		hosts_by_vlan[vlan_offset].push_back(hosts.size());
+		hosts.push_back(current);
+	}
+
+	host_cdf.clear();
+	if (settings.host_distribution == distribution::ZIPF) {
+		host_cdf = get_zipf_cdf(settings.num_hosts, settings.zipf_exponent);
+	}
+	return true;
+}
+
+// generates the next packet
+uint16_t host_population::next_packet(autobuf& frame) {
+	const host& sender = hosts[pick(host_cdf, hosts.size())];
+	const vector<uint32_t>& peers = hosts_by_vlan[sender.vlan_id - settings.first_vlan];
+	const host& receiver = hosts[peers[uniform_int_distribution<uint32_t>(0, peers.size()-1)(generator)]];
+
+	if (uniform_real_distribution<double>(0.0, 1.0)(generator) < settings.arp_fraction) {
+		arp_packet packet;
+		packet.has_vlan_tag = settings.tagged;
+		packet.vlan_id = sender.vlan_id;
+		packet.src_mac = sender.mac;
+		packet.dest_mac.set_broadcast();
+		packet.sender_mac = sender.mac;
+		packet.receiver_mac.clear();
+		packet.arp_request = true;
+		packet.src_ip = sender.ip;
+		packet.dest_ip = receiver.ip;
+		packet.serialize(frame);
+	} else {
+		udp_packet packet;
+		packet.has_vlan_tag = settings.tagged;
+		packet.vlan_id = sender.vlan_id;
+		packet.src_mac = sender.mac;
+		packet.dest_mac = receiver.mac;
+		packet.src_ip = sender.ip;
+		packet.dest_ip = receiver.ip;
+		packet.src_port = udp_port;
+		packet.dest_port = 9;
+		packet.udp_payload.create_empty_buffer(18, true);
+		packet.serialize(frame);
+		udp_port = (udp_port >= 65535 ? 1024 : udp_port+1);
+	}
+	return sender.port;
+}
+
+// gets the hosts in the population
+const vector<host_population::host>& host_population::get_hosts() const {
+	return hosts;
+}
+
+// gets the population parameters
+const host_population::config& host_population::get_config() const {
+	return settings;
+}
+
+// generates a readable summary of the population
+string host_population::to_string() const {
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%u hosts on %u ports, vlans %u-%u (%s, %s hosts, %s vlans, zipf exponent %.2f), %.0f%% arp",
+		settings.num_hosts, settings.num_ports, settings.first_vlan, settings.first_vlan + settings.num_vlans - 1,
+		settings.tagged ? "tagged" : "untagged",
+		settings.host_distribution == distribution::ZIPF ? "zipf" : "uniform",
+		settings.vlan_distribution == distribution::ZIPF ? "zipf" : "uniform",
+		settings.zipf_exponent, settings.arp_fraction * 100.0);
+	return buf;
+}
+
+// parses a distribution name
+bool host_population::parse_distribution(const string& name, distribution& result) {
+	if (name == "uniform") {
+		result = distribution::UNIFORM;
+	} else if (name == "zipf") {
+		result = distribution::ZIPF;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+// picks an index from a cdf (uniformly if the cdf is empty)
+uint32_t host_population::pick(const vector<double>& cdf, uint32_t count) {
+	if (cdf.empty()) {
+		return uniform_int_distribution<uint32_t>(0, count-1)(generator);
+	}
+	double value = uniform_real_distribution<double>(0.0, 1.0)(generator);
+	uint32_t result = lower_bound(cdf.begin(), cdf.end(), value) - cdf.begin();
+	return result < count ? result : count-1;
+}
+
+// generates the cumulative distribution of a zipf distribution
+vector<double> host_population::get_zipf_cdf(uint32_t count, double exponent) {
+	vector<double> result(count);
+	double sum = 0.0;
+	for (uint32_t counter = 0; counter < count; ++counter) {
+		sum += 1.0 / pow(counter+1, exponent);
+		result[counter] = sum;
+	}
+	for (auto& value : result) {
+		value /= sum;
+	}
+	return result;
+}
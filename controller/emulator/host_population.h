@@ -0,0 +1,81 @@
+#pragma once
+
+#include <random>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "../../common/autobuf.h"
+#include "../../common/ip_address.h"
+#include "../../common/mac_address.h"
+using namespace std;
+
+// synthetic host population for the switch emulator
+//
+// hosts are spread over a set of vlans and switch ports. each generated packet
+// picks a sending host and a receiver on the same vlan and produces either a
+// broadcast arp request or a unicast udp datagram between them. hosts and vlans
+// are chosen uniformly or with a zipf (heavy-hitter) distribution so that cam
+// and flow table behaviour under skewed traffic can be exercised.
+//
+// revision 1 (10/19/26)
+
+class host_population {
+public:
+
+	enum class distribution { UNIFORM, ZIPF };
+
+	// population parameters
+	class config {
+	public:
+		config();
+
+		uint32_t     num_hosts;
+		uint32_t     num_ports;          // hosts are attached to ports 1..num_ports
+		uint16_t     first_vlan;
+		uint32_t     num_vlans;          // vlans first_vlan..first_vlan+num_vlans-1
+		bool         tagged;             // send 802.1q tagged frames
+		distribution host_distribution;  // how senders are picked
+		distribution vlan_distribution;  // how hosts are assigned to vlans
+		double       zipf_exponent;
+		double       arp_fraction;       // fraction of packets that are arp requests
+		uint32_t     seed;
+	};
+
+	// a single emulated host
+	class host {
+	public:
+		mac_address mac;
+		ip_address  ip;
+		uint16_t    vlan_id;
+		uint16_t    port;
+	};
+
+	// constructor
+	host_population();
+
+	// (re)creates the population
+	bool init(const config& settings);
+
+	// generates the next packet. returns the port it arrives on.
+	uint16_t next_packet(autobuf& frame);
+
+	// accessors
+	const vector<host>& get_hosts() const;
+	const config&       get_config() const;
+	string              to_string() const;
+
+	// parses a distribution name ("uniform" or "zipf")
+	static bool parse_distribution(const string& name, distribution& result);
+
+private:
+
+	config                   settings;
+	vector<host>             hosts;
+	vector<vector<uint32_t>> hosts_by_vlan;   // index by vlan offset
+	vector<double>           host_cdf;        // zipf cdf over hosts (empty if uniform)
+	mt19937                  generator;
+	uint32_t                 udp_port;
+
+	uint32_t pick(const vector<double>& cdf, uint32_t count);
+	static vector<double> get_zipf_cdf(uint32_t count, double exponent);
+};
@@ -0,0 +1,304 @@
+#include <string.h>
+#include <time.h>
+#include "log_format.h"
+
+// linker-provided bounds of the executable image (text, read-only data, data)
+extern "C" char __executable_start;
+extern "C" char edata;
+
+const char log_format::MAGIC[8] = { 'I', 'R', 'O', 'N', 'L', 'O', 'G', '1' };
+
+// parses one conversion specification (fmt points past the '%'). returns a
+// pointer past the conversion character, or nullptr if it is not supported.
+const char* log_format::parse_spec(const char* fmt, spec_t& spec) {
+	spec.type = arg_type::NONE;
+	spec.stars = 0;
+
+	// flags, width and precision
+	while (*fmt != '\0' && strchr("-+ #0'", *fmt) != nullptr) ++fmt;
+	if (*fmt == '*') {
+		++spec.stars;
+		++fmt;
+	}
+	while (*fmt >= '0' && *fmt <= '9') ++fmt;
+	if (*fmt == '.') {
+		++fmt;
+		if (*fmt == '*') {
+			++spec.stars;
+			++fmt;
+		}
+		while (*fmt >= '0' && *fmt <= '9') ++fmt;
+	}
+
+	// length modifiers
+	bool is_long = false;
+	while (*fmt != '\0' && strchr("hlqjzt", *fmt) != nullptr) {
+		if (*fmt != 'h') is_long = true;
+		++fmt;
+	}
+
+	// conversion
+	switch (*fmt) {
+		case '%':
+			if (spec.stars != 0) return nullptr;
+			break;
+		case 'd':
+		case 'i':
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+			spec.type = is_long ? arg_type::LONG : arg_type::INT;
+			break;
+		case 'c':
+			if (is_long) return nullptr;
+			spec.type = arg_type::INT;
+			break;
+		case 'e':
+		case 'E':
+		case 'f':
+		case 'F':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			spec.type = arg_type::DOUBLE;
+			break;
+		case 's':
+			if (is_long) return nullptr;
+			spec.type = arg_type::STRING;
+			break;
+		case 'p':
+			spec.type = arg_type::POINTER;
+			break;
+		default:
+			return nullptr;
+	}
+	return fmt+1;
+}
+
+// returns the argument types of a static format string
+const log_format::signature_t& log_format::get_signature(const char* fmt) {
+	static thread_local signature_t cache[SIGNATURE_CACHE_SIZE];
+	signature_t& signature = cache[((uintptr_t) fmt >> 3) % SIGNATURE_CACHE_SIZE];
+	if (signature.fmt == fmt) return signature;
+
+	signature.fmt = fmt;
+	signature.count = 0;
+	spec_t spec;
+	const char* pos = fmt;
+	while ((pos = strchr(pos, '%')) != nullptr) {
+		pos = parse_spec(pos+1, spec);
+		if (pos == nullptr || signature.count + spec.stars + 1 > (int) MAX_SIGNATURE_ARGS) {
+			signature.count = -1;
+			break;
+		}
+		for (int counter = 0; counter < spec.stars; ++counter) {
+			signature.types[signature.count++] = arg_type::INT;
+		}
+		if (spec.type != arg_type::NONE) {
+			signature.types[signature.count++] = spec.type;
+		}
+	}
+	return signature;
+}
+
+// captures the arguments of a format string into a buffer. only static format
+// strings are deferred, since the writer refers to the format later.
+int log_format::encode_args(const char* fmt, va_list args, uint8_t* buf, uint32_t buf_size) {
+	if (!is_static_string(fmt)) return -1;
+	const signature_t& signature = get_signature(fmt);
+	if (signature.count < 0) return -1;
+
+	uint32_t offset = 0;
+	for (int counter = 0; counter < signature.count; ++counter) {
+		switch (signature.types[counter]) {
+			case arg_type::NONE:
+				break;
+			case arg_type::INT:
+			{
+				if (offset + 8 > buf_size) return -1;
+				int64_t value = va_arg(args, int);
+				memcpy(buf+offset, &value, 8);
+				offset += 8;
+				break;
+			}
+			case arg_type::LONG:
+			{
+				if (offset + 8 > buf_size) return -1;
+				int64_t value = va_arg(args, long long);
+				memcpy(buf+offset, &value, 8);
+				offset += 8;
+				break;
+			}
+			case arg_type::DOUBLE:
+			{
+				if (offset + 8 > buf_size) return -1;
+				double value = va_arg(args, double);
+				memcpy(buf+offset, &value, 8);
+				offset += 8;
+				break;
+			}
+			case arg_type::POINTER:
+			{
+				if (offset + 8 > buf_size) return -1;
+				uint64_t value = (uint64_t) (uintptr_t) va_arg(args, void*);
+				memcpy(buf+offset, &value, 8);
+				offset += 8;
+				break;
+			}
+			case arg_type::STRING:
+			{
+				const char* str = va_arg(args, const char*);
+				if (str == nullptr) str = "(null)";
+				size_t len = strlen(str);
+				if (len > 0xffff || offset + 2 + len > buf_size) return -1;
+				uint16_t len16 = (uint16_t) len;
+				memcpy(buf+offset, &len16, 2);
+				memcpy(buf+offset+2, str, len);
+				offset += 2 + len;
+				break;
+			}
+		}
+	}
+	return (int) offset;
+}
+
+// formats a message from its format string and captured arguments
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+string log_format::decode_args(const char* fmt, const uint8_t* buf, uint32_t len) {
+	string result;
+	uint32_t offset = 0;
+	spec_t spec;
+	char spec_str[64];
+	char value_str[512];
+
+	while (*fmt != '\0') {
+
+		// copy literal text up to the next conversion
+		const char* start = fmt;
+		while (*fmt != '\0' && *fmt != '%') ++fmt;
+		result.append(start, fmt - start);
+		if (*fmt == '\0') break;
+
+		start = fmt++;
+		fmt = parse_spec(fmt, spec);
+		if (fmt == nullptr || (size_t) (fmt - start) >= sizeof(spec_str)) {
+			result += "<bad format>";
+			break;
+		}
+		memcpy(spec_str, start, fmt - start);
+		spec_str[fmt - start] = '\0';
+
+		// width and precision arguments
+		int stars[2] = { 0, 0 };
+		for (int counter = 0; counter < spec.stars; ++counter) {
+			int64_t value = 0;
+			if (offset + 8 <= len) memcpy(&value, buf+offset, 8);
+			offset += 8;
+			stars[counter] = (int) value;
+		}
+
+		// the value itself
+		uint64_t raw = 0;
+		string str;
+		if (spec.type == arg_type::STRING) {
+			uint16_t str_len = 0;
+			if (offset + 2 <= len) memcpy(&str_len, buf+offset, 2);
+			offset += 2;
+			if (offset + str_len <= len) str.assign((const char*) buf+offset, str_len);
+			offset += str_len;
+		} else if (spec.type != arg_type::NONE) {
+			if (offset + 8 <= len) memcpy(&raw, buf+offset, 8);
+			offset += 8;
+		}
+		if (offset > len) {
+			result += "<truncated>";
+			break;
+		}
+
+		int written = 0;
+		switch (spec.type) {
+			case arg_type::NONE:
+				result += '%';
+				continue;
+			case arg_type::INT:
+			{
+				int value = (int) raw;
+				if (spec.stars == 0) written = snprintf(value_str, sizeof(value_str), spec_str, value);
+				else if (spec.stars == 1) written = snprintf(value_str, sizeof(value_str), spec_str, stars[0], value);
+				else written = snprintf(value_str, sizeof(value_str), spec_str, stars[0], stars[1], value);
+				break;
+			}
+			case arg_type::LONG:
+			{
+				long long value = (long long) raw;
+				if (spec.stars == 0) written = snprintf(value_str, sizeof(value_str), spec_str, value);
+				else if (spec.stars == 1) written = snprintf(value_str, sizeof(value_str), spec_str, stars[0], value);
+				else written = snprintf(value_str, sizeof(value_str), spec_str, stars[0], stars[1], value);
+				break;
+			}
+			case arg_type::DOUBLE:
+			{
+				double value;
+				memcpy(&value, &raw, 8);
+				if (spec.stars == 0) written = snprintf(value_str, sizeof(value_str), spec_str, value);
+				else if (spec.stars == 1) written = snprintf(value_str, sizeof(value_str), spec_str, stars[0], value);
+				else written = snprintf(value_str, sizeof(value_str), spec_str, stars[0], stars[1], value);
+				break;
+			}
+			case arg_type::POINTER:
+			{
+				void* value = (void*) (uintptr_t) raw;
+				if (spec.stars == 0) written = snprintf(value_str, sizeof(value_str), spec_str, value);
+				else if (spec.stars == 1) written = snprintf(value_str, sizeof(value_str), spec_str, stars[0], value);
+				else written = snprintf(value_str, sizeof(value_str), spec_str, stars[0], stars[1], value);
+				break;
+			}
+			case arg_type::STRING:
+			{
+				// strings can be longer than the scratch buffer; size the output first
+				const char* value = str.c_str();
+				if (spec.stars == 0) written = snprintf(nullptr, 0, spec_str, value);
+				else if (spec.stars == 1) written = snprintf(nullptr, 0, spec_str, stars[0], value);
+				else written = snprintf(nullptr, 0, spec_str, stars[0], stars[1], value);
+				if (written <= 0) continue;
+
+				size_t pos = result.size();
+				result.resize(pos + written + 1);
+				if (spec.stars == 0) snprintf(&result[pos], written+1, spec_str, value);
+				else if (spec.stars == 1) snprintf(&result[pos], written+1, spec_str, stars[0], value);
+				else snprintf(&result[pos], written+1, spec_str, stars[0], stars[1], value);
+				result.resize(pos + written);
+				continue;
+			}
+		}
+		if (written > 0) {
+			result.append(value_str, (size_t) written < sizeof(value_str) ? written : sizeof(value_str)-1);
+		}
+	}
+	return result;
+}
+#pragma GCC diagnostic pop
+
+// returns the display name of a loglevel
+const char* log_format::get_level_name(uint8_t level) {
+	static const char* names[] = { "VERBOSE", "INFO", "WARNING", "CRITICAL", "ERROR", "BUG" };
+	if (level < sizeof(names) / sizeof(names[0])) return names[level];
+	return "";
+}
+
+// formats a timestamp as it appears in the log
+void log_format::get_timestamp(uint64_t timestamp, char* result, uint32_t size) {
+	time_t rawtime = (time_t) (timestamp / 1000000000ULL);
+	struct tm info;
+
+	localtime_r(&rawtime, &info);
+	strftime(result, size, "%d/%b %H:%M:%S", &info);
+}
+
+// checks if a string lives in the executable image
+bool log_format::is_static_string(const char* str) {
+	return str >= &__executable_start && str < &edata;
+}
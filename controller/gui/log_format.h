@@ -0,0 +1,92 @@
+#pragma once
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+using namespace std;
+
+/*
+ * deferred formatting support for the logging backend.
+ *
+ * a log call with a static format string does not need to be formatted on the
+ * calling thread: its arguments are captured in raw form (integers and doubles
+ * as 8-byte values, strings copied with a length prefix) and formatted later,
+ * either by the log writer thread or, for binary logs, by the log decoder.
+ *
+ * binary logs start with a file header, followed by records. a format record
+ * carries a format string and the id later records use to refer to it; a message
+ * record carries the captured arguments; a text record carries a message that
+ * was formatted by the caller. all values are in host byte order.
+ *
+ * revision 1 (10/19/26)
+ */
+class log_format {
+public:
+
+	// record types
+	static const uint8_t RECORD_FORMAT = 1;
+	static const uint8_t RECORD_MESSAGE = 2;
+	static const uint8_t RECORD_TEXT = 3;
+
+	// level used for messages logged without a loglevel
+	static const uint8_t NO_LEVEL = 0xff;
+
+	static const uint32_t VERSION = 1;
+	static const char MAGIC[8];
+
+	struct file_header {
+		char     magic[8];
+		uint32_t version;
+		uint32_t reserved;
+	};
+
+	struct record_header {
+		uint32_t length;       // payload length
+		uint8_t  type;
+		uint8_t  level;
+		uint16_t thread_id;
+		uint32_t format_id;
+		uint32_t reserved;
+		uint64_t timestamp;    // nanoseconds since the unix epoch
+	};
+
+	// captures the arguments of a static format string into a buffer. returns the
+	// number of bytes written, or -1 if the format cannot be deferred (an
+	// unsupported conversion, or the buffer is too small).
+	static int encode_args(const char* fmt, va_list args, uint8_t* buf, uint32_t buf_size);
+
+	// formats a message from its format string and captured arguments
+	static string decode_args(const char* fmt, const uint8_t* buf, uint32_t len);
+
+	// returns the display name of a loglevel ("" for NO_LEVEL)
+	static const char* get_level_name(uint8_t level);
+
+	// formats a timestamp as it appears in the log (seconds resolution)
+	static void get_timestamp(uint64_t timestamp, char* result, uint32_t size);
+
+	// checks if a format string lives in the executable image (and therefore
+	// outlives the log call that references it)
+	static bool is_static_string(const char* str);
+
+private:
+
+	// a single conversion specification
+	enum class arg_type { NONE, INT, LONG, DOUBLE, STRING, POINTER };
+	struct spec_t {
+		arg_type type;
+		int      stars;    // number of '*' width/precision arguments
+	};
+
+	// argument types of a static format string, cached per thread so that
+	// repeated log calls skip parsing the format
+	static const uint32_t MAX_SIGNATURE_ARGS = 16;
+	static const uint32_t SIGNATURE_CACHE_SIZE = 256;
+	struct signature_t {
+		const char* fmt;
+		int         count;   // -1 if the format cannot be deferred
+		arg_type    types[MAX_SIGNATURE_ARGS];
+	};
+
+	static const char*        parse_spec(const char* fmt, spec_t& spec);
+	static const signature_t& get_signature(const char* fmt);
+};
@@ -1,12 +1,89 @@
+#include <algorithm>
+#include <chrono>
+#include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
+#include "log_format.h"
 #include "output.h"
 
+// per-thread log ring (single producer, drained by the writer). head and tail
+// count bytes written and consumed; entries are 8-byte aligned and never wrap:
+// an entry that does not fit before the end of the buffer is preceded by a pad
+// entry (or, if even the header does not fit, by implicit padding).
+struct output::log_ring {
+	static const uint32_t SIZE = 256*1024;
+
+	log_ring(uint16_t thread_id_):head(0), tail(0), orphaned(false), thread_id(thread_id_) {}
+
+	atomic<uint64_t>      head;
+	atomic<uint64_t>      tail;
+	atomic_bool           orphaned;      // owning thread has exited
+	uint16_t              thread_id;
+	alignas(8) uint8_t    data[SIZE];
+};
+
+// entry stored in a log ring, followed by its payload (captured arguments or text)
+struct output::log_entry {
+	static const uint8_t PAD = 0;
+
+	uint32_t              length;        // including header and alignment
+	uint8_t               type;          // log_format record type or PAD
+	uint8_t               level;
+	uint16_t              reserved;
+	uint64_t              timestamp;     // clock ticks (see get_clock())
+	const char*           fmt;
+};
+
+// marks the ring of an exiting thread so that the writer can reclaim it. the
+// ring may be freed as soon as it is orphaned, so later messages from the
+// thread's remaining thread_local destructors are written out directly.
+struct output::ring_owner {
+	~ring_owner() {
+		if (ring != nullptr) ring->orphaned = true;
+		ring = nullptr;
+		ring_released = true;
+	}
+	log_ring*             ring = nullptr;
+};
+
 weak_ptr<gui_controller> output::controller;
 atomic_bool output::log_printf{false};
 output::loglevel output::loglevel_threshold{output::loglevel::WARNING};
 mutex output::fp_lock;
 FILE* output::fp = nullptr;
 
+atomic_bool output::logging_active{false};
+atomic<int> output::log_level{(int) output::loglevel::VERBOSE};
+output::logformat output::log_file_format{output::logformat::TEXT};
+vector<output::log_ring*> output::rings;
+unordered_map<const char*, uint32_t> output::format_ids;
+atomic<uint64_t> output::dropped{0};
+uint64_t output::dropped_reported = 0;
+atomic_bool output::writer_stop{false};
+thread output::writer_tid;
+thread_local output::ring_owner output::local_ring;
+thread_local bool output::ring_released = false;
+uint64_t output::clock_base = 0;
+uint64_t output::clock_base_ns = 0;
+double output::ns_per_tick = 1.0;
+atomic<uint32_t> output::log_rate_limit{output::DEFAULT_LOG_RATE_LIMIT};
+vector<log_site*> output::sites;
+atomic<uint32_t> output::sites_reported_sec{0};
+
+// chrono::milliseconds takes its count by reference
+const uint32_t output::WRITER_INTERVAL_MS;
+
+// constructor registers the call site with the log writer
+log_site::log_site(output::loglevel level_, const char* file_, int line_, uint32_t budget_):level(level_),
+	file(file_),
+	line(line_),
+	budget(budget_),
+	window(0),
+	count(0),
+	suppressed(0) {
+	output::register_log_site(this);
+}
+
 // sets up output to point to a controller
 void output::init(const shared_ptr<gui_controller>& controller_) {
 	controller = controller_;
@@ -24,31 +101,58 @@ void output::shutdown() {
 }
 
 // attempts to start logging output to file
-bool output::start_log(const string& filename, bool log_printf_, loglevel loglevel_display_threshold) {
+bool output::start_log(const string& filename, bool log_printf_, loglevel loglevel_display_threshold, logformat format) {
+	static once_flag stop_at_exit;
+	stop_log();
+	call_once(stop_at_exit, []() { atexit(output::stop_log); });
+
 	log_printf = log_printf_;
-	
-	lock_guard<mutex> g(fp_lock);
-	if (fp != nullptr) {
-		fclose(fp);
+	{
+		lock_guard<mutex> g(fp_lock);
+		fp = fopen(filename.c_str(), "a");
+		if (fp != nullptr) {
+			char timestamp[128];
+			get_timestamp(timestamp);
+			log_file_format = format;
+			format_ids.clear();
+			if (format == logformat::BINARY) {
+				log_format::file_header header;
+				memset(&header, 0, sizeof(header));
+				memcpy(header.magic, log_format::MAGIC, sizeof(header.magic));
+				header.version = log_format::VERSION;
+				fwrite(&header, sizeof(header), 1, fp);
+			} else {
+				fprintf(fp, "### LOG STARTED [%s] ###\n", timestamp);
+			}
+		} else {
+			log_printf = false;
+		}
 	}
 
-	fp = fopen(filename.c_str(), "a");
+	loglevel_threshold = loglevel_display_threshold;
+
+	// start the writer
 	if (fp != nullptr) {
-		char timestamp[128];
-		get_timestamp(timestamp);
-		fprintf(fp, "### LOG STARTED [%s] ###\n", timestamp);
-	} else {
-		log_printf = false;
+		clock_base = get_clock();
+		clock_base_ns = get_time_ns();
+		writer_stop = false;
+		logging_active = true;
+		writer_tid = thread(&output::writer_entrypoint);
 	}
 
-	loglevel_threshold = loglevel_display_threshold;
-
 	return fp == nullptr;
 }
 
-// stops logging to file
+// stops logging to file (pending messages are written out first)
 void output::stop_log() {
+	logging_active = false;
+	writer_stop = true;
+	if (writer_tid.joinable() && writer_tid.get_id() != this_thread::get_id()) {
+		writer_tid.join();
+	}
+
 	lock_guard<mutex> g(fp_lock);
+	flush_unsafe();
 	if (fp != nullptr) {
 		fclose(fp);
 	}
@@ -56,6 +160,43 @@ void output::stop_log() {
 	log_printf = false;
 }
 
+// writes out all pending log messages
+void output::flush() {
+	lock_guard<mutex> g(fp_lock);
+	flush_unsafe();
+}
+
+// returns the number of messages dropped because a log ring was full
+uint64_t output::get_dropped_count() {
+	return dropped;
+}
+
+// sets the minimum level of messages that are logged or displayed
+void output::set_log_level(loglevel level) {
+	log_level = (int) level;
+}
+
+// returns the minimum level of messages that are logged or displayed
+output::loglevel output::get_log_level() {
+	return (loglevel) log_level.load();
+}
+
+// sets the default per call site rate limit of OUTPUT_LOG_LIMITED()
+void output::set_log_rate_limit(uint32_t messages_per_sec) {
+	log_rate_limit = messages_per_sec;
+}
+
+// returns the default per call site rate limit
+uint32_t output::get_log_rate_limit() {
+	return log_rate_limit;
+}
+
+// registers a rate limited call site (sites are static and never removed)
+void output::register_log_site(log_site* site) {
+	lock_guard<mutex> g(fp_lock);
+	sites.push_back(site);
+}
+
 // prints to either stdout or through the GUI controller
 void output::printf(const char* fmt, ...) {
 	char buf[10240];
@@ -63,13 +204,9 @@ void output::printf(const char* fmt, ...) {
 	va_list args;
 	va_start(args, fmt);
 	vsnprintf(buf, sizeof(buf)-1, fmt, args);
+	va_end(args);
 
-	shared_ptr<gui_controller> current_controller = controller.lock();
-	if (current_controller != nullptr) {
-		current_controller->printf("%s", buf);
-	} else {
-		::printf("%s", buf);
-	}
+	display(buf);
 
 	// log to file if required
 	if (log_printf) {
@@ -79,110 +216,371 @@ void output::printf(const char* fmt, ...) {
 
 // logs directly to file. does not appear on display. no loglevel associated.
 void output::log(const char* fmt, ...) {
-	char buf[10240];
-	char timestamp[128];
+	if (!logging_active.load(memory_order_relaxed)) return;
+
+	va_list args;
+	va_start(args, fmt);
+	enqueue(log_format::NO_LEVEL, fmt, args);
+	va_end(args);
+}
+
+// logs directly to file, with loglevel. the message is displayed by the writer
+// if it is at or above the display threshold.
+void output::log(const loglevel& level, const char* fmt, ...) {
+	if ((int) level < log_level.load(memory_order_relaxed)) return;
+
 	va_list args;
 	va_start(args, fmt);
-	vsnprintf(buf, sizeof(buf)-33, fmt, args);
 
-	// get timestamp
-	get_timestamp(timestamp);
+	if (logging_active.load(memory_order_relaxed)) {
+		enqueue((uint8_t) level, fmt, args);
 
-	// write to file
-	lock_guard<mutex> g(fp_lock);
-	if (fp != nullptr) {
-		fprintf(fp, "[%s] %s", timestamp, buf);
+	// not logging to file: display only, on the caller's thread
+	} else if ((int) level >= (int) loglevel_threshold) {
+		report_suppressed();
 
-		// append a newline if it wasn't given
-		int len = strlen(buf);
-		if (len == 0 || buf[len-1] != '\n') {
-			fprintf(fp, "\n");
-		}
+		char buf[MAX_MESSAGE_SIZE];
+		char timestamp[128];
+		vsnprintf(buf, sizeof(buf), fmt, args);
+		get_timestamp(timestamp);
+
+		string result = string("[") + timestamp + "] " + log_format::get_level_name((uint8_t) level) + ": " + buf;
+		if (result.back() != '\n') result += '\n';
+		display(result.c_str());
 	}
+	va_end(args);
 }
 
-// logs directly to file, with loglevel
-void output::log(const loglevel& level, const char* fmt, ...) {
+// displays the suppressed message counts of rate limited call sites, at most
+// once a second. used when there is no log writer to report them.
+void output::report_suppressed() {
+	uint32_t now_sec = (uint32_t) time(nullptr);
+	if (sites_reported_sec.load(memory_order_relaxed) == now_sec) return;
 
-	char buf[10240];
-	char timestamp[128];
-	va_list args;
-	va_start(args, fmt);
-	vsnprintf(buf, sizeof(buf)-33, fmt, args);
-
-	// get timestamp
-	get_timestamp(timestamp);
-
-	// generate output string
-	char result[1024+128+2];
-	switch (level) {
-		case loglevel::VERBOSE:
-		{
-			snprintf(result, sizeof(result), "[%s] VERBOSE: %s", timestamp, buf);
-			break;
-		}
-		case loglevel::INFO:
-		{
-			snprintf(result, sizeof(result), "[%s] INFO: %s", timestamp, buf);
-			break;
+	vector<pair<log_site*, uint32_t>> reports;
+	{
+		lock_guard<mutex> g(fp_lock);
+		if (sites_reported_sec == now_sec) return;
+		sites_reported_sec = now_sec;
+		for (log_site* site : sites) {
+			uint32_t suppressed = site->suppressed.exchange(0, memory_order_relaxed);
+			if (suppressed != 0) reports.push_back(make_pair(site, suppressed));
 		}
-		case loglevel::WARNING:
-		{
-			snprintf(result, sizeof(result), "[%s] WARNING: %s", timestamp, buf);
-			break;
+	}
+
+	for (const auto& report : reports) {
+		log(report.first->level, "%s:%d: last message repeated %u times.\n", report.first->file, report.first->line, report.second);
+	}
+}
+
+// returns the log ring of the calling thread, creating it on first use. returns
+// nullptr once the thread has released its ring on exit.
+output::log_ring* output::get_local_ring() {
+	if (ring_released) return nullptr;
+	log_ring* ring = local_ring.ring;
+	if (ring != nullptr) return ring;
+
+	static atomic<uint16_t> next_thread_id{0};
+	ring = new log_ring(next_thread_id++);
+	{
+		lock_guard<mutex> g(fp_lock);
+		rings.push_back(ring);
+	}
+	local_ring.ring = ring;
+	return ring;
+}
+
+// appends a message to the calling thread's log ring. messages with a static
+// format string are stored as captured arguments; anything else is formatted
+// here.
+void output::enqueue(uint8_t level, const char* fmt, va_list args) {
+	uint8_t payload[MAX_MESSAGE_SIZE];
+	uint8_t type = log_format::RECORD_MESSAGE;
+	int len = -1;
+
+	va_list args_copy;
+	va_copy(args_copy, args);
+	len = log_format::encode_args(fmt, args_copy, payload, sizeof(payload));
+	va_end(args_copy);
+	if (len < 0) {
+		type = log_format::RECORD_TEXT;
+		len = vsnprintf((char*) payload, sizeof(payload), fmt, args);
+		if (len < 0) return;
+		if (len >= (int) sizeof(payload)) len = sizeof(payload)-1;
+	}
+
+	// the thread is exiting and its ring is gone: write the message out now,
+	// after everything logged before it
+	log_ring* ring = get_local_ring();
+	if (ring == nullptr) {
+		alignas(8) uint8_t buf[sizeof(log_entry) + MAX_MESSAGE_SIZE];
+		log_entry* entry = (log_entry*) buf;
+		entry->length = sizeof(log_entry) + len;
+		entry->type = type;
+		entry->level = level;
+		entry->timestamp = get_clock();
+		entry->fmt = fmt;
+		memcpy(entry+1, payload, len);
+
+		lock_guard<mutex> g(fp_lock);
+		flush_unsafe();
+		string batch;
+		write_entry_unsafe(entry, 0xffff, batch);
+		if (fp != nullptr && !batch.empty()) {
+			fwrite(batch.data(), 1, batch.size(), fp);
+			fflush(fp);
 		}
-		case loglevel::CRITICAL:
-		{
-			snprintf(result, sizeof(result), "[%s] CRITICAL: %s", timestamp, buf);
-			break;
+		return;
+	}
+
+	// reserve space in the ring
+	uint32_t length = (sizeof(log_entry) + len + 7) & ~7u;
+	uint64_t head = ring->head.load(memory_order_relaxed);
+	uint64_t tail = ring->tail.load(memory_order_acquire);
+	uint32_t offset = head % log_ring::SIZE;
+	uint32_t contiguous = log_ring::SIZE - offset;
+	uint32_t needed = contiguous < length ? contiguous + length : length;
+	if (log_ring::SIZE - (head - tail) < needed) {
+		++dropped;
+		return;
+	}
+	if (contiguous < length) {
+		if (contiguous >= sizeof(log_entry)) {
+			log_entry* pad = (log_entry*) (ring->data + offset);
+			pad->length = contiguous;
+			pad->type = log_entry::PAD;
 		}
-		case loglevel::ERROR:
-		{
-			snprintf(result, sizeof(result), "[%s] ERROR: %s", timestamp, buf);
-			break;
+		head += contiguous;
+		offset = 0;
+	}
+
+	// write the entry and publish it
+	log_entry* entry = (log_entry*) (ring->data + offset);
+	entry->length = length;
+	entry->type = type;
+	entry->level = level;
+	entry->timestamp = get_clock();
+	entry->fmt = fmt;
+	memcpy(entry+1, payload, len);
+	ring->head.store(head + length, memory_order_release);
+}
+
+// sends a message to the GUI controller, or to stdout if there is none
+void output::display(const char* msg) {
+	shared_ptr<gui_controller> current_controller = controller.lock();
+	if (current_controller != nullptr) {
+		current_controller->printf("%s", msg);
+	} else {
+		::printf("%s", msg);
+	}
+}
+
+// writer thread: drains the log rings periodically
+void output::writer_entrypoint() {
+	while (!writer_stop) {
+		this_thread::sleep_for(chrono::milliseconds(WRITER_INTERVAL_MS));
+		flush();
+	}
+}
+
+// drains all log rings, writing their entries in timestamp order as one batch.
+// caller holds fp_lock.
+void output::flush_unsafe() {
+
+	// calibrate the clock against the wall clock
+	#if __x86_64__ || __i386__
+	uint64_t ticks = get_clock() - clock_base;
+	if (ticks > 0) {
+		ns_per_tick = (double) (get_time_ns() - clock_base_ns) / ticks;
+	}
+	#endif
+
+	// collect pending entries
+	vector<pair<const log_entry*, uint16_t>> entries;
+	vector<uint64_t> new_tails(rings.size());
+	for (size_t counter = 0; counter < rings.size(); ++counter) {
+		log_ring* ring = rings[counter];
+		uint64_t head = ring->head.load(memory_order_acquire);
+		uint64_t pos = ring->tail.load(memory_order_relaxed);
+		while (pos < head) {
+			uint32_t offset = pos % log_ring::SIZE;
+			if (log_ring::SIZE - offset < sizeof(log_entry)) {
+				pos += log_ring::SIZE - offset;
+				continue;
+			}
+			const log_entry* entry = (const log_entry*) (ring->data + offset);
+			if (entry->type != log_entry::PAD) {
+				entries.push_back(make_pair(entry, ring->thread_id));
+			}
+			pos += entry->length;
 		}
-		case loglevel::BUG:
-		{
-			snprintf(result, sizeof(result), "[%s] BUG: %s", timestamp, buf);
-			break;
+		new_tails[counter] = pos;
+	}
+
+	stable_sort(entries.begin(), entries.end(), [](const pair<const log_entry*, uint16_t>& a, const pair<const log_entry*, uint16_t>& b) {
+		return a.first->timestamp < b.first->timestamp;
+	});
+
+	// write them out
+	string batch;
+	for (const auto& it : entries) {
+		write_entry_unsafe(it.first, it.second, batch);
+	}
+
+	uint64_t current_dropped = dropped;
+	if (current_dropped != dropped_reported) {
+		char msg[128];
+		snprintf(msg, sizeof(msg), "output::flush() -- %" PRIu64 " log messages dropped (log ring full).\n", current_dropped - dropped_reported);
+		dropped_reported = current_dropped;
+		write_text_unsafe((uint8_t) loglevel::WARNING, msg, batch);
+	}
+
+	// report suppressed messages of rate limited call sites, once a second
+	uint32_t now_sec = (uint32_t) time(nullptr);
+	if (now_sec != sites_reported_sec) {
+		sites_reported_sec = now_sec;
+		for (log_site* site : sites) {
+			uint32_t suppressed = site->suppressed.exchange(0, memory_order_relaxed);
+			if (suppressed == 0) continue;
+
+			char msg[256];
+			snprintf(msg, sizeof(msg), "%s:%d: last message repeated %u times.\n", site->file, site->line, suppressed);
+			write_text_unsafe((uint8_t) site->level, msg, batch);
 		}
 	}
 
-	// check if newline was written. if not, add one.
-	int len = strlen(buf);
-	if (len == 0 || buf[len-1] != '\n') {
-		strcat(buf, "\n");
+	if (fp != nullptr && !batch.empty()) {
+		fwrite(batch.data(), 1, batch.size(), fp);
+		fflush(fp);
 	}
 
-	// write to file
-	{
-		lock_guard<mutex> g(fp_lock);
-		if (fp != nullptr) {
-			fprintf(fp, "%s", result);
+	// release the ring space, and reclaim the rings of exited threads
+	for (size_t counter = 0; counter < rings.size(); ++counter) {
+		rings[counter]->tail.store(new_tails[counter], memory_order_release);
+	}
+	for (auto it = rings.begin(); it != rings.end();) {
+		if ((*it)->orphaned && (*it)->tail == (*it)->head) {
+			delete *it;
+			it = rings.erase(it);
+		} else {
+			++it;
 		}
 	}
+}
+
+// appends an entry to the output batch in the log file format, and displays it
+// if it is at or above the display threshold. caller holds fp_lock.
+void output::write_entry_unsafe(const log_entry* entry, uint16_t thread_id, string& batch) {
+	const char* payload = (const char*) (entry+1);
+	uint32_t payload_len = entry->length - sizeof(log_entry);
+	bool show = entry->level != log_format::NO_LEVEL && entry->level >= (uint8_t) loglevel_threshold;
+	bool binary = log_file_format == logformat::BINARY;
+	uint64_t timestamp_ns = to_nanoseconds(entry->timestamp);
+
+	// binary entries are written as records
+	if (binary) {
+		log_format::record_header header;
+		memset(&header, 0, sizeof(header));
+		header.type = entry->type;
+		header.level = entry->level;
+		header.thread_id = thread_id;
+		header.timestamp = timestamp_ns;
 
-	// display to output as required
-	int loglevel_threshold_num = (int) loglevel_threshold;
-	int loglevel_current_num = (int) level;
+		if (entry->type == log_format::RECORD_MESSAGE) {
 
-	if (loglevel_current_num >= loglevel_threshold_num) {
-		shared_ptr<gui_controller> current_controller = controller.lock();
-		if (current_controller != nullptr) {
-			current_controller->printf("%s", result);
+			// define the format string the first time it is used
+			auto it = format_ids.find(entry->fmt);
+			if (it == format_ids.end()) {
+				it = format_ids.insert(make_pair(entry->fmt, (uint32_t) format_ids.size())).first;
+				log_format::record_header format_header;
+				memset(&format_header, 0, sizeof(format_header));
+				format_header.type = log_format::RECORD_FORMAT;
+				format_header.format_id = it->second;
+				format_header.length = strlen(entry->fmt);
+				batch.append((const char*) &format_header, sizeof(format_header));
+				batch.append(entry->fmt, format_header.length);
+			}
+			header.format_id = it->second;
 		} else {
-			::printf("%s", result);
+			payload_len = strnlen(payload, payload_len);
 		}
+		header.length = payload_len;
+		batch.append((const char*) &header, sizeof(header));
+		batch.append(payload, payload_len);
+		if (!show) return;
 	}
+
+	// generate the text line
+	static uint64_t last_second = 0;
+	static char timestamp[128] = { '\0' };
+	if (timestamp_ns / 1000000000ULL != last_second || timestamp[0] == '\0') {
+		last_second = timestamp_ns / 1000000000ULL;
+		log_format::get_timestamp(timestamp_ns, timestamp, sizeof(timestamp));
+	}
+
+	string line = string("[") + timestamp + "] ";
+	if (entry->level != log_format::NO_LEVEL) {
+		line += log_format::get_level_name(entry->level);
+		line += ": ";
+	}
+	if (entry->type == log_format::RECORD_MESSAGE) {
+		line += log_format::decode_args(entry->fmt, (const uint8_t*) payload, payload_len);
+	} else {
+		line.append(payload, strnlen(payload, payload_len));
+	}
+	if (line.back() != '\n') line += '\n';
+
+	if (!binary) batch += line;
+	if (show) display(line.c_str());
+}
+
+// appends a message generated by the writer itself to the output batch.
+// caller holds fp_lock.
+void output::write_text_unsafe(uint8_t level, const char* msg, string& batch) {
+	alignas(8) uint8_t buf[sizeof(log_entry) + 256];
+	uint32_t len = strnlen(msg, 256);
+
+	log_entry* entry = (log_entry*) buf;
+	entry->length = sizeof(log_entry) + len;
+	entry->type = log_format::RECORD_TEXT;
+	entry->level = level;
+	entry->timestamp = get_clock();
+	entry->fmt = nullptr;
+	memcpy(entry+1, msg, len);
+	write_entry_unsafe(entry, 0xffff, batch);
+}
+
+// returns the clock used to stamp log entries. on x86 this is the timestamp
+// counter, which is much cheaper to read than the system clock; the writer
+// converts it to wall clock time.
+uint64_t output::get_clock() {
+	#if __x86_64__ || __i386__
+	return __builtin_ia32_rdtsc();
+	#else
+	return get_time_ns();
+	#endif
+}
+
+// converts a clock reading to nanoseconds since the unix epoch
+uint64_t output::to_nanoseconds(uint64_t clock) {
+	#if __x86_64__ || __i386__
+	return clock_base_ns + (int64_t) ((double) (int64_t) (clock - clock_base) * ns_per_tick);
+	#else
+	return clock;
+	#endif
+}
+
+// returns the wall clock time in nanoseconds since the unix epoch
+uint64_t output::get_time_ns() {
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
 }
 
 // generates a timestamp
 void output::get_timestamp(char* timestamp) {
 	time_t rawtime;
-	struct tm* info;
+	struct tm info;
 
 	time(&rawtime);
-	info = localtime(&rawtime);
-	strftime(timestamp, 128, "%d/%b %H:%M:%S", info);
+	localtime_r(&rawtime, &info);
+	strftime(timestamp, 128, "%d/%b %H:%M:%S", &info);
 }
-
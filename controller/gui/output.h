@@ -1,13 +1,28 @@
 #pragma once
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <time.h>
+#include <unordered_map>
+#include <vector>
 #include "gui_controller.h"
 
+class log_site;
+
 /*
  * all program output should be redirected to this class.
  * output will be sent to text GUI (if applicable), or stderr.
  * optionally, output may be logged from this module.
+ *
+ * logging is asynchronous: log() appends the message to a lock-free ring owned
+ * by the calling thread and returns. a background writer drains the rings of
+ * all threads every few milliseconds, orders the messages by timestamp and
+ * writes them out in a single batch. messages with a static format string are
+ * not formatted by the caller; their arguments are captured and formatted by
+ * the writer (or, in a binary log, by the log_decoder tool). if a ring is full
+ * the message is dropped and counted rather than blocking the caller.
  */
 class output {
 public:
@@ -15,6 +30,9 @@ public:
 	// enum type for priority classes
 	enum class loglevel { VERBOSE, INFO, WARNING, CRITICAL, ERROR, BUG };
 
+	// log file formats (binary logs are read with log_decoder)
+	enum class logformat { TEXT, BINARY };
+
 	// central on/off functionality
 	static void init(const shared_ptr<gui_controller>& controller);
 	static void shutdown();
@@ -22,15 +40,37 @@ public:
 	// used to control logging. log_printf controls if printfs() called through this output
 	// module will be logged. log_display_threshold determines what severity of errors should
 	// also be sent to the output when log() is called.
-	static bool start_log(const string& filename, bool log_printf=true, loglevel log_display_threshold=loglevel::WARNING);
+	static bool start_log(const string& filename, bool log_printf=true, loglevel log_display_threshold=loglevel::WARNING, logformat format=logformat::TEXT);
 	static void stop_log();
 
+	// writes out all pending log messages (called by the writer periodically)
+	static void flush();
+
+	// number of messages dropped because a thread's log ring was full
+	static uint64_t get_dropped_count();
+
+	// minimum level of messages that are logged or displayed. OUTPUT_LOG()
+	// checks it before evaluating the message arguments.
+	static void     set_log_level(loglevel level);
+	static loglevel get_log_level();
+	static bool     is_enabled(loglevel level) {
+		return (int) level >= log_level.load(memory_order_relaxed) &&
+			(logging_active.load(memory_order_relaxed) || (int) level >= (int) loglevel_threshold);
+	}
+
+	// default number of messages per second an OUTPUT_LOG_LIMITED() call site
+	// may log before it is suppressed
+	static void     set_log_rate_limit(uint32_t messages_per_sec);
+	static uint32_t get_log_rate_limit();
+
 	// output. printf() will send to screen and log (if set)
 	static void printf(const char* fmt, ...);
 	static void log(const char* fmt, ...);				// sends to logfile only -- does not display
 	static void log(const loglevel& level, const char* fmt, ...); // logs to file and also displays if the display threshold is lower than the loglevel
 
 private:
+
+	friend class log_site;
 	
 	static weak_ptr<gui_controller> controller;
 	static atomic_bool              log_printf;
@@ -38,5 +78,113 @@ private:
 	static mutex                    fp_lock;
 	static FILE*                    fp;
 
-	static void get_timestamp(char* timestamp);
+	// asynchronous logging
+	struct log_ring;
+	struct log_entry;
+	struct ring_owner;
+
+	static const uint32_t MAX_MESSAGE_SIZE = 4096;
+	static const uint32_t WRITER_INTERVAL_MS = 5;
+	static const uint32_t DEFAULT_LOG_RATE_LIMIT = 10;
+
+	static atomic_bool              logging_active;
+	static atomic<int>              log_level;
+	static logformat                log_file_format;
+	static vector<log_ring*>        rings;              // protected by fp_lock
+	static unordered_map<const char*, uint32_t> format_ids;
+	static atomic<uint64_t>         dropped;
+	static uint64_t                 dropped_reported;
+	static atomic_bool              writer_stop;
+	static thread                   writer_tid;
+	static thread_local ring_owner  local_ring;
+	static thread_local bool        ring_released;      // local_ring destroyed (thread exiting)
+	static uint64_t                 clock_base;         // clock calibration (protected by fp_lock)
+	static uint64_t                 clock_base_ns;
+	static double                   ns_per_tick;
+	static atomic<uint32_t>         log_rate_limit;
+	static vector<log_site*>        sites;              // protected by fp_lock
+	static atomic<uint32_t>         sites_reported_sec;
+
+	static void      get_timestamp(char* timestamp);
+	static uint64_t  get_clock();
+	static uint64_t  to_nanoseconds(uint64_t clock);
+	static uint64_t  get_time_ns();
+	static log_ring* get_local_ring();
+	static void      enqueue(uint8_t level, const char* fmt, va_list args);
+	static void      display(const char* msg);
+	static void      writer_entrypoint();
+	static void      flush_unsafe();
+	static void      write_entry_unsafe(const log_entry* entry, uint16_t thread_id, string& batch);
+	static void      write_text_unsafe(uint8_t level, const char* msg, string& batch);
+	static void      register_log_site(log_site* site);
+	static void      report_suppressed();
 };
+
+/*
+ * rate limiting state of one OUTPUT_LOG_LIMITED() call site. a site may log
+ * up to its budget of messages per second (the output rate limit unless the
+ * site sets its own); further messages in the same second are only counted,
+ * without formatting or evaluating their arguments. the count is reported once
+ * a second as "last message repeated N times": by the log writer, or without a
+ * log file, ahead of the next message that is displayed.
+ */
+class log_site {
+public:
+
+	log_site(output::loglevel level, const char* file, int line, uint32_t budget=0);
+
+	// checks if the site may log another message this second
+	bool allow() {
+		uint32_t now = (uint32_t) time(nullptr);
+		if (window.load(memory_order_relaxed) != now) {
+			window.store(now, memory_order_relaxed);
+			count.store(0, memory_order_relaxed);
+		}
+		uint32_t limit = budget != 0 ? budget : output::log_rate_limit.load(memory_order_relaxed);
+		if (count.fetch_add(1, memory_order_relaxed) < limit) return true;
+		suppressed.fetch_add(1, memory_order_relaxed);
+		return false;
+	}
+
+private:
+
+	friend class output;
+
+	output::loglevel   level;
+	const char*        file;
+	int                line;
+	uint32_t           budget;
+	atomic<uint32_t>   window;      // current second
+	atomic<uint32_t>   count;       // messages seen in the current second
+	atomic<uint32_t>   suppressed;  // messages not logged since the last report
+};
+
+// compile-time minimum log level: OUTPUT_LOG() calls below it are compiled out
+// (0 = VERBOSE ... 5 = BUG; the makefile sets it with -DOUTPUT_MIN_LOGLEVEL=n)
+#ifndef OUTPUT_MIN_LOGLEVEL
+#define OUTPUT_MIN_LOGLEVEL 0
+#endif
+
+// level-checked logging. the arguments are only evaluated if the level is
+// enabled, e.g. OUTPUT_LOG(VERBOSE, "flow [%s]\n", flow.to_string().c_str());
+#define OUTPUT_LOG(level, ...) \
+	do { \
+		if ((int) output::loglevel::level >= OUTPUT_MIN_LOGLEVEL && output::is_enabled(output::loglevel::level)) { \
+			output::log(output::loglevel::level, __VA_ARGS__); \
+		} \
+	} while (0)
+
+// level-checked logging with a per call site rate limit (the output default,
+// or messages_per_sec for OUTPUT_LOG_BUDGET). use on paths that can log per
+// packet, so that a misbehaving port cannot flood the log.
+#define OUTPUT_LOG_BUDGET(level, messages_per_sec, ...) \
+	do { \
+		if ((int) output::loglevel::level >= OUTPUT_MIN_LOGLEVEL && output::is_enabled(output::loglevel::level)) { \
+			static log_site output_log_site_(output::loglevel::level, __FILE__, __LINE__, messages_per_sec); \
+			if (output_log_site_.allow()) { \
+				output::log(output::loglevel::level, __VA_ARGS__); \
+			} \
+		} \
+	} while (0)
+
+#define OUTPUT_LOG_LIMITED(level, ...) OUTPUT_LOG_BUDGET(level, 0, __VA_ARGS__)
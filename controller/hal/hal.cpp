@@ -11,12 +11,22 @@
 #include "../services/ironstack_echo_daemon.h"
 #include "../services/operational_stats.h"
 #include "../services/switch_state.h"
+#include "packet_in_latency.h"
+#include "transaction_latency.h"
+#include "../utils/openflow_utils.h"
 #include "../gui/output.h"
 
 // expose some statistics here for the GUI
 uint64_t controller_bytes_sent = 0;
 uint64_t controller_bytes_received = 0;
 
+// gets the copy of a packet that a packet_out holds on to. refcounted packets
+// are shared; anything else is borrowed, which is safe because a transaction
+// serializes its request when it is created.
+static autobuf get_packet_out_data(const autobuf& packet) {
+	return (packet.is_refcounted() ? packet : packet.copy_as_read_only());
+}
+
 // constructor
 hal::hal() {
 	atomic_store(&switch_ready, false);
@@ -25,6 +35,9 @@ hal::hal() {
 	svc_catalog.set_controller(this);
 	svc_catalog.clear();
 	switch_response_time_ms = -1;
+	atomic_store(&packets_queued, (uint64_t) 0);
+	atomic_store(&packets_dropped_overflow, (uint64_t) 0);
+	atomic_store(&packets_dropped_timeout, (uint64_t) 0);
 }
 
 // destructor calls shutdown to reset all state and close threads
@@ -38,7 +51,7 @@ bool hal::init(uint16_t port, const set<shared_ptr<service>>& services,
 
 	bool expected = false;
 	if (!under_initialization.compare_exchange_strong(expected, true)) {
-		output::log(output::loglevel::VERBOSE, "hal::init() -- already under initialization.\n");
+		OUTPUT_LOG(VERBOSE, "hal::init() -- already under initialization.\n");
 		return false;
 	}
 
@@ -46,7 +59,7 @@ bool hal::init(uint16_t port, const set<shared_ptr<service>>& services,
 	// note that switch_ready and shutdown_flag cannot both be true (the shutdown
 	// function toggles the switch_ready flag first)
 	if (atomic_load(&switch_ready) && !atomic_load(&shutdown_flag)) {
-		output::log(output::loglevel::VERBOSE, "hal::init() -- already initialized.\n");
+		OUTPUT_LOG(VERBOSE, "hal::init() -- already initialized.\n");
 		return true;
 	}
 
@@ -73,7 +86,7 @@ bool hal::init(uint16_t port, const set<shared_ptr<service>>& services,
 				allowed_ip_addresses.count(info.get_remote_ip_address()) > 0) {
 				break;
 			} else {
-				output::log(output::loglevel::VERBOSE, "openflow connection rejected. ov-switch:[%s:%u] not in allowed list.\n",
+				OUTPUT_LOG(VERBOSE, "openflow connection rejected. ov-switch:[%s:%u] not in allowed list.\n",
 					info.get_remote_ip_address().to_string().c_str(),
 					info.get_remote_port());
 			}
@@ -84,6 +97,10 @@ bool hal::init(uint16_t port, const set<shared_ptr<service>>& services,
 	// with the openflow connection made, stop listening so other processes can listen
 	tcp::stop_listen(port);
 
+	// openflow messages are small and latency sensitive. without this, a
+	// packet_out that follows a flow_mod waits for the delayed ack of the switch
+	connection.set_no_delay(true);
+
 	// connected to a switch on the allowed ip address list
 	output::log(output::loglevel::INFO, "openflow connection established. ov-switch:[%s:%u] local-endpoint:[%s:%u].\n",
 		info.get_remote_ip_address().to_string().c_str(),
@@ -102,9 +119,9 @@ bool hal::init(uint16_t port, const set<shared_ptr<service>>& services,
 	m_hello->xid = hal_transaction::reserve_xid();
 	m_hello->serialize(serialized_msg);
 
-	if (connection.send_raw(serialized_msg)) {
+	if (send_to_switch(serialized_msg)) {
 		while(1) {
-			received_msg = ironstack::net_utils::get_next_openflow_message(connection, socket_buf);
+			received_msg = recv_from_switch(socket_buf);
 			if (received_msg == nullptr) {
 				output::log(output::loglevel::ERROR, "openflow handshaking failed.\n");
 				connection.close();
@@ -132,7 +149,7 @@ bool hal::init(uint16_t port, const set<shared_ptr<service>>& services,
 	m_set_config->max_msg_send_len = 65535;
 	m_set_config->serialize(serialized_msg);
 
-	if (connection.send_raw(serialized_msg)) {
+	if (send_to_switch(serialized_msg)) {
 		output::log(output::loglevel::INFO, "switch parameters submitted (no completion guarantee!).\n");
 	} else {
 		output::log(output::loglevel::ERROR, "failed to set switch parameters.\n");
@@ -146,9 +163,9 @@ bool hal::init(uint16_t port, const set<shared_ptr<service>>& services,
 	m_echo_req->xid = hal_transaction::reserve_xid();
 	m_echo_req->serialize(serialized_msg);
 
-	if (connection.send_raw(serialized_msg)) {
+	if (send_to_switch(serialized_msg)) {
 		while(1) {
-			received_msg = ironstack::net_utils::get_next_openflow_message(connection, socket_buf);
+			received_msg = recv_from_switch(socket_buf);
 			if (received_msg == nullptr) {
 				output::log(output::loglevel::ERROR, "openflow echo request failed.\n");
 				connection.close();
@@ -196,6 +213,9 @@ bool hal::init(uint16_t port, const set<shared_ptr<service>>& services,
 	// start up packet in processor
 	packet_processor.init(1);
 
+	// keep the session setup in the capture when it wraps, so it can be replayed
+	capture.pin();
+
 	// all done
 	output::log(output::loglevel::INFO, "ironstack controller started.\n");
 	return true;
@@ -249,11 +269,44 @@ void hal::shutdown() {
 	// TODO -- inform all pending transactions that they have failed
 	pending_transactions.clear();
 	asynchronous_messages.clear();
+	capture.close();
+	{
+		lock_guard<mutex> g(pending_destinations_lock);
+		for (const auto& it : pending_destinations) {
+			packets_dropped_timeout += it.second.packets.size();
+		}
+		pending_destinations.clear();
+	}
 
 	atomic_store(&switch_ready, false);
 	atomic_store(&shutdown_flag, false);
 }
 
+// starts recording openflow messages exchanged with the switch
+bool hal::start_capture(const string& filename, uint64_t max_bytes) {
+	return capture.open(filename, max_bytes);
+}
+
+// stops recording openflow messages
+void hal::stop_capture() {
+	capture.close();
+}
+
+// sends a serialized openflow message to the switch
+bool hal::send_to_switch(const autobuf& serialized_msg) {
+	capture.record(session_capture::TO_SWITCH, serialized_msg);
+	return connection.send_raw(serialized_msg);
+}
+
+// reads and deserializes the next openflow message from the switch
+shared_ptr<of_message> hal::recv_from_switch(autobuf& buf, packet_in_trace* trace) {
+	shared_ptr<of_message> result = ironstack::net_utils::get_next_openflow_message(connection, buf, trace);
+	if (result != nullptr) {
+		capture.record(session_capture::FROM_SWITCH, buf);
+	}
+	return result;
+}
+
 // sends an echo request to the switch
 bool hal::send_echo_request(int* response_time_ms) {
 
@@ -261,7 +314,7 @@ bool hal::send_echo_request(int* response_time_ms) {
 	shared_ptr<of_message_echo_request> request(new of_message_echo_request());
 	shared_ptr<blocking_hal_callback> hal_echo_request_callback(new blocking_hal_callback());
 	shared_ptr<hal_transaction> transaction(new hal_transaction(request, true, hal_echo_request_callback));
-	pending_transactions.enqueue(transaction);
+	enqueue_transaction(transaction);
 
 	// block while waiting for a response
 	// if the response is a false, that means the transaction failed
@@ -286,7 +339,7 @@ bool hal::send_barrier_request(int* response_time_ms) {
 	shared_ptr<of_message_barrier_request> request(new of_message_barrier_request());
 	shared_ptr<blocking_hal_callback> hal_barrier_request_callback(new blocking_hal_callback());
 	shared_ptr<hal_transaction> transaction(new hal_transaction(request, true, hal_barrier_request_callback));
-	pending_transactions.enqueue(transaction);
+	enqueue_transaction(transaction);
 
 	// block until barrier returns and is successful
 	if (!hal_barrier_request_callback->wait() || !hal_barrier_request_callback->is_transaction_successful()) {
@@ -321,7 +374,7 @@ bool hal::send_packet(const autobuf& packet, const set<uint16_t>& phy_ports) {
 
 	// generate the packet out request
 	shared_ptr<of_message_packet_out> pkt_out(new of_message_packet_out());
-	pkt_out->packet_data = packet.copy_as_read_only();
+	pkt_out->packet_data = get_packet_out_data(packet);
 
 	// generate an output action for each physical port
 	for (const auto& it : phy_ports) {
@@ -331,7 +384,7 @@ bool hal::send_packet(const autobuf& packet, const set<uint16_t>& phy_ports) {
 	}
 
 	shared_ptr<hal_transaction> transaction(new hal_transaction(pkt_out, false));
-	pending_transactions.enqueue(transaction);
+	enqueue_transaction(transaction);
 
 	return true;
 }
@@ -343,14 +396,237 @@ bool hal::send_packet(const autobuf& packet, uint16_t phy_port) {
 	return send_packet(packet, port_set);
 }
 
+// sends a packet to the ports in a port mask
+bool hal::send_packet(const autobuf& packet, const port_mask& phy_ports) {
+
+	if (!atomic_load(&switch_ready)) {
+		output::log(output::loglevel::ERROR, "hal::send_packet() -- switch is not in the ready mode.\n");
+		return false;
+	}
+
+	// generate the packet out request with an output action for each port
+	shared_ptr<of_message_packet_out> pkt_out(new of_message_packet_out());
+	pkt_out->packet_data = get_packet_out_data(packet);
+	phy_ports.for_each([&pkt_out](uint16_t port) {
+		of_action_output_to_port action;
+		action.port = port;
+		pkt_out->action_list.add_action(action);
+	});
+
+	shared_ptr<hal_transaction> transaction(new hal_transaction(pkt_out, false));
+	enqueue_transaction(transaction);
+
+	return true;
+}
+
+// sends a packet with a pre-serialized action list
+bool hal::send_packet_with_actions(const autobuf& packet, const autobuf& serialized_actions) {
+
+	if (!atomic_load(&switch_ready)) {
+		output::log(output::loglevel::ERROR, "hal::send_packet_with_actions() -- switch is not in the ready mode.\n");
+		return false;
+	}
+
+	shared_ptr<of_message_packet_out> pkt_out(new of_message_packet_out());
+	pkt_out->packet_data = get_packet_out_data(packet);
+	pkt_out->serialized_actions = serialized_actions.copy_as_refcounted();
+
+	shared_ptr<hal_transaction> transaction(new hal_transaction(pkt_out, false));
+	enqueue_transaction(transaction);
+
+	return true;
+}
+
 // sends a packet to a given IP address
 bool hal::send_packet(const autobuf& packet, const ip_address& nw_addr) {
-	return false;
+
+	if (!atomic_load(&switch_ready)) {
+		output::log(output::loglevel::ERROR, "hal::send_packet() -- switch is not in the ready mode.\n");
+		return false;
+	}
+
+	shared_ptr<arp> arp_svc = static_pointer_cast<arp>(get_service(service_catalog::service_type::ARP));
+	if (arp_svc == nullptr) {
+		output::log(output::loglevel::ERROR, "hal::send_packet() -- cannot send to [%s]; arp service offline.\n", nw_addr.to_string().c_str());
+		return false;
+	}
+
+	int tagged_vlan;
+	set<uint16_t> vlans = get_destination_vlans(packet, &tagged_vlan);
+	if (vlans.empty()) {
+		return false;
+	}
+
+	// fast path: the address is already known on one of the vlans
+	for (const auto& vlan_id : vlans) {
+		mac_address dl_addr = arp_svc->lookup_mac_for(nw_addr, vlan_id);
+		if (!dl_addr.is_nil()) {
+			return send_packet_on_vlan(packet, dl_addr, vlan_id);
+		}
+	}
+
+	// queue the packet behind the destination. the first packet for a
+	// destination starts the resolution; later packets only join the queue.
+	uint64_t key = (((uint64_t) (tagged_vlan == -1 ? 0 : tagged_vlan)) << 32) | nw_addr.get_as_be32();
+	{
+		lock_guard<mutex> g(pending_destinations_lock);
+		auto iterator = pending_destinations.find(key);
+		if (iterator != pending_destinations.end()) {
+			if (iterator->second.packets.size() >= MAX_PENDING_PACKETS_PER_DESTINATION) {
+				packets_dropped_overflow++;
+				return false;
+			}
+			iterator->second.packets.push_back(packet.copy_as_refcounted());
+			packets_queued++;
+			return true;
+		}
+
+		if (pending_destinations.size() >= MAX_PENDING_DESTINATIONS) {
+			packets_dropped_overflow++;
+			output::log(output::loglevel::WARNING, "hal::send_packet() -- too many unresolved destinations; packet to [%s] dropped.\n",
+				nw_addr.to_string().c_str());
+			return false;
+		}
+
+		pending_destination_t& destination = pending_destinations[key];
+		destination.packets.push_back(packet.copy_as_refcounted());
+		destination.outstanding_resolutions = vlans.size();
+		packets_queued++;
+	}
+
+	// resolve on every candidate vlan; callbacks run on arp threads
+	for (const auto& vlan_id : vlans) {
+		arp_svc->resolve(nw_addr, vlan_id, [this, key, vlan_id](const ip_address& ip, const mac_address& dl_addr) {
+			complete_pending_destination(key, dl_addr, vlan_id);
+		}, PENDING_DESTINATION_TIMEOUT_MS);
+	}
+	return true;
 }
 
 // sends a packet to a given MAC address
 bool hal::send_packet(const autobuf& packet, const mac_address& dl_addr) {
-	return false;
+
+	if (!atomic_load(&switch_ready)) {
+		output::log(output::loglevel::ERROR, "hal::send_packet() -- switch is not in the ready mode.\n");
+		return false;
+	}
+
+	set<uint16_t> vlans = get_destination_vlans(packet, nullptr);
+	bool result = !vlans.empty();
+	for (const auto& vlan_id : vlans) {
+		result = send_packet_on_vlan(packet, dl_addr, vlan_id) && result;
+	}
+	return result;
+}
+
+// returns the number of packets queued behind an ARP resolution
+uint64_t hal::get_packets_queued() const {
+	return atomic_load(&packets_queued);
+}
+
+// returns the number of packets dropped because a destination queue was full
+uint64_t hal::get_packets_dropped_overflow() const {
+	return atomic_load(&packets_dropped_overflow);
+}
+
+// returns the number of packets dropped because their destination could not
+// be resolved
+uint64_t hal::get_packets_dropped_timeout() const {
+	return atomic_load(&packets_dropped_timeout);
+}
+
+// returns the vlans a packet should be sent on: its own vlan if tagged, or all
+// switch vlans if untagged. tagged_vlan is set to the tag, or -1.
+set<uint16_t> hal::get_destination_vlans(const autobuf& packet, int* tagged_vlan) {
+
+	// only the ethernet header is needed here
+	if (packet.size() < sizeof(raw_packet::tagged_ethernet_hdr_t)) {
+		output::log(output::loglevel::ERROR, "hal::send_packet() -- malformed ethernet packet dropped.\n");
+		return set<uint16_t>();
+	}
+	const raw_packet::tagged_ethernet_hdr_t* hdr = (const raw_packet::tagged_ethernet_hdr_t*) packet.get_content_ptr();
+	bool has_vlan_tag = (hdr->vlan_8100[0] == 0x81 && hdr->vlan_8100[1] == 0x00);
+	uint16_t vlan_id = ((hdr->vlan_pcp_dei_id[0] << 8) | hdr->vlan_pcp_dei_id[1]) & 0x0fff;
+	if (tagged_vlan != nullptr) {
+		*tagged_vlan = (has_vlan_tag ? vlan_id : -1);
+	}
+	if (has_vlan_tag) {
+		return { vlan_id };
+	}
+
+	shared_ptr<switch_state> switch_state_svc = static_pointer_cast<switch_state>(get_service(service_catalog::service_type::SWITCH_STATE));
+	if (switch_state_svc == nullptr) {
+		output::log(output::loglevel::ERROR, "hal::send_packet() -- switch state offline; cannot determine vlans.\n");
+		return set<uint16_t>();
+	}
+	return switch_state_svc->get_port_snapshot()->get_vlan_ids().to_set();
+}
+
+// sends a packet to a mac address on one vlan: out the port learned in the
+// CAM table, or flooded on the vlan if the port is unknown. the packet is
+// tagged or untagged to match the output port.
+bool hal::send_packet_on_vlan(const autobuf& packet, const mac_address& dl_addr, uint16_t vlan_id) {
+
+	shared_ptr<cam> cam_svc = static_pointer_cast<cam>(get_service(service_catalog::service_type::CAM));
+	shared_ptr<switch_state> switch_state_svc = static_pointer_cast<switch_state>(get_service(service_catalog::service_type::SWITCH_STATE));
+	if (switch_state_svc == nullptr) {
+		output::log(output::loglevel::ERROR, "hal::send_packet() -- switch state offline; packet dropped.\n");
+		return false;
+	}
+
+	// work on an untagged copy addressed to the destination
+	autobuf untagged_packet;
+	if (!std_packet_utils::strip_vlan_tag(packet, untagged_packet)) {
+		output::log(output::loglevel::ERROR, "hal::send_packet() -- malformed ethernet packet dropped.\n");
+		return false;
+	}
+	dl_addr.get((uint8_t*) untagged_packet.get_content_ptr_mutable());
+
+	int phy_port = (cam_svc == nullptr ? -1 : cam_svc->lookup_port_for(dl_addr, vlan_id));
+	if (phy_port == -1) {
+		ironstack::net_utils::flood_packet(this, switch_state_svc, untagged_packet, vlan_id);
+		return true;
+	}
+
+	if (switch_state_svc->get_port_snapshot()->get_tagged_ports(vlan_id).test(phy_port)) {
+		autobuf tagged_packet;
+		std_packet_utils::set_vlan_tag(untagged_packet, tagged_packet, vlan_id);
+		return send_packet(tagged_packet, (uint16_t) phy_port);
+	}
+	return send_packet(untagged_packet, (uint16_t) phy_port);
+}
+
+// called when one of the resolutions for a queued destination completes.
+// a successful resolution drains the queue; the queue is dropped once every
+// resolution has failed.
+void hal::complete_pending_destination(uint64_t key, const mac_address& dl_addr, uint16_t vlan_id) {
+
+	vector<autobuf> packets;
+	{
+		lock_guard<mutex> g(pending_destinations_lock);
+		auto iterator = pending_destinations.find(key);
+		if (iterator == pending_destinations.end()) {
+			return;
+		}
+
+		if (dl_addr.is_nil()) {
+			if (--iterator->second.outstanding_resolutions != 0) {
+				return;
+			}
+			packets_dropped_timeout += iterator->second.packets.size();
+			OUTPUT_LOG(VERBOSE, "hal::send_packet() -- destination unresolved; %u packet(s) dropped.\n",
+				(uint32_t) iterator->second.packets.size());
+			pending_destinations.erase(iterator);
+			return;
+		}
+
+		packets.swap(iterator->second.packets);
+		pending_destinations.erase(iterator);
+	}
+
+	for (const auto& it : packets) {
+		send_packet_on_vlan(it, dl_addr, vlan_id);
+	}
 }
 
 // returns a reference to the internal service catalog
@@ -370,6 +646,22 @@ packet_in_processor* hal::get_packet_processor() {
 
 // queues a hal transaction for processing
 void hal::enqueue_transaction(const shared_ptr<hal_transaction>& transaction) {
+
+	// timestamp transactions that wait for completion (see transaction_latency)
+	if (transaction != nullptr && transaction->has_completion_acknowledgement()) {
+		transaction->set_enqueue_time(cycle_clock::now());
+	}
+
+	// attribute packet_outs and flow_mods issued while filtering a sampled packet_in
+	const packet_in_trace* trace = packet_in_latency::get_current_trace();
+	if (trace != nullptr && transaction != nullptr) {
+		shared_ptr<of_message> request = transaction->get_request();
+		if (request != nullptr && (request->msg_type == OFPT_PACKET_OUT || request->msg_type == OFPT_FLOW_MOD)) {
+			uint64_t now = cycle_clock::now();
+			packet_in_latency::record(packet_in_latency::stage::OUTPUT_ENQUEUE, trace->read, now);
+			transaction->set_trace(trace->read, now);
+		}
+	}
 	pending_transactions.enqueue(transaction);
 }
 
@@ -388,11 +680,12 @@ void hal::send_loop_entrypoint() {
 		// could be lost
 		if (current_msg->has_completion_acknowledgement()) {
 			lock_guard<mutex> g(callback_transactions_lock);
+			current_msg->set_send_time(cycle_clock::now());
 			callback_transactions.push_back(current_msg);
 		}
 
 		// send message to the switch
-		if (!connection.send_raw(*current_msg->get_serialized_msg())) {
+		if (!send_to_switch(*current_msg->get_serialized_msg())) {
 			output::log(output::loglevel::ERROR, "hal::send_loop_entrypoint() -- could not send the openflow message.\n");
 			if (!connection.get_connection_info().is_connected()) {
 				output::log(output::loglevel::ERROR, "hal::send_loop_entrypoint() -- controller connection broken.\n");
@@ -400,6 +693,13 @@ void hal::send_loop_entrypoint() {
 			break;
 		}
 		controller_bytes_sent = connection.get_connection_info().get_bytes_sent();
+
+		// latency tracing for messages sent in response to a sampled packet_in
+		if (current_msg->get_trace_enqueued() != 0) {
+			uint64_t now = cycle_clock::now();
+			packet_in_latency::record(packet_in_latency::stage::OUTPUT_SEND, current_msg->get_trace_enqueued(), now);
+			packet_in_latency::record(packet_in_latency::stage::TOTAL, current_msg->get_trace_read(), now);
+		}
 	}
 
 	output::log(output::loglevel::INFO, "hal send loop shutdown completed.\n");
@@ -410,10 +710,12 @@ void hal::recv_loop_entrypoint() {
 
 	shared_ptr<of_message> current_msg;
 	autobuf sock_buf;
+	packet_in_trace trace;
 	while(!atomic_load(&shutdown_flag)) {
 
-		// read the next message from the connection
-		current_msg = ironstack::net_utils::get_next_openflow_message(connection, sock_buf);
+		// read the next message from the connection (timing one in every few)
+		bool sampled = packet_in_latency::should_sample();
+		current_msg = recv_from_switch(sock_buf, sampled ? &trace : nullptr);
 		if (current_msg == nullptr) {
 			output::log(output::loglevel::ERROR, "hal::recv_loop_entrypoint() -- could not read the next openflow message.\n");
 			if (!connection.get_connection_info().is_connected()) {
@@ -423,6 +725,13 @@ void hal::recv_loop_entrypoint() {
 		}
 		controller_bytes_received = connection.get_connection_info().get_bytes_received();
 
+		// only packet_ins carry their trace further down the pipeline
+		if (sampled && current_msg->msg_type == OFPT_PACKET_IN) {
+			static_pointer_cast<of_message_packet_in>(current_msg)->trace = trace;
+			packet_in_latency::record(packet_in_latency::stage::FRAMING, trace.read, trace.framed);
+			packet_in_latency::record(packet_in_latency::stage::MESSAGE_DECODE, trace.framed, trace.decoded);
+		}
+
 		// enqueue for processing
 		asynchronous_messages.enqueue(current_msg);
 	}
@@ -454,16 +763,8 @@ void hal::process_message_loop_entrypoint() {
 			case (OFPT_ERROR):
 			{
 				shared_ptr<of_message_error> msg = static_pointer_cast<of_message_error>(current_msg);
-				output::log(output::loglevel::ERROR, "\n*** the openflow switch has sent an error ***\nmsg xid: %d\nerror message contents:\n%s\n\n", msg->xid, msg->to_string().c_str());
-
-				// log the error message into a file
-				FILE* fp = fopen("error.txt", "a");
-				if (fp != nullptr) {
-					fprintf(fp, "An OpenFlow error has occurred. This may be a bug in the ironstack code.\n\nmsg xid: %d\n", msg->xid);
-					fprintf(fp, "verbose error: \n%s\n\n", msg->to_string().c_str());
-					fprintf(fp, "error data hex output:\n%s\n", msg->error_data.to_hex().c_str());
-					fclose(fp);
-				}
+				output::log(output::loglevel::ERROR, "\n*** the openflow switch has sent an error ***\nmsg xid: %d\nerror message contents:\n%s\nerror data hex output:\n%s\n\n",
+					msg->xid, msg->to_string().c_str(), msg->error_data.to_hex().c_str());
 
 				perform_callbacks = true;
 				callback_status = false;
@@ -498,6 +799,10 @@ void hal::process_message_loop_entrypoint() {
 			case (OFPT_PACKET_IN):
 			{
 				shared_ptr<of_message_packet_in> msg = static_pointer_cast<of_message_packet_in>(current_msg);
+				if (msg->trace.is_sampled()) {
+					msg->trace.dispatched = cycle_clock::now();
+					packet_in_latency::record(packet_in_latency::stage::HAL_QUEUE, msg->trace.decoded, msg->trace.dispatched);
+				}
 				packet_processor.enqueue_packet(msg);
 
 				perform_callbacks = false;
@@ -664,6 +969,7 @@ void hal::process_message_loop_entrypoint() {
 		// process callbacks if required
 		if (perform_callbacks) {
 			uint32_t xid = current_msg->xid;
+			uint64_t completed = cycle_clock::now();
 		
 			// if this is a barrier reply, handle all preceding callbacks as successful (since no error messages were generated)
 			if (current_msg->msg_type == OFPT_BARRIER_REPLY) {
@@ -687,6 +993,7 @@ void hal::process_message_loop_entrypoint() {
 							}
 						}
 						// if callback was fired, remove it from the callback backlog
+						transaction_latency::record(**iterator, completed);
 						iterator = callback_transactions.erase(iterator);
 					} else {
 						++iterator;
@@ -702,6 +1009,7 @@ void hal::process_message_loop_entrypoint() {
 						(*iterator)->set_reply(current_msg);
 						(*iterator)->get_callback()->hal_callback((*iterator), current_msg, callback_status);
 						
+						transaction_latency::record(**iterator, completed);
 						callback_transactions.erase(iterator);
 						break;
 					} else {
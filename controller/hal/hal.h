@@ -6,13 +6,17 @@
 #include <stdio.h>
 #include <string>
 #include <stdint.h>
+#include <unordered_map>
+#include <vector>
 #include "../../common/ip_address.h"
 #include "../../common/mac_address.h"
 #include "../../common/rwqueue.h"
 #include "../../common/tcp.h"
 #include "hal_transaction.h"
+#include "../ironstack_types/openflow_vlan_port.h"
 #include "service_catalog.h"
 #include "packet_in_processor.h"
+#include "session_capture.h"
 
 // hardware abstraction layer to isolate users from dealing with the
 // OpenFlow switch.
@@ -21,6 +25,7 @@
 // revision 5 (2/20/15)
 
 using namespace std;
+class packet_in_trace;
 class hal {
 public:
 
@@ -38,6 +43,11 @@ public:
 	// stops the openflow controller; releases shared pointers to services.
 	void shutdown();
 
+	// records every openflow message exchanged with the switch to a capture file
+	// (see session_capture). call before init() to include the handshake.
+	bool start_capture(const string& filename, uint64_t max_bytes=session_capture::DEFAULT_MAX_BYTES);
+	void stop_capture();
+
 	// sends a ping request to the switch
 	bool send_echo_request(int* response_time_ms=nullptr);
 
@@ -53,15 +63,33 @@ public:
 	// openflow message).
 	bool send_packet(const autobuf& packet, const set<uint16_t>& phy_ports);
 	bool send_packet(const autobuf& packet, uint16_t phy_port);
+	bool send_packet(const autobuf& packet, const port_mask& phy_ports);
+
+	// sends a raw ethernet packet with a pre-serialized openflow action list
+	bool send_packet_with_actions(const autobuf& packet, const autobuf& serialized_actions);
 
 	// send a packet using the controller identity to a given IP or mac address
 	// destination. if IP address is unknown, ARP is first sent. if mac address
 	// is unknown, the packet is flooded on all spanning tree ports on all vlans.
 	// these functions do not block (but messages may be dropped if the ARP
 	// times out and the destination cannot be resolved).
+	//
+	// the ethernet destination of the packet is rewritten to the resolved mac
+	// address. a vlan-tagged packet is only sent on its own vlan; untagged
+	// packets are sent on every vlan of the switch. packets waiting on ARP are
+	// held in a bounded queue per destination that drains on resolution.
 	bool send_packet(const autobuf& packet, const ip_address& address);
 	bool send_packet(const autobuf& packet, const mac_address& address);
 
+	// accounting for packets sent to IP addresses
+	uint64_t get_packets_queued() const;
+	uint64_t get_packets_dropped_overflow() const;
+	uint64_t get_packets_dropped_timeout() const;
+
+	static const uint32_t MAX_PENDING_PACKETS_PER_DESTINATION = 16;
+	static const uint32_t MAX_PENDING_DESTINATIONS = 1024;
+	static const int      PENDING_DESTINATION_TIMEOUT_MS = 3000;
+
 	// gets the service catalog (for registration/unregistration)
 	service_catalog* get_service_catalog();
 
@@ -80,6 +108,24 @@ private:
 	hal(const hal& other)=delete;
 	hal& operator=(const hal& other)=delete;
 
+	// packets waiting for a destination to be resolved through ARP
+	class pending_destination_t {
+	public:
+		pending_destination_t():outstanding_resolutions(0) {}
+
+		vector<autobuf>   packets;                  // refcounted, so queueing is O(1)
+		uint32_t          outstanding_resolutions;  // one per vlan queried
+	};
+
+	// helpers to send packets to resolved destinations
+	set<uint16_t> get_destination_vlans(const autobuf& packet, int* tagged_vlan);
+	bool send_packet_on_vlan(const autobuf& packet, const mac_address& address, uint16_t vlan_id);
+	void complete_pending_destination(uint64_t key, const mac_address& address, uint16_t vlan_id);
+
+	// all messages to and from the switch pass through these (for the capture)
+	bool send_to_switch(const autobuf& serialized_msg);
+	shared_ptr<of_message> recv_from_switch(autobuf& buf, packet_in_trace* trace=nullptr);
+
 	// thread entrypoints
 	void send_loop_entrypoint();		// sends pending controller messages in the pending queue
 	void recv_loop_entrypoint();		// receives controller messages and parses them
@@ -95,6 +141,9 @@ private:
 	// TCP connection to the switch
 	tcp connection;
 
+	// optional recording of the openflow session
+	session_capture capture;
+
 	// in and out queues
 	rwqueue<shared_ptr<hal_transaction>> pending_transactions;    // waiting to get to the switch
 	rwqueue<shared_ptr<of_message>>      asynchronous_messages;   // async switch to controller msgs
@@ -116,5 +165,12 @@ private:
 
 	// switch responsiveness
 	atomic_int switch_response_time_ms;
+
+	// packets waiting on ARP (keyed by vlan << 32 | ip, vlan 0 if untagged)
+	mutex                                pending_destinations_lock;
+	unordered_map<uint64_t, pending_destination_t> pending_destinations;
+	atomic<uint64_t>                     packets_queued;
+	atomic<uint64_t>                     packets_dropped_overflow;
+	atomic<uint64_t>                     packets_dropped_timeout;
 };
 
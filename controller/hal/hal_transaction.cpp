@@ -68,6 +68,42 @@ uint32_t hal_transaction::reserve_xid() {
 	return xid_counter++;
 }
 
+// marks the transaction as sent in response to a sampled packet_in
+void hal_transaction::set_trace(uint64_t packet_read, uint64_t enqueued) {
+	trace_read = packet_read;
+	trace_enqueued = enqueued;
+}
+
+// gets the time the sampled packet_in was read (0 if not traced)
+uint64_t hal_transaction::get_trace_read() const {
+	return trace_read;
+}
+
+// gets the time the transaction was enqueued (0 if not traced)
+uint64_t hal_transaction::get_trace_enqueued() const {
+	return trace_enqueued;
+}
+
+// sets the time the transaction was enqueued to the hal
+void hal_transaction::set_enqueue_time(uint64_t timestamp) {
+	enqueue_time = timestamp;
+}
+
+// sets the time the transaction was written to the switch
+void hal_transaction::set_send_time(uint64_t timestamp) {
+	send_time = timestamp;
+}
+
+// gets the time the transaction was enqueued to the hal
+uint64_t hal_transaction::get_enqueue_time() const {
+	return enqueue_time;
+}
+
+// gets the time the transaction was written to the switch
+uint64_t hal_transaction::get_send_time() const {
+	return send_time;
+}
+
 // unblocks any potential waiting callers
 void blocking_hal_callback::hal_callback(const shared_ptr<hal_transaction>& transaction_reply,
 	const shared_ptr<of_message>& openflow_reply,
@@ -26,10 +26,10 @@ class hal_transaction {
 public:
 
 	// constructors and destructor
-	hal_transaction():needs_completion_acknowledgement(false) {}
+	hal_transaction():needs_completion_acknowledgement(false), trace_read(0), trace_enqueued(0), enqueue_time(0), send_time(0) {}
 	hal_transaction(const shared_ptr<of_message>& request,
 		bool needs_acknowledgement,
-		const shared_ptr<hal_callbacks>& cob=nullptr) {
+		const shared_ptr<hal_callbacks>& cob=nullptr):trace_read(0), trace_enqueued(0), enqueue_time(0), send_time(0) {
 		assign_and_serialize(request, needs_acknowledgement, cob);
 	}
 	~hal_transaction() {}
@@ -67,6 +67,20 @@ public:
 	// manually reserve one transaction value
 	static uint32_t reserve_xid();
 
+	// latency tracing: cycle_clock timestamps of the sampled packet_in this
+	// message was sent in response to, and of the enqueue (0 if not traced)
+	void     set_trace(uint64_t packet_read, uint64_t enqueued);
+	uint64_t get_trace_read() const;
+	uint64_t get_trace_enqueued() const;
+
+	// cycle_clock timestamps of when the transaction was enqueued to the hal
+	// and written to the switch (0 if not yet; only kept for transactions
+	// that need completion acknowledgement)
+	void     set_enqueue_time(uint64_t timestamp);
+	void     set_send_time(uint64_t timestamp);
+	uint64_t get_enqueue_time() const;
+	uint64_t get_send_time() const;
+
 private:
 
 	// points to the request message and the serialized content
@@ -86,6 +100,14 @@ private:
 	// the needs_completion_acknowledgement flag is set).
 	shared_ptr<hal_callbacks> callback;
 
+	// latency tracing timestamps
+	uint64_t                  trace_read;
+	uint64_t                  trace_enqueued;
+
+	// transaction latency timestamps
+	uint64_t                  enqueue_time;
+	uint64_t                  send_time;
+
 private:
 
 	static atomic<uint32_t> xid_counter;
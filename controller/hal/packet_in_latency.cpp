@@ -0,0 +1,145 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include "packet_in_latency.h"
+
+atomic<uint32_t> packet_in_latency::sample_rate{packet_in_latency::DEFAULT_SAMPLE_RATE};
+atomic<uint32_t> packet_in_latency::sample_counter{0};
+latency_histogram packet_in_latency::stages[packet_in_latency::NUM_STAGES];
+latency_histogram packet_in_latency::filters[packet_in_latency::NUM_FILTER_CLASSES];
+thread_local const packet_in_trace* packet_in_latency::current_trace = nullptr;
+
+// sets the sampling rate (one in n messages; 0 disables tracing)
+void packet_in_latency::set_sample_rate(uint32_t one_in_n) {
+	sample_rate = one_in_n;
+}
+
+// gets the sampling rate
+uint32_t packet_in_latency::get_sample_rate() {
+	return sample_rate;
+}
+
+// decides if the next message should be sampled
+bool packet_in_latency::should_sample() {
+	uint32_t rate = sample_rate.load(memory_order_relaxed);
+	if (rate == 0) return false;
+	return sample_counter.fetch_add(1, memory_order_relaxed) % rate == 0;
+}
+
+// records the time spent in a pipeline stage
+void packet_in_latency::record(stage pipeline_stage, uint64_t start, uint64_t end) {
+	if (start == 0 || end < start) return;
+	stages[(uint32_t) pipeline_stage].record(end - start);
+}
+
+// records the time spent in a packet filter
+void packet_in_latency::record_filter(uint32_t priority, uint64_t start, uint64_t end) {
+	if (priority >= NUM_FILTER_CLASSES || end < start) return;
+	filters[priority].record(end - start);
+}
+
+// sets the sampled packet being filtered on this thread
+void packet_in_latency::set_current_trace(const packet_in_trace* trace) {
+	current_trace = trace;
+}
+
+// gets the sampled packet being filtered on this thread
+const packet_in_trace* packet_in_latency::get_current_trace() {
+	return current_trace;
+}
+
+// gets the histogram of a pipeline stage (in cycle_clock ticks)
+const latency_histogram& packet_in_latency::get_histogram(stage pipeline_stage) {
+	return stages[(uint32_t) pipeline_stage];
+}
+
+// gets the histogram of a packet filter priority class (in cycle_clock ticks)
+const latency_histogram& packet_in_latency::get_filter_histogram(uint32_t priority) {
+	return filters[priority < NUM_FILTER_CLASSES ? priority : 0];
+}
+
+// gets the display name of a pipeline stage
+const char* packet_in_latency::get_stage_name(stage pipeline_stage) {
+	switch (pipeline_stage) {
+		case stage::FRAMING:
+			return "socket framing";
+		case stage::MESSAGE_DECODE:
+			return "message decode";
+		case stage::HAL_QUEUE:
+			return "hal queue";
+		case stage::PROCESSOR_QUEUE:
+			return "processor queue";
+		case stage::FILTERS:
+			return "all filters";
+		case stage::OUTPUT_ENQUEUE:
+			return "read -> output enqueue";
+		case stage::OUTPUT_SEND:
+			return "output send";
+		case stage::TOTAL:
+			return "read -> output sent";
+	}
+	return "unknown";
+}
+
+// gets the display name of a packet filter priority class
+const char* packet_in_latency::get_filter_name(uint32_t priority) {
+	switch ((packet_in_processor::priority_class) priority) {
+		case packet_in_processor::priority_class::CAM:
+			return "filter: cam";
+		case packet_in_processor::priority_class::ARP:
+			return "filter: arp";
+		case packet_in_processor::priority_class::ECHO_SERVER:
+			return "filter: echo server";
+		case packet_in_processor::priority_class::INTER_IRONSTACK:
+			return "filter: inter-ironstack";
+		case packet_in_processor::priority_class::FLOW_POLICY_CHECKER:
+			return "filter: flow policy";
+		default:
+			return "filter: unknown";
+	}
+}
+
+// generates a table of all histograms (times in microseconds)
+string packet_in_latency::to_string() {
+	char buf[256];
+	double us_per_tick = cycle_clock::get_ns_per_tick() / 1000.0;
+	string result;
+
+	uint32_t rate = get_sample_rate();
+	if (rate == 0) {
+		result = "packet_in latency (sampling disabled; times in us)\n";
+	} else {
+		snprintf(buf, sizeof(buf), "packet_in latency (sampling 1 in %u; times in us)\n", rate);
+		result = buf;
+	}
+	snprintf(buf, sizeof(buf), "%-24s %10s %9s %9s %9s %9s %9s\n", "stage", "samples", "mean", "p50", "p99", "p99.9", "max");
+	result += buf;
+
+	auto append = [&](const char* name, const latency_histogram& histogram) {
+		snprintf(buf, sizeof(buf), "%-24s %10" PRIu64 " %9.1f %9.1f %9.1f %9.1f %9.1f\n", name,
+			histogram.get_count(),
+			histogram.get_mean() * us_per_tick,
+			histogram.get_percentile(0.5) * us_per_tick,
+			histogram.get_percentile(0.99) * us_per_tick,
+			histogram.get_percentile(0.999) * us_per_tick,
+			histogram.get_max() * us_per_tick);
+		result += buf;
+	};
+
+	for (uint32_t counter = 0; counter < NUM_STAGES; ++counter) {
+		append(get_stage_name((stage) counter), stages[counter]);
+	}
+	for (uint32_t counter = 1; counter < NUM_FILTER_CLASSES; ++counter) {
+		append(get_filter_name(counter), filters[counter]);
+	}
+	return result;
+}
+
+// resets all histograms
+void packet_in_latency::clear() {
+	for (uint32_t counter = 0; counter < NUM_STAGES; ++counter) {
+		stages[counter].clear();
+	}
+	for (uint32_t counter = 0; counter < NUM_FILTER_CLASSES; ++counter) {
+		filters[counter].clear();
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include "../../common/latency_histogram.h"
+#include "../openflow_messages/of_message_packet_in.h"
+#include "packet_in_processor.h"
+using namespace std;
+
+// latency tracing for the packet_in pipeline
+//
+// one in every N messages read from the switch is sampled. a sampled packet_in
+// carries a packet_in_trace with the time it was read off the socket, framed,
+// decoded, dispatched by the hal and dequeued by a packet_in processor thread;
+// each stage, each packet filter (by priority class) and any packet_out or
+// flow_mod the filters issue for the packet (enqueue and send) are recorded
+// into log-bucketed histograms. unsampled packets take no timestamps at all.
+//
+// revision 1 (10/19/26)
+
+class packet_in_latency {
+public:
+
+	// pipeline stages (each measured from the end of the previous stage)
+	enum class stage : uint32_t {	FRAMING = 0,          // header read -> full message read
+																MESSAGE_DECODE = 1,   // message read -> decoded
+																HAL_QUEUE = 2,        // decoded -> dispatched by the hal process loop
+																PROCESSOR_QUEUE = 3,  // dispatched -> dequeued by a processor thread
+																FILTERS = 4,          // dequeued -> filter chain done
+																OUTPUT_ENQUEUE = 5,   // header read -> packet_out/flow_mod enqueued
+																OUTPUT_SEND = 6,      // enqueued -> written to the switch
+																TOTAL = 7             // header read -> packet_out/flow_mod written
+	};
+
+	static const uint32_t NUM_STAGES = 8;
+	static const uint32_t NUM_FILTER_CLASSES = (uint32_t) packet_in_processor::priority_class::ALWAYS_AT_LAST;
+	static const uint32_t DEFAULT_SAMPLE_RATE = 16;
+
+	// sampling control (one in n messages; 0 disables tracing)
+	static void     set_sample_rate(uint32_t one_in_n);
+	static uint32_t get_sample_rate();
+	static bool     should_sample();
+
+	// records the time spent between two cycle_clock timestamps
+	static void record(stage pipeline_stage, uint64_t start, uint64_t end);
+	static void record_filter(uint32_t priority, uint64_t start, uint64_t end);
+
+	// the sampled packet being filtered on the calling thread (nullptr if none),
+	// so that messages sent by the filters can be attributed to it
+	static void                   set_current_trace(const packet_in_trace* trace);
+	static const packet_in_trace* get_current_trace();
+
+	// reporting
+	static const latency_histogram& get_histogram(stage pipeline_stage);
+	static const latency_histogram& get_filter_histogram(uint32_t priority);
+	static const char* get_stage_name(stage pipeline_stage);
+	static const char* get_filter_name(uint32_t priority);
+	static string      to_string();
+	static void        clear();
+
+private:
+
+	static atomic<uint32_t>  sample_rate;
+	static atomic<uint32_t>  sample_counter;
+	static latency_histogram stages[NUM_STAGES];
+	static latency_histogram filters[NUM_FILTER_CLASSES];
+	static thread_local const packet_in_trace* current_trace;
+};
@@ -2,6 +2,7 @@
 #include "../openflow_messages/of_message_packet_in.h"
 #include "../../common/std_packet.h"
 #include "../gui/output.h"
+#include "packet_in_latency.h"
 
 // constructor
 packet_in_processor::packet_in_processor() {
@@ -89,6 +90,11 @@ void packet_in_processor::enqueue_packet(const shared_ptr<of_message_packet_in>&
 	packet_queue.enqueue(packet);
 }
 
+// gets the number of packets waiting for a processor thread
+uint32_t packet_in_processor::get_queue_length() const {
+	return packet_queue.size();
+}
+
 // registers a filter for packet processing
 void packet_in_processor::register_filter(const shared_ptr<packet_filter>& filter) {
 
@@ -126,8 +132,14 @@ void packet_in_processor::packet_processing_entrypoint() {
 		
 		current_packet = packet_queue.dequeue();
 		if (current_packet == nullptr) continue;
+		bool sampled = current_packet->trace.is_sampled();
+		if (sampled) {
+			current_packet->trace.dequeued = cycle_clock::now();
+			packet_in_latency::record(packet_in_latency::stage::PROCESSOR_QUEUE, current_packet->trace.dispatched, current_packet->trace.dequeued);
+			packet_in_latency::set_current_trace(&current_packet->trace);
+		}
 		if (!raw_pkt.deserialize(current_packet->pkt_data)) {
-			output::log(output::loglevel::WARNING, "packet_in_processor::packet_processing_entrypoint() "
+			OUTPUT_LOG_LIMITED(WARNING, "packet_in_processor::packet_processing_entrypoint() "
 				"-- failed to deserialize raw packet. this packet originated from port %hu.\n", current_packet->in_port);
 		}
 
@@ -138,11 +150,26 @@ void packet_in_processor::packet_processing_entrypoint() {
 		}
 
 		handled = false;
-		for (const auto filter : packet_filter_copy) {
-			if (filter.first->filter_packet(current_packet, raw_pkt)) {
-				handled = true;
-				break;
+		if (!sampled) {
+			for (const auto& filter : packet_filter_copy) {
+				if (filter.first->filter_packet(current_packet, raw_pkt)) {
+					handled = true;
+					break;
+				}
+			}
+		} else {
+
+			// sampled packets time each filter they pass through
+			uint64_t start = cycle_clock::now();
+			for (const auto& filter : packet_filter_copy) {
+				handled = filter.first->filter_packet(current_packet, raw_pkt);
+				uint64_t end = cycle_clock::now();
+				packet_in_latency::record_filter(filter.second, start, end);
+				start = end;
+				if (handled) break;
 			}
+			packet_in_latency::record(packet_in_latency::stage::FILTERS, current_packet->trace.dequeued, start);
+			packet_in_latency::set_current_trace(nullptr);
 		}
 
 		/*
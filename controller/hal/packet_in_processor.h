@@ -41,6 +41,9 @@ public:
 	void register_filter(const shared_ptr<packet_filter>& filter);
 	void unregister_filter(const shared_ptr<packet_filter>& filter);
 
+	// gets the number of packets waiting for a processor thread
+	uint32_t get_queue_length() const;
+
 private:
 
 	// init and shutdown flags
@@ -0,0 +1,338 @@
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "session_capture.h"
+#include "../gui/output.h"
+
+const char session_capture::MAGIC[8] = { 'I', 'S', 'O', 'F', 'C', 'A', 'P', '1' };
+
+// records are padded so that every record header is aligned
+static inline uint64_t get_padded_size(uint32_t length) {
+	return (sizeof(session_capture::record_header) + length + 7) & ~7ULL;
+}
+
+// gets the current time in nanoseconds since the unix epoch
+static inline uint64_t get_time_ns() {
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// constructor
+session_capture::session_capture():active(false),
+	fd(-1),
+	mapping(nullptr),
+	mapping_size(0) {}
+
+// destructor
+session_capture::~session_capture() {
+	close();
+}
+
+// creates the capture file and maps it
+bool session_capture::open(const string& filename_, uint64_t max_bytes) {
+	close();
+	if (max_bytes < sizeof(file_header) + (1 << 16)) {
+		output::log(output::loglevel::ERROR, "session_capture::open() -- capture size of %" PRIu64 " bytes is too small.\n", max_bytes);
+		return false;
+	}
+
+	lock_guard<mutex> g(lock);
+	fd = ::open(filename_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		output::log(output::loglevel::ERROR, "session_capture::open() -- unable to create %s: %s.\n", filename_.c_str(), strerror(errno));
+		return false;
+	}
+
+	// reserve the blocks up front. a sparse file would be filled in through
+	// the mapping, and running out of disk there raises SIGBUS.
+	int error = posix_fallocate(fd, 0, max_bytes);
+	if (error != 0) {
+		output::log(output::loglevel::ERROR, "session_capture::open() -- unable to reserve %" PRIu64 " bytes for %s: %s.\n",
+			max_bytes, filename_.c_str(), strerror(error));
+		if (ftruncate(fd, 0) != 0) {
+			output::log(output::loglevel::WARNING, "session_capture::open() -- unable to release the space reserved for %s.\n", filename_.c_str());
+		}
+		::close(fd);
+		fd = -1;
+		return false;
+	}
+	void* result = mmap(nullptr, max_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (result == MAP_FAILED) {
+		output::log(output::loglevel::ERROR, "session_capture::open() -- unable to map %s: %s.\n", filename_.c_str(), strerror(errno));
+		::close(fd);
+		fd = -1;
+		return false;
+	}
+
+	mapping = (uint8_t*) result;
+	mapping_size = max_bytes;
+	filename = filename_;
+
+	file_header* header = (file_header*) mapping;
+	memcpy(header->magic, MAGIC, sizeof(MAGIC));
+	header->version = VERSION;
+	header->header_size = sizeof(file_header);
+	header->start_time = get_time_ns();
+	header->pinned = 0;
+	header->ring_offset = sizeof(file_header);
+	header->first_offset = sizeof(file_header);
+	header->end_offset = sizeof(file_header);
+	header->wrap_offset = 0;
+	header->records = 0;
+	header->overwritten = 0;
+	header->dropped = 0;
+
+	active.store(true);
+	output::log(output::loglevel::INFO, "session_capture::open() recording openflow messages to %s (the most recent %" PRIu64 " bytes).\n",
+		filename.c_str(), max_bytes);
+	return true;
+}
+
+// stops recording and trims the file
+void session_capture::close() {
+	active.store(false);
+	lock_guard<mutex> g(lock);
+	if (mapping == nullptr) {
+		return;
+	}
+
+	// records end at the wrap point, or at the newest record if the capture
+	// never wrapped
+	const file_header* header = (const file_header*) mapping;
+	uint64_t records = header->pinned + header->records, overwritten = header->overwritten, dropped = header->dropped;
+	uint64_t used_size = (header->wrap_offset != 0 ? header->wrap_offset : header->end_offset);
+	munmap(mapping, mapping_size);
+	if (ftruncate(fd, used_size) != 0) {
+		output::log(output::loglevel::WARNING, "session_capture::close() -- unable to trim %s.\n", filename.c_str());
+	}
+	::close(fd);
+	output::log(output::loglevel::INFO, "session_capture::close() %" PRIu64 " messages recorded to %s, %" PRIu64 " older ones overwritten, %" PRIu64 " dropped.\n",
+		records, filename.c_str(), overwritten, dropped);
+
+	fd = -1;
+	mapping = nullptr;
+	mapping_size = 0;
+}
+
+// appends a message to the capture, overwriting the oldest records if it is full
+void session_capture::record(uint8_t direction, const autobuf& message) {
+	if (!active.load(memory_order_relaxed)) {
+		return;
+	}
+	uint64_t timestamp = get_time_ns();
+	uint32_t length = message.size();
+	uint64_t padded_size = get_padded_size(length);
+
+	lock_guard<mutex> g(lock);
+	if (mapping == nullptr) {
+		return;
+	}
+	file_header* header = (file_header*) mapping;
+	if (padded_size > mapping_size - header->ring_offset) {
+		if (header->dropped++ == 0) {
+			output::log(output::loglevel::WARNING, "session_capture::record() -- a %u byte message does not fit in %s and is dropped.\n",
+				length, filename.c_str());
+		}
+		return;
+	}
+
+	// make room. a record that does not fit before the end of the file wraps to
+	// the start of the ring, and the oldest records in its way are retired.
+	while (true) {
+		if (header->wrap_offset == 0) {
+			if (header->end_offset + padded_size <= mapping_size) {
+				break;
+			}
+			if (header->overwritten == 0) {
+				output::log(output::loglevel::INFO, "session_capture::record() -- %s is full. the oldest messages are overwritten from now on.\n",
+					filename.c_str());
+			}
+			header->wrap_offset = header->end_offset;
+			header->end_offset = header->ring_offset;
+		} else if (header->first_offset == header->wrap_offset) {
+			header->first_offset = header->ring_offset;
+			header->wrap_offset = 0;
+		} else if (header->end_offset + padded_size <= header->first_offset) {
+			break;
+		} else {
+			const record_header* oldest = (const record_header*) (mapping + header->first_offset);
+			header->first_offset += get_padded_size(oldest->length);
+			--header->records;
+			++header->overwritten;
+		}
+	}
+
+	record_header* entry = (record_header*) (mapping + header->end_offset);
+	entry->timestamp = timestamp;
+	entry->length = length;
+	entry->direction = direction;
+	memset(entry->reserved, 0, sizeof(entry->reserved));
+	memcpy(mapping + header->end_offset + sizeof(record_header), message.get_content_ptr(), length);
+
+	// the record is complete before it is counted in the header
+	header->end_offset += padded_size;
+	++header->records;
+}
+
+// moves the records written so far out of the ring, so that they are never
+// overwritten (e.g. the session setup, which a replay needs)
+bool session_capture::pin() {
+	lock_guard<mutex> g(lock);
+	if (mapping == nullptr) {
+		return false;
+	}
+	file_header* header = (file_header*) mapping;
+	if (header->wrap_offset != 0 || header->overwritten != 0) {
+		output::log(output::loglevel::WARNING, "session_capture::pin() -- %s has already wrapped. nothing is pinned.\n", filename.c_str());
+		return false;
+	}
+	header->pinned += header->records;
+	header->records = 0;
+	header->ring_offset = header->end_offset;
+	header->first_offset = header->end_offset;
+	return true;
+}
+
+// gets the number of messages recorded
+uint64_t session_capture::get_records() const {
+	lock_guard<mutex> g(lock);
+	if (mapping == nullptr) {
+		return 0;
+	}
+	const file_header* header = (const file_header*) mapping;
+	return header->pinned + header->records;
+}
+
+// gets the number of messages overwritten by newer ones
+uint64_t session_capture::get_overwritten() const {
+	lock_guard<mutex> g(lock);
+	return mapping == nullptr ? 0 : ((const file_header*) mapping)->overwritten;
+}
+
+// gets the number of messages dropped
+uint64_t session_capture::get_dropped() const {
+	lock_guard<mutex> g(lock);
+	return mapping == nullptr ? 0 : ((const file_header*) mapping)->dropped;
+}
+
+// constructor
+session_capture_reader::session_capture_reader():mapping(nullptr),
+	mapping_size(0),
+	read_offset(0),
+	pinned_remaining(0),
+	remaining(0) {}
+
+// destructor
+session_capture_reader::~session_capture_reader() {
+	close();
+}
+
+// maps a capture file for reading
+bool session_capture_reader::open(const string& filename) {
+	close();
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		output::log(output::loglevel::ERROR, "session_capture_reader::open() -- unable to open %s: %s.\n", filename.c_str(), strerror(errno));
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (uint64_t) info.st_size < sizeof(session_capture::file_header)) {
+		output::log(output::loglevel::ERROR, "session_capture_reader::open() -- %s is not a capture file.\n", filename.c_str());
+		::close(fd);
+		return false;
+	}
+	void* result = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (result == MAP_FAILED) {
+		output::log(output::loglevel::ERROR, "session_capture_reader::open() -- unable to map %s: %s.\n", filename.c_str(), strerror(errno));
+		return false;
+	}
+	mapping = (const uint8_t*) result;
+	mapping_size = info.st_size;
+
+	const session_capture::file_header& header = get_header();
+	if (memcmp(header.magic, session_capture::MAGIC, sizeof(session_capture::MAGIC)) != 0 ||
+		header.version != session_capture::VERSION || header.header_size != sizeof(session_capture::file_header)) {
+		output::log(output::loglevel::ERROR, "session_capture_reader::open() -- %s is not a version %u capture file.\n",
+			filename.c_str(), session_capture::VERSION);
+		close();
+		return false;
+	}
+	if (header.ring_offset < header.header_size || header.ring_offset > mapping_size ||
+		header.first_offset < header.ring_offset || header.first_offset > mapping_size ||
+		header.end_offset < header.ring_offset || header.end_offset > mapping_size || header.wrap_offset > mapping_size) {
+		output::log(output::loglevel::ERROR, "session_capture_reader::open() -- %s is truncated.\n", filename.c_str());
+		close();
+		return false;
+	}
+	rewind();
+	return true;
+}
+
+// unmaps the file
+void session_capture_reader::close() {
+	if (mapping != nullptr) {
+		munmap((void*) mapping, mapping_size);
+	}
+	mapping = nullptr;
+	mapping_size = 0;
+	read_offset = 0;
+	pinned_remaining = 0;
+	remaining = 0;
+}
+
+// reads the next record. the pinned records come first; the ring runs from its
+// oldest record to the wrap point, then from the start of the ring to the newest.
+bool session_capture_reader::next(record& result) {
+	if (mapping == nullptr || (pinned_remaining == 0 && remaining == 0)) {
+		return false;
+	}
+	const session_capture::file_header& header = get_header();
+	if (pinned_remaining == 0 && header.wrap_offset != 0 && read_offset == header.wrap_offset) {
+		read_offset = header.ring_offset;
+	}
+	if (read_offset + sizeof(session_capture::record_header) > mapping_size) {
+		return false;
+	}
+	const session_capture::record_header* entry = (const session_capture::record_header*) (mapping + read_offset);
+	uint64_t padded_size = get_padded_size(entry->length);
+	if (read_offset + sizeof(session_capture::record_header) + entry->length > mapping_size) {
+		return false;
+	}
+	result.timestamp = entry->timestamp;
+	result.direction = entry->direction;
+	result.length = entry->length;
+	result.message = mapping + read_offset + sizeof(session_capture::record_header);
+	read_offset += padded_size;
+	if (pinned_remaining != 0) {
+		if (--pinned_remaining == 0) {
+			read_offset = header.first_offset;
+		}
+	} else {
+		--remaining;
+	}
+	return true;
+}
+
+// restarts from the first pinned record, or the oldest record in the ring
+void session_capture_reader::rewind() {
+	if (mapping == nullptr) {
+		read_offset = 0;
+		pinned_remaining = 0;
+		remaining = 0;
+		return;
+	}
+	const session_capture::file_header& header = get_header();
+	pinned_remaining = header.pinned;
+	remaining = header.records;
+	read_offset = (pinned_remaining != 0 ? header.header_size : header.first_offset);
+}
+
+// gets the file header
+const session_capture::file_header& session_capture_reader::get_header() const {
+	return *(const session_capture::file_header*) mapping;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include "../../common/autobuf.h"
+using namespace std;
+
+// binary capture of an openflow session
+//
+// the hal can append every raw openflow message it sends to or receives from
+// the switch to a capture file. the file is preallocated and memory-mapped, so
+// recording a message is a copy into the mapping under a short lock (no system
+// call). the file is a ring: once it is full, the oldest records are
+// overwritten, so the capture always holds the most recent part of the session.
+// the records of the session setup can be pinned, so that they are never
+// overwritten and a wrapped capture can still be replayed.
+//
+// a capture starts with a file header, followed by records. each record is a
+// record header and the raw message bytes, padded to 8 bytes. the pinned records
+// come first, then the ring. records never straddle the end of the file; a
+// record that does not fit is written at the start of the ring instead, and the
+// header marks where the older records end.
+// the header is updated after each record, so a capture stays readable if the
+// controller dies while recording. all values are in host byte order.
+//
+// revision 2 (10/19/26)
+
+class session_capture {
+public:
+
+	// direction of a recorded message
+	static const uint8_t FROM_SWITCH = 1;
+	static const uint8_t TO_SWITCH = 2;
+
+	static const uint32_t VERSION = 2;
+	static const char MAGIC[8];
+	static const uint64_t DEFAULT_MAX_BYTES = 64ULL << 20;
+
+	struct file_header {
+		char     magic[8];
+		uint32_t version;
+		uint32_t header_size;
+		uint64_t start_time;   // nanoseconds since the unix epoch
+		uint64_t pinned;       // records before the ring
+		uint64_t ring_offset;  // start of the ring (end of the pinned records)
+		uint64_t first_offset; // oldest record in the ring
+		uint64_t end_offset;   // end of the newest record
+		uint64_t wrap_offset;  // end of the records before the wrap (0 if not wrapped)
+		uint64_t records;      // records in the ring
+		uint64_t overwritten;  // oldest records overwritten by newer ones
+		uint64_t dropped;      // messages larger than the ring
+	};
+
+	struct record_header {
+		uint64_t timestamp;    // nanoseconds since the unix epoch
+		uint32_t length;       // message length (excluding header and padding)
+		uint8_t  direction;
+		uint8_t  reserved[3];
+	};
+
+	// constructor and destructor
+	session_capture();
+	~session_capture();
+
+	// creates a capture file of at most max_bytes and starts recording
+	bool open(const string& filename, uint64_t max_bytes=DEFAULT_MAX_BYTES);
+
+	// stops recording and trims the unused end of the file
+	void close();
+
+	// checks if messages are being recorded
+	bool is_active() const { return active.load(memory_order_relaxed); }
+
+	// records a raw openflow message (does nothing if not active)
+	void record(uint8_t direction, const autobuf& message);
+
+	// keeps everything recorded so far out of the ring (only before it wraps)
+	bool pin();
+
+	// accessors
+	uint64_t get_records() const;
+	uint64_t get_overwritten() const;
+	uint64_t get_dropped() const;
+
+private:
+
+	// disable copying
+	session_capture(const session_capture& other)=delete;
+	session_capture& operator=(const session_capture& other)=delete;
+
+	atomic<bool>  active;
+	mutable mutex lock;
+	int           fd;
+	uint8_t*      mapping;
+	uint64_t      mapping_size;
+	string        filename;
+};
+
+// sequential reader for a capture file
+class session_capture_reader {
+public:
+
+	// a record as stored in the capture (the message points into the mapping)
+	class record {
+	public:
+		uint64_t       timestamp;
+		uint8_t        direction;
+		uint32_t       length;
+		const uint8_t* message;
+	};
+
+	// constructor and destructor
+	session_capture_reader();
+	~session_capture_reader();
+
+	// maps a capture file and checks its header
+	bool open(const string& filename);
+	void close();
+
+	// reads the next record, oldest first. returns false at the end of the capture
+	bool next(record& result);
+
+	// restarts from the first record
+	void rewind();
+
+	// gets the file header
+	const session_capture::file_header& get_header() const;
+
+private:
+
+	// disable copying
+	session_capture_reader(const session_capture_reader& other)=delete;
+	session_capture_reader& operator=(const session_capture_reader& other)=delete;
+
+	const uint8_t* mapping;
+	uint64_t       mapping_size;
+	uint64_t       read_offset;
+	uint64_t       pinned_remaining;
+	uint64_t       remaining;
+};
@@ -0,0 +1,89 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include "transaction_latency.h"
+
+latency_histogram transaction_latency::histograms[transaction_latency::NUM_CATEGORIES][transaction_latency::NUM_INTERVALS];
+
+// records the queueing and switch time of a completed transaction
+void transaction_latency::record(const hal_transaction& transaction, uint64_t completed) {
+	uint64_t enqueued = transaction.get_enqueue_time();
+	uint64_t sent = transaction.get_send_time();
+	shared_ptr<of_message> request = transaction.get_request();
+	if (enqueued == 0 || sent < enqueued || completed < sent || request == nullptr) return;
+
+	uint32_t msg_category = (uint32_t) get_category(request->msg_type);
+	histograms[msg_category][(uint32_t) interval::QUEUE].record(sent - enqueued);
+	histograms[msg_category][(uint32_t) interval::SWITCH].record(completed - sent);
+}
+
+// maps an openflow message type to its category
+transaction_latency::category transaction_latency::get_category(uint8_t msg_type) {
+	switch (msg_type) {
+		case OFPT_FLOW_MOD:
+			return category::FLOW_MOD;
+		case OFPT_STATS_REQUEST:
+			return category::STATS;
+		case OFPT_BARRIER_REQUEST:
+			return category::BARRIER;
+		case OFPT_ECHO_REQUEST:
+			return category::ECHO;
+		default:
+			return category::OTHER;
+	}
+}
+
+// gets the histogram of a category and interval (in cycle_clock ticks)
+const latency_histogram& transaction_latency::get_histogram(category msg_category, interval measured) {
+	return histograms[(uint32_t) msg_category][(uint32_t) measured];
+}
+
+// gets the display name of a category
+const char* transaction_latency::get_category_name(category msg_category) {
+	switch (msg_category) {
+		case category::FLOW_MOD:
+			return "flow_mod";
+		case category::STATS:
+			return "stats";
+		case category::BARRIER:
+			return "barrier";
+		case category::ECHO:
+			return "echo";
+		case category::OTHER:
+			return "other";
+	}
+	return "unknown";
+}
+
+// generates a table of all histograms (times in microseconds)
+string transaction_latency::to_string() {
+	char buf[256];
+	double us_per_tick = cycle_clock::get_ns_per_tick() / 1000.0;
+	string result = "hal transaction latency (times in us)\n";
+
+	snprintf(buf, sizeof(buf), "%-24s %10s %9s %9s %9s %9s %9s\n", "transaction", "samples", "mean", "p50", "p99", "p99.9", "max");
+	result += buf;
+	for (uint32_t counter = 0; counter < NUM_CATEGORIES; ++counter) {
+		for (uint32_t measured = 0; measured < NUM_INTERVALS; ++measured) {
+			const latency_histogram& histogram = histograms[counter][measured];
+			string name = string(get_category_name((category) counter)) + (measured == (uint32_t) interval::QUEUE ? ": queue" : ": switch");
+			snprintf(buf, sizeof(buf), "%-24s %10" PRIu64 " %9.1f %9.1f %9.1f %9.1f %9.1f\n", name.c_str(),
+				histogram.get_count(),
+				histogram.get_mean() * us_per_tick,
+				histogram.get_percentile(0.5) * us_per_tick,
+				histogram.get_percentile(0.99) * us_per_tick,
+				histogram.get_percentile(0.999) * us_per_tick,
+				histogram.get_max() * us_per_tick);
+			result += buf;
+		}
+	}
+	return result;
+}
+
+// resets all histograms
+void transaction_latency::clear() {
+	for (uint32_t counter = 0; counter < NUM_CATEGORIES; ++counter) {
+		for (uint32_t measured = 0; measured < NUM_INTERVALS; ++measured) {
+			histograms[counter][measured].clear();
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include "../../common/latency_histogram.h"
+#include "hal_transaction.h"
+using namespace std;
+
+// latency histograms for hal transactions that carry a completion callback
+//
+// each such transaction is timestamped when it is enqueued to the hal and when
+// the send loop puts it on the wire. on completion (its reply, an error, or
+// the barrier reply that covers it) the two intervals are recorded by message
+// type: enqueue -> wire is controller queueing delay, and wire -> completion
+// is the time the switch took (for flow_mods, the table install latency).
+//
+// revision 1 (10/19/26)
+
+class transaction_latency {
+public:
+
+	// message categories
+	enum class category : uint32_t {	FLOW_MOD = 0,
+																		STATS = 1,
+																		BARRIER = 2,
+																		ECHO = 3,
+																		OTHER = 4
+	};
+
+	// measured intervals
+	enum class interval : uint32_t {	QUEUE = 0,      // enqueued -> written to the switch
+																		SWITCH = 1      // written to the switch -> completed
+	};
+
+	static const uint32_t NUM_CATEGORIES = 5;
+	static const uint32_t NUM_INTERVALS = 2;
+
+	// records a completed transaction (ignored if it was never timestamped)
+	static void record(const hal_transaction& transaction, uint64_t completed);
+
+	// reporting
+	static category get_category(uint8_t msg_type);
+	static const latency_histogram& get_histogram(category msg_category, interval measured);
+	static const char* get_category_name(category msg_category);
+	static string      to_string();
+	static void        clear();
+
+private:
+
+	static latency_histogram histograms[NUM_CATEGORIES][NUM_INTERVALS];
+};
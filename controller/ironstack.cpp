@@ -39,6 +39,9 @@ shared_ptr<dell_s48xx_acl_table> acl_table;
 // for debug use
 string switch_name;
 
+// write the log in binary format (read with log_decoder)
+bool binary_log = false;
+
 // experimental global vars
 bool experimental_auto_broadcast_rules = true;
 bool experimental_auto_broadcast_rules_installed = false;
@@ -58,8 +61,10 @@ int main(int argc, char** argv) {
 	ip_address sw_management_addr;
 	bool preserve_flows = false;
 	int instance_id = 0;
-	if (argc < 3 || argc > 4) {
-		output::printf("usage: ./%s [instance id] [switch management address] [--preserve-flows]\n", argv[0]);
+	string capture_filename;
+	uint64_t capture_bytes = session_capture::DEFAULT_MAX_BYTES;
+	if (argc < 3 || argc > 9) {
+		output::printf("usage: ./%s [instance id] [switch management address] [--preserve-flows] [--binary-log] [--capture file] [--capture-size MiB]\n", argv[0]);
 		return 1;
 	} else {
 		if (sscanf(argv[1], "%d", &instance_id) != 1 || instance_id < 1 || instance_id > 4) {
@@ -71,8 +76,19 @@ int main(int argc, char** argv) {
 				output::printf("invalid management ip.\n");
 				return 1;
 			}
-			if (argc == 4 && (strcmp(argv[3], "--preserve-flows") == 0)) {
-				preserve_flows = true;
+			for (int counter = 3; counter < argc; ++counter) {
+				if (strcmp(argv[counter], "--preserve-flows") == 0) {
+					preserve_flows = true;
+				} else if (strcmp(argv[counter], "--binary-log") == 0) {
+					binary_log = true;
+				} else if (strcmp(argv[counter], "--capture") == 0 && counter+1 < argc) {
+					capture_filename = argv[++counter];
+				} else if (strcmp(argv[counter], "--capture-size") == 0 && counter+1 < argc) {
+					capture_bytes = strtoull(argv[++counter], nullptr, 0) << 20;
+				} else {
+					output::printf("unknown option %s.\n", argv[counter]);
+					return 1;
+				}
 			}
 		}
 	}
@@ -153,6 +169,12 @@ int main(int argc, char** argv) {
 		cam_service->create_cam_table(switch_vlan);
 		arp_service->create_arp_table(switch_vlan);
 	}
+	for (const auto& vlan : vlan_settings) {
+		if (vlan.active && vlan.proxy_arp) {
+			arp_service->set_proxy_arp(vlan.vlan_id, true);
+			output::printf("proxy arp enabled on vlan %hu.\n", vlan.vlan_id);
+		}
+	}
 
 	// 3. attach flow tables
 	l2_table = make_shared<dell_s48xx_l2_table>();
@@ -182,6 +204,12 @@ int main(int argc, char** argv) {
 	display->init();
 	#endif
 
+	// record the openflow session if requested (replay with session_replay)
+	if (!capture_filename.empty() && !controller->start_capture(capture_filename, capture_bytes)) {
+		output::printf("error: unable to create capture file %s.\n", capture_filename.c_str());
+		return 1;
+	}
+
 	// init controller
 	bool status = false;
 	output::log(output::loglevel::INFO, "waiting for switch %s to connect.\n", allowed.begin()->to_string().c_str());
@@ -1,5 +1,7 @@
 #include "ironstack_gui.h"
 #include "gui/output.h"
+#include "hal/packet_in_latency.h"
+#include "hal/transaction_latency.h"
 #include "services/arp.h"
 #include "services/cam.h"
 #include "services/dell_s48xx_acl_table.h"
@@ -15,6 +17,7 @@ extern shared_ptr<dell_s48xx_acl_table> acl_table;
 extern uint64_t controller_bytes_sent;
 extern uint64_t controller_bytes_received;
 extern string switch_name;
+extern bool binary_log;
 extern ethernet_mac_db dl_address_db;
 extern bool experimental_auto_broadcast_rules;
 extern bool experimental_auto_broadcast_rules_installed;
@@ -265,6 +268,7 @@ bool ironstack_gui::init() {
 	menu->add_option("cam table");
 	menu->add_option("switch control");
 	menu->add_option("experimental");
+	menu->add_option("latency");
 	menu->set_visible(false);
 	menu->commit_all();
 	display->register_gui_component(menu);
@@ -336,6 +340,34 @@ bool ironstack_gui::init() {
 	display->register_gui_component(experimental_textbox);
 	display->register_input_component(experimental_textbox);
 
+	/* components for the packet_in latency screen */
+	// the background that contains the histogram table
+	latency_background = make_shared<gui_component>();
+	latency_background->set_origin(vec2d(0, 2));
+	latency_background->set_dimensions(vec2d(screen_dimensions.x, 39));
+	latency_background->set_z_position(999);
+	latency_background->set_cursor_visible(false);
+	latency_background->set_color(FG_WHITE | BG_BLACK);
+	latency_background->clear();
+	latency_background->set_visible(false);
+	latency_background->commit_all();
+	display->register_gui_component(latency_background);
+
+	// menu to dump or reset the histograms
+	latency_menu = make_shared<input_menu>();
+	latency_menu->set_origin(vec2d(2, 36));
+	latency_menu->set_z_position(998);
+	latency_menu->set_dimensions(vec2d(28,4));
+	latency_menu->set_menu_color(FG_WHITE | BG_BLUE, FG_WHITE | BG_BLACK);
+	latency_menu->set_option_highlight_color(FG_BLACK | BG_GREEN);
+	latency_menu->add_option("dump to log");
+	latency_menu->add_option("reset");
+	latency_menu->set_visible(false);
+	latency_menu->set_enable(false);
+	latency_menu->commit_all();
+	display->register_gui_component(latency_menu);
+	display->register_input_component(latency_menu);
+
 	// redirect output to display controller
 	// and setup logging
 	output::init(display);
@@ -343,8 +375,13 @@ bool ironstack_gui::init() {
 		assert(false && "ironstack_gui::init() -- switch name cannot be empty.");
 		abort();
 	} 
-	string log_name = string("logs/") + switch_name.substr(10) + string(".log");
-	output::start_log(log_name, true, output::loglevel::INFO);
+	if (binary_log) {
+		string log_name = string("logs/") + switch_name.substr(10) + string(".blog");
+		output::start_log(log_name, true, output::loglevel::INFO, output::logformat::BINARY);
+	} else {
+		string log_name = string("logs/") + switch_name.substr(10) + string(".log");
+		output::start_log(log_name, true, output::loglevel::INFO);
+	}
 
 	// start the gui execution code in a separate thread
 	gui_tid = thread(&ironstack_gui::gui_entrypoint, this);
@@ -427,6 +464,12 @@ void ironstack_gui::gui_entrypoint() {
 				case 6:
 				{
 					hide_experimental_screen();
+					break;
+				}
+				case 7:
+				{
+					hide_latency_screen();
+					break;
 				}
 				default:
 					break;
@@ -477,6 +520,11 @@ void ironstack_gui::gui_entrypoint() {
 				do_experimental_screen();
 				break;
 			}
+			case 7:		// packet_in latency
+			{
+				do_latency_screen();
+				break;
+			}
 			default:
 				break;
 		}
@@ -912,9 +960,13 @@ void ironstack_gui::do_arp_screen() {
 				string lookup_count, last_lookup, last_updated;
 				sprintf(stat_buf, "%u", entry.lookup_count);
 				lookup_count = stat_buf;
-				sprintf(stat_buf, "%us", entry.last_lookup.get_time_elapsed_ms()/1000);
+				if (entry.sec_since_lookup == (uint32_t) -1) {
+					sprintf(stat_buf, "never");
+				} else {
+					sprintf(stat_buf, "%us", entry.sec_since_lookup);
+				}
 				last_lookup = stat_buf;
-				sprintf(stat_buf, "%us", entry.last_updated.get_time_elapsed_ms()/1000);
+				sprintf(stat_buf, "%us", entry.sec_since_update);
 				last_updated = stat_buf;
 
 				char buf[1024];
@@ -966,28 +1018,32 @@ void ironstack_gui::do_cam_screen() {
 				sprintf(stat_buf, "%hu", vlan_id);
 
 				string vlan = stat_buf;
-				string mac_address_string = entry.second.dl_address.to_string();
-				string vendor = dl_address_db.lookup_name_for_mac(entry.second.dl_address);
+				string mac_address_string = entry.dl_address.to_string();
+				string vendor = dl_address_db.lookup_name_for_mac(entry.dl_address);
 				if (vendor.empty()) {
 					vendor = "[unknown vendor]";
 				}
 
 				string phy_port = "???";
-				if (entry.second.phy_port < OFPP_MAX) {
+				if (entry.phy_port < OFPP_MAX) {
 					// TODO -- this is a hack for the dell switches. should really lookup the port name
-					sprintf(stat_buf, "Te0/%hu", entry.second.phy_port-1);
+					sprintf(stat_buf, "Te0/%hu", entry.phy_port-1);
 					phy_port = stat_buf;
-				} else if (entry.second.phy_port == OFPP_CONTROLLER) {
+				} else if (entry.phy_port == OFPP_CONTROLLER) {
 					phy_port = "local";
 				}
 
 				// generate lookup count, last lookup and last update
 				string lookup_count, last_lookup, last_updated;
-				sprintf(stat_buf, "%u", entry.second.lookup_count);
+				sprintf(stat_buf, "%u", entry.lookup_count);
 				lookup_count = stat_buf;
-				sprintf(stat_buf, "%us", entry.second.last_lookup.get_time_elapsed_ms()/1000);
+				if (entry.sec_since_lookup == (uint32_t) -1) {
+					sprintf(stat_buf, "never");
+				} else {
+					sprintf(stat_buf, "%us", entry.sec_since_lookup);
+				}
 				last_lookup = stat_buf;
-				sprintf(stat_buf, "%us", entry.second.last_updated.get_time_elapsed_ms()/1000);
+				sprintf(stat_buf, "%us", entry.sec_since_update);
 				last_updated = stat_buf;
 
 				char buf[1024];
@@ -1113,6 +1169,38 @@ void ironstack_gui::do_experimental_screen() {
 	}
 }
 
+// displays the packet_in pipeline and hal transaction latency histograms
+void ironstack_gui::do_latency_screen() {
+
+	// the histograms change constantly; redraw at most once a second
+	static bool measurement_started = false;
+	static timer measurement_timer;
+	if (!measurement_started || measurement_timer.get_time_elapsed_ms() >= 1000) {
+		measurement_started = true;
+		measurement_timer.reset();
+
+		latency_background->clear();
+		latency_background->printf(vec2d(0,0), "%s packet_in and transaction latency", switch_name.substr(10).c_str());
+		latency_background->printf(vec2d(0,2), "%s\n%s", packet_in_latency::to_string().c_str(), transaction_latency::to_string().c_str());
+		latency_background->commit_all();
+	}
+
+	latency_background->set_visible(true);
+	latency_background->commit_attributes();
+	latency_menu->set_visible(true);
+	latency_menu->set_enable(true);
+	latency_menu->commit_all();
+
+	int decision = latency_menu->wait_for_decision(0);
+	if (decision == 0) {
+		output::log(output::loglevel::INFO, "%s\n%s", packet_in_latency::to_string().c_str(), transaction_latency::to_string().c_str());
+	} else if (decision == 1) {
+		packet_in_latency::clear();
+		transaction_latency::clear();
+		measurement_started = false;
+	}
+}
+
 // hides all components associated with the summary screen
 void ironstack_gui::hide_summary_screen() {
 	summary->set_visible(false);
@@ -1179,6 +1267,15 @@ void ironstack_gui::hide_experimental_screen() {
 	experimental_textbox->commit_attributes();
 }
 
+// hides all components in the latency screen
+void ironstack_gui::hide_latency_screen() {
+	latency_background->set_visible(false);
+	latency_background->commit_attributes();
+	latency_menu->set_visible(false);
+	latency_menu->set_enable(false);
+	latency_menu->commit_attributes();
+}
+
 // thread entrypoint to do periodic pings
 void ironstack_gui::ping_entrypoint() {
 	vector<pair<string, int>> ping_times;
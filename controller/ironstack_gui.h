@@ -26,6 +26,7 @@ public:
 	void do_cam_screen();
 	void do_switch_control_screen();
 	void do_experimental_screen();
+	void do_latency_screen();
 
 	// hides all components, but doesn't commit
 	void hide_summary_screen();
@@ -35,6 +36,7 @@ public:
 	void hide_cam_screen();
 	void hide_switch_control_screen();
 	void hide_experimental_screen();
+	void hide_latency_screen();
 
 private:
 
@@ -80,6 +82,10 @@ private:
 	shared_ptr<gui_component> experimental_rule_instructions;
 	shared_ptr<input_textbox> experimental_textbox;
 
+	// packet_in latency components
+	shared_ptr<gui_component> latency_background;
+	shared_ptr<input_menu>    latency_menu;
+
 	// ping-related state
 	mutex ping_lock;
 	vector<pair<string, int>> pings;
@@ -1,49 +1,80 @@
+#include <arpa/inet.h>
+#include <functional>
+#include <string.h>
 #include "openflow_action_list.h"
 #include "../gui/output.h"
 
+// decodes an action record into an object of its type
+template <class T>
+static bool decode_as(const autobuf& record, const function<void(const of_action&)>& visitor) {
+	T action;
+	if (!action.deserialize(record)) {
+		return false;
+	}
+	visitor(action);
+	return true;
+}
+
+// decodes the action record at the front of a buffer and passes it to the
+// visitor. returns false if the action cannot be decoded.
+static bool decode_action(const autobuf& record, const function<void(const of_action&)>& visitor) {
+	switch (of_action::infer_type(record)) {
+		case of_action::action_type::OUTPUT_TO_PORT:
+			return decode_as<of_action_output_to_port>(record, visitor);
+		case of_action::action_type::ENQUEUE:
+			return decode_as<of_action_enqueue>(record, visitor);
+		case of_action::action_type::SET_VLAN_ID:
+			return decode_as<of_action_set_vlan_id>(record, visitor);
+		case of_action::action_type::SET_VLAN_PCP:
+			return decode_as<of_action_set_vlan_pcp>(record, visitor);
+		case of_action::action_type::STRIP_VLAN:
+			return decode_as<of_action_strip_vlan>(record, visitor);
+		case of_action::action_type::SET_DL_ADDR:
+			return decode_as<of_action_set_mac_address>(record, visitor);
+		case of_action::action_type::SET_NW_ADDR:
+			return decode_as<of_action_set_ip_address>(record, visitor);
+		case of_action::action_type::SET_IP_TOS:
+			return decode_as<of_action_set_ip_type_of_service>(record, visitor);
+		case of_action::action_type::SET_TCPUDP_PORT:
+			return decode_as<of_action_set_tcpudp_port>(record, visitor);
+		case of_action::action_type::VENDOR:
+			return decode_as<of_action_vendor>(record, visitor);
+		default:
+			return false;
+	}
+}
+
 // constructor
-openflow_action_list::openflow_action_list() {
+openflow_action_list::openflow_action_list():count(0) {
 }
 
 // destructor
 openflow_action_list::~openflow_action_list() {
 }
 
-// copy constructor 
-openflow_action_list::openflow_action_list(const openflow_action_list& original) {
-	for (const auto& action : original.actions) {
-		actions.push_back(std::move(std::unique_ptr<of_action>(of_action::clone(action.get()))));
-	}
+// copy constructor
+openflow_action_list::openflow_action_list(const openflow_action_list& original):encoded(original.encoded),
+	count(original.count) {
 }
 
 // assignment operator
 openflow_action_list& openflow_action_list::operator=(const openflow_action_list& original) {
-	clear();
-	for (const auto& action : original.actions) {
-		actions.push_back(std::move(std::unique_ptr<of_action>(of_action::clone(action.get()))));
-	}
-
+	encoded = original.encoded;
+	count = original.count;
 	return *this;
 }
 
-// checks if action lists are identical
+// checks if action lists are identical (the order of the actions is ignored)
 bool openflow_action_list::operator==(const openflow_action_list& other) const {
-	if (actions.size() != other.actions.size()) {
+	if (count != other.count || encoded.size() != other.encoded.size()) {
 		return false;
+	} else if (encoded == other.encoded) {
+		return true;
 	}
 
-	bool found;
-	for (const auto& action : actions) {
-
-		found = false;
-		for (const auto& other_action : other.actions) {
-			if (*action == *other_action) {
-				found = true;
-				break;
-			}
-		}
-
-		if (!found) {
+	autobuf record;
+	for (uint32_t index = 0; get_record(index, record); ++index) {
+		if (other.find_record(record) < 0) {
 			return false;
 		}
 	}
@@ -58,18 +89,22 @@ bool openflow_action_list::operator!=(const openflow_action_list& other) const {
 
 // clears the action list
 void openflow_action_list::clear() {
-	actions.clear();
+	encoded.clear();
+	count = 0;
 }
 
 // returns a readable form of the action list
 std::string openflow_action_list::to_string() const {
 	std::string result;
-	if (actions.size() == 0) {
+	if (count == 0) {
 		result += "no actions.";
 	}
 
-	for (const auto& item : actions) {
-		result += item->to_string() + string(" ");
+	autobuf record;
+	for (uint32_t index = 0; get_record(index, record); ++index) {
+		decode_action(record, [&](const of_action& action) {
+			result += action.to_string() + string(" ");
+		});
 	}
 
 	return result;
@@ -81,7 +116,6 @@ bool openflow_action_list::from_string(const std::string& input) {
 	clear();
 	std::vector<std::pair<std::string, std::string>> kv = string_utils::generate_key_value_pair(input);
 	bool result = true;
-	std::unique_ptr<of_action> action_to_add;
 	uint32_t max = kv.size();
 
 	for (uint32_t index = 0; index < max; ++index) {
@@ -96,11 +130,10 @@ bool openflow_action_list::from_string(const std::string& input) {
 			}
 
 			// synthesize output
-			of_action_output_to_port* action = new of_action_output_to_port();
-			action->send_to_controller = (port == (uint16_t) OFPP_CONTROLLER);
-			action->port = port;
-			action_to_add.reset(action);
-			actions.push_back(std::move(action_to_add));
+			of_action_output_to_port action;
+			action.send_to_controller = (port == (uint16_t) OFPP_CONTROLLER);
+			action.port = port;
+			append_action(action);
 
 		} else if (kv[index].first == "enqueue_port") {
 			uint16_t port;
@@ -121,11 +154,10 @@ bool openflow_action_list::from_string(const std::string& input) {
 				}
 			
 				// synthesize output
-				of_action_enqueue* action = new of_action_enqueue();
-				action->port = port;
-				action->queue_id = queue_id;
-				action_to_add.reset(action);
-				actions.push_back(std::move(action_to_add));
+				of_action_enqueue action;
+				action.port = port;
+				action.queue_id = queue_id;
+				append_action(action);
 			}
 
 		} else if (kv[index].first == "set_vlan") {
@@ -137,10 +169,9 @@ bool openflow_action_list::from_string(const std::string& input) {
 			}
 
 			// synthesize output
-			of_action_set_vlan_id* action = new of_action_set_vlan_id();
-			action->vlan_id = id;
-			action_to_add.reset(action);
-			actions.push_back(std::move(action_to_add));
+			of_action_set_vlan_id action;
+			action.vlan_id = id;
+			append_action(action);
 
 		} else if (kv[index].first == "set_vlan_pcp") {
 			uint16_t pcp;
@@ -151,10 +182,9 @@ bool openflow_action_list::from_string(const std::string& input) {
 			}
 
 			// synthesize output
-			of_action_set_vlan_pcp* action = new of_action_set_vlan_pcp();
-			action->vlan_pcp = (uint8_t) pcp;
-			action_to_add.reset(action);
-			actions.push_back(std::move(action_to_add));
+			of_action_set_vlan_pcp action;
+			action.vlan_pcp = (uint8_t) pcp;
+			append_action(action);
 		
 		} else if(kv[index].first == "strip_vlan") {
 			uint16_t value;
@@ -164,7 +194,7 @@ bool openflow_action_list::from_string(const std::string& input) {
 				continue;
 			}
 			if (value == 1) {
-				actions.push_back(std::move(std::unique_ptr<of_action>(new of_action_strip_vlan())));
+				append_action(of_action_strip_vlan());
 			}
 
 		} else if (kv[index].first == "set_dl_src") {
@@ -177,11 +207,10 @@ bool openflow_action_list::from_string(const std::string& input) {
 			}
 
 			// synthesize output
-			of_action_set_mac_address* action = new of_action_set_mac_address();
-			action->set_src = true;
-			action->new_addr = dl_src;
-			action_to_add.reset(action);
-			actions.push_back(std::move(action_to_add));
+			of_action_set_mac_address action;
+			action.set_src = true;
+			action.new_addr = dl_src;
+			append_action(action);
 
 		} else if (kv[index].first == "set_dl_dest") {
 			mac_address dl_dest;
@@ -193,11 +222,10 @@ bool openflow_action_list::from_string(const std::string& input) {
 			}
 
 			// synthesize output
-			of_action_set_mac_address *action = new of_action_set_mac_address();
-			action->set_src = false;
-			action->new_addr = dl_dest;
-			action_to_add.reset(action);
-			actions.push_back(std::move(action_to_add));
+			of_action_set_mac_address action;
+			action.set_src = false;
+			action.new_addr = dl_dest;
+			append_action(action);
 
 		} else if (kv[index].first == "set_nw_src") {
 			ip_address nw_src;
@@ -209,11 +237,10 @@ bool openflow_action_list::from_string(const std::string& input) {
 			}
 
 			// synthesize output
-			of_action_set_ip_address* action = new of_action_set_ip_address();
-			action->set_src = true;
-			action->new_addr = nw_src;
-			action_to_add.reset(action);
-			actions.push_back(std::move(action_to_add));
+			of_action_set_ip_address action;
+			action.set_src = true;
+			action.new_addr = nw_src;
+			append_action(action);
 
 		} else if (kv[index].first == "set_nw_dest") {
 			ip_address nw_dest;
@@ -225,11 +252,10 @@ bool openflow_action_list::from_string(const std::string& input) {
 			}
 
 			// synthesize output
-			of_action_set_ip_address* action = new of_action_set_ip_address();
-			action->set_src = false;
-			action->new_addr = nw_dest;
-			action_to_add.reset(action);
-			actions.push_back(std::move(action_to_add));
+			of_action_set_ip_address action;
+			action.set_src = false;
+			action.new_addr = nw_dest;
+			append_action(action);
 
 		} else if (kv[index].first == "set_ip_tos") {
 			uint16_t tos;
@@ -240,10 +266,9 @@ bool openflow_action_list::from_string(const std::string& input) {
 			}
 
 			// synthesize output
-			of_action_set_ip_type_of_service* action = new of_action_set_ip_type_of_service();
-			action->type_of_service = tos;
-			action_to_add.reset(action);
-			actions.push_back(std::move(action_to_add));
+			of_action_set_ip_type_of_service action;
+			action.type_of_service = tos;
+			append_action(action);
 
 		} else if (kv[index].first == "set_src_port") {
 			uint16_t port;
@@ -254,11 +279,10 @@ bool openflow_action_list::from_string(const std::string& input) {
 			}
 
 			// synthesize output
-			of_action_set_tcpudp_port* action = new of_action_set_tcpudp_port();
-			action->set_src_port = true;
-			action->port = port;
-			action_to_add.reset(action);
-			actions.push_back(std::move(action_to_add));
+			of_action_set_tcpudp_port action;
+			action.set_src_port = true;
+			action.port = port;
+			append_action(action);
 
 		} else if (kv[index].first == "set_dest_port") {
 			uint16_t port;
@@ -269,11 +293,10 @@ bool openflow_action_list::from_string(const std::string& input) {
 			}
 
 			// synthesize output
-			of_action_set_tcpudp_port* action = new of_action_set_tcpudp_port();
-			action->set_src_port = false;
-			action->port = port;
-			action_to_add.reset(action);
-			actions.push_back(std::move(action_to_add));
+			of_action_set_tcpudp_port action;
+			action.set_src_port = false;
+			action.port = port;
+			append_action(action);
 
 		} else if (kv[index].first == "vendor") {
 			output::log(output::loglevel::WARNING, "openflow_action_list::from_string() vendor action not supported; ignoring.\n");
@@ -292,63 +315,99 @@ bool openflow_action_list::from_string(const std::string& input) {
 void openflow_action_list::add_action(const of_action& action) {
 
 	// make sure there are no duplicates
-	for (const auto& orig_action_ptr : actions) {
-		if (*orig_action_ptr == action) {
-			return;
-		}
+	autobuf record;
+	action.serialize(record);
+	if (find_record(record) >= 0) {
+		return;
+	}
+
+	encoded.append(record.get_content_ptr(), record.size());
+	++count;
+}
+
+// removes the first action that is identical to the given one
+void openflow_action_list::remove_action(const of_action& action) {
+	autobuf record;
+	action.serialize(record);
+	int32_t offset = find_record(record);
+	if (offset < 0) {
+		return;
 	}
 
-	std::unique_ptr<of_action> action_copy(of_action::clone(&action));
-	actions.push_back(std::move(action_copy));
+	uint8_t* buf = (uint8_t*) encoded.get_content_ptr_mutable();
+	memmove(buf + offset, buf + offset + record.size(), encoded.size() - offset - record.size());
+	encoded.trim_rear(record.size());
+	--count;
 }
 
 // returns a copy of the vector of actions
 std::vector<std::unique_ptr<of_action>> openflow_action_list::get_actions() const {
 	std::vector<std::unique_ptr<of_action>> result;
+	result.reserve(count);
 
-	for (const auto& orig_action_ptr : actions) {
-		result.push_back(std::unique_ptr<of_action>(of_action::clone(orig_action_ptr.get())));
-
+	autobuf record;
+	for (uint32_t index = 0; get_record(index, record); ++index) {
+		decode_action(record, [&](const of_action& action) {
+			result.push_back(std::unique_ptr<of_action>(of_action::clone(&action)));
+		});
 	}
 
 	return result;
 }
 
+// returns the number of actions
+uint32_t openflow_action_list::size() const {
+	return count;
+}
+
+// checks if there are no actions
+bool openflow_action_list::empty() const {
+	return count == 0;
+}
+
+// returns the type of the action at an index (unknown if out of range)
+of_action::action_type openflow_action_list::get_action_type(uint32_t index) const {
+	autobuf record;
+	if (!get_record(index, record)) {
+		return of_action::action_type::UNKNOWN;
+	}
+	return of_action::infer_type(record);
+}
+
+// decodes the action at an index if it has the same type as result
+bool openflow_action_list::get_action(uint32_t index, of_action& result) const {
+	autobuf record;
+	if (!get_record(index, record) || of_action::infer_type(record) != result.get_action_type()) {
+		return false;
+	}
+	return result.deserialize(record);
+}
+
 // serializes the action list
 uint32_t openflow_action_list::serialize(autobuf& dest) const {
 
-	if (actions.empty()) {
+	if (count == 0) {
 		dest.clear();
 		return 0;
 	}
 
-	uint32_t size_required = get_serialization_size();
-	uint32_t offset = 0;
-	dest.create_empty_buffer(size_required, false);
-
-	for (const auto& action : actions) {
-		uint32_t deserialization_size = action->get_deserialization_size();
-		autobuf current_buf;
-		current_buf.inherit_shared(dest.ptr_offset_mutable(offset),
-			deserialization_size, deserialization_size);
-//		autobuf current_buf(dest.ptr_offset(offset), deserialization_size, deserialization_size, false);
-		action->serialize(current_buf);
-		offset += deserialization_size;
-	}
-
-	return size_required;
+	dest.set_content(encoded.get_content_ptr(), encoded.size());
+	return encoded.size();
 }
 
 // returns the size required for serialization
 uint32_t openflow_action_list::get_serialization_size() const {
-	uint32_t result = 0;
-	for (const auto& action : actions) {
-		result += action->get_deserialization_size();
-	}
-	return result;
+	return encoded.size();
+}
+
+// gets the actions in wire format
+const autobuf& openflow_action_list::get_wire() const {
+	return encoded;
 }
 
-// deserializes an incoming action list
+// deserializes an incoming action list. every action is decoded and encoded
+// again, so fields the list does not keep (such as the output max_len) are
+// normalized.
 bool openflow_action_list::deserialize(const autobuf& input) {
 	clear();
 	if (input.size() == 0) {
@@ -359,83 +418,58 @@ bool openflow_action_list::deserialize(const autobuf& input) {
 
 	uint32_t offset = 0;
 	while (offset+sizeof(struct ofp_action_header) <= input.size()) {
-		autobuf type_buf;
-		type_buf.inherit_read_only(input.ptr_offset_const(offset), sizeof(struct ofp_action_header));
-		of_action::action_type type = of_action::infer_type(type_buf);
-//		of_action::action_type type = of_action::infer_type(input.ptr_offset(offset));
-		std::unique_ptr<of_action> current_action;
 		autobuf current_autobuf;
 		current_autobuf.inherit_read_only(input.ptr_offset_const(offset), input.size()-offset);
-		bool status;
-
-		switch (type) {
-		case of_action::action_type::OUTPUT_TO_PORT:
-			current_action.reset(new of_action_output_to_port());
-			status = current_action->deserialize(current_autobuf);
-			break;
-
-		case of_action::action_type::ENQUEUE:
-			current_action.reset(new of_action_enqueue());
-			status = current_action->deserialize(current_autobuf);
-			break;
-
-		case of_action::action_type::SET_VLAN_ID:
-			current_action.reset(new of_action_set_vlan_id());
-			status = current_action->deserialize(current_autobuf);
-			break;
-
-		case of_action::action_type::SET_VLAN_PCP:
-			current_action.reset(new of_action_set_vlan_pcp());
-			status = current_action->deserialize(current_autobuf);
-			break;
-
-		case of_action::action_type::STRIP_VLAN:
-			current_action.reset(new of_action_strip_vlan());
-			status = current_action->deserialize(current_autobuf);
-			break;
-
-		case of_action::action_type::SET_DL_ADDR:
-			current_action.reset(new of_action_set_mac_address());
-			status = current_action->deserialize(current_autobuf);
-			break;
-
-		case of_action::action_type::SET_NW_ADDR:
-			current_action.reset(new of_action_set_ip_address());
-			status = current_action->deserialize(current_autobuf);
-			break;
-
-		case of_action::action_type::SET_IP_TOS:
-			current_action.reset(new of_action_set_ip_type_of_service());
-			status = current_action->deserialize(current_autobuf);
-			break;
-
-		case of_action::action_type::SET_TCPUDP_PORT:
-			current_action.reset(new of_action_set_tcpudp_port());
-			status = current_action->deserialize(current_autobuf);
-			break;
-
-		case of_action::action_type::VENDOR:
-			current_action.reset(new of_action_vendor());
-			status = current_action->deserialize(current_autobuf);
-			break;
-
-		default:
-			goto fail;
-		}
-
-		if (!status) {
-			goto fail;
+		uint32_t action_size = 0;
+		bool status = decode_action(current_autobuf, [&](const of_action& action) {
+			append_action(action);
+			action_size = action.get_deserialization_size();
+		});
+
+		if (!status || action_size == 0) {
+			clear();
+			return false;
 		}
-
-		offset += current_action->get_deserialization_size();
-		actions.push_back(std::move(current_action));
+		offset += action_size;
 	}
 
 	return true;
+}
 
-fail:
+// appends an action in wire format (duplicates are kept)
+void openflow_action_list::append_action(const of_action& action) {
+	autobuf record;
+	action.serialize(record);
+	encoded.append(record.get_content_ptr(), record.size());
+	++count;
+}
+
+// gets the wire record of the action at an index. the record refers to the
+// list's buffer
+bool openflow_action_list::get_record(uint32_t index, autobuf& record) const {
+	if (index >= count) {
+		return false;
+	}
 
-	actions.clear();
-	return false;
+	const uint8_t* buf = (const uint8_t*) encoded.get_content_ptr();
+	uint32_t offset = 0;
+	for (uint32_t counter = 0; counter < index; ++counter) {
+		offset += ntohs(((const struct ofp_action_header*) (buf + offset))->len);
+	}
+	record.inherit_read_only(buf + offset, ntohs(((const struct ofp_action_header*) (buf + offset))->len));
+	return true;
 }
 
+// gets the offset of the first record that is identical to an encoded action
+int32_t openflow_action_list::find_record(const autobuf& record) const {
+	const uint8_t* buf = (const uint8_t*) encoded.get_content_ptr();
+	uint32_t offset = 0;
+	for (uint32_t counter = 0; counter < count; ++counter) {
+		uint16_t len = ntohs(((const struct ofp_action_header*) (buf + offset))->len);
+		if (len == record.size() && memcmp(buf + offset, record.get_content_ptr(), len) == 0) {
+			return offset;
+		}
+		offset += len;
+	}
+	return -1;
+}
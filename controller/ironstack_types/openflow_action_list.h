@@ -8,6 +8,14 @@
 #include "../../common/common_utils_oop.h"
 using namespace std;
 
+// list of openflow 1.0 actions
+//
+// the actions are kept as their wire encoding (a run of ofp_action_* records)
+// in an autobuf, so short lists live inside the object and copying, comparing
+// and serializing a list does not touch the heap. actions read from the wire
+// are decoded and re-encoded once, so equal actions always have equal bytes.
+// single actions can be read back into an of_action of the right type with
+// get_action(); get_actions() still returns a full (heap allocated) copy.
 class openflow_action_list {
 public:
 	openflow_action_list();
@@ -27,13 +35,31 @@ public:
 	void   remove_action(const of_action& action);
 	vector<unique_ptr<of_action>> get_actions() const;
 
+	// allocation-free access to single actions
+	uint32_t size() const;
+	bool     empty() const;
+	of_action::action_type get_action_type(uint32_t index) const;
+
+	// decodes the action at an index into result. fails if the index is out of
+	// range or the action is not of result's type
+	bool     get_action(uint32_t index, of_action& result) const;
+
 	uint32_t serialize(autobuf& dest) const;
 	uint32_t get_serialization_size() const;
+	const autobuf& get_wire() const;
 	bool     deserialize(const autobuf& input);
 
 private:
 
-	vector<unique_ptr<of_action>> actions;
+	autobuf  encoded;       // the actions in wire format
+	uint32_t count;         // number of actions in encoded
 
-};
+	// appends an action in wire format
+	void     append_action(const of_action& action);
 
+	// gets the wire record of the action at an index
+	bool     get_record(uint32_t index, autobuf& record) const;
+
+	// gets the offset of the record that matches an encoded action (or -1)
+	int32_t  find_record(const autobuf& record) const;
+};
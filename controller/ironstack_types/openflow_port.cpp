@@ -44,6 +44,21 @@ void openflow_port::set(const struct ofp_phy_port& input) {
 	peer_features.set(ntohl(input.peer));
 }
 
+// writes the port description into an openflow data structure
+void openflow_port::get(struct ofp_phy_port& output) const {
+	memset(&output, 0, sizeof(output));
+	output.port_no = htons(port_number);
+	dl_addr.get(output.hw_addr);
+	strncpy(output.name, name.c_str(), OFP_MAX_PORT_NAME_LEN-1);
+
+	output.config = htonl(config.get());
+	output.state = htonl(state.get());
+	output.curr = htonl(current_features.get());
+	output.advertised = htonl(advertised_features.get());
+	output.supported = htonl(supported_features.get());
+	output.peer = htonl(peer_features.get());
+}
+
 // generates a debug verbose message about this physical port
 string openflow_port::to_string() const {
 	char buf[128];
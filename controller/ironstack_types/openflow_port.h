@@ -36,6 +36,7 @@ public:
 
 	// support functions
 	void   set(const struct ofp_phy_port& input);
+	void   get(struct ofp_phy_port& output) const;
 	string to_string() const;
 };
 
@@ -25,7 +25,7 @@ void openflow_vlan_port::set_valid(bool state) {
 // sets the tagging on the vlan port
 void openflow_vlan_port::set_vlan_tagging(bool state) {
 	tagged = state;
-	if (!tagged && vlan_membership.size() > 1) {
+	if (!tagged && vlan_membership.count() > 1) {
 		output::log(output::loglevel::ERROR, "openflow_vlan_port::set_vlan_tagging() untagged port "
 			"cannot belong to more than one vlan!\n");
 		abort();
@@ -35,21 +35,21 @@ void openflow_vlan_port::set_vlan_tagging(bool state) {
 // adds this port to a vlan flood domain
 // automatically implies vlan membership
 void openflow_vlan_port::add_as_flood_port_for_vlan(uint16_t vlan_id) {
-	vlan_flood_port_membership.insert(vlan_id);
+	vlan_flood_port_membership.set(vlan_id);
 	add_to_vlan_membership(vlan_id);
 }
 
 // adds this port to the stp domain
 // automatically implies vlan membership
 void openflow_vlan_port::add_as_stp_port_for_vlan(uint16_t vlan_id) {
-	vlan_stp_membership.insert(vlan_id);
+	vlan_stp_membership.set(vlan_id);
 	add_to_vlan_membership(vlan_id);
 }
 
 // adds this port to a vlan
 void openflow_vlan_port::add_to_vlan_membership(uint16_t vlan_id) {
-	vlan_membership.insert(vlan_id);
-	if (!tagged && vlan_membership.size() > 1) {
+	vlan_membership.set(vlan_id);
+	if (!tagged && vlan_membership.count() > 1) {
 		output::log(output::loglevel::ERROR, "openflow_vlan_port::add_to_vlan_membership() untagged port"
 			" cannot belong to more than one vlan!\n");
 		abort();
@@ -58,18 +58,18 @@ void openflow_vlan_port::add_to_vlan_membership(uint16_t vlan_id) {
 
 // removes this port from a vlan flood domain
 void openflow_vlan_port::remove_as_flood_port_for_vlan(uint16_t vlan_id) {
-	vlan_flood_port_membership.erase(vlan_id);
+	vlan_flood_port_membership.reset(vlan_id);
 }
 
 // removes this port from a vlan stp domain
 void openflow_vlan_port::remove_as_stp_port_for_vlan(uint16_t vlan_id) {
-	vlan_stp_membership.erase(vlan_id);
+	vlan_stp_membership.reset(vlan_id);
 }
 
 // removes this port from a vlan
 // automatically implies removal from flood and stp domains
 void openflow_vlan_port::remove_from_vlan_membership(uint16_t vlan_id) {
-	vlan_membership.erase(vlan_id);
+	vlan_membership.reset(vlan_id);
 	remove_as_flood_port_for_vlan(vlan_id);
 	remove_as_stp_port_for_vlan(vlan_id);
 }
@@ -98,24 +98,39 @@ bool openflow_vlan_port::is_tagged_port() const {
 
 // checks if a port is part of a vlan flood domain
 bool openflow_vlan_port::is_flood_port_for_vlan(uint16_t vlan_id) const {
-	return vlan_flood_port_membership.count(vlan_id) > 0;
+	return vlan_flood_port_membership.test(vlan_id);
 }
 
 // checks if a port is part of a vlan spanning tree
 bool openflow_vlan_port::is_stp_port_for_vlan(uint16_t vlan_id) const {
-	return vlan_stp_membership.count(vlan_id) > 0;
+	return vlan_stp_membership.test(vlan_id);
 }
 
 // checks if a port is part of a vlan
 bool openflow_vlan_port::is_member_of_vlan(uint16_t vlan_id) const {
-	return vlan_membership.count(vlan_id) > 0;
+	return vlan_membership.test(vlan_id);
 }
 
 // gets the list of all vlans that this port is a member of
 set<uint16_t> openflow_vlan_port::get_all_vlans() const {
+	return vlan_membership.to_set();
+}
+
+// gets the vlan membership as a mask
+const vlan_mask& openflow_vlan_port::get_vlan_mask() const {
 	return vlan_membership;
 }
 
+// gets the vlan flood domain membership as a mask
+const vlan_mask& openflow_vlan_port::get_flood_vlan_mask() const {
+	return vlan_flood_port_membership;
+}
+
+// gets the vlan spanning tree membership as a mask
+const vlan_mask& openflow_vlan_port::get_stp_vlan_mask() const {
+	return vlan_stp_membership;
+}
+
 // returns a reference to the internal openflow port 
 openflow_port& openflow_vlan_port::get_openflow_port() {
 	return port;
@@ -135,18 +150,18 @@ string openflow_vlan_port::to_string() const {
 	result += string("\nvalid          : ") + (valid ? string("yes") : string("no"));
 	result += string("\ntagged         : ") + (tagged ? string("yes") : string("no"));
 	result += string("\nvlan membership: ");
-	for (const auto& v : vlan_membership) {
+	for (const auto& v : vlan_membership.to_set()) {
 		sprintf(buf, "%hu ", v);
 		result += buf;
 	}
 
 	result += string("\nflood ports    : ");
-	for (const auto& p : vlan_flood_port_membership) {
+	for (const auto& p : vlan_flood_port_membership.to_set()) {
 		sprintf(buf, "%hu ", p);
 		result += buf;
 	}
 	result += string("\nstp ports      : ");
-	for (const auto& p : vlan_stp_membership) {
+	for (const auto& p : vlan_stp_membership.to_set()) {
 		sprintf(buf, "%hu ", p);
 		result += buf;
 	}
@@ -3,8 +3,14 @@
 #include <set>
 #include <string>
 #include "openflow_port.h"
+#include "../../common/bit_mask.h"
 using namespace std;
 
+// membership masks: one bit per vlan id, and one bit per physical port.
+// ports at or above port_mask::WIDTH cannot be represented in a port mask.
+typedef bit_mask<4096> vlan_mask;
+typedef bit_mask<128>  port_mask;
+
 // used by switch state for openflow vlans
 class openflow_vlan_port {
 public:
@@ -41,6 +47,11 @@ public:
 	bool           is_stp_port_for_vlan(uint16_t vlan_id) const;
 	bool           is_member_of_vlan(uint16_t vlan_id) const;
 	set<uint16_t>  get_all_vlans() const;
+
+	// membership as vlan masks (no allocation)
+	const vlan_mask& get_vlan_mask() const;
+	const vlan_mask& get_flood_vlan_mask() const;
+	const vlan_mask& get_stp_vlan_mask() const;
 	openflow_port& get_openflow_port();
 	const openflow_port& get_openflow_port_const() const;
 
@@ -51,8 +62,8 @@ private:
 
 	bool           valid;
 	bool           tagged;
-	set<uint16_t>  vlan_flood_port_membership;
-	set<uint16_t>  vlan_stp_membership;
-	set<uint16_t>  vlan_membership;
+	vlan_mask      vlan_flood_port_membership;
+	vlan_mask      vlan_stp_membership;
+	vlan_mask      vlan_membership;
 	openflow_port  port;
 };
@@ -0,0 +1,105 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "gui/log_format.h"
+using namespace std;
+
+// binary log decoder
+//
+// converts a binary log written by output::start_log(..., logformat::BINARY)
+// into the text log format. with -t, the id of the logging thread is shown
+// after the timestamp.
+
+int main(int argc, char** argv) {
+
+	bool show_thread = false;
+	const char* filename = nullptr;
+	for (int counter = 1; counter < argc; ++counter) {
+		if (strcmp(argv[counter], "-t") == 0) {
+			show_thread = true;
+		} else {
+			filename = argv[counter];
+		}
+	}
+	if (filename == nullptr) {
+		printf("usage: %s [-t] [binary log file]\n", argv[0]);
+		return 1;
+	}
+
+	FILE* fp = fopen(filename, "rb");
+	if (fp == nullptr) {
+		printf("error: unable to open %s.\n", filename);
+		return 1;
+	}
+
+	// a log file may hold several sessions, each starting with a file header
+	unordered_map<uint32_t, string> formats;
+	vector<uint8_t> payload;
+	char timestamp[128];
+	uint64_t num_records = 0;
+	while (true) {
+
+		// read the next record (or file header)
+		log_format::record_header header;
+		if (fread(&header, sizeof(header), 1, fp) != 1) break;
+		if (memcmp(&header, log_format::MAGIC, sizeof(log_format::MAGIC)) == 0) {
+			log_format::file_header file_header;
+			memcpy(&file_header, &header, sizeof(file_header));
+			if (file_header.version != log_format::VERSION) {
+				printf("error: unsupported log version %u.\n", file_header.version);
+				break;
+			}
+			if (fseek(fp, (long) sizeof(file_header) - (long) sizeof(header), SEEK_CUR) != 0) break;
+			formats.clear();
+			printf("### LOG STARTED ###\n");
+			continue;
+		}
+
+		payload.resize(header.length);
+		if (header.length > 0 && fread(payload.data(), header.length, 1, fp) != 1) {
+			printf("error: log truncated.\n");
+			break;
+		}
+		++num_records;
+
+		if (header.type == log_format::RECORD_FORMAT) {
+			formats[header.format_id] = string((const char*) payload.data(), header.length);
+			continue;
+		}
+
+		// format the message
+		string msg;
+		if (header.type == log_format::RECORD_MESSAGE) {
+			auto it = formats.find(header.format_id);
+			if (it == formats.end()) {
+				printf("error: message refers to unknown format %u.\n", header.format_id);
+				continue;
+			}
+			msg = log_format::decode_args(it->second.c_str(), payload.data(), header.length);
+		} else if (header.type == log_format::RECORD_TEXT) {
+			msg = string((const char*) payload.data(), header.length);
+		} else {
+			printf("error: unknown record type %u.\n", header.type);
+			break;
+		}
+
+		log_format::get_timestamp(header.timestamp, timestamp, sizeof(timestamp));
+		if (show_thread) {
+			printf("[%s] <%hu> ", timestamp, header.thread_id);
+		} else {
+			printf("[%s] ", timestamp);
+		}
+		if (header.level != log_format::NO_LEVEL) {
+			printf("%s: ", log_format::get_level_name(header.level));
+		}
+		printf("%s", msg.c_str());
+		if (msg.empty() || msg.back() != '\n') printf("\n");
+	}
+
+	fclose(fp);
+	fprintf(stderr, "%" PRIu64 " records decoded.\n", num_records);
+	return 0;
+}
@@ -0,0 +1,662 @@
+#include <inttypes.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "openflow_messages/of_flow_mod_template.h"
+#include "openflow_messages/of_message_factory.h"
+#include "openflow_types/of_match.h"
+#include "openflow_types/of_packed_match.h"
+#include "ironstack_types/openflow_action_list.h"
+#include "../common/autobuf.h"
+#include "../common/openflow.h"
+#include "../common/std_packet.h"
+using namespace std;
+
+// microbenchmarks for the serialization and packet parsing hot paths
+//
+// each case is run until it has taken at least a tenth of a second and
+// reported in ns/op and heap allocations/op. allocations are counted by
+// interposing malloc/calloc/realloc (operator new goes through malloc), so
+// autobuf's realloc-based growth is counted as well.
+//
+// usage: ./micro_benchmark [substring filter]
+
+// allocation counting
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+static atomic<uint64_t> allocation_count(0);
+
+extern "C" void* malloc(size_t size) {
+	allocation_count.fetch_add(1, memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+	allocation_count.fetch_add(1, memory_order_relaxed);
+	return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+	allocation_count.fetch_add(1, memory_order_relaxed);
+	return __libc_realloc(ptr, size);
+}
+
+// keeps results alive so that the measured work isn't optimized away
+static volatile uint64_t sink;
+
+// runs one benchmark case
+static string filter;
+static void run(const string& name, const function<void()>& body) {
+	if (!filter.empty() && name.find(filter) == string::npos) {
+		return;
+	}
+
+	// warm up (first-use allocations are not counted)
+	for (uint32_t counter = 0; counter < 100; ++counter) {
+		body();
+	}
+
+	// grow the iteration count until the run is long enough to time
+	uint64_t iterations = 1000;
+	while (true) {
+		uint64_t allocations_before = allocation_count.load(memory_order_relaxed);
+		auto start = chrono::steady_clock::now();
+		for (uint64_t counter = 0; counter < iterations; ++counter) {
+			body();
+		}
+		double elapsed_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+		uint64_t allocations = allocation_count.load(memory_order_relaxed) - allocations_before;
+
+		if (elapsed_ns >= 1e8 || iterations >= (1ULL << 30)) {
+			printf("%-52s %12.1f ns/op %9.2f allocs/op\n", name.c_str(), elapsed_ns / iterations,
+				(double) allocations / iterations);
+			return;
+		}
+		iterations *= (elapsed_ns < 1e7 ? 10 : 2);
+	}
+}
+
+// builds the test frames
+static void build_frames(autobuf& arp_frame, autobuf& tcp_frame, autobuf& udp_frame, autobuf& icmp_frame) {
+	mac_address host1, host2;
+	host1.set_from_uint64(0x020000000001ULL);
+	host2.set_from_uint64(0x020000000002ULL);
+
+	arp_packet arp;
+	arp.has_vlan_tag = true;
+	arp.vlan_id = 10;
+	arp.src_mac = host1;
+	arp.dest_mac.set_broadcast();
+	arp.sender_mac = host1;
+	arp.receiver_mac.clear();
+	arp.arp_request = true;
+	arp.src_ip = ip_address("10.0.0.1");
+	arp.dest_ip = ip_address("10.0.0.2");
+	arp.serialize(arp_frame);
+
+	tcp_packet tcp;
+	tcp.has_vlan_tag = true;
+	tcp.vlan_id = 10;
+	tcp.src_mac = host1;
+	tcp.dest_mac = host2;
+	tcp.src_ip = ip_address("10.0.0.1");
+	tcp.dest_ip = ip_address("10.0.0.2");
+	tcp.src_port = 40000;
+	tcp.dest_port = 80;
+	tcp.seq = 1;
+	tcp.ack = 1;
+	tcp.ack_flag = true;
+	tcp.psh_flag = true;
+	tcp.payload.create_empty_buffer(512, true);
+	tcp.serialize(tcp_frame);
+
+	udp_packet udp;
+	udp.has_vlan_tag = true;
+	udp.vlan_id = 10;
+	udp.src_mac = host1;
+	udp.dest_mac = host2;
+	udp.src_ip = ip_address("10.0.0.1");
+	udp.dest_ip = ip_address("10.0.0.2");
+	udp.src_port = 5353;
+	udp.dest_port = 53;
+	udp.udp_payload.create_empty_buffer(64, true);
+	udp.serialize(udp_frame);
+
+	icmp_packet icmp;
+	icmp.has_vlan_tag = true;
+	icmp.vlan_id = 10;
+	icmp.src_mac = host1;
+	icmp.dest_mac = host2;
+	icmp.src_ip = ip_address("10.0.0.1");
+	icmp.dest_ip = ip_address("10.0.0.2");
+	icmp.icmp_pkt_type = 8;
+	icmp.code = 0;
+	icmp.data.create_empty_buffer(56, true);
+	icmp.serialize(icmp_frame);
+}
+
+// the l2 acceleration rule (dl_dst + vlan)
+static of_match get_l2_match() {
+	of_match result;
+	result.wildcard_all();
+	result.wildcard_ethernet_dest = false;
+	result.ethernet_dest.set_from_uint64(0x020000000001ULL);
+	result.wildcard_vlan_id = false;
+	result.vlan_id = 10;
+	return result;
+}
+
+// an exact 12-tuple match
+static of_match get_exact_match() {
+	of_match result;
+	result.wildcard_none();
+	result.in_port = 3;
+	result.ethernet_src.set_from_uint64(0x020000000001ULL);
+	result.ethernet_dest.set_from_uint64(0x020000000002ULL);
+	result.vlan_id = 10;
+	result.vlan_pcp = 0;
+	result.ethernet_frame_type = 0x0800;
+	result.ip_type_of_service = 0;
+	result.ip_protocol = 6;
+	result.ip_src_address = ip_address("10.0.0.1");
+	result.ip_dest_address = ip_address("10.0.0.2");
+	result.tcpudp_src_port = 40000;
+	result.tcpudp_dest_port = 80;
+	return result;
+}
+
+// builds a serialized sample of every openflow message type
+static vector<pair<string, autobuf>> build_messages(const autobuf& frame) {
+	vector<pair<string, autobuf>> result;
+	auto add = [&](const string& name, const of_message& message) {
+		autobuf buf;
+		message.serialize(buf);
+		result.push_back(make_pair(name, buf));
+	};
+
+	openflow_action_list actions;
+	actions.from_string("out_port=3");
+	openflow_port port;
+	port.port_number = 1;
+	port.name = "port1";
+	port.dl_addr.set_from_uint64(0x020000000100ULL);
+	port.current_features.bandwidth_1gb_full_duplex = true;
+
+	add("hello", of_message_hello());
+	{
+		of_message_echo_request message;
+		message.data.create_empty_buffer(8, true);
+		add("echo_request", message);
+	}
+	add("echo_reply", of_message_echo_reply());
+	add("features_request", of_message_features_request());
+	{
+		of_message_features_reply message;
+		message.switch_features.n_tables = 1;
+		for (uint16_t counter = 1; counter <= 48; ++counter) {
+			port.port_number = counter;
+			message.physical_ports.push_back(port);
+		}
+		add("features_reply (48 ports)", message);
+	}
+	add("get_config_request", of_message_get_config_request());
+	{
+		of_message_get_config_reply message;
+		message.config.frag_normal = true;
+		message.config.max_msg_send_len = 65535;
+		add("get_config_reply", message);
+	}
+	{
+		of_message_set_config message;
+		message.frag_normal = true;
+		message.max_msg_send_len = 65535;
+		add("set_config", message);
+	}
+	{
+		of_message_packet_in message;
+		message.buffer_id = 0xffffffff;
+		message.in_port = 3;
+		message.reason_no_match = true;
+		message.pkt_data = frame;
+		message.actual_message_len = frame.size();
+		add("packet_in", message);
+	}
+	{
+		of_message_flow_removed message;
+		message.match = get_l2_match();
+		message.reason_idle_timeout = true;
+		add("flow_removed", message);
+	}
+	{
+		of_message_packet_out message;
+		message.buffer_id = 0xffffffff;
+		message.action_list = actions;
+		message.packet_data = frame;
+		add("packet_out", message);
+	}
+	{
+		of_message_modify_flow message;
+		message.flow_description.criteria = get_l2_match();
+		message.flow_description.action_list = actions;
+		message.flow_description.priority = 100;
+		message.command = OFPFC_MODIFY_STRICT;
+		message.buffer_id = 0xffffffff;
+		add("flow_mod", message);
+	}
+	{
+		of_message_port_modification message;
+		message.port_no = 1;
+		message.port_mac_address = port.dl_addr;
+		add("port_mod", message);
+	}
+	add("stats_request (desc)", of_message_stats_request_switch_description());
+	{
+		of_message_stats_request_flow_stats message;
+		message.fields_to_match.wildcard_all();
+		message.all_tables = true;
+		add("stats_request (flow)", message);
+	}
+	{
+		of_message_stats_request_aggregate_stats message;
+		message.fields_to_match.wildcard_all();
+		message.all_tables = true;
+		add("stats_request (aggregate)", message);
+	}
+	add("stats_request (table)", of_message_stats_request_table_stats());
+	{
+		of_message_stats_request_port_stats message;
+		message.all_ports = true;
+		add("stats_request (port)", message);
+	}
+	{
+		of_message_stats_request_queue_stats message;
+		message.all_ports = true;
+		message.all_queues = true;
+		add("stats_request (queue)", message);
+	}
+	{
+		of_message_stats_reply_switch_description message;
+		message.description.manufacturer = "ironstack";
+		message.description.hardware_description = "benchmark";
+		add("stats_reply (desc)", message);
+	}
+	{
+		of_message_stats_reply_flow_stats message;
+		for (uint32_t counter = 0; counter < 64; ++counter) {
+			openflow_flow_description_and_stats flow;
+			flow.flow_description.criteria = get_l2_match();
+			flow.flow_description.action_list = actions;
+			flow.flow_description.priority = 100;
+			message.flow_stats.push_back(flow);
+		}
+		add("stats_reply (flow, 64 flows)", message);
+	}
+	add("stats_reply (aggregate)", of_message_stats_reply_aggregate_stats());
+	{
+		of_message_stats_reply_table_stats message;
+		openflow_table_stats table;
+		table.name = "table";
+		message.table_stats.push_back(table);
+		add("stats_reply (table)", message);
+	}
+	{
+		of_message_stats_reply_port_stats message;
+		for (uint16_t counter = 1; counter <= 48; ++counter) {
+			openflow_port_stats stats;
+			stats.port = counter;
+			message.port_stats.push_back(stats);
+		}
+		add("stats_reply (port, 48 ports)", message);
+	}
+	add("stats_reply (queue)", of_message_stats_reply_queue_stats());
+	add("barrier_request", of_message_barrier_request());
+	add("barrier_reply", of_message_barrier_reply());
+	{
+		of_message_queue_get_config_request message;
+		message.port = 1;
+		add("queue_get_config_request", message);
+	}
+
+	// switch to controller messages the controller never serializes
+	{
+		autobuf buf;
+		buf.create_empty_buffer(sizeof(struct ofp_error_msg) + sizeof(struct ofp_header), true);
+		struct ofp_error_msg* hdr = (struct ofp_error_msg*) buf.get_content_ptr_mutable();
+		hdr->header.version = OFP_VERSION;
+		hdr->header.type = (uint8_t) OFPT_ERROR;
+		hdr->header.length = htons(buf.size());
+		hdr->type = htons((uint16_t) OFPET_BAD_REQUEST);
+		hdr->code = htons((uint16_t) OFPBRC_BAD_TYPE);
+		result.push_back(make_pair(string("error"), buf));
+	}
+	{
+		autobuf buf;
+		buf.create_empty_buffer(sizeof(struct ofp_port_status), true);
+		struct ofp_port_status* hdr = (struct ofp_port_status*) buf.get_content_ptr_mutable();
+		hdr->header.version = OFP_VERSION;
+		hdr->header.type = (uint8_t) OFPT_PORT_STATUS;
+		hdr->header.length = htons(buf.size());
+		hdr->reason = (uint8_t) OFPPR_MODIFY;
+		port.get(hdr->desc);
+		result.push_back(make_pair(string("port_status"), buf));
+	}
+
+	// queue_get_config_reply is left out: its deserialize() is still a stub
+	return result;
+}
+
+int main(int argc, char** argv) {
+
+	if (argc > 2) {
+		printf("usage: %s [substring filter]\n", argv[0]);
+		return 1;
+	}
+	if (argc == 2) {
+		filter = argv[1];
+	}
+
+	autobuf arp_frame, tcp_frame, udp_frame, icmp_frame;
+	build_frames(arp_frame, tcp_frame, udp_frame, icmp_frame);
+
+	autobuf mtu_frame;
+	mtu_frame.create_empty_buffer(1500, true);
+	uint8_t chunk[64];
+	memset(chunk, 0xa5, sizeof(chunk));
+
+	// 1. autobuf
+	run("autobuf create_empty_buffer (64b)", [&]() {
+		autobuf buf;
+		buf.create_empty_buffer(64, false);
+		sink += buf.size();
+	});
+	run("autobuf create_empty_buffer (1500b)", [&]() {
+		autobuf buf;
+		buf.create_empty_buffer(1500, false);
+		sink += buf.size();
+	});
+	run("autobuf append (16 x 64b)", [&]() {
+		autobuf buf;
+		for (uint32_t counter = 0; counter < 16; ++counter) {
+			buf.append(chunk, sizeof(chunk));
+		}
+		sink += buf.size();
+	});
+	{
+		autobuf buf;
+		run("autobuf set_content + trim (reused, 1500b)", [&]() {
+			buf.set_content(mtu_frame.get_content_ptr(), mtu_frame.size());
+			buf.trim_front(18);
+			buf.trim_rear(4);
+			sink += buf.size();
+		});
+	}
+	run("autobuf copy constructor (1500b)", [&]() {
+		autobuf copy(mtu_frame);
+		sink += copy.size();
+	});
+	{
+		autobuf copy;
+		run("autobuf assignment (reused, 1500b)", [&]() {
+			copy = mtu_frame;
+			sink += copy.size();
+		});
+	}
+	run("autobuf copy_as_read_only (1500b)", [&]() {
+		autobuf copy = mtu_frame.copy_as_read_only();
+		sink += copy.size();
+	});
+	{
+		autobuf refcounted_frame = mtu_frame.copy_as_refcounted();
+		run("autobuf copy constructor (refcounted, 1500b)", [&]() {
+			autobuf copy(refcounted_frame);
+			sink += copy.size();
+		});
+		run("autobuf slice (refcounted, 1500b)", [&]() {
+			autobuf payload = refcounted_frame.slice(18, 1478);
+			sink += payload.size();
+		});
+	}
+
+	// 2. of_match
+	of_match l2_match = get_l2_match(), exact_match = get_exact_match();
+	autobuf l2_match_buf, exact_match_buf;
+	l2_match.serialize(l2_match_buf);
+	exact_match.serialize(exact_match_buf);
+	{
+		autobuf buf;
+		run("of_match serialize (l2)", [&]() {
+			sink += l2_match.serialize(buf);
+		});
+		run("of_match serialize (exact)", [&]() {
+			sink += exact_match.serialize(buf);
+		});
+		of_match match;
+		run("of_match deserialize (l2)", [&]() {
+			sink += match.deserialize(l2_match_buf);
+		});
+		run("of_match deserialize (exact)", [&]() {
+			sink += match.deserialize(exact_match_buf);
+		});
+		run("of_match subset check (exact < l2)", [&]() {
+			sink += (exact_match < l2_match);
+		});
+		run("of_match equality (exact)", [&]() {
+			sink += (match == exact_match);
+		});
+	}
+
+	// 2b. of_packed_match
+	{
+		of_packed_match packed_l2(l2_match), packed_exact(exact_match), packed;
+		autobuf buf;
+		run("of_packed_match set from of_match (exact)", [&]() {
+			packed.set(exact_match);
+			sink += packed.get_wildcards();
+		});
+		run("of_packed_match serialize (exact)", [&]() {
+			sink += packed_exact.serialize(buf);
+		});
+		run("of_packed_match deserialize (exact)", [&]() {
+			sink += packed.deserialize(exact_match_buf);
+		});
+		run("of_packed_match subset check (exact < l2)", [&]() {
+			sink += (packed_exact < packed_l2);
+		});
+		run("of_packed_match equality (exact)", [&]() {
+			sink += (packed == packed_exact);
+		});
+		run("of_packed_match hash", [&]() {
+			sink += packed_exact.get_hash();
+		});
+	}
+
+	// 3. openflow_action_list
+	openflow_action_list actions;
+	actions.from_string("set_vlan=20 set_dl_dest=02:00:00:00:00:02 out_port=3 out_port=4");
+	autobuf actions_buf;
+	actions.serialize(actions_buf);
+	string actions_string = actions.to_string();
+	{
+		autobuf buf;
+		run("action_list serialize (4 actions)", [&]() {
+			sink += actions.serialize(buf);
+		});
+		openflow_action_list parsed;
+		run("action_list deserialize (4 actions)", [&]() {
+			sink += parsed.deserialize(actions_buf);
+		});
+		run("action_list copy (4 actions)", [&]() {
+			openflow_action_list copy(actions);
+			sink += copy.get_serialization_size();
+		});
+		run("action_list to_string + from_string (4 actions)", [&]() {
+			sink += parsed.from_string(actions.to_string());
+		});
+		openflow_action_list single;
+		single.from_string("out_port=3");
+		run("action_list serialize + deserialize (1 action)", [&]() {
+			single.serialize(buf);
+			sink += parsed.deserialize(buf);
+		});
+		openflow_action_list reordered;
+		reordered.from_string("out_port=4 out_port=3 set_dl_dest=02:00:00:00:00:02 set_vlan=20");
+		run("action_list equality (4 actions, reordered)", [&]() {
+			sink += (actions == reordered);
+		});
+		run("action_list build (1 output action)", [&]() {
+			openflow_action_list list;
+			of_action_output_to_port output;
+			output.port = 3;
+			list.add_action(output);
+			sink += list.size();
+		});
+		of_action_output_to_port output;
+		run("action_list get_action (output)", [&]() {
+			sink += single.get_action(0, output);
+		});
+	}
+
+	// 4. of_message_factory
+	vector<pair<string, autobuf>> messages = build_messages(udp_frame);
+	for (const auto& message : messages) {
+		if (ironstack::of_message_factory::deserialize_message(message.second) == nullptr) {
+			printf("%-52s failed to deserialize\n", ("factory " + message.first).c_str());
+			continue;
+		}
+		run("factory " + message.first, [&]() {
+			shared_ptr<of_message> result = ironstack::of_message_factory::deserialize_message(message.second);
+			sink += result->msg_type;
+		});
+	}
+
+	// 5. packet parsing
+	{
+		arp_packet arp;
+		tcp_packet tcp;
+		udp_packet udp;
+		icmp_packet icmp;
+		raw_packet raw;
+		run("raw_packet deserialize (tcp frame)", [&]() {
+			sink += raw.deserialize(tcp_frame);
+		});
+		run("arp_packet deserialize", [&]() {
+			sink += arp.deserialize(arp_frame);
+		});
+		run("tcp_packet deserialize (512b payload)", [&]() {
+			sink += tcp.deserialize(tcp_frame);
+		});
+		run("udp_packet deserialize (64b payload)", [&]() {
+			sink += udp.deserialize(udp_frame);
+		});
+		run("icmp_packet deserialize (56b payload)", [&]() {
+			sink += icmp.deserialize(icmp_frame);
+		});
+		const autobuf* frames[] = { &arp_frame, &tcp_frame, &udp_frame, &icmp_frame };
+		uint32_t index = 0;
+		run("std_packet_factory instantiate (arp/tcp/udp/icmp)", [&]() {
+			raw_packet* packet = std_packet_factory::instantiate(*frames[index++ & 3]);
+			sink += packet->packet_type;
+			delete packet;
+		});
+	}
+
+	// 6. ip header checksum
+	{
+		const ip_packet::ip_hdr_t* ip_hdr = (const ip_packet::ip_hdr_t*) udp_frame.ptr_offset_const(sizeof(raw_packet::tagged_ethernet_hdr_t));
+		run("checksum_ip", [&]() {
+			sink += ip_packet::checksum_ip(ip_hdr);
+		});
+	}
+
+	// 7. the packet_in message path: decode a packet_in, parse its frame and
+	// answer it with a flow_mod and a packet_out, each serialized into a new
+	// buffer like the hal does. the message sits in a refcounted block, as it
+	// does when received from the switch.
+	{
+		autobuf packet_in_buf;
+		for (const auto& message : messages) {
+			if (message.first == "packet_in") {
+				packet_in_buf = message.second.copy_as_refcounted();
+			}
+		}
+		of_match l2_rule = get_l2_match();
+		run("packet_in path (decode + flow_mod + packet_out)", [&]() {
+			shared_ptr<of_message> message = ironstack::of_message_factory::deserialize_message(packet_in_buf);
+			const of_message_packet_in& packet_in = *static_pointer_cast<of_message_packet_in>(message);
+			raw_packet* packet = std_packet_factory::instantiate(packet_in.pkt_data);
+			sink += packet->packet_type;
+			delete packet;
+
+			of_action_output_to_port output;
+			output.port = 3;
+			of_message_modify_flow flow_mod;
+			flow_mod.flow_description.criteria = l2_rule;
+			flow_mod.flow_description.action_list.add_action(output);
+			flow_mod.flow_description.priority = 100;
+			flow_mod.buffer_id = 0xffffffff;
+			autobuf flow_mod_buf;
+			sink += flow_mod.serialize(flow_mod_buf);
+
+			of_message_packet_out packet_out;
+			packet_out.buffer_id = 0xffffffff;
+			packet_out.packet_data = packet_in.pkt_data.copy_as_read_only();
+			packet_out.action_list.add_action(output);
+			autobuf packet_out_buf;
+			sink += packet_out.serialize(packet_out_buf);
+		});
+	}
+
+	// 8. l2 rule flow_mods (as installed by the l2 accelerators), through the
+	// full serializer and from a serialized template
+	{
+		of_action_output_to_port output;
+		output.port = 3;
+		of_message_modify_flow flow_mod;
+		flow_mod.flow_description.criteria = get_l2_match();
+		flow_mod.flow_description.action_list.add_action(output);
+		flow_mod.flow_description.priority = 100;
+		flow_mod.flow_description.cookie = 0x1234;
+		flow_mod.command = OFPFC_MODIFY_STRICT;
+		flow_mod.buffer_id = 0xffffffff;
+		flow_mod.flag_send_flow_removal_message = true;
+		flow_mod.flag_check_overlap = true;
+		flow_mod.xid = 42;
+
+		shared_ptr<of_flow_mod_template> l2_template = make_shared<of_flow_mod_template>();
+		l2_template->set(flow_mod);
+		of_message_modify_flow templated_flow_mod = flow_mod;
+		templated_flow_mod.serialization_template = l2_template;
+
+		autobuf full_buf, templated_buf;
+		flow_mod.serialize(full_buf);
+		templated_flow_mod.serialize(templated_buf);
+		if (full_buf != templated_buf) {
+			printf("%-52s differs from the full serializer\n", "flow_mod template");
+		}
+
+		run("flow_mod serialize (l2 rule)", [&]() {
+			autobuf buf;
+			sink += flow_mod.serialize(buf);
+		});
+		run("flow_mod serialize from template (l2 rule)", [&]() {
+			autobuf buf;
+			sink += templated_flow_mod.serialize(buf);
+		});
+		mac_address dl_dest;
+		dl_dest.set_from_uint64(0x020000000002ULL);
+		run("flow_mod template instantiate (l2 rule)", [&]() {
+			autobuf buf;
+			sink += l2_template->instantiate(buf, dl_dest, 10, 3, 0x1234, 42);
+		});
+	}
+
+	return 0;
+}
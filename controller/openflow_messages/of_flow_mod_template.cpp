@@ -0,0 +1,130 @@
+#include <arpa/inet.h>
+#include <endian.h>
+#include "of_flow_mod_template.h"
+#include "../gui/output.h"
+
+// constructor
+of_flow_mod_template::of_flow_mod_template() {
+}
+
+// builds the template from a prototype l2 rule
+bool of_flow_mod_template::set(const of_message_modify_flow& prototype_) {
+	if (!is_l2_rule(prototype_.flow_description)) {
+		output::log(output::loglevel::BUG, "of_flow_mod_template::set() -- prototype is not an l2 rule:\n%s\n",
+			prototype_.flow_description.to_string().c_str());
+		serialized.clear();
+		return false;
+	}
+
+	// the prototype must not point to a template itself
+	prototype = prototype_;
+	prototype.serialization_template.reset();
+	prototype.serialize(serialized);
+	return true;
+}
+
+// checks if the template was built
+bool of_flow_mod_template::is_set() const {
+	return serialized.size() > 0;
+}
+
+// checks if a flow_mod differs from the prototype only in the patched fields
+bool of_flow_mod_template::matches(const of_message_modify_flow& flow_mod) const {
+	uint16_t out_port;
+	return get_output_port(flow_mod, out_port);
+}
+
+// checks the flow_mod against the prototype and gets its output port. the
+// port is read straight from the action list's wire form
+bool of_flow_mod_template::get_output_port(const of_message_modify_flow& flow_mod, uint16_t& out_port) const {
+	const openflow_action_list& actions = flow_mod.flow_description.action_list;
+	if (!(is_set() &&
+		flow_mod.version == prototype.version &&
+		flow_mod.command == prototype.command &&
+		flow_mod.idle_timeout == prototype.idle_timeout &&
+		flow_mod.hard_timeout == prototype.hard_timeout &&
+		flow_mod.buffer_id == prototype.buffer_id &&
+		flow_mod.use_out_port == prototype.use_out_port &&
+		(!flow_mod.use_out_port || flow_mod.out_port == prototype.out_port) &&
+		flow_mod.flag_send_flow_removal_message == prototype.flag_send_flow_removal_message &&
+		flow_mod.flag_check_overlap == prototype.flag_check_overlap &&
+		flow_mod.flag_emergency_flow == prototype.flag_emergency_flow &&
+		flow_mod.flow_description.priority == prototype.flow_description.priority &&
+		is_l2_match(flow_mod.flow_description.criteria) &&
+		actions.size() == 1 &&
+		actions.get_serialization_size() == sizeof(struct ofp_action_output))) {
+		return false;
+	}
+
+	const struct ofp_action_output* action = (const struct ofp_action_output*) actions.get_wire().get_content_ptr();
+	out_port = ntohs(action->port);
+	return ntohs(action->type) == (uint16_t) OFPAT_OUTPUT && out_port != (uint16_t) OFPP_CONTROLLER;
+}
+
+// copies the template and patches in the rule
+uint32_t of_flow_mod_template::instantiate(autobuf& dest, const mac_address& dl_dest, uint16_t vlan_id,
+	uint16_t out_port, uint64_t cookie, uint32_t xid) const {
+
+	dest.set_content(serialized.get_content_ptr(), serialized.size());
+	struct ofp_flow_mod* hdr = (struct ofp_flow_mod*) dest.get_content_ptr_mutable();
+	hdr->header.xid = htonl(xid);
+	dl_dest.get(hdr->match.dl_dst);
+	hdr->match.dl_vlan = htons(vlan_id);
+	hdr->cookie = htobe64(cookie);
+
+	struct ofp_action_output* action = (struct ofp_action_output*) dest.ptr_offset_mutable(sizeof(struct ofp_flow_mod));
+	action->port = htons(out_port);
+	return serialized.size();
+}
+
+// serializes a flow_mod of the template's shape
+uint32_t of_flow_mod_template::serialize(const of_message_modify_flow& flow_mod, autobuf& dest) const {
+	uint16_t out_port;
+	if (!get_output_port(flow_mod, out_port)) {
+		return 0;
+	}
+
+	const of_match& criteria = flow_mod.flow_description.criteria;
+	return instantiate(dest, criteria.ethernet_dest, criteria.vlan_id, out_port,
+		flow_mod.flow_description.cookie, flow_mod.xid);
+}
+
+// writes a flow_mod built to the template's shape without checking it. the
+// output port is read straight from the action list's wire form
+uint32_t of_flow_mod_template::instantiate(const of_message_modify_flow& flow_mod, autobuf& dest) const {
+	const of_match& criteria = flow_mod.flow_description.criteria;
+	const struct ofp_action_output* action = (const struct ofp_action_output*) flow_mod.flow_description.action_list.get_wire().get_content_ptr();
+	return instantiate(dest, criteria.ethernet_dest, criteria.vlan_id, ntohs(action->port),
+		flow_mod.flow_description.cookie, flow_mod.xid);
+}
+
+// checks if a flow description is an l2 rule: dl_dest and dl_vlan exact, the
+// rest wildcarded, and a single output to a port other than the controller
+bool of_flow_mod_template::is_l2_rule(const openflow_flow_description& description) {
+	of_action_output_to_port output;
+	return is_l2_match(description.criteria) && get_output_action(description.action_list, output);
+}
+
+// checks if only dl_dest and dl_vlan are matched
+bool of_flow_mod_template::is_l2_match(const of_match& criteria) {
+	return criteria.wildcard_in_port &&
+		criteria.wildcard_ethernet_src &&
+		!criteria.wildcard_ethernet_dest &&
+		!criteria.wildcard_vlan_id &&
+		criteria.wildcard_vlan_pcp &&
+		criteria.wildcard_ethernet_frame_type &&
+		criteria.wildcard_ip_type_of_service &&
+		criteria.wildcard_ip_protocol &&
+		criteria.wildcard_ip_src_lsb_count == 32 &&
+		criteria.wildcard_ip_dest_lsb_count == 32 &&
+		criteria.wildcard_tcpudp_src_port &&
+		criteria.wildcard_tcpudp_dest_port;
+}
+
+// gets the action of a list that is a single output to a port other than the
+// controller
+bool of_flow_mod_template::get_output_action(const openflow_action_list& actions, of_action_output_to_port& output) {
+	return actions.size() == 1 &&
+		actions.get_action(0, output) &&
+		!output.send_to_controller;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include "of_message_modify_flow.h"
+#include "../../common/autobuf.h"
+#include "../../common/mac_address.h"
+using namespace std;
+
+// serialized flow_mod template for l2 rules
+//
+// an l2 rule (dl_dest and dl_vlan exact, every other field wildcarded, one
+// output to a port) always has the same 80-byte wire form apart from the mac,
+// the vlan, the output port, the cookie and the xid. the template keeps that
+// form, serialized once from a prototype, and writes a rule by copying it and
+// patching those five fields.
+//
+// a flow_mod that points to a template (serialization_template) is serialized
+// from it if it has the prototype's shape; any other flow_mod goes through the
+// full serializer. callers that build the rule to the template's shape
+// themselves (template_shape_known) skip the shape check.
+//
+// revision 1 (10/19/26)
+
+class of_flow_mod_template {
+public:
+
+	// constructor
+	of_flow_mod_template();
+
+	// builds the template from a prototype. fails if the prototype is not an
+	// l2 rule
+	bool     set(const of_message_modify_flow& prototype);
+	bool     is_set() const;
+
+	// checks if a flow_mod differs from the prototype only in the patched fields
+	bool     matches(const of_message_modify_flow& flow_mod) const;
+
+	// writes a rule with the given fields patched in
+	uint32_t instantiate(autobuf& dest, const mac_address& dl_dest, uint16_t vlan_id,
+	         uint16_t out_port, uint64_t cookie, uint32_t xid) const;
+
+	// writes a flow_mod of the template's shape. returns 0 (and leaves dest
+	// untouched) if the flow_mod does not match
+	uint32_t serialize(const of_message_modify_flow& flow_mod, autobuf& dest) const;
+
+	// writes a flow_mod that the caller built to the template's shape. the
+	// shape is not checked
+	uint32_t instantiate(const of_message_modify_flow& flow_mod, autobuf& dest) const;
+
+	// checks if a flow description is an l2 rule
+	static bool is_l2_rule(const openflow_flow_description& description);
+
+private:
+
+	of_message_modify_flow prototype;
+	autobuf                serialized;   // the prototype in wire format
+
+	// checks a flow_mod against the prototype and gets its output port
+	bool        get_output_port(const of_message_modify_flow& flow_mod, uint16_t& out_port) const;
+
+	static bool is_l2_match(const of_match& criteria);
+	static bool get_output_action(const openflow_action_list& actions, of_action_output_to_port& output);
+};
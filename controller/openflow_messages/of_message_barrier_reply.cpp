@@ -18,12 +18,9 @@ string of_message_barrier_reply::to_string() const {
 	return of_message::to_string();
 }
 
-// should never be called
+// serializes the barrier reply (used by the switch emulator)
 uint32_t of_message_barrier_reply::serialize(autobuf& dest) const {
-
-	// should never be called
-	abort();
-	return 0;
+	return of_message::serialize(dest);
 }
 
 // deserializes the barrier message
@@ -22,8 +22,16 @@ uint32_t of_message_barrier_request::serialize(autobuf& dest) const {
 	return of_message::serialize(dest);
 }
 
-// should never be called
+// deserializes the barrier request (used by the switch emulator)
 bool of_message_barrier_request::deserialize(const autobuf& input) {
-	abort();
-	return false;
+	bool status = of_message::deserialize(input);
+
+	#ifndef __NO_OPENFLOW_SAFETY_CHECKS
+	if (!status || msg_type != OFPT_BARRIER_REQUEST) {
+		clear();
+		return false;
+	}
+	#endif
+
+	return true;
 }
@@ -34,8 +34,8 @@ shared_ptr<of_message> ironstack::of_message_factory::deserialize_message(const
 			break;
 
 		case (OFPT_FEATURES_REQUEST):
-			// should not be called; controller to switch only
-			abort();
+			// controller to switch only (seen by the switch emulator)
+			result.reset(new of_message_features_request());
 			break;
 
 		case (OFPT_FEATURES_REPLY):
@@ -43,8 +43,8 @@ shared_ptr<of_message> ironstack::of_message_factory::deserialize_message(const
 			break;
 
 		case (OFPT_GET_CONFIG_REQUEST):
-			// should not be called; controller to switch only
-			abort();
+			// controller to switch only (seen by the switch emulator)
+			result.reset(new of_message_get_config_request());
 			break;
 
 		case (OFPT_GET_CONFIG_REPLY):
@@ -52,8 +52,8 @@ shared_ptr<of_message> ironstack::of_message_factory::deserialize_message(const
 			break;
 
 		case (OFPT_SET_CONFIG):
-			// should not be called; controller to switch only
-			abort();
+			// controller to switch only (seen by the switch emulator)
+			result.reset(new of_message_set_config());
 			break;
 
 		case (OFPT_PACKET_IN):
@@ -69,21 +69,56 @@ shared_ptr<of_message> ironstack::of_message_factory::deserialize_message(const
 			break;
 
 		case (OFPT_PACKET_OUT):
-			// should not be called; controller to switch only
-			abort();
+			// controller to switch only (seen by the switch emulator)
+			result.reset(new of_message_packet_out());
 			break;
 
 		case (OFPT_FLOW_MOD):
-			result.reset(new of_message_flow_removed());
+			// controller to switch only (seen by the switch emulator)
+			result.reset(new of_message_modify_flow());
 			break;
 
 		case (OFPT_PORT_MOD):
-			result.reset(new of_message_port_status());
+			// controller to switch only (seen by the switch emulator)
+			result.reset(new of_message_port_modification());
 			break;
 
 		case (OFPT_STATS_REQUEST):
-			// should not be called; controller to switch only
-			abort();
+			// controller to switch only (seen by the switch emulator)
+			if (input.size() < sizeof(struct ofp_stats_request)) {
+				goto fail;
+			}
+
+			switch(ntohs(((const struct ofp_stats_request*)input.get_content_ptr())->type)) {
+
+				case OFPST_DESC:
+					result.reset(new of_message_stats_request_switch_description());
+					break;
+
+				case OFPST_FLOW:
+					result.reset(new of_message_stats_request_flow_stats());
+					break;
+
+				case OFPST_AGGREGATE:
+					result.reset(new of_message_stats_request_aggregate_stats());
+					break;
+
+				case OFPST_TABLE:
+					result.reset(new of_message_stats_request_table_stats());
+					break;
+
+				case OFPST_PORT:
+					result.reset(new of_message_stats_request_port_stats());
+					break;
+
+				case OFPST_QUEUE:
+					result.reset(new of_message_stats_request_queue_stats());
+					break;
+
+				default:
+					output::log(output::loglevel::ERROR, "of_message_factory::deserialize() error -- unsupported of_message_stats_request type.\n");
+					goto fail;
+			}
 			break;
 
 		case (OFPT_STATS_REPLY):
@@ -129,8 +164,8 @@ shared_ptr<of_message> ironstack::of_message_factory::deserialize_message(const
 			break;
 
 		case (OFPT_BARRIER_REQUEST):
-			// should not be called; controller to switch only
-			abort();
+			// controller to switch only (seen by the switch emulator)
+			result.reset(new of_message_barrier_request());
 			break;
 
 		case (OFPT_BARRIER_REPLY):
@@ -138,8 +173,8 @@ shared_ptr<of_message> ironstack::of_message_factory::deserialize_message(const
 			break;
 
 		case (OFPT_QUEUE_GET_CONFIG_REQUEST):
-			// should not be called; controller to switch only
-			abort();
+			// controller to switch only (seen by the switch emulator)
+			result.reset(new of_message_queue_get_config_request());
 			break;
 
 		case (OFPT_QUEUE_GET_CONFIG_REPLY):
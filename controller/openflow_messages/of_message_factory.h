@@ -17,6 +17,7 @@
 #include "of_message_get_config_reply.h"
 #include "of_message_packet_in.h"
 #include "of_message_packet_out.h"
+#include "of_message_port_modification.h"
 #include "of_message_port_status.h"
 #include "of_message_queue_get_config_request.h"
 #include "of_message_queue_get_config_reply.h"
@@ -31,10 +31,30 @@ string of_message_features_reply::to_string() const {
 	return result;
 }
 
-// serializes the features reply message (should never be called)
+// serializes the features reply message (used by the switch emulator)
 uint32_t of_message_features_reply::serialize(autobuf& dest) const {
-	abort();
-	return 0;
+
+	uint32_t size_required = sizeof(struct ofp_switch_features) + physical_ports.size()*sizeof(struct ofp_phy_port);
+	dest.create_empty_buffer(size_required, true);
+	struct ofp_switch_features* hdr = (struct ofp_switch_features*) dest.get_content_ptr_mutable();
+
+	hdr->header.version = version;
+	hdr->header.type = (uint8_t) OFPT_FEATURES_REPLY;
+	hdr->header.length = htons(size_required);
+	hdr->header.xid = htonl(xid);
+
+	// the datapath id is kept in network order (see deserialize())
+	hdr->datapath_id = switch_features.datapath_id;
+	hdr->n_buffers = htonl(switch_features.n_buffers);
+	hdr->n_tables = (uint8_t) switch_features.n_tables;
+	hdr->capabilities = htonl(switch_features.capabilities.get());
+	hdr->actions = htonl(switch_features.actions_supported.get());
+
+	for (uint32_t counter = 0; counter < physical_ports.size(); ++counter) {
+		physical_ports[counter].get(hdr->ports[counter]);
+	}
+
+	return size_required;
 }
 
 // deserializes the features reply message
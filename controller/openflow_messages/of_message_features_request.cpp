@@ -24,9 +24,16 @@ uint32_t of_message_features_request::serialize(autobuf& dest) const {
 	return of_message::serialize(dest);
 }
 
-// deserializes the features request message
-// should never be called
+// deserializes the features request message (used by the switch emulator)
 bool of_message_features_request::deserialize(const autobuf& input) {
-	abort();
-	return false;
+	bool status = of_message::deserialize(input);
+
+	#ifndef __NO_OPENFLOW_SAFETY_CHECKS
+	if (!status || msg_type != OFPT_FEATURES_REQUEST) {
+		clear();
+		return false;
+	}
+	#endif
+
+	return true;
 }
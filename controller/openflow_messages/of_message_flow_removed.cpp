@@ -59,10 +59,38 @@ string of_message_flow_removed::to_string() const {
 	return result;
 }
 
-// should never be called
+// serializes the message (used by the switch emulator)
 uint32_t of_message_flow_removed::serialize(autobuf& dest) const {
-	abort();
-	return 0;
+
+	dest.create_empty_buffer(sizeof(struct ofp_flow_removed), true);
+	struct ofp_flow_removed* header = (struct ofp_flow_removed*) dest.get_content_ptr_mutable();
+
+	header->header.version = version;
+	header->header.type = (uint8_t) OFPT_FLOW_REMOVED;
+	header->header.length = htons(sizeof(struct ofp_flow_removed));
+	header->header.xid = htonl(xid);
+
+	autobuf match_rules;
+	match_rules.inherit_shared(&header->match, sizeof(struct ofp_match));
+	match.serialize(match_rules);
+
+	header->cookie = htobe64(cookie);
+	header->priority = htons(priority);
+	if (reason_idle_timeout) {
+		header->reason = (uint8_t) OFPRR_IDLE_TIMEOUT;
+	} else if (reason_hard_timeout) {
+		header->reason = (uint8_t) OFPRR_HARD_TIMEOUT;
+	} else {
+		header->reason = (uint8_t) OFPRR_DELETE;
+	}
+
+	header->duration_sec = htonl(duration_alive_sec);
+	header->duration_nsec = htonl(duration_alive_nsec);
+	header->idle_timeout = htons(original_idle_timeout);
+	header->packet_count = htobe64(packet_count);
+	header->byte_count = htobe64(byte_count);
+
+	return sizeof(struct ofp_flow_removed);
 }
 
 // deserializes the message
@@ -22,10 +22,29 @@ string of_message_get_config_reply::to_string() const {
 	return result;
 }
 
-// should never be called -- controllers don't send this message to switches
+// serializes the configuration reply (used by the switch emulator)
 uint32_t of_message_get_config_reply::serialize(autobuf& dest) const {
-	abort();
-	return 0;
+
+	dest.create_empty_buffer(sizeof(struct ofp_switch_config), false);
+	struct ofp_switch_config* hdr = (struct ofp_switch_config*) dest.get_content_ptr_mutable();
+
+	hdr->header.version = version;
+	hdr->header.type = (uint8_t) msg_type;
+	hdr->header.length = htons(sizeof(struct ofp_switch_config));
+	hdr->header.xid = htonl(xid);
+
+	if (config.frag_drop) {
+		hdr->flags = htons(1);
+	} else if (config.frag_reasm) {
+		hdr->flags = htons(2);
+	} else if (config.frag_mask) {
+		hdr->flags = htons(3);
+	} else {
+		hdr->flags = 0;
+	}
+	hdr->miss_send_len = htons(config.max_msg_send_len);
+
+	return sizeof(struct ofp_switch_config);
 }
 
 // deserializes the configuration reply message
@@ -21,9 +21,16 @@ uint32_t of_message_get_config_request::serialize(autobuf& dest) const {
 	return of_message::serialize(dest);
 }
 
-// should never need to get called -- switch never replies with this message
-// type
+// deserializes the message (used by the switch emulator)
 bool of_message_get_config_request::deserialize(const autobuf& input) {
-	abort();
-	return false;
+	bool status = of_message::deserialize(input);
+
+	#ifndef __NO_OPENFLOW_SAFETY_CHECKS
+	if (!status || msg_type != OFPT_GET_CONFIG_REQUEST) {
+		clear();
+		return false;
+	}
+	#endif
+
+	return true;
 }
@@ -1,4 +1,5 @@
 #include "of_message_modify_flow.h"
+#include "of_flow_mod_template.h"
 using namespace std;
 
 // constructor
@@ -19,6 +20,8 @@ void of_message_modify_flow::clear() {
 	flag_send_flow_removal_message = false;
 	flag_check_overlap = false;
 	flag_emergency_flow = false;
+	serialization_template.reset();
+	template_shape_known = false;
 }
 
 // generates a readable form of the message
@@ -89,6 +92,17 @@ string of_message_modify_flow::to_string() const {
 // serializes the message
 uint32_t of_message_modify_flow::serialize(autobuf& dest) const {
 
+	// rules of the template's shape are copied from it and patched
+	if (serialization_template != nullptr) {
+		if (template_shape_known) {
+			return serialization_template->instantiate(*this, dest);
+		}
+		uint32_t result = serialization_template->serialize(*this, dest);
+		if (result > 0) {
+			return result;
+		}
+	}
+
 	uint32_t size_required;
 	uint32_t action_list_size = flow_description.action_list.get_serialization_size();
 	size_required = sizeof(struct ofp_flow_mod) + action_list_size;
@@ -133,12 +147,12 @@ uint32_t of_message_modify_flow::serialize(autobuf& dest) const {
 // deserializes the message
 bool of_message_modify_flow::deserialize(const autobuf& input) {
 	const struct ofp_flow_mod* header = (const struct ofp_flow_mod*) input.get_content_ptr();
-	autobuf match_struct;
+	autobuf match_struct, actions;
 	uint16_t cmd, flags;
 
 	clear();
 	bool status = of_message::deserialize(input);
-	if (!status || input.size() < sizeof(struct ofp_match) || msg_type != OFPT_FLOW_MOD)
+	if (!status || input.size() < sizeof(struct ofp_flow_mod) || msg_type != OFPT_FLOW_MOD)
 		goto fail;
 
 	match_struct.inherit_read_only(&header->match, sizeof(struct ofp_match));
@@ -148,7 +162,7 @@ bool of_message_modify_flow::deserialize(const autobuf& input) {
 		goto fail;
 	}
 
-	flow_description.cookie = header->cookie;
+	flow_description.cookie = be64toh(header->cookie);
 	
 	cmd = ntohs(header->command);
 	switch (cmd)	{
@@ -184,7 +198,12 @@ bool of_message_modify_flow::deserialize(const autobuf& input) {
 	flag_check_overlap = (flags & (uint16_t) OFPFF_CHECK_OVERLAP) > 0;
 	flag_emergency_flow = (flags & (uint16_t) OFPFF_EMERG) > 0;
 
-	// action lists not generated for incoming packets
+	// the action list follows the fixed header (only the switch emulator
+	// receives flow mods)
+	actions.inherit_read_only(input.ptr_offset_const(sizeof(struct ofp_flow_mod)), input.size() - sizeof(struct ofp_flow_mod));
+	if (!flow_description.action_list.deserialize(actions)) {
+		goto fail;
+	}
 	return true;
 
 fail:
@@ -5,11 +5,14 @@
 #endif
 
 #include <inttypes.h>
+#include <memory>
 #include <vector>
 #include "of_message.h"
 #include "../ironstack_types/openflow_flow_description.h"
 
 using namespace std;
+class of_flow_mod_template;
+
 class of_message_modify_flow : public of_message {
 public:
 
@@ -33,6 +36,12 @@ public:
 	bool						flag_check_overlap;
 	bool						flag_emergency_flow;
 
+	// if set, the message is serialized by patching the template (when it has
+	// the template's shape). template_shape_known is set by callers that built
+	// the message to the template's shape, and skips the check
+	shared_ptr<const of_flow_mod_template> serialization_template;
+	bool						template_shape_known;
+
 	// serialization functions
 	virtual uint32_t serialize(autobuf& dest) const;
 	virtual bool deserialize(const autobuf& input);
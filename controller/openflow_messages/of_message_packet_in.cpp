@@ -15,6 +15,7 @@ void of_message_packet_in::clear() {
 	reason_no_match = false;
 	reason_action = false;
 	pkt_data.clear();
+	trace.clear();
 }
 
 // generates a user-readable debug string
@@ -59,10 +60,30 @@ string of_message_packet_in::to_string() const {
 	return result;
 }
 
-// should never be called -- controller never sends this message type
+// serializes the message (used by the switch emulator)
 uint32_t of_message_packet_in::serialize(autobuf& dest) const {
-	abort();
-	return 0;
+
+	// ofp_packet_in ends with two bytes of padding overlapping the data
+	uint32_t header_size = sizeof(struct ofp_packet_in)-2;
+	uint32_t size_required = header_size + pkt_data.size();
+	dest.create_empty_buffer(size_required, false);
+	struct ofp_packet_in* hdr = (struct ofp_packet_in*) dest.get_content_ptr_mutable();
+
+	hdr->header.version = version;
+	hdr->header.type = (uint8_t) OFPT_PACKET_IN;
+	hdr->header.length = htons(size_required);
+	hdr->header.xid = htonl(xid);
+
+	hdr->buffer_id = htonl(buffer_id);
+	hdr->total_len = htons(summarized ? actual_message_len : pkt_data.size());
+	hdr->in_port = htons(in_port);
+	hdr->reason = (uint8_t) (reason_action ? OFPR_ACTION : OFPR_NO_MATCH);
+	hdr->pad = 0;
+
+	if (pkt_data.size() > 0) {
+		pkt_data.memcpy_to(dest.ptr_offset_mutable(header_size), pkt_data.size());
+	}
+	return size_required;
 }
 
 // deserializes the raw data into this message type
@@ -77,7 +98,7 @@ bool of_message_packet_in::deserialize(const autobuf& input) {
 	}
 
 	// sanity check the message type
-	if (msg_type != OFPT_PACKET_IN) {
+	if (msg_type != OFPT_PACKET_IN || input.size() < sizeof(struct ofp_packet_in)-2) {
 		goto fail;
 	}
 	#endif
@@ -92,7 +113,10 @@ bool of_message_packet_in::deserialize(const autobuf& input) {
 		reason_action = true;
 	}
 
-	pkt_data.set_content((void*)input.ptr_offset_const(sizeof(struct ofp_packet_in)-2), actual_message_len);
+	// the frame is refcounted so that it can be passed on and queued without
+	// further copies. it is shorter than total_len if the switch truncated it
+	pkt_data = input.slice(sizeof(struct ofp_packet_in)-2,
+		min<uint32_t>(actual_message_len, input.size() - (sizeof(struct ofp_packet_in)-2)));
 
 	if (pkt_data.size() != actual_message_len) {
 		summarized = true;
@@ -10,6 +10,29 @@
 using namespace std;
 class raw_packet;
 
+// cycle_clock timestamps of a packet_in sampled for latency tracing (see
+// packet_in_latency). all zero if the packet is not sampled.
+class packet_in_trace {
+public:
+	packet_in_trace() {
+		clear();
+	}
+
+	void clear() {
+		read = framed = decoded = dispatched = dequeued = 0;
+	}
+
+	bool is_sampled() const {
+		return read != 0;
+	}
+
+	uint64_t  read;         // openflow header read from the socket
+	uint64_t  framed;       // full message read from the socket
+	uint64_t  decoded;      // deserialized by of_message_factory
+	uint64_t  dispatched;   // handed to the packet_in processor by the hal
+	uint64_t  dequeued;     // picked up by a packet_in processor thread
+};
+
 // defines the class for an incoming message
 class of_message_packet_in : public of_message {
 public:
@@ -34,6 +57,7 @@ public:
 	bool      reason_no_match;
 	bool      reason_action;
 	autobuf   pkt_data;
+	packet_in_trace trace;
 
 	// inherited from serializable class
 	virtual uint32_t serialize(autobuf& dest) const;
@@ -14,6 +14,7 @@ void of_message_packet_out::clear() {
 	in_port = 0;
 
 	action_list.clear();
+	serialized_actions.clear();
 	packet_data.clear();
 }
 
@@ -39,7 +40,7 @@ string of_message_packet_out::to_string() const {
 // serializes the message
 uint32_t of_message_packet_out::serialize(autobuf& dest) const {
 
-	uint32_t action_list_len = action_list.get_serialization_size();
+	uint32_t action_list_len = (serialized_actions.size() > 0 ? serialized_actions.size() : action_list.get_serialization_size());
 	uint32_t size_required = sizeof(struct ofp_packet_out) + action_list_len + packet_data.size();
 
 	dest.clear();
@@ -59,9 +60,13 @@ uint32_t of_message_packet_out::serialize(autobuf& dest) const {
 	}
 
 	hdr->actions_len = htons(action_list_len);
-	autobuf action_buf;
-	action_buf.inherit_shared(dest.ptr_offset_mutable(sizeof(struct ofp_packet_out)), action_list_len);
-	action_list.serialize(action_buf);
+	if (serialized_actions.size() > 0) {
+		serialized_actions.memcpy_to(dest.ptr_offset_mutable(sizeof(struct ofp_packet_out)), action_list_len);
+	} else {
+		autobuf action_buf;
+		action_buf.inherit_shared(dest.ptr_offset_mutable(sizeof(struct ofp_packet_out)), action_list_len);
+		action_list.serialize(action_buf);
+	}
 
 	if (packet_data.size() > 0) {
 		packet_data.memcpy_to(dest.ptr_offset_mutable(sizeof(struct ofp_packet_out) + action_list_len), packet_data.size());
@@ -71,8 +76,41 @@ uint32_t of_message_packet_out::serialize(autobuf& dest) const {
 	return size_required;
 }
 
-// should not be called
+// deserializes the message (used by the switch emulator)
 bool of_message_packet_out::deserialize(const autobuf& input) {
-	abort();
+	const struct ofp_packet_out* hdr = (const struct ofp_packet_out*) input.get_content_ptr();
+	uint32_t action_list_len = 0;
+	autobuf action_buf;
+
+	clear();
+	bool status = of_message::deserialize(input);
+
+	#ifndef __NO_OPENFLOW_SAFETY_CHECKS
+	if (!status || msg_type != OFPT_PACKET_OUT || input.size() < sizeof(struct ofp_packet_out)) {
+		goto fail;
+	}
+	#endif
+
+	buffer_id = ntohl(hdr->buffer_id);
+	in_port = ntohs(hdr->in_port);
+	use_port = (in_port != (uint16_t) OFPP_NONE);
+
+	action_list_len = ntohs(hdr->actions_len);
+	if (sizeof(struct ofp_packet_out) + action_list_len > input.size()) {
+		goto fail;
+	}
+	action_buf.inherit_read_only(input.ptr_offset_const(sizeof(struct ofp_packet_out)), action_list_len);
+	if (!action_list.deserialize(action_buf)) {
+		goto fail;
+	}
+
+	if (sizeof(struct ofp_packet_out) + action_list_len < input.size()) {
+		packet_data = input.slice(sizeof(struct ofp_packet_out) + action_list_len,
+			input.size() - sizeof(struct ofp_packet_out) - action_list_len);
+	}
+	return true;
+
+fail:
+	clear();
 	return false;
 }
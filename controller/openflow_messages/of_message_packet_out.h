@@ -21,6 +21,7 @@ public:
 	uint16_t             in_port;	
 
 	openflow_action_list action_list;
+	autobuf              serialized_actions;  // if set, sent instead of action_list
 	autobuf              packet_data;
 
 	// serialization functions
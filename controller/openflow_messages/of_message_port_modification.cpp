@@ -66,8 +66,22 @@ uint32_t of_message_port_modification::serialize(autobuf& dest) const {
 	return sizeof(struct ofp_port_mod);
 }
 
-// should not be called
+// deserializes the message (used by the switch emulator)
 bool of_message_port_modification::deserialize(const autobuf& input) {
-	abort();
-	return false;
+	const struct ofp_port_mod* hdr = (const struct ofp_port_mod*) input.get_content_ptr();
+	bool status = of_message::deserialize(input);
+
+	#ifndef __NO_OPENFLOW_SAFETY_CHECKS
+	if (!status || msg_type != OFPT_PORT_MOD || input.size() < sizeof(struct ofp_port_mod)) {
+		clear();
+		return false;
+	}
+	#endif
+
+	port_no = ntohs(hdr->port_no);
+	port_mac_address.set_from_network_buffer(hdr->hw_addr);
+	new_config.set(ntohl(hdr->config));
+	change_features = (hdr->advertise != 0);
+	features.set(ntohl(hdr->advertise));
+	return true;
 }
@@ -39,8 +39,18 @@ uint32_t of_message_queue_get_config_request::serialize(autobuf& dest) const {
 	return sizeof(struct ofp_queue_get_config_request);
 }
 
-// should never be called
+// deserializes the message (used by the switch emulator)
 bool of_message_queue_get_config_request::deserialize(const autobuf& input) {
-	abort();
-	return false;
+	const struct ofp_queue_get_config_request* hdr = (const struct ofp_queue_get_config_request*) input.get_content_ptr();
+	bool status = of_message::deserialize(input);
+
+	#ifndef __NO_OPENFLOW_SAFETY_CHECKS
+	if (!status || msg_type != OFPT_QUEUE_GET_CONFIG_REQUEST || input.size() < sizeof(struct ofp_queue_get_config_request)) {
+		clear();
+		return false;
+	}
+	#endif
+
+	port = ntohs(hdr->port);
+	return true;
 }
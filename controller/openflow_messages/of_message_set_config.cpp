@@ -74,8 +74,35 @@ uint32_t of_message_set_config::serialize(autobuf& dest) const {
 	return sizeof(struct ofp_switch_config);
 }
 
-// should never be called -- switches don't send this message
+// deserializes the message (used by the switch emulator)
 bool of_message_set_config::deserialize(const autobuf& input) {
-	abort();
+	const struct ofp_switch_config* hdr = (const struct ofp_switch_config*) input.get_content_ptr();
+	bool status = of_message::deserialize(input);
+
+	if (!status || msg_type != OFPT_SET_CONFIG || input.size() < sizeof(struct ofp_switch_config)) {
+		goto fail;
+	}
+
+	switch (ntohs(hdr->flags)) {
+		case 0:
+			frag_normal = true;
+			break;
+		case 1:
+			frag_drop = true;
+			break;
+		case 2:
+			frag_reasm = true;
+			break;
+		case 3:
+			frag_mask = true;
+			break;
+		default:
+			goto fail;
+	}
+	max_msg_send_len = ntohs(hdr->miss_send_len);
+	return true;
+
+fail:
+	clear();
 	return false;
 }
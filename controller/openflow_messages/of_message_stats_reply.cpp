@@ -2,6 +2,27 @@
 #include "../gui/output.h"
 using namespace std;
 
+// writes a stats reply header followed by an already serialized body
+uint32_t of_message_stats_reply::serialize_reply(autobuf& dest, uint16_t type, bool more_to_follow, const autobuf& body) const {
+
+	uint32_t size_required = sizeof(struct ofp_stats_reply) + body.size();
+	dest.create_empty_buffer(size_required, false);
+	struct ofp_stats_reply* hdr = (struct ofp_stats_reply*) dest.get_content_ptr_mutable();
+
+	hdr->header.version = version;
+	hdr->header.type = (uint8_t) OFPT_STATS_REPLY;
+	hdr->header.length = htons(size_required);
+	hdr->header.xid = htonl(xid);
+
+	hdr->type = htons(type);
+	hdr->flags = htons(more_to_follow ? 0x0001 : 0);
+	if (body.size() > 0) {
+		memcpy(hdr->body, body.get_content_ptr(), body.size());
+	}
+
+	return size_required;
+}
+
 // constructor
 of_message_stats_reply_switch_description::of_message_stats_reply_switch_description() {
 	clear();
@@ -30,11 +51,11 @@ string of_message_stats_reply_switch_description::to_string() const {
 	return result;
 }
 
-// should not be called (if you just want to serialize the description,
-// call description.serialize())
+// serializes the message (used by the switch emulator)
 uint32_t of_message_stats_reply_switch_description::serialize(autobuf& dest) const {
-	abort();
-	return 0;
+	autobuf body;
+	description.serialize(body);
+	return serialize_reply(dest, (uint16_t) OFPST_DESC, more_to_follow, body);
 }
 
 // deserializes the message into a usable form
@@ -104,11 +125,14 @@ string of_message_stats_reply_flow_stats::to_string() const {
 	return result;
 }
 
-// should not be called. if you wish to serialize the flow description and stats,
-// call the serialize() function on each flow
+// serializes the message (used by the switch emulator)
 uint32_t of_message_stats_reply_flow_stats::serialize(autobuf& dest) const {
-	abort();
-	return 0;
+	autobuf body, one_flow;
+	for (const auto& flow : flow_stats) {
+		flow.serialize(one_flow);
+		body.append(one_flow.get_content_ptr(), one_flow.size());
+	}
+	return serialize_reply(dest, (uint16_t) OFPST_FLOW, more_to_follow, body);
 }
 
 // deserializes the message into a usable form
@@ -205,11 +229,11 @@ string of_message_stats_reply_aggregate_stats::to_string() const {
 	return result;
 }
 
-// should not be called. if you wish to serialize aggregate stats, call the serialize
-// function directly on the aggregate_stats object.
+// serializes the message (used by the switch emulator)
 uint32_t of_message_stats_reply_aggregate_stats::serialize(autobuf& dest) const {
-	abort();
-	return 0;
+	autobuf body;
+	aggregate_stats.serialize(body);
+	return serialize_reply(dest, (uint16_t) OFPST_AGGREGATE, more_to_follow, body);
 }
 
 // deserializes the message into a usable form
@@ -278,10 +302,14 @@ string of_message_stats_reply_table_stats::to_string() const {
 	return result;
 }
 
-// should not be called
+// serializes the message (used by the switch emulator)
 uint32_t of_message_stats_reply_table_stats::serialize(autobuf& dest) const {
-	abort();
-	return 0;
+	autobuf body, one_table;
+	for (const auto& table : table_stats) {
+		table.serialize(one_table);
+		body.append(one_table.get_content_ptr(), one_table.size());
+	}
+	return serialize_reply(dest, (uint16_t) OFPST_TABLE, more_to_follow, body);
 }
 
 // deserializes the message into a usable form
@@ -369,11 +397,14 @@ string of_message_stats_reply_port_stats::to_string() const {
 	return result;
 }
 
-// should not be called. if you wish to serialize the port stats, call the serialize
-// function directly on the object itself.
+// serializes the message (used by the switch emulator)
 uint32_t of_message_stats_reply_port_stats::serialize(autobuf& dest) const {
-	abort();
-	return 0;
+	autobuf body, one_port;
+	for (const auto& port : port_stats) {
+		port.serialize(one_port);
+		body.append(one_port.get_content_ptr(), one_port.size());
+	}
+	return serialize_reply(dest, (uint16_t) OFPST_PORT, more_to_follow, body);
 }
 
 // deserializes the message into a usable form
@@ -467,11 +498,14 @@ string of_message_stats_reply_queue_stats::to_string() const {
 	return result;
 }
 
-// should not be called. if you wish to serialize individual queue stats, call the
-// serialize function on the openflow_queue_stats object.
+// serializes the message (used by the switch emulator)
 uint32_t of_message_stats_reply_queue_stats::serialize(autobuf& dest) const {
-	abort();
-	return 0;
+	autobuf body, one_queue;
+	for (const auto& queue : queue_stats) {
+		queue.serialize(one_queue);
+		body.append(one_queue.get_content_ptr(), one_queue.size());
+	}
+	return serialize_reply(dest, (uint16_t) OFPST_QUEUE, more_to_follow, body);
 }
 
 // deserializes the message into a usable form
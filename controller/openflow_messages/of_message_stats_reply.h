@@ -34,6 +34,11 @@ public:
 	
 	virtual uint32_t serialize(autobuf& dest) const=0;
 	virtual bool deserialize(const autobuf& input)=0;
+
+protected:
+
+	// writes a stats reply header followed by an already serialized body
+	uint32_t serialize_reply(autobuf& dest, uint16_t type, bool more_to_follow, const autobuf& body) const;
 };
 
 
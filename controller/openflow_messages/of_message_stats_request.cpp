@@ -37,10 +37,15 @@ uint32_t of_message_stats_request_switch_description::serialize(autobuf& dest) c
 	return sizeof(struct ofp_stats_request);
 }
 
-// should not be called
+// deserializes the message (used by the switch emulator)
 bool of_message_stats_request_switch_description::deserialize(const autobuf& input) {
-	abort();
-	return false;
+	const struct ofp_stats_request* hdr = (const struct ofp_stats_request*) input.get_content_ptr();
+	if (!of_message::deserialize(input) || msg_type != OFPT_STATS_REQUEST || input.size() < sizeof(struct ofp_stats_request)
+		|| ntohs(hdr->type) != OFPST_DESC) {
+		clear();
+		return false;
+	}
+	return true;
 }
 
 // constructor
@@ -112,9 +117,31 @@ uint32_t of_message_stats_request_flow_stats::serialize(autobuf& dest) const {
 	return size_required;
 }
 
-// should not be called
+// deserializes the message (used by the switch emulator)
 bool of_message_stats_request_flow_stats::deserialize(const autobuf& input) {
-	abort();
+	const struct ofp_stats_request* hdr = (const struct ofp_stats_request*) input.get_content_ptr();
+	const struct ofp_flow_stats_request* request = (const struct ofp_flow_stats_request*) input.ptr_offset_const(sizeof(struct ofp_stats_request));
+	autobuf match_buf;
+
+	if (!of_message::deserialize(input) || msg_type != OFPT_STATS_REQUEST
+		|| input.size() < sizeof(struct ofp_stats_request) + sizeof(struct ofp_flow_stats_request)
+		|| ntohs(hdr->type) != OFPST_FLOW) {
+		goto fail;
+	}
+
+	match_buf.inherit_read_only(&request->match, sizeof(struct ofp_match));
+	if (!fields_to_match.deserialize(match_buf)) {
+		goto fail;
+	}
+
+	all_tables = (request->table_id == 0xff);
+	table_id = all_tables ? 0 : request->table_id;
+	out_port = ntohs(request->out_port);
+	restrict_out_port = (out_port != (uint16_t) OFPP_NONE);
+	return true;
+
+fail:
+	clear();
 	return false;
 }
 
@@ -187,9 +214,31 @@ uint32_t of_message_stats_request_aggregate_stats::serialize(autobuf& dest) cons
 	return size_required;
 }
 
-// should not be called
+// deserializes the message (used by the switch emulator)
 bool of_message_stats_request_aggregate_stats::deserialize(const autobuf& input) {
-	abort();
+	const struct ofp_stats_request* hdr = (const struct ofp_stats_request*) input.get_content_ptr();
+	const struct ofp_aggregate_stats_request* request = (const struct ofp_aggregate_stats_request*) input.ptr_offset_const(sizeof(struct ofp_stats_request));
+	autobuf match_buf;
+
+	if (!of_message::deserialize(input) || msg_type != OFPT_STATS_REQUEST
+		|| input.size() < sizeof(struct ofp_stats_request) + sizeof(struct ofp_aggregate_stats_request)
+		|| ntohs(hdr->type) != OFPST_AGGREGATE) {
+		goto fail;
+	}
+
+	match_buf.inherit_read_only(&request->match, sizeof(struct ofp_match));
+	if (!fields_to_match.deserialize(match_buf)) {
+		goto fail;
+	}
+
+	all_tables = (request->table_id == 0xff);
+	table_id = all_tables ? 0 : request->table_id;
+	out_port = ntohs(request->out_port);
+	restrict_out_port = (out_port != (uint16_t) OFPP_NONE);
+	return true;
+
+fail:
+	clear();
 	return false;
 }
 
@@ -229,10 +278,15 @@ uint32_t of_message_stats_request_table_stats::serialize(autobuf& dest) const {
 	return sizeof(struct ofp_stats_request);
 }
 
-// should not be called
+// deserializes the message (used by the switch emulator)
 bool of_message_stats_request_table_stats::deserialize(const autobuf& input) {
-	abort();
-	return false;
+	const struct ofp_stats_request* hdr = (const struct ofp_stats_request*) input.get_content_ptr();
+	if (!of_message::deserialize(input) || msg_type != OFPT_STATS_REQUEST || input.size() < sizeof(struct ofp_stats_request)
+		|| ntohs(hdr->type) != OFPST_TABLE) {
+		clear();
+		return false;
+	}
+	return true;
 }
 
 // constructor
@@ -286,10 +340,22 @@ uint32_t of_message_stats_request_port_stats::serialize(autobuf& dest) const {
 	return size_required;
 }
 
-// should not be called
+// deserializes the message (used by the switch emulator)
 bool of_message_stats_request_port_stats::deserialize(const autobuf& input) {
-	abort();
-	return false;
+	const struct ofp_stats_request* hdr = (const struct ofp_stats_request*) input.get_content_ptr();
+	const struct ofp_port_stats_request* request = (const struct ofp_port_stats_request*) input.ptr_offset_const(sizeof(struct ofp_stats_request));
+
+	if (!of_message::deserialize(input) || msg_type != OFPT_STATS_REQUEST
+		|| input.size() < sizeof(struct ofp_stats_request) + sizeof(struct ofp_port_stats_request)
+		|| ntohs(hdr->type) != OFPST_PORT) {
+		clear();
+		return false;
+	}
+
+	port = ntohs(request->port_no);
+	all_ports = (port == (uint16_t) OFPP_NONE);
+	if (all_ports) port = 0;
+	return true;
 }
 
 // constructor
@@ -355,8 +421,23 @@ uint32_t of_message_stats_request_queue_stats::serialize(autobuf& dest) const {
 	return size_required;
 }
 
-// should not be called
+// deserializes the message (used by the switch emulator)
 bool of_message_stats_request_queue_stats::deserialize(const autobuf& input) {
-	abort();
-	return false;
+	const struct ofp_stats_request* hdr = (const struct ofp_stats_request*) input.get_content_ptr();
+	const struct ofp_queue_stats_request* request = (const struct ofp_queue_stats_request*) input.ptr_offset_const(sizeof(struct ofp_stats_request));
+
+	if (!of_message::deserialize(input) || msg_type != OFPT_STATS_REQUEST
+		|| input.size() < sizeof(struct ofp_stats_request) + sizeof(struct ofp_queue_stats_request)
+		|| ntohs(hdr->type) != OFPST_QUEUE) {
+		clear();
+		return false;
+	}
+
+	port = ntohs(request->port_no);
+	all_ports = (port == (uint16_t) OFPP_ALL);
+	if (all_ports) port = 0;
+	queue_id = ntohl(request->queue_id);
+	all_queues = (queue_id == (uint32_t) OFPQ_ALL);
+	if (all_queues) queue_id = 0;
+	return true;
 }
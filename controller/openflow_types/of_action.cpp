@@ -173,7 +173,7 @@ std::string of_action_output_to_port::to_string() const {
 // generates the header for the output action
 uint32_t of_action_output_to_port::serialize(autobuf& dest) const {
 
-	dest.create_empty_buffer(sizeof(struct ofp_action_output), false);
+	dest.create_empty_buffer(sizeof(struct ofp_action_output), true);
 	struct ofp_action_output* hdr = (struct ofp_action_output*) dest.get_content_ptr_mutable();
 	hdr->type = htons((uint16_t) OFPAT_OUTPUT);
 	hdr->len = htons((uint16_t) sizeof(struct ofp_action_output));
@@ -251,7 +251,7 @@ std::string of_action_enqueue::to_string() const {
 // generates the header for the enqueue action
 uint32_t of_action_enqueue::serialize(autobuf& dest) const {
 
-	dest.create_empty_buffer(sizeof(struct ofp_action_enqueue), false);
+	dest.create_empty_buffer(sizeof(struct ofp_action_enqueue), true);
 	struct ofp_action_enqueue* hdr = (struct ofp_action_enqueue*) dest.get_content_ptr_mutable();
 
 	hdr->type = htons((uint16_t) OFPAT_ENQUEUE);
@@ -321,7 +321,7 @@ std::string of_action_set_vlan_id::to_string() const {
 
 // generates the header for the set vlan vid action
 uint32_t of_action_set_vlan_id::serialize(autobuf& dest) const {
-	dest.create_empty_buffer(sizeof(struct ofp_action_vlan_vid), false);
+	dest.create_empty_buffer(sizeof(struct ofp_action_vlan_vid), true);
 	struct ofp_action_vlan_vid* hdr = (struct ofp_action_vlan_vid*) dest.get_content_ptr_mutable();
 
 	hdr->type = htons((uint16_t) OFPAT_SET_VLAN_VID);
@@ -388,7 +388,7 @@ std::string of_action_set_vlan_pcp::to_string() const {
 // generates the header for the set vlan pcp action
 uint32_t of_action_set_vlan_pcp::serialize(autobuf& dest) const {
 
-	dest.create_empty_buffer(sizeof(struct ofp_action_vlan_pcp), false);
+	dest.create_empty_buffer(sizeof(struct ofp_action_vlan_pcp), true);
 	struct ofp_action_vlan_pcp* hdr = (struct ofp_action_vlan_pcp*) dest.get_content_ptr_mutable();
 
 	hdr->type = htons((uint16_t) OFPAT_SET_VLAN_PCP);
@@ -445,7 +445,7 @@ std::string of_action_strip_vlan::to_string() const {
 // generates the header for the action
 uint32_t of_action_strip_vlan::serialize(autobuf& dest) const {
 
-	dest.create_empty_buffer(sizeof(struct ofp_action_header), false);
+	dest.create_empty_buffer(sizeof(struct ofp_action_header), true);
 	struct ofp_action_header* hdr = (struct ofp_action_header*) dest.get_content_ptr_mutable();
 
 	hdr->type = htons((uint16_t) OFPAT_STRIP_VLAN);
@@ -506,7 +506,7 @@ std::string of_action_set_mac_address::to_string() const {
 // generates the action header
 uint32_t of_action_set_mac_address::serialize(autobuf& dest) const {
 
-	dest.create_empty_buffer(sizeof(struct ofp_action_dl_addr), false);
+	dest.create_empty_buffer(sizeof(struct ofp_action_dl_addr), true);
 	struct ofp_action_dl_addr* hdr = (struct ofp_action_dl_addr*) dest.get_content_ptr_mutable();
 
 	hdr->type = htons((uint16_t) set_src ? OFPAT_SET_DL_SRC : OFPAT_SET_DL_DST);
@@ -572,7 +572,7 @@ std::string of_action_set_ip_address::to_string() const {
 // generates the action header
 uint32_t of_action_set_ip_address::serialize(autobuf& dest) const {
 
-	dest.create_empty_buffer(sizeof(struct ofp_action_nw_addr), false);
+	dest.create_empty_buffer(sizeof(struct ofp_action_nw_addr), true);
 	struct ofp_action_nw_addr* hdr = (struct ofp_action_nw_addr*) dest.get_content_ptr_mutable();
 
 	hdr->type = htons((uint16_t) set_src ? OFPAT_SET_NW_SRC : OFPAT_SET_NW_DST);
@@ -595,7 +595,7 @@ bool of_action_set_ip_address::deserialize(const autobuf& content) {
 	uint16_t hdr_type = ntohs(hdr->type);
 	uint16_t hdr_len = ntohs(hdr->len);
 
-	if (hdr_type != ((uint16_t) OFPAT_SET_NW_SRC && hdr_type != (uint16_t) OFPAT_SET_NW_DST)
+	if ((hdr_type != (uint16_t) OFPAT_SET_NW_SRC && hdr_type != (uint16_t) OFPAT_SET_NW_DST)
 		|| hdr_len != get_deserialization_size()) {
 		clear();
 		return false;
@@ -603,8 +603,7 @@ bool of_action_set_ip_address::deserialize(const autobuf& content) {
 	#endif
 
 	set_src = (ntohs(hdr->type) == (uint16_t) OFPAT_SET_NW_SRC);
-	uint32_t raw_address = ntohl(hdr->nw_addr);
-	new_addr.set_from_network_buffer(&raw_address);
+	new_addr.set_from_network_buffer(&hdr->nw_addr);
 
 	return true;
 }
@@ -643,7 +642,7 @@ std::string of_action_set_ip_type_of_service::to_string() const {
 // generates the action header
 uint32_t of_action_set_ip_type_of_service::serialize(autobuf& dest) const {
 
-	dest.create_empty_buffer(sizeof(struct ofp_action_nw_tos), false);
+	dest.create_empty_buffer(sizeof(struct ofp_action_nw_tos), true);
 	struct ofp_action_nw_tos* hdr = (struct ofp_action_nw_tos*) dest.get_content_ptr_mutable();
 
 	hdr->type = htons((uint16_t) OFPAT_SET_NW_TOS);
@@ -712,7 +711,7 @@ std::string of_action_set_tcpudp_port::to_string() const {
 // generates the action header
 uint32_t of_action_set_tcpudp_port::serialize(autobuf& dest) const {
 
-	dest.create_empty_buffer(sizeof(struct ofp_action_tp_port), false);
+	dest.create_empty_buffer(sizeof(struct ofp_action_tp_port), true);
 	struct ofp_action_tp_port* hdr = (struct ofp_action_tp_port*) dest.get_content_ptr_mutable();
 
 	hdr->type = htons((uint16_t) (set_src_port ? OFPAT_SET_TP_SRC : OFPAT_SET_TP_DST));
@@ -735,7 +734,7 @@ bool of_action_set_tcpudp_port::deserialize(const autobuf& content) {
 	uint16_t hdr_type = ntohs(hdr->type);
 	uint16_t hdr_len = ntohs(hdr->len);
 
-	if (hdr_type != ((uint16_t) OFPAT_SET_TP_SRC && hdr_type != (uint16_t) OFPAT_SET_TP_DST)
+	if ((hdr_type != (uint16_t) OFPAT_SET_TP_SRC && hdr_type != (uint16_t) OFPAT_SET_TP_DST)
 		|| hdr_len != get_deserialization_size()) {
 		clear();
 		return false;
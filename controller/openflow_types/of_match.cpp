@@ -109,6 +109,15 @@ bool of_match::operator!=(const of_match& other) const {
 	return !(*this == other);
 }
 
+// checks if two addresses agree on all but the given number of low-order bits
+static bool ip_prefix_equal(const ip_address& addr1, const ip_address& addr2, uint8_t wildcard_lsb_count) {
+	if (wildcard_lsb_count >= 32) {
+		return true;
+	}
+	uint32_t mask = 0xffffffffU << wildcard_lsb_count;
+	return ((be32toh(addr1.get_as_be32()) ^ be32toh(addr2.get_as_be32())) & mask) == 0;
+}
+
 // check if this is subset of other
 bool of_match::operator<(const of_match& other) const {
 
@@ -152,36 +161,20 @@ bool of_match::operator<(const of_match& other) const {
 		return false;
 	}
 
-	// check ip_src wildcard
-	char addr1[4];
-	char addr2[4];
-	uint8_t prefix_size;
-	uint8_t counter;
-	if (other.wildcard_ip_src_lsb_count >= wildcard_ip_src_lsb_count) {
-		ip_src_address.get_address_network_order(addr1);
-		other.ip_src_address.get_address_network_order(addr2);
-
-		// check prefix for ip src
-		prefix_size = 32-wildcard_ip_src_lsb_count;
-		for (counter = 0; counter < prefix_size; ++counter) {
-			if ((addr1[counter/8] & (1 << (counter%8))) != (addr2[counter/8] & (1 << (counter%8)))) {
-				return false;
-			}
-		}
+	// check ip src prefix (the other match must wildcard at least as many bits)
+	if (other.wildcard_ip_src_lsb_count < wildcard_ip_src_lsb_count) {
+		return false;
+	}
+	if (!ip_prefix_equal(ip_src_address, other.ip_src_address, other.wildcard_ip_src_lsb_count)) {
+		return false;
 	}
 
-	// check ip dest wildcard
-	if (other.wildcard_ip_dest_lsb_count >= wildcard_ip_dest_lsb_count) {
-		ip_dest_address.get_address_network_order(addr1);
-		other.ip_dest_address.get_address_network_order(addr2);
-
-		// check prefix for ip src
-		prefix_size = 32-wildcard_ip_dest_lsb_count;
-		for (counter = 0; counter < prefix_size; ++counter) {
-			if ((addr1[counter/8] & (1 << (counter%8))) != (addr2[counter/8] & (1 << (counter%8)))) {
-				return false;
-			}
-		}
+	// check ip dest prefix
+	if (other.wildcard_ip_dest_lsb_count < wildcard_ip_dest_lsb_count) {
+		return false;
+	}
+	if (!ip_prefix_equal(ip_dest_address, other.ip_dest_address, other.wildcard_ip_dest_lsb_count)) {
+		return false;
 	}
 
 	// check tcpudp_src_port
@@ -477,7 +470,25 @@ string of_match::to_string() const {
 // serializes the object into a struct ofp_match
 uint32_t of_match::serialize(autobuf& dest) const {
 	dest.create_empty_buffer(sizeof(struct ofp_match), false);
-	struct ofp_match* result = (struct ofp_match*) dest.get_content_ptr_mutable();
+	get(*(struct ofp_match*) dest.get_content_ptr_mutable());
+	return sizeof(struct ofp_match);
+}
+
+// deserializes an input struct of_match and populates this object
+bool of_match::deserialize(const autobuf& input) {
+	#ifndef __NO_OPENFLOW_SAFETY_CHECKS
+	clear();
+	if (input.size() < sizeof(struct ofp_match))
+		return false;
+	#endif
+
+	set(*(const struct ofp_match*) input.get_content_ptr());
+	return true;
+}
+
+// fills in a struct ofp_match
+void of_match::get(struct ofp_match& dest) const {
+	struct ofp_match* result = &dest;
 	result->pad1[0] = 0;
 	*((uint16_t*) result->pad2) = 0;
 
@@ -517,21 +528,11 @@ uint32_t of_match::serialize(autobuf& dest) const {
 	ip_dest_address.get_address_network_order(&result->nw_dst);
 	result->tp_src = htons(tcpudp_src_port);
 	result->tp_dst = htons(tcpudp_dest_port);
-
-	return sizeof(struct ofp_match);
 }
 
-// deserializes an input struct of_match and populates this object
-bool of_match::deserialize(const autobuf& input) {
-	const struct ofp_match* header = (const struct ofp_match*) input.get_content_ptr();
-
-	#ifndef __NO_OPENFLOW_SAFETY_CHECKS
-	clear();
-	if (input.size() < sizeof(struct ofp_match))
-		return false;
-	#endif
-
-//	memcpy(&header, input.get_content_ptr(), sizeof(struct ofp_match));
+// populates this object from a struct ofp_match
+void of_match::set(const struct ofp_match& src) {
+	const struct ofp_match* header = &src;
 
 	in_port = ntohs(header->in_port);
 	ethernet_src.set_from_network_buffer(header->dl_src);
@@ -561,15 +562,13 @@ bool of_match::deserialize(const autobuf& input) {
 	if (wildcards & (uint32_t) OFPFW_NW_SRC_ALL) {
 		wildcard_ip_src_lsb_count = 32;
 	} else {
-		wildcard_ip_src_lsb_count = (wildcards & ((uint32_t) OFPFW_NW_SRC_MASK)) >> ((uint32_t) OFPFW_NW_SRC_BITS);
+		wildcard_ip_src_lsb_count = (wildcards & ((uint32_t) OFPFW_NW_SRC_MASK)) >> ((uint32_t) OFPFW_NW_SRC_SHIFT);
 	}
 	if (wildcards & (uint32_t) OFPFW_NW_DST_ALL) {
 		wildcard_ip_dest_lsb_count = 32;
 	} else {
-		wildcard_ip_dest_lsb_count = (wildcards & ((uint32_t) OFPFW_NW_DST_MASK)) >> ((uint32_t) OFPFW_NW_DST_BITS);
+		wildcard_ip_dest_lsb_count = (wildcards & ((uint32_t) OFPFW_NW_DST_MASK)) >> ((uint32_t) OFPFW_NW_DST_SHIFT);
 	}
 	wildcard_tcpudp_src_port = (wildcards & (uint32_t) OFPFW_TP_SRC) > 0;
 	wildcard_tcpudp_dest_port = (wildcards & (uint32_t) OFPFW_TP_DST) > 0;
-
-	return true;
 }
@@ -68,6 +68,10 @@ public:
 	uint32_t serialize(autobuf& dest) const;
 	bool deserialize(const autobuf& input);
 
+	// conversion to and from the wire struct
+	void get(struct ofp_match& dest) const;
+	void set(const struct ofp_match& src);
+
 	// (deprecated) generates the title for the rule set
 //	static string generate_title();
 };
@@ -0,0 +1,163 @@
+#include <arpa/inet.h>
+#include <string.h>
+#include "of_packed_match.h"
+
+// constructor
+of_packed_match::of_packed_match() {
+	set(of_match());
+}
+
+// constructor
+of_packed_match::of_packed_match(const of_match& match) {
+	set(match);
+}
+
+// constructor
+of_packed_match::of_packed_match(const struct ofp_match& wire_) {
+	set(wire_);
+}
+
+// packs an of_match
+void of_packed_match::set(const of_match& match) {
+	match.get(wire);
+	canonicalize();
+}
+
+// unpacks into an of_match
+of_match of_packed_match::get() const {
+	of_match result;
+	result.set(wire);
+	return result;
+}
+
+// copies in a match in wire format
+void of_packed_match::set(const struct ofp_match& wire_) {
+	memcpy(&wire, &wire_, sizeof(struct ofp_match));
+	canonicalize();
+}
+
+// gets the match in wire format
+const struct ofp_match& of_packed_match::get_wire() const {
+	return wire;
+}
+
+// serializes the match into a struct ofp_match
+uint32_t of_packed_match::serialize(autobuf& dest) const {
+	dest.set_content(&wire, sizeof(struct ofp_match));
+	return sizeof(struct ofp_match);
+}
+
+// deserializes a struct ofp_match
+bool of_packed_match::deserialize(const autobuf& input) {
+	#ifndef __NO_OPENFLOW_SAFETY_CHECKS
+	if (input.size() < sizeof(struct ofp_match)) {
+		set(of_match());
+		return false;
+	}
+	#endif
+
+	set(*(const struct ofp_match*) input.get_content_ptr());
+	return true;
+}
+
+// gets the wildcards field
+uint32_t of_packed_match::get_wildcards() const {
+	return ntohl(wire.wildcards);
+}
+
+// hashes the five words of the match
+uint64_t of_packed_match::get_hash() const {
+	uint64_t result = 0x9e3779b97f4a7c15ULL;
+	for (uint32_t counter = 0; counter < WORDS; ++counter) {
+		result = (result ^ words[counter]) * 0xff51afd7ed558ccdULL;
+		result ^= result >> 32;
+	}
+	return result;
+}
+
+// checks equality (wildcarded bits are always zero, so the words can be
+// compared directly)
+bool of_packed_match::operator==(const of_packed_match& other) const {
+	uint64_t difference = 0;
+	for (uint32_t counter = 0; counter < WORDS; ++counter) {
+		difference |= words[counter] ^ other.words[counter];
+	}
+	return difference == 0;
+}
+
+bool of_packed_match::operator!=(const of_packed_match& other) const {
+	return !(*this == other);
+}
+
+// check if this is subset of other: every bit the other matches must also be
+// matched here, with the same value
+bool of_packed_match::operator<(const of_packed_match& other) const {
+	uint64_t violations = 0;
+	for (uint32_t counter = 0; counter < WORDS; ++counter) {
+		violations |= (other.mask[counter] & ~mask[counter]) |
+			((words[counter] ^ other.words[counter]) & other.mask[counter]);
+	}
+	return violations == 0;
+}
+
+// generates a readable form of the match
+string of_packed_match::to_string() const {
+	return get().to_string();
+}
+
+// clamps the wildcards, rebuilds the mask and zeroes the wildcarded bits
+void of_packed_match::canonicalize() {
+	uint32_t wildcards = ntohl(wire.wildcards) & (uint32_t) OFPFW_ALL;
+	uint32_t src_bits = (wildcards & (uint32_t) OFPFW_NW_SRC_MASK) >> OFPFW_NW_SRC_SHIFT;
+	uint32_t dest_bits = (wildcards & (uint32_t) OFPFW_NW_DST_MASK) >> OFPFW_NW_DST_SHIFT;
+	src_bits = (src_bits > 32 ? 32 : src_bits);
+	dest_bits = (dest_bits > 32 ? 32 : dest_bits);
+	wildcards = (wildcards & ~((uint32_t) OFPFW_NW_SRC_MASK | (uint32_t) OFPFW_NW_DST_MASK)) |
+		(src_bits << OFPFW_NW_SRC_SHIFT) | (dest_bits << OFPFW_NW_DST_SHIFT);
+
+	// the mask has the same layout as the match
+	struct ofp_match* field_mask = (struct ofp_match*) mask;
+	memset(mask, 0xff, sizeof(mask));
+	field_mask->wildcards = 0;
+	field_mask->pad1[0] = 0;
+	field_mask->pad2[0] = 0;
+	field_mask->pad2[1] = 0;
+	if (wildcards & (uint32_t) OFPFW_IN_PORT) {
+		field_mask->in_port = 0;
+	}
+	if (wildcards & (uint32_t) OFPFW_DL_SRC) {
+		memset(field_mask->dl_src, 0, sizeof(field_mask->dl_src));
+	}
+	if (wildcards & (uint32_t) OFPFW_DL_DST) {
+		memset(field_mask->dl_dst, 0, sizeof(field_mask->dl_dst));
+	}
+	if (wildcards & (uint32_t) OFPFW_DL_VLAN) {
+		field_mask->dl_vlan = 0;
+	}
+	if (wildcards & (uint32_t) OFPFW_DL_VLAN_PCP) {
+		field_mask->dl_vlan_pcp = 0;
+	}
+	if (wildcards & (uint32_t) OFPFW_DL_TYPE) {
+		field_mask->dl_type = 0;
+	}
+	if (wildcards & (uint32_t) OFPFW_NW_TOS) {
+		field_mask->nw_tos = 0;
+	}
+	if (wildcards & (uint32_t) OFPFW_NW_PROTO) {
+		field_mask->nw_proto = 0;
+	}
+	field_mask->nw_src = htonl(src_bits >= 32 ? 0 : 0xffffffffU << src_bits);
+	field_mask->nw_dst = htonl(dest_bits >= 32 ? 0 : 0xffffffffU << dest_bits);
+	if (wildcards & (uint32_t) OFPFW_TP_SRC) {
+		field_mask->tp_src = 0;
+	}
+	if (wildcards & (uint32_t) OFPFW_TP_DST) {
+		field_mask->tp_dst = 0;
+	}
+
+	// drop everything that is not matched, then put the wildcards back
+	for (uint32_t counter = 0; counter < WORDS; ++counter) {
+		words[counter] &= mask[counter];
+	}
+	wire.wildcards = htonl(wildcards);
+}
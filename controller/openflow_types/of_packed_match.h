@@ -0,0 +1,82 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include "of_match.h"
+#include "../../common/autobuf.h"
+#include "../../common/openflow.h"
+using namespace std;
+
+// packed openflow 1.0 match
+//
+// keeps a match in the 40-byte struct ofp_match layout it has on the wire
+// (network byte order), together with a mask of the bits that are matched.
+// fields that are wildcarded, including the wildcarded low bits of nw_src and
+// nw_dst, are kept zeroed, so two matches that select the same packets are
+// byte-for-byte identical. equality is then a compare of five 64-bit words,
+// the subset check a few masked word operations, and the match can be hashed
+// and used as a key in hashed containers. converting to and from the wire is
+// a 40-byte copy.
+//
+// unlike of_match::operator==, equality ignores the bits under a wildcard (as
+// a switch does).
+//
+// the word operations are plain c++ rather than simd intrinsics. this file is
+// built with CCOPTS, which has no -march (only CCOPTSFAST and LINKOPTS use
+// -march=native), and five words are a handful of instructions either way.
+//
+// revision 1 (10/19/26)
+
+class of_packed_match {
+public:
+
+	static const uint32_t WORDS = sizeof(struct ofp_match) / sizeof(uint64_t);
+
+	// constructors (the default is the same as a default of_match)
+	of_packed_match();
+	of_packed_match(const of_match& match);
+	of_packed_match(const struct ofp_match& wire);
+
+	// conversion to and from of_match
+	void     set(const of_match& match);
+	of_match get() const;
+
+	// conversion to and from the wire
+	void     set(const struct ofp_match& wire);
+	const struct ofp_match& get_wire() const;
+	uint32_t serialize(autobuf& dest) const;
+	bool     deserialize(const autobuf& input);
+
+	// gets the wildcards field (in host order)
+	uint32_t get_wildcards() const;
+
+	// gets a 64-bit hash of the match
+	uint64_t get_hash() const;
+
+	// comparators
+	bool operator==(const of_packed_match& other) const;
+	bool operator!=(const of_packed_match& other) const;
+
+	// subset operator (returns true if every packet this match selects is also
+	// selected by the other)
+	bool operator<(const of_packed_match& other) const;
+
+	string to_string() const;
+
+	// hash functor for unordered containers
+	class hasher {
+	public:
+		size_t operator()(const of_packed_match& match) const { return match.get_hash(); }
+	};
+
+private:
+
+	union {
+		struct ofp_match wire;
+		uint64_t         words[WORDS];
+	};
+	uint64_t mask[WORDS];    // set for every matched bit (the wildcards field is left out)
+
+	// clamps the wildcards, rebuilds the mask and zeroes the wildcarded bits
+	void canonicalize();
+};
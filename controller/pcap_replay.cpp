@@ -0,0 +1,595 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include "hal/hal.h"
+#include "gui/output.h"
+#include "emulator/emulated_switch.h"
+#include "openflow_messages/of_message_packet_in.h"
+#include "services/arp.h"
+#include "services/cam.h"
+#include "services/flow_service.h"
+#include "services/flow_policy_checker.h"
+#include "services/ironstack_echo_daemon.h"
+#include "services/operational_stats.h"
+#include "services/switch_state.h"
+#include "services/dell_s48xx_acl_table.h"
+#include "services/dell_s48xx_l2_table.h"
+using namespace std;
+
+// offline pcap replay into the packet_in pipeline
+//
+// reads an ethernet pcap file, wraps every frame as a packet_in (with an
+// in_port taken from a source mac mapping) and hands it straight to the
+// packet_in_processor of a hal running the same services as the ironstack
+// executive. the flow_mods and packet_outs that the services emit travel to an
+// emulated switch on localhost that records them. frames are replayed at line
+// rate or with their original timing, and the process cpu time spent per
+// packet is reported at the end.
+//
+// by default the emulated switch keeps the flows the controller installs and
+// frames that match one are counted as switched instead of being replayed (as
+// they would never reach the controller on a real switch).
+
+// needed by the flow tables (normally defined by the ironstack executive)
+string switch_name = "pcap_replay";
+
+// one captured frame
+class capture_frame {
+public:
+	uint64_t timestamp_ns;
+	uint32_t original_len;
+	autobuf  data;
+};
+
+// minimal reader for libpcap capture files (microsecond and nanosecond
+// variants in either byte order; ethernet link type only)
+class pcap_reader {
+public:
+
+	pcap_reader():fp(nullptr), swapped(false), nanosecond(false) {}
+	~pcap_reader() { close(); }
+
+	// opens a capture file and checks its header
+	bool open(const string& filename) {
+		close();
+		fp = fopen(filename.c_str(), "rb");
+		if (fp == nullptr) {
+			printf("error: unable to open %s.\n", filename.c_str());
+			return false;
+		}
+
+		file_header_t header;
+		if (fread(&header, sizeof(header), 1, fp) != 1) {
+			printf("error: %s is too short to be a pcap file.\n", filename.c_str());
+			close();
+			return false;
+		}
+		switch (header.magic) {
+			case 0xa1b2c3d4: swapped = false; nanosecond = false; break;
+			case 0xd4c3b2a1: swapped = true;  nanosecond = false; break;
+			case 0xa1b23c4d: swapped = false; nanosecond = true;  break;
+			case 0x4d3cb2a1: swapped = true;  nanosecond = true;  break;
+			default:
+				printf("error: %s is not a pcap file (pcapng is not supported).\n", filename.c_str());
+				close();
+				return false;
+		}
+		if (get32(header.linktype) != LINKTYPE_ETHERNET) {
+			printf("error: %s has link type %u (only ethernet captures can be replayed).\n",
+				filename.c_str(), get32(header.linktype));
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	// reads the next frame. returns false at the end of the file
+	bool read(capture_frame& frame) {
+		record_header_t header;
+		if (fp == nullptr || fread(&header, sizeof(header), 1, fp) != 1) {
+			return false;
+		}
+		uint32_t captured_len = get32(header.captured_len);
+		if (captured_len > MAX_FRAME_LEN) {
+			printf("error: corrupt pcap record (%u byte frame).\n", captured_len);
+			return false;
+		}
+		frame.timestamp_ns = get32(header.ts_sec) * 1000000000ULL +
+			get32(header.ts_frac) * (nanosecond ? 1ULL : 1000ULL);
+		frame.original_len = get32(header.original_len);
+		frame.data.create_empty_buffer(captured_len, false);
+		if (captured_len > 0 && fread(frame.data.get_content_ptr_mutable(), captured_len, 1, fp) != 1) {
+			printf("error: truncated pcap record.\n");
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+		if (fp != nullptr) {
+			fclose(fp);
+			fp = nullptr;
+		}
+	}
+
+private:
+
+	static const uint32_t LINKTYPE_ETHERNET = 1;
+	static const uint32_t MAX_FRAME_LEN = 262144;
+
+	struct file_header_t {
+		uint32_t magic;
+		uint16_t version_major;
+		uint16_t version_minor;
+		int32_t  thiszone;
+		uint32_t sigfigs;
+		uint32_t snaplen;
+		uint32_t linktype;
+	};
+
+	struct record_header_t {
+		uint32_t ts_sec;
+		uint32_t ts_frac;
+		uint32_t captured_len;
+		uint32_t original_len;
+	};
+
+	uint32_t get32(uint32_t value) const {
+		return swapped ? __builtin_bswap32(value) : value;
+	}
+
+	FILE* fp;
+	bool  swapped;
+	bool  nanosecond;
+};
+
+// maps the source mac of a frame to the switch port it is replayed on
+class in_port_map {
+public:
+
+	in_port_map():num_ports(48), fixed_port(0) {}
+
+	// loads "mac port" lines ('#' starts a comment)
+	bool load(const string& filename) {
+		FILE* fp = fopen(filename.c_str(), "r");
+		if (fp == nullptr) {
+			printf("error: unable to open port map %s.\n", filename.c_str());
+			return false;
+		}
+		char line[256], mac[64];
+		unsigned int port;
+		uint32_t line_number = 0;
+		bool status = true;
+		while (fgets(line, sizeof(line), fp) != nullptr) {
+			++line_number;
+			char* comment = strchr(line, '#');
+			if (comment != nullptr) {
+				*comment = '\0';
+			}
+			if (sscanf(line, "%63s", mac) != 1) {
+				continue;
+			}
+			if (sscanf(line, "%63s %u", mac, &port) != 2 || port == 0 || port > num_ports) {
+				printf("error: %s line %u: expected \"mac port\" with a port between 1 and %u.\n",
+					filename.c_str(), line_number, num_ports);
+				status = false;
+				break;
+			}
+			ports[mac_address(string(mac)).get_as_uint64()] = (uint16_t) port;
+		}
+		fclose(fp);
+		return status;
+	}
+
+	// gets the in_port for a frame. unmapped hosts go to the fixed port if one is
+	// set, otherwise they are spread over all ports by a hash of the source mac
+	uint16_t get(const autobuf& frame) const {
+		if (frame.size() < 12) {
+			return fixed_port != 0 ? fixed_port : 1;
+		}
+		mac_address src_mac((uint8_t*) frame.ptr_offset_const(6));
+		uint64_t key = src_mac.get_as_uint64();
+		auto iterator = ports.find(key);
+		if (iterator != ports.end()) {
+			return iterator->second;
+		}
+		if (fixed_port != 0) {
+			return fixed_port;
+		}
+		key *= 0x9e3779b97f4a7c15ULL;
+		return (uint16_t) ((key >> 32) % num_ports) + 1;
+	}
+
+	uint32_t                  num_ports;
+	uint16_t                  fixed_port;
+	map<uint64_t, uint16_t>   ports;
+};
+
+// receives the flow_mods and packet_outs emitted by the services (runs on the
+// emulated switch receive thread)
+class recording_sink {
+public:
+
+	recording_sink():fp(nullptr), flow_mods(0), packet_outs(0), last_message_ns(0), start_ns(get_time_ns()) {}
+	~recording_sink() {
+		if (fp != nullptr) {
+			fclose(fp);
+		}
+	}
+
+	// records every message to a file (otherwise they are only counted)
+	bool open(const string& filename) {
+		fp = fopen(filename.c_str(), "w");
+		if (fp == nullptr) {
+			printf("error: unable to create %s.\n", filename.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	void on_flow_mod(const of_message_modify_flow& flow_mod) {
+		++flow_mods;
+		record("flow_mod", flow_mod);
+	}
+
+	void on_packet_out(const of_message_packet_out& packet_out) {
+		++packet_outs;
+		record("packet_out", packet_out);
+	}
+
+	// nanoseconds since the last message arrived
+	uint64_t get_idle_ns() const {
+		return get_time_ns() - last_message_ns;
+	}
+
+	static uint64_t get_time_ns() {
+		return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	FILE*            fp;
+	mutex            lock;
+	atomic<uint64_t> flow_mods;
+	atomic<uint64_t> packet_outs;
+	atomic<uint64_t> last_message_ns;
+
+private:
+
+	uint64_t         start_ns;
+
+	void record(const char* type, const of_message& message) {
+		uint64_t now = get_time_ns();
+		last_message_ns = now;
+		if (fp == nullptr) {
+			return;
+		}
+		lock_guard<mutex> g(lock);
+		fprintf(fp, "# %.6f %s\n%s\n\n", (now - start_ns) / 1e9, type, message.to_string().c_str());
+	}
+};
+
+// inserts a vlan tag into an untagged frame
+static void add_vlan_tag(autobuf& frame, uint16_t vlan_id) {
+	autobuf tagged;
+	tagged.create_empty_buffer(frame.size() + 4, false);
+	uint8_t* dest = (uint8_t*) tagged.get_content_ptr_mutable();
+	const uint8_t* src = (const uint8_t*) frame.get_content_ptr();
+	memcpy(dest, src, 12);
+	dest[12] = 0x81;
+	dest[13] = 0x00;
+	dest[14] = (uint8_t) (vlan_id >> 8);
+	dest[15] = (uint8_t) vlan_id;
+	memcpy(dest + 16, src + 12, frame.size() - 12);
+	frame = tagged;
+}
+
+// gets the vlan id of a tagged frame (-1 if untagged)
+static int get_frame_vlan(const autobuf& frame) {
+	if (frame.size() < 16) {
+		return -1;
+	}
+	const uint8_t* ptr = (const uint8_t*) frame.get_content_ptr();
+	if (ptr[12] != 0x81 || ptr[13] != 0x00) {
+		return -1;
+	}
+	return ((ptr[14] << 8) | ptr[15]) & 0x0fff;
+}
+
+// gets the user + system cpu time of this process in nanoseconds
+static uint64_t get_cpu_time_ns() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ULL +
+		(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ULL;
+}
+
+static void usage(const char* name) {
+	printf("usage: %s [options] [pcap file]\n"
+		"  --timing [line|original]  replay as fast as possible or with capture timing (default line)\n"
+		"  --speed [x]               speedup factor for original timing (default 1.0)\n"
+		"  --loops [n]               number of passes over the capture (default 1)\n"
+		"  --ports [n]               number of switch ports (default 48)\n"
+		"  --port-map [file]         \"mac port\" lines assigning hosts to in_ports\n"
+		"  --in-port [n]             in_port for hosts not in the port map (default: hash of the source mac)\n"
+		"  --native-vlan [n]         vlan of untagged frames (default 1)\n"
+		"  --max-pending [n]         packet_ins queued ahead of the processor at line rate (default 4096)\n"
+		"  --no-offload              replay every frame, even if it matches an installed flow\n"
+		"  --record [file]           write every flow_mod and packet_out to a file\n"
+		"  --port [n]                local openflow port for the recording switch (default 16634)\n"
+		"  --verbose                 keep the per-flow log messages\n", name);
+}
+
+int main(int argc, char** argv) {
+
+	string pcap_filename, port_map_filename, record_filename;
+	bool original_timing = false;
+	double speed = 1.0;
+	uint32_t loops = 1;
+	uint32_t max_pending = 4096;
+	uint16_t native_vlan = 1;
+	uint16_t port = 16634;
+	bool offload = true;
+	bool verbose = false;
+	in_port_map port_map;
+
+	for (int counter = 1; counter < argc; ++counter) {
+		const char* option = argv[counter];
+		if (strcmp(option, "--no-offload") == 0) {
+			offload = false;
+			continue;
+		} else if (strcmp(option, "--verbose") == 0) {
+			verbose = true;
+			continue;
+		} else if (option[0] != '-') {
+			pcap_filename = option;
+			continue;
+		}
+		if (counter+1 >= argc) {
+			usage(argv[0]);
+			return 1;
+		}
+		const char* value = argv[++counter];
+
+		bool valid = true;
+		if (strcmp(option, "--timing") == 0) {
+			valid = (strcmp(value, "line") == 0 || strcmp(value, "original") == 0);
+			original_timing = (strcmp(value, "original") == 0);
+		} else if (strcmp(option, "--speed") == 0) {
+			speed = atof(value);
+			valid = speed > 0.0;
+		} else if (strcmp(option, "--loops") == 0) {
+			loops = atoi(value);
+		} else if (strcmp(option, "--ports") == 0) {
+			port_map.num_ports = atoi(value);
+		} else if (strcmp(option, "--port-map") == 0) {
+			port_map_filename = value;
+		} else if (strcmp(option, "--in-port") == 0) {
+			port_map.fixed_port = atoi(value);
+		} else if (strcmp(option, "--native-vlan") == 0) {
+			native_vlan = atoi(value);
+		} else if (strcmp(option, "--max-pending") == 0) {
+			max_pending = atoi(value);
+		} else if (strcmp(option, "--record") == 0) {
+			record_filename = value;
+		} else if (strcmp(option, "--port") == 0) {
+			port = atoi(value);
+		} else {
+			valid = false;
+		}
+		if (!valid) {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (pcap_filename.empty() || loops == 0 || max_pending == 0 || port == 0 ||
+		port_map.num_ports == 0 || port_map.num_ports > 0xff00 || port_map.fixed_port > port_map.num_ports ||
+		native_vlan == 0 || native_vlan > 4095) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (!port_map_filename.empty() && !port_map.load(port_map_filename)) {
+		return 1;
+	}
+
+	// 1. load the capture into memory so that file i/o does not count as controller cpu
+	vector<capture_frame> frames;
+	set<uint16_t> vlans;
+	uint32_t untagged_frames = 0;
+	{
+		pcap_reader reader;
+		if (!reader.open(pcap_filename)) {
+			return 1;
+		}
+		capture_frame frame;
+		while (reader.read(frame)) {
+			if (frame.data.size() < 14) {
+				continue;
+			}
+			int vlan_id = get_frame_vlan(frame.data);
+			if (vlan_id < 0) {
+				++untagged_frames;
+			} else {
+				vlans.insert((uint16_t) vlan_id);
+			}
+			frames.push_back(frame);
+		}
+	}
+	if (frames.empty()) {
+		printf("error: no ethernet frames in %s.\n", pcap_filename.c_str());
+		return 1;
+	}
+
+	// all ports are tagged members of every vlan in the capture. untagged frames
+	// are tagged with the native vlan, unless the whole capture is untagged (then
+	// the ports are untagged members of the native vlan)
+	bool tagged_ports = !vlans.empty();
+	if (untagged_frames > 0) {
+		vlans.insert(native_vlan);
+		if (tagged_ports) {
+			for (auto& frame : frames) {
+				if (get_frame_vlan(frame.data) < 0) {
+					add_vlan_tag(frame.data, native_vlan);
+				}
+			}
+		}
+	}
+	printf("pcap replay: %zu frames (%u untagged) on %zu vlan(s) from %s.\n",
+		frames.size(), untagged_frames, vlans.size(), pcap_filename.c_str());
+
+	if (!verbose) {
+		output::set_log_level(output::loglevel::WARNING);
+	}
+
+	// 2. controller and services, set up as the ironstack executive does (without
+	// the switch database and telnet configuration)
+	shared_ptr<hal> controller(new hal());
+	shared_ptr<cam> cam_service = make_shared<cam>(controller->get_service_catalog());
+	shared_ptr<arp> arp_service = make_shared<arp>(controller->get_service_catalog());
+	shared_ptr<switch_state> sw_state = make_shared<switch_state>(controller->get_service_catalog());
+	shared_ptr<flow_service> flow_svc = make_shared<flow_service>(controller->get_service_catalog());
+	shared_ptr<ironstack::echo_daemon> echo_daemon = make_shared<ironstack::echo_daemon>(controller->get_service_catalog());
+	shared_ptr<operational_stats> op_stats = make_shared<operational_stats>(controller->get_service_catalog());
+	shared_ptr<flow_policy_checker> flow_policy_svc = make_shared<flow_policy_checker>(controller->get_service_catalog());
+	set<shared_ptr<service>> services = { cam_service, arp_service, sw_state, flow_svc, echo_daemon, op_stats, flow_policy_svc };
+
+	sw_state->set_switch_ip(ip_address("10.255.255.254"));
+	sw_state->set_name("ironstack_pcap_replay");
+	set<uint16_t> all_ports;
+	for (uint16_t counter = 1; counter <= port_map.num_ports; ++counter) {
+		all_ports.insert(counter);
+	}
+	for (const auto& vlan_id : vlans) {
+		sw_state->set_vlan_ports(all_ports, vlan_id);
+		sw_state->set_vlan_flood_ports(all_ports, vlan_id);
+		cam_service->create_cam_table(vlan_id);
+		arp_service->create_arp_table(vlan_id);
+	}
+	sw_state->set_vlan_port_tagging(all_ports, tagged_ports);
+
+	shared_ptr<dell_s48xx_l2_table> l2_table = make_shared<dell_s48xx_l2_table>();
+	shared_ptr<dell_s48xx_acl_table> acl_table = make_shared<dell_s48xx_acl_table>();
+	l2_table->set_max_capacity(10000);
+	acl_table->set_max_capacity(100);
+	flow_svc->attach_flow_table(l2_table);
+	flow_svc->attach_flow_table(acl_table);
+
+	// 3. the recording switch connects to the controller over localhost
+	atomic<bool> init_ok(false);
+	thread init_tid([&]() {
+		init_ok = controller->init(port, services, set<ip_address>{ ip_address("127.0.0.1") });
+	});
+
+	emulated_switch::config switch_settings;
+	switch_settings.num_ports = port_map.num_ports;
+	switch_settings.max_flows = 10100;
+	switch_settings.keep_flow_table = offload;
+	emulated_switch sw(switch_settings);
+	recording_sink sink;
+	if (!record_filename.empty() && !sink.open(record_filename)) {
+		_exit(1);
+	}
+	sw.set_flow_mod_observer([&](const of_message_modify_flow& flow_mod) { sink.on_flow_mod(flow_mod); });
+	sw.set_packet_out_observer([&](const of_message_packet_out& packet_out) { sink.on_packet_out(packet_out); });
+
+	bool connected = false;
+	for (int attempt = 0; attempt < 50 && !connected; ++attempt) {
+		this_thread::sleep_for(chrono::milliseconds(100));
+		connected = sw.connect("127.0.0.1", port);
+	}
+	if (!connected || !sw.start(nullptr, 0)) {
+		printf("error: the recording switch could not connect to the controller on port %hu.\n", port);
+		_exit(1);
+	}
+	init_tid.join();
+	if (!init_ok) {
+		printf("error: controller initialization failed.\n");
+		sw.shutdown();
+		return 1;
+	}
+
+	// let the startup exchange settle so it is not counted
+	while (sink.get_idle_ns() < 200000000ULL) {
+		this_thread::sleep_for(chrono::milliseconds(50));
+	}
+	uint64_t flow_mods_before = sink.flow_mods, packet_outs_before = sink.packet_outs;
+
+	// 4. replay
+	packet_in_processor* processor = controller->get_packet_processor();
+	uint64_t replayed = 0, switched = 0, truncated = 0;
+	uint64_t first_timestamp = frames.front().timestamp_ns;
+	uint64_t capture_span_ns = frames.back().timestamp_ns > first_timestamp ? frames.back().timestamp_ns - first_timestamp : 0;
+	uint64_t cpu_start = get_cpu_time_ns();
+	auto start = chrono::steady_clock::now();
+
+	for (uint32_t loop = 0; loop < loops && sw.is_connected(); ++loop) {
+		auto loop_start = chrono::steady_clock::now();
+		for (const auto& frame : frames) {
+
+			if (original_timing) {
+				uint64_t offset_ns = frame.timestamp_ns > first_timestamp ? frame.timestamp_ns - first_timestamp : 0;
+				this_thread::sleep_until(loop_start + chrono::nanoseconds((uint64_t) (offset_ns / speed)));
+			} else {
+				while (processor->get_queue_length() >= max_pending) {
+					this_thread::yield();
+				}
+			}
+
+			uint16_t in_port = port_map.get(frame.data);
+			bool reason_action = false;
+			if (offload && !sw.needs_controller(frame.data, in_port, reason_action)) {
+				++switched;
+				continue;
+			}
+
+			shared_ptr<of_message_packet_in> packet_in = make_shared<of_message_packet_in>();
+			packet_in->buffer_id = 0xffffffff;
+			packet_in->in_port = in_port;
+			packet_in->actual_message_len = (uint16_t) min<uint32_t>(frame.original_len, 0xffff);
+			packet_in->summarized = frame.data.size() < frame.original_len;
+			packet_in->reason_no_match = !reason_action;
+			packet_in->reason_action = reason_action;
+			packet_in->pkt_data = frame.data;
+			truncated += packet_in->summarized ? 1 : 0;
+			processor->enqueue_packet(packet_in);
+			++replayed;
+		}
+	}
+
+	// 5. wait until the processor queue is empty and the services stop emitting
+	while (processor->get_queue_length() > 0 || sink.get_idle_ns() < 250000000ULL) {
+		this_thread::sleep_for(chrono::milliseconds(10));
+		if (chrono::steady_clock::now() - start > chrono::seconds(3600)) {
+			break;
+		}
+	}
+	double elapsed_sec = chrono::duration<double>(chrono::steady_clock::now() - start).count() - 0.25;
+	uint64_t cpu_ns = get_cpu_time_ns() - cpu_start;
+	uint64_t flow_mods = sink.flow_mods - flow_mods_before;
+	uint64_t packet_outs = sink.packet_outs - packet_outs_before;
+
+	printf("replayed   : %" PRIu64 " packet_ins (%" PRIu64 " truncated), %" PRIu64 " frames switched by installed flows\n",
+		replayed, truncated, switched);
+	printf("emitted    : %" PRIu64 " flow_mods, %" PRIu64 " packet_outs\n", flow_mods, packet_outs);
+	printf("wall time  : %.3f s (capture spans %.3f s), %.0f packet_ins/s\n",
+		elapsed_sec, capture_span_ns / 1e9, elapsed_sec > 0.0 ? replayed / elapsed_sec : 0.0);
+	printf("cpu time   : %.3f s, %.2f us per packet_in (whole process, including the recording switch)\n",
+		cpu_ns / 1e9, replayed > 0 ? cpu_ns / 1000.0 / replayed : 0.0);
+
+	if (sink.fp != nullptr) {
+		lock_guard<mutex> g(sink.lock);
+		fflush(sink.fp);
+	}
+	fflush(stdout);
+	_exit(0);
+}
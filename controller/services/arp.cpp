@@ -1,8 +1,24 @@
+#include <algorithm>
 #include "arp.h"
+#include "cam.h"
 #include "flow_policy_checker.h"
 #include "../utils/openflow_utils.h"
 #include "../gui/output.h"
 
+// destructor. the packet processor holds registered filters by shared_ptr,
+// so the service is no longer registered here (and shared_from_this() would
+// throw); only the query state is torn down.
+arp::~arp() {
+	{
+		lock_guard<mutex> g(table_lock);
+		initialized = false;
+	}
+	stop_queries();
+	for (auto& it : arp_tables) {
+		delete it.exchange(nullptr);
+	}
+}
+
 // prepares the arp service for work before the controller is active
 bool arp::init() {
 
@@ -15,6 +31,9 @@ bool arp::init() {
 	atomic_store(&requests_forwarded, (uint32_t) 0);
 	atomic_store(&requests_serviced, (uint32_t) 0);
 	atomic_store(&requests_made, (uint32_t) 0);
+	atomic_store(&queries_suppressed_inflight, (uint32_t) 0);
+	atomic_store(&queries_suppressed_negative, (uint32_t) 0);
+	atomic_store(&queries_suppressed_rate, (uint32_t) 0);
 
 	// register packet processor. arp service must be generated by new() so enable
 	// sharing from this is OK since the creator holds the original shared_ptr
@@ -26,6 +45,13 @@ bool arp::init() {
 		return false;
 	}
 
+	// start the thread that times out asynchronous waiters
+	{
+		lock_guard<mutex> g2(query_lock);
+		timeout_thread_stop = false;
+	}
+	timeout_thread = thread(&arp::timeout_thread_entrypoint, this);
+
 	output::log(output::loglevel::INFO, "arp::init() OK service started.\n");
 	initialized = true;
 
@@ -46,12 +72,7 @@ void arp::shutdown() {
 		lock_guard<mutex> g(table_lock);
 		initialized = false;
 	}
-
-	{
-		// halt existing queries
-		lock_guard<mutex> g(query_lock);
-		pending_queries.clear();
-	}
+	stop_queries();
 
 	// unregister packet processor
 	if (processor != nullptr) {
@@ -61,72 +82,114 @@ void arp::shutdown() {
 	output::log(output::loglevel::INFO, "arp::shutdown() OK service shutdown complete.\n");
 }
 
+// stops the timeout thread, fails all waiting resolutions and drops the
+// suppression state
+void arp::stop_queries() {
+
+	// stop the timeout thread and fail all waiting resolutions
+	vector<pair<ip_address, arp_resolve_callback>> failed;
+	{
+		lock_guard<mutex> g(query_lock);
+		timeout_thread_stop = true;
+		query_cond.notify_all();
+		for (const auto& query : pending_queries) {
+			for (const auto& waiter : query.second.waiters) {
+				failed.push_back(make_pair(query.second.ip_to_query, waiter.second));
+			}
+		}
+		pending_queries.clear();
+	}
+	if (timeout_thread.joinable()) {
+		timeout_thread.join();
+	}
+	for (const auto& it : failed) {
+		it.second(it.first, mac_address());
+	}
+
+	{
+		// drop suppression state
+		lock_guard<mutex> g(suppression_lock);
+		query_states.clear();
+		query_rates.clear();
+	}
+}
+
 // creates an arp table for a specified vlan
 void arp::create_arp_table(uint16_t vlan_id) {
+	if (vlan_id >= 4096) return;
 	lock_guard<mutex> g(table_lock);
-	auto iterator = arp_tables.find(vlan_id);
-	if (iterator != arp_tables.end()) {
+	if (arp_tables[vlan_id].load() != nullptr) {
 		return;
 	} else {
-		arp_tables[vlan_id] = arp_table();
+		arp_tables[vlan_id].store(new arp_table());
 		output::log(output::loglevel::INFO, "arp_table: created ARP table for vlan id %hu.\n", vlan_id);
 	}
 }
 
 // removes an arp table
 void arp::remove_arp_table(uint16_t vlan_id) {
+	if (vlan_id >= 4096) return;
 	lock_guard<mutex> g(table_lock);
-	auto iterator = arp_tables.find(vlan_id);
-	if (iterator != arp_tables.end()) {
-		arp_tables.erase(iterator);
+	arp_table* table = arp_tables[vlan_id].exchange(nullptr);
+	if (table != nullptr) {
+		retired_tables.emplace_back(table);
 	}
 }
 
 // removes all arp tables
 void arp::remove_all_arp_tables() {
 	lock_guard<mutex> g(table_lock);
-	arp_tables.clear();
+	for (auto& it : arp_tables) {
+		arp_table* table = it.exchange(nullptr);
+		if (table != nullptr) {
+			retired_tables.emplace_back(table);
+		}
+	}
 }
 
+
 // gets the list of all vlans for the arp service
 set<uint16_t> arp::get_arp_vlans() const {
-	lock_guard<mutex> g(table_lock);
 	set<uint16_t> result;
-	for (const auto& it : arp_tables) {
-		result.insert(it.first);
+	for (uint32_t vlan_id = 0; vlan_id < 4096; ++vlan_id) {
+		if (arp_tables[vlan_id].load(memory_order_acquire) != nullptr) {
+			result.insert(vlan_id);
+		}
 	}
 	return result;
 }
 
 // clear non persistent arp entries in a vlan
 void arp::clear_arp_table(uint16_t vlan_id) {
-	lock_guard<mutex> g(table_lock);
-	auto iterator = arp_tables.find(vlan_id);
-	if (iterator != arp_tables.end()) {
-		iterator->second.clear();
+	arp_table* table = get_table(vlan_id);
+	if (table != nullptr) {
+		table->clear();
 	}
 }
 
 // clear all non persistent entries in all vlans
 void arp::clear_all_tables() {
-	lock_guard<mutex> g(table_lock);
 	for (auto& it : arp_tables) {
-		it.second.clear();
+		arp_table* table = it.load(memory_order_acquire);
+		if (table != nullptr) {
+			table->clear();
+		}
 	}
 }
 
 // insert an entry into an arp table
 void arp::insert(const mac_address& dl_address, const ip_address& nw_address,
 	uint16_t vlan_id, bool persistent) {
-	lock_guard<mutex> g(table_lock);
 
-	auto iterator = arp_tables.find(vlan_id);
-	if (iterator != arp_tables.end()) {
+	arp_table* table = get_table(vlan_id);
+	if (table != nullptr) {
 		if (persistent) {
-			iterator->second.insert_persistent(dl_address, nw_address);
+			table->insert_persistent(dl_address, nw_address);
 		} else {
-			iterator->second.insert(dl_address, nw_address);
+			table->insert(dl_address, nw_address);
 		}
+		clear_query_state(nw_address, vlan_id);
+		complete_queries(nw_address, vlan_id, dl_address);
 	} else {
 		output::log(output::loglevel::WARNING, "arp::insert() -- [%s]:[%s] not inserted (vlan %hu not found).\n",
 			dl_address.to_string().c_str(),
@@ -139,16 +202,18 @@ void arp::insert(const mac_address& dl_address, const ip_address& nw_address,
 void arp::insert_all(const mac_address& dl_address, const ip_address& nw_address,
 	bool persistent) {
 
-	output::log(output::loglevel::INFO, "arp::insert_all() -- added dl_addr [%s] <---> [%s].\n",
+	OUTPUT_LOG(INFO, "arp::insert_all() -- added dl_addr [%s] <---> [%s].\n",
 		dl_address.to_string().c_str(),
 		nw_address.to_string().c_str());
 
-	lock_guard<mutex> g(table_lock);
 	for (auto& it : arp_tables) {
-		if (persistent) {
-			it.second.insert_persistent(dl_address, nw_address);
+		arp_table* table = it.load(memory_order_acquire);
+		if (table == nullptr) {
+			continue;
+		} else if (persistent) {
+			table->insert_persistent(dl_address, nw_address);
 		} else {
-			it.second.insert(dl_address, nw_address);
+			table->insert(dl_address, nw_address);
 		}
 	}
 }
@@ -156,77 +221,82 @@ void arp::insert_all(const mac_address& dl_address, const ip_address& nw_address
 // lookup an arp entry
 ip_address arp::lookup_ip_for(const mac_address& dl_address, uint16_t vlan_id) const {
 
-	lock_guard<mutex> g(table_lock);
-	auto iterator = arp_tables.find(vlan_id);
-	if (iterator == arp_tables.end()) {
+	arp_table* table = get_table(vlan_id);
+	if (table == nullptr) {
 		return ip_address();
 	} else {
-		return iterator->second.lookup_ip_for(dl_address);
+		return table->lookup_ip_for(dl_address);
 	}
 }
 
 // lookup an arp entry
 mac_address arp::lookup_mac_for(const ip_address& nw_address, uint16_t vlan_id) const {
 
-	lock_guard<mutex> g(table_lock);
-	auto iterator = arp_tables.find(vlan_id);
-	if (iterator == arp_tables.end()) {
+	arp_table* table = get_table(vlan_id);
+	if (table == nullptr) {
 		return mac_address();
 	} else {
-		return iterator->second.lookup_mac_for(nw_address);
+		return table->lookup_mac_for(nw_address);
 	}
 }
 
 // remove an arp entry
 void arp::remove(const mac_address& dl_address, uint16_t vlan_id) {
 
-	lock_guard<mutex> g(table_lock);
-	auto iterator = arp_tables.find(vlan_id);
-	if (iterator != arp_tables.end()) {
-		iterator->second.remove(dl_address);
+	arp_table* table = get_table(vlan_id);
+	if (table != nullptr) {
+		table->remove(dl_address);
 	}
 }
 
 // remove an arp entry
 void arp::remove(const ip_address& nw_address, uint16_t vlan_id) {
 
-	lock_guard<mutex> g(table_lock);
-	auto iterator = arp_tables.find(vlan_id);
-	if (iterator != arp_tables.end()) {
-		iterator->second.remove(nw_address);
+	arp_table* table = get_table(vlan_id);
+	if (table != nullptr) {
+		table->remove(nw_address);
 	}
 }
 
 // remove an arp entry from all tables
 void arp::remove_all(const mac_address& dl_address) {
 
-	lock_guard<mutex> g(table_lock);
 	for (auto& it : arp_tables) {
-		it.second.remove(dl_address);
+		arp_table* table = it.load(memory_order_acquire);
+		if (table != nullptr) {
+			table->remove(dl_address);
+		}
 	}
 }
 
 // remove an arp entry from all tables
 void arp::remove_all(const ip_address& nw_address) {
-	lock_guard<mutex> g(table_lock);
 	for (auto& it : arp_tables) {
-		it.second.remove(nw_address);
+		arp_table* table = it.load(memory_order_acquire);
+		if (table != nullptr) {
+			table->remove(nw_address);
+		}
 	}
 }
 
 // get a copy of the arp table for a given vlan
 vector<arp_entry> arp::get_arp_table(uint16_t vlan_id) const {
-	lock_guard<mutex> g(table_lock);
-	auto iterator = arp_tables.find(vlan_id);
-	if (iterator != arp_tables.end()) {
-		return iterator->second.get_arp_table();
+	arp_table* table = get_table(vlan_id);
+	if (table != nullptr) {
+		return table->get_arp_table();
 	} else {
 		return vector<arp_entry>();
 	}
 }
 
+// returns the table for a vlan, or nullptr if there is none
+arp_table* arp::get_table(uint16_t vlan_id) const {
+	if (vlan_id >= 4096) return nullptr;
+	return arp_tables[vlan_id].load(memory_order_acquire);
+}
+
 // sends an ARP query (floods all stp ports)
-void arp::send_arp_query(const ip_address& dest, uint16_t vlan_id) {
+void arp::send_arp_query(const ip_address& dest, uint16_t vlan_id, bool bypass_negative_cache) {
 
 	if (!initialized) {
 		output::log(output::loglevel::ERROR, "arp::send_arp_query() -- arp service not initialized.\n");
@@ -256,6 +326,11 @@ void arp::send_arp_query(const ip_address& dest, uint16_t vlan_id) {
 		return;
 	}
 
+	// hold back repeated queries for the same address
+	if (!admit_query(dest, vlan_id, bypass_negative_cache)) {
+		return;
+	}
+
 	// synthesize ARP request
 	arp_packet query;
 	query.src_mac = switch_mac;
@@ -289,39 +364,156 @@ mac_address arp::send_arp_query_blocking(const ip_address& dest_ip, uint16_t vla
 		return mac_address();
 	}
 
-	// setup new entry/retrieve existing entry for query
-	shared_ptr<pending_query_t> query;
+	// wait on an asynchronous resolution. the timeout thread guarantees that
+	// the callback runs, but the wait is bounded as well in case of shutdown.
+	class blocking_result_t {
+	public:
+		blocking_result_t():done(false) {}
+		mutex              lock;
+		condition_variable cond;
+		bool               done;
+		mac_address        result_mac;
+	};
+	shared_ptr<blocking_result_t> result(new blocking_result_t());
+
+	resolve(dest_ip, vlan_id, [result](const ip_address& ip, const mac_address& mac) {
+		lock_guard<mutex> g(result->lock);
+		result->result_mac = mac;
+		result->done = true;
+		result->cond.notify_all();
+	}, timeout_ms);
+
+	unique_lock<mutex> m(result->lock);
+	result->cond.wait_for(m, chrono::milliseconds(timeout_ms + 100), [&result]() { return result->done; });
+	return result->result_mac;
+}
+
+// resolves an address without blocking the caller
+void arp::resolve(const ip_address& dest_ip, uint16_t vlan_id, const arp_resolve_callback& callback, int timeout_ms) {
+
+	if (!initialized || timeout_ms < 0) {
+		callback(dest_ip, mac_address());
+		return;
+	}
+
+	// fast path: already known
+	mac_address known = lookup_mac_for(dest_ip, vlan_id);
+	if (!known.is_nil()) {
+		callback(dest_ip, known);
+		return;
+	}
+
+	add_waiter(dest_ip, vlan_id, callback, timeout_ms);
+}
+
+// registers a waiter for an address that was not in the table
+void arp::add_waiter(const ip_address& dest_ip, uint16_t vlan_id, const arp_resolve_callback& callback, int timeout_ms) {
+
+	// register the waiter. waiters on the same address share one query, and
+	// only the first one may bypass the negative cache. the table is checked
+	// again under query_lock: insert() updates the table before it completes
+	// waiters under the same lock, so a mapping learned since the caller's
+	// lookup is either seen here or completes this waiter.
+	mac_address known;
+	bool first_waiter = false;
+	bool negative = false;
+	{
+		lock_guard<mutex> g(query_lock);
+		known = lookup_mac_for(dest_ip, vlan_id);
+		if (known.is_nil()) {
+			uint64_t key = (((uint64_t) vlan_id) << 32) | dest_ip.get_as_be32();
+			first_waiter = (pending_queries.find(key) == pending_queries.end());
+			negative = is_negatively_cached(dest_ip, vlan_id, first_waiter);
+			if (!negative) {
+				pending_query_t& query = pending_queries[key];
+				query.ip_to_query = dest_ip;
+				query.vlan_id = vlan_id;
+				query.waiters.push_back(make_pair(chrono::steady_clock::now() + chrono::milliseconds(timeout_ms), callback));
+				query_cond.notify_all();
+			}
+		}
+	}
+
+	// learned in the meantime
+	if (!known.is_nil()) {
+		callback(dest_ip, known);
+		return;
+	}
+
+	// negatively cached: fail fast instead of waiting out the timeout
+	if (negative) {
+		queries_suppressed_negative++;
+		callback(dest_ip, mac_address());
+		return;
+	}
+
+	// send the query request (suppressed if one is already in flight)
+	send_arp_query(dest_ip, vlan_id, first_waiter);
+}
+
+// dispatches the result of a query to all of its waiters
+void arp::complete_queries(const ip_address& dest, uint16_t vlan_id, const mac_address& result) {
+
+	pending_query_t query;
 	{
 		lock_guard<mutex> g(query_lock);
-		auto iterator = pending_queries.find(dest_ip);
+		auto iterator = pending_queries.find((((uint64_t) vlan_id) << 32) | dest.get_as_be32());
 		if (iterator == pending_queries.end()) {
-			query = shared_ptr<pending_query_t>(new pending_query_t());
-			query->ip_to_query = dest_ip;
-			pending_queries[dest_ip] = query;
-			
-		} else {
-			query = iterator->second;
+			return;
 		}
+		query = move(iterator->second);
+		pending_queries.erase(iterator);
 	}
 
-	// send the query request
-	send_arp_query(dest_ip, vlan_id);
+	OUTPUT_LOG(VERBOSE, "arp::complete_queries() -- [%s] resolved for %lu waiter(s).\n",
+		dest.to_string().c_str(), query.waiters.size());
+	for (const auto& waiter : query.waiters) {
+		waiter.second(dest, result);
+	}
+}
 
-	// wait until query is complete or timed out
-	unique_lock<mutex> m(query->lock);
-	query->cond.wait_for(m, chrono::milliseconds(timeout_ms));
-	if (!query->status) {
-		{
-			lock_guard<mutex> g(query_lock);
-			auto iterator = pending_queries.find(dest_ip);
-			if (iterator != pending_queries.end()) {
-				pending_queries.erase(iterator);
+// times out waiters of queries that were not answered
+void arp::timeout_thread_entrypoint() {
+
+	unique_lock<mutex> g(query_lock);
+	while (!timeout_thread_stop) {
+
+		// collect expired waiters and find the next deadline
+		auto now = chrono::steady_clock::now();
+		auto next_deadline = now + chrono::seconds(1);
+		vector<pair<ip_address, arp_resolve_callback>> expired;
+
+		auto iterator = pending_queries.begin();
+		while (iterator != pending_queries.end()) {
+			auto& waiters = iterator->second.waiters;
+			for (auto waiter = waiters.begin(); waiter != waiters.end();) {
+				if (waiter->first <= now) {
+					expired.push_back(make_pair(iterator->second.ip_to_query, waiter->second));
+					waiter = waiters.erase(waiter);
+				} else {
+					next_deadline = min(next_deadline, waiter->first);
+					++waiter;
+				}
+			}
+
+			if (waiters.empty()) {
+				iterator = pending_queries.erase(iterator);
+			} else {
+				++iterator;
 			}
 		}
 
-		return mac_address();
-	} else {
-		return query->result_mac;
+		// run the callbacks without holding the lock
+		if (!expired.empty()) {
+			g.unlock();
+			for (const auto& it : expired) {
+				it.second(it.first, mac_address());
+			}
+			g.lock();
+			continue;
+		}
+
+		query_cond.wait_until(g, next_deadline);
 	}
 }
 
@@ -340,6 +532,131 @@ uint32_t arp::get_requests_made() const {
 	return atomic_load(&requests_made);
 }
 
+// returns the number of queries held back because one was recently sent
+uint32_t arp::get_queries_suppressed_inflight() const {
+	return atomic_load(&queries_suppressed_inflight);
+}
+
+// returns the number of queries held back because the address is negatively cached
+uint32_t arp::get_queries_suppressed_negative() const {
+	return atomic_load(&queries_suppressed_negative);
+}
+
+// returns the number of queries held back by the per-vlan rate cap
+uint32_t arp::get_queries_suppressed_rate() const {
+	return atomic_load(&queries_suppressed_rate);
+}
+
+// sets the per-vlan cap on queries sent per second
+void arp::set_max_queries_per_sec(uint32_t max) {
+	lock_guard<mutex> g(suppression_lock);
+	max_queries_per_sec = max;
+}
+
+// returns the per-vlan cap on queries sent per second
+uint32_t arp::get_max_queries_per_sec() const {
+	lock_guard<mutex> g(suppression_lock);
+	return max_queries_per_sec;
+}
+
+// decides if a query for an address may be sent now, and records it if so
+bool arp::admit_query(const ip_address& dest, uint16_t vlan_id, bool bypass_negative_cache) {
+
+	uint64_t now = get_time_ms();
+	uint64_t key = (((uint64_t) vlan_id) << 32) | dest.get_as_be32();
+	lock_guard<mutex> g(suppression_lock);
+
+	// periodically drop state that has run its course
+	if (now - last_sweep_ms >= NEGATIVE_CACHE_TTL_MS) {
+		auto iterator = query_states.begin();
+		while (iterator != query_states.end()) {
+			const query_state_t& state = iterator->second;
+			if (now >= state.next_query_ms + (state.negative ? 0 : NEGATIVE_CACHE_TTL_MS)) {
+				iterator = query_states.erase(iterator);
+			} else {
+				++iterator;
+			}
+		}
+		last_sweep_ms = now;
+	}
+
+	// backoff and negative cache. the state is worked on in a copy so that a
+	// rejected query neither creates nor changes an entry
+	query_state_t state;
+	auto iterator = query_states.find(key);
+	if (iterator != query_states.end() && !(iterator->second.negative && now >= iterator->second.next_query_ms)) {
+		state = iterator->second;
+	}
+	bool bypass = false;
+	if (now < state.next_query_ms) {
+		if (!state.negative) {
+			queries_suppressed_inflight++;
+			return false;
+		} else if (!bypass_negative_cache || state.bypassed) {
+			queries_suppressed_negative++;
+			return false;
+		}
+
+		// explicit query for a negatively cached address: allow one more try
+		// per negative period. the period itself is not extended.
+		bypass = true;
+	}
+
+	// per-vlan rate cap (token bucket holding at most one second of queries)
+	query_rate_t& rate = query_rates[vlan_id];
+	rate.tokens = min((double) max_queries_per_sec, rate.tokens + (now - rate.last_refill_ms) * max_queries_per_sec / 1000.0);
+	rate.last_refill_ms = now;
+	if (rate.tokens < 1.0) {
+		queries_suppressed_rate++;
+		return false;
+	}
+	rate.tokens -= 1.0;
+
+	// schedule the next allowed query
+	if (bypass) {
+		state.bypassed = true;
+	} else {
+		state.attempts++;
+		if (state.attempts >= MAX_QUERY_ATTEMPTS) {
+			state.negative = true;
+			state.next_query_ms = now + NEGATIVE_CACHE_TTL_MS;
+		} else {
+			state.next_query_ms = now + ((uint64_t) INITIAL_RETRY_MS << (state.attempts-1));
+		}
+	}
+	if (iterator != query_states.end()) {
+		iterator->second = state;
+	} else {
+		query_states.emplace(key, state);
+	}
+	return true;
+}
+
+// checks if queries for an address are held back by the negative cache. a
+// bypass is honoured once per negative period
+bool arp::is_negatively_cached(const ip_address& dest, uint16_t vlan_id, bool bypass_negative_cache) const {
+	uint64_t key = (((uint64_t) vlan_id) << 32) | dest.get_as_be32();
+	lock_guard<mutex> g(suppression_lock);
+	auto iterator = query_states.find(key);
+	if (iterator == query_states.end()) {
+		return false;
+	}
+	const query_state_t& state = iterator->second;
+	return state.negative && get_time_ms() < state.next_query_ms && (!bypass_negative_cache || state.bypassed);
+}
+
+// forgets the suppression state of an address once it has been resolved
+void arp::clear_query_state(const ip_address& dest, uint16_t vlan_id) {
+	uint64_t key = (((uint64_t) vlan_id) << 32) | dest.get_as_be32();
+	lock_guard<mutex> g(suppression_lock);
+	query_states.erase(key);
+}
+
+// returns a monotonic time in ms
+uint64_t arp::get_time_ms() {
+	return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 // packet_in handler for all ARP packets
 bool arp::filter_packet(const shared_ptr<of_message_packet_in>& packet, const raw_packet& raw_pkt) {
 
@@ -386,7 +703,7 @@ bool arp::filter_packet(const shared_ptr<of_message_packet_in>& packet, const ra
 	// generate the ARP packet; return if malformed
 	arp_packet arp_pkt;
 	if (!arp_pkt.deserialize(packet->pkt_data)) {
-		output::log(output::loglevel::ERROR, "arp::filter_packet() -- incoming ARP packet is malformed.\n");
+		OUTPUT_LOG_LIMITED(ERROR, "arp::filter_packet() -- incoming ARP packet is malformed.\n");
 		return false;
 	}
 
@@ -395,7 +712,7 @@ bool arp::filter_packet(const shared_ptr<of_message_packet_in>& packet, const ra
 	ip_address switch_ip_address;
 	mac_address switch_mac_address;
 	if (switch_state_svc == nullptr) {
-		output::log(output::loglevel::WARNING, "arp::filter_packet(): switch state offline; cannot get controller IP/mac.\n");
+		OUTPUT_LOG_LIMITED(WARNING, "arp::filter_packet(): switch state offline; cannot get controller IP/mac.\n");
 	} else {
 		switch_ip_address = switch_state_svc->get_switch_ip();
 		switch_mac_address = switch_state_svc->get_switch_mac();
@@ -403,7 +720,7 @@ bool arp::filter_packet(const shared_ptr<of_message_packet_in>& packet, const ra
 
 	// drop packets that cannot be looked up
 	if (arp_pkt.dest_ip.is_nil()) {
-		output::log(output::loglevel::WARNING, "arp::filter_packet() lookup failed for src [%s] dest [%s]; dest is invalid. query dropped.\n",
+		OUTPUT_LOG_LIMITED(WARNING, "arp::filter_packet() lookup failed for src [%s] dest [%s]; dest is invalid. query dropped.\n",
 			arp_pkt.src_ip.to_string().c_str(),
 			arp_pkt.dest_ip.to_string().c_str());
 		return false;
@@ -412,7 +729,7 @@ bool arp::filter_packet(const shared_ptr<of_message_packet_in>& packet, const ra
 	} else if ((!switch_ip_address.is_nil() && arp_pkt.src_ip == switch_ip_address)
 		|| (!switch_mac_address.is_nil() && arp_pkt.src_mac == switch_mac_address)) {
 
-		output::log(output::loglevel::BUG, "arp lookup: WARNING arp packet [%s] from this controller [%s]:[%s] to dest [%s]:[%s] looped!\n",
+		OUTPUT_LOG_LIMITED(BUG, "arp lookup: WARNING arp packet [%s] from this controller [%s]:[%s] to dest [%s]:[%s] looped!\n",
 			arp_pkt.arp_request ? "request" : "reply",
 			switch_ip_address.to_string().c_str(),
 			switch_mac_address.to_string().c_str(),
@@ -427,12 +744,16 @@ bool arp::filter_packet(const shared_ptr<of_message_packet_in>& packet, const ra
 		// snoopy update for the source
 		int vlan_id = ironstack::net_utils::get_vlan_from_packet(switch_state_svc, packet, raw_pkt);
 		if (vlan_id == -1 || vlan_id == 0) {
-			output::log(output::loglevel::ERROR, "arp::filter_packet() -- cannot get vlan id from packet. packet dropped.\n");
+			OUTPUT_LOG_LIMITED(ERROR, "arp::filter_packet() -- cannot get vlan id from packet. packet dropped.\n");
 			return false;
 		}
 		insert(arp_pkt.src_mac, arp_pkt.src_ip, (uint16_t) vlan_id);
 		accelerate_flow(arp_pkt.src_mac, (uint16_t) vlan_id, packet->in_port);
-		forward_packet(packet, raw_pkt);
+
+		// answer from the table instead of flooding if proxy arp allows it
+		if (!arp_pkt.arp_request || !proxy_arp_reply(packet, arp_pkt, (uint16_t) vlan_id)) {
+			forward_packet(packet, raw_pkt);
+		}
 		return true;
 
 	// if control gets here, the ARP packet was meant for the controller
@@ -441,34 +762,17 @@ bool arp::filter_packet(const shared_ptr<of_message_packet_in>& packet, const ra
 		// if this is an ARP reply, unblock waiting users and update table
 		if (!arp_pkt.arp_request) {
 
-			output::log(output::loglevel::VERBOSE, "arp lookup: local lookup for [%s] completed.\n",
+			OUTPUT_LOG(VERBOSE, "arp lookup: local lookup for [%s] completed.\n",
 			arp_pkt.src_ip.to_string().c_str());
 
 			// update ARP table
 			int vlan_id = ironstack::net_utils::get_vlan_from_packet(switch_state_svc, packet, raw_pkt);
 			if (vlan_id == -1) {
-				output::log(output::loglevel::ERROR, "arp::filter_packet() -- cannot get vlan id from packet. packet dropped.\n");
+				OUTPUT_LOG_LIMITED(ERROR, "arp::filter_packet() -- cannot get vlan id from packet. packet dropped.\n");
 				return false;
 			}
+			// anyone waiting for this result is notified by insert()
 			insert(arp_pkt.src_mac, arp_pkt.src_ip, (uint16_t) vlan_id);
-			
-			// notify anyone waiting for this result
-			shared_ptr<pending_query_t> result;
-			{
-				lock_guard<mutex> g(query_lock);
-				auto iterator = pending_queries.find(arp_pkt.src_ip);
-				if (iterator != pending_queries.end()) {
-					result = iterator->second;
-					pending_queries.erase(iterator);
-				}
-			}
-
-			if (result != nullptr) {
-				unique_lock<mutex> m(result->lock);
-				result->status = true;
-				result->result_mac = arp_pkt.src_mac;
-				result->cond.notify_all();
-			}
 
 			// TODO -- this placement might be inappropriate when the flow policy checker is moved
 			accelerate_flow(arp_pkt.src_mac, (uint16_t) vlan_id, packet->in_port);
@@ -480,12 +784,12 @@ bool arp::filter_packet(const shared_ptr<of_message_packet_in>& packet, const ra
 			// update the source address into the ARP table
 			int vlan_id = ironstack::net_utils::get_vlan_from_packet(switch_state_svc, packet, raw_pkt);
 			if (vlan_id == -1) {
-				output::log(output::loglevel::ERROR, "arp::filter_packet() -- cannot get vlan id from packet. packet dropped.\n");
+				OUTPUT_LOG_LIMITED(ERROR, "arp::filter_packet() -- cannot get vlan id from packet. packet dropped.\n");
 				return true;
 			}
 			insert(arp_pkt.src_mac, arp_pkt.src_ip, (uint16_t) vlan_id);
 
-			output::log(output::loglevel::VERBOSE, "arp: responding to ARP probe from [%s].\n",
+			OUTPUT_LOG(VERBOSE, "arp: responding to ARP probe from [%s].\n",
 				arp_pkt.src_ip.to_string().c_str());
 
 			// TODO -- this part can be optimized by keeping a premade arp response (the only thing that
@@ -512,6 +816,110 @@ bool arp::filter_packet(const shared_ptr<of_message_packet_in>& packet, const ra
 	}
 }
 
+// answers an arp request on behalf of its target. returns false if the request
+// should be flooded instead.
+bool arp::proxy_arp_reply(const shared_ptr<of_message_packet_in>& packet, const arp_packet& arp_pkt, uint16_t vlan_id) {
+
+	if (!is_proxy_arp_enabled(vlan_id)) {
+		return false;
+	}
+
+	// probes (no sender address) and gratuitous arps are used for duplicate
+	// address detection and must reach the owner of the address
+	if (arp_pkt.src_ip.is_nil() || arp_pkt.src_ip == arp_pkt.dest_ip) {
+		proxy_declined++;
+		return false;
+	}
+
+	// only answer from fresh mappings
+	arp_table* table = get_table(vlan_id);
+	if (table == nullptr) {
+		return false;
+	}
+	mac_address target_mac = table->lookup_mac_for(arp_pkt.dest_ip, atomic_load(&proxy_arp_max_age));
+	if (target_mac.is_nil()) {
+		return false;
+	}
+
+	// the sender claims the mac of the address it is asking for: conflict
+	if (target_mac == arp_pkt.src_mac) {
+		proxy_declined++;
+		return false;
+	}
+
+	// the target must be present on the switch, and not on the requester's
+	// segment (it sees the broadcast and answers itself)
+	shared_ptr<cam> cam_svc = static_pointer_cast<cam>(controller->get_service(service_catalog::service_type::CAM));
+	int target_port = (cam_svc == nullptr ? -1 : cam_svc->lookup_port_for(target_mac, vlan_id));
+	if (target_port == -1 || target_port == packet->in_port) {
+		proxy_declined++;
+		return false;
+	}
+
+	// reply as the target
+	arp_packet response;
+	response.has_vlan_tag = true;
+	response.vlan_id = vlan_id;
+	response.src_mac = target_mac;
+	response.dest_mac = arp_pkt.src_mac;
+	response.sender_mac = target_mac;
+	response.receiver_mac = arp_pkt.src_mac;
+	response.arp_request = false;
+	response.src_ip = arp_pkt.dest_ip;
+	response.dest_ip = arp_pkt.src_ip;
+	autobuf serialized_response;
+	response.serialize(serialized_response);
+
+	if (!controller->send_packet(serialized_response, packet->in_port)) {
+		return false;
+	}
+	proxy_replies++;
+	return true;
+}
+
+// enables or disables proxy arp on a vlan
+bool arp::set_proxy_arp(uint16_t vlan_id, bool enabled) {
+	if (vlan_id >= 4096) {
+		output::log(output::loglevel::ERROR, "arp::set_proxy_arp() -- invalid vlan id %u.\n", vlan_id);
+		return false;
+	}
+	uint64_t bit = ((uint64_t) 1) << (vlan_id % 64);
+	if (enabled) {
+		proxy_arp_vlans[vlan_id / 64].fetch_or(bit);
+	} else {
+		proxy_arp_vlans[vlan_id / 64].fetch_and(~bit);
+	}
+	return true;
+}
+
+// checks if proxy arp is enabled on a vlan
+bool arp::is_proxy_arp_enabled(uint16_t vlan_id) const {
+	if (vlan_id >= 4096) {
+		return false;
+	}
+	return (proxy_arp_vlans[vlan_id / 64].load(memory_order_relaxed) >> (vlan_id % 64)) & 1;
+}
+
+// sets the maximum age of a mapping used to answer on a host's behalf
+void arp::set_proxy_arp_max_age(uint32_t max_age_sec) {
+	atomic_store(&proxy_arp_max_age, max_age_sec == 0 ? 1 : max_age_sec);
+}
+
+// returns the maximum age of a mapping used to answer on a host's behalf
+uint32_t arp::get_proxy_arp_max_age() const {
+	return atomic_load(&proxy_arp_max_age);
+}
+
+// returns the number of requests answered on behalf of another host
+uint32_t arp::get_proxy_replies() const {
+	return atomic_load(&proxy_replies);
+}
+
+// returns the number of requests flooded because of a proxy arp safeguard
+uint32_t arp::get_proxy_declined() const {
+	return atomic_load(&proxy_declined);
+}
+
 // returns information about the arp service
 string arp::get_service_info() const {
 	char buf[128];
@@ -522,7 +930,18 @@ string arp::get_service_info() const {
 // returns running information about the arp service
 string arp::get_running_info() const {
 
-	return string();
+	char buf[256];
+	sprintf(buf, "queries sent: %u. suppressed: %u in flight, %u negatively cached, %u rate capped. "
+		"requests forwarded: %u, serviced: %u, proxied: %u (%u declined).",
+		get_requests_made(),
+		get_queries_suppressed_inflight(),
+		get_queries_suppressed_negative(),
+		get_queries_suppressed_rate(),
+		get_requests_forwarded(),
+		get_requests_serviced(),
+		get_proxy_replies(),
+		get_proxy_declined());
+	return string(buf);
 }
 
 // helper function to call flow policy checker that accelerates flows
@@ -1,11 +1,15 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <set>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include "arp_table.h"
 #include "../../common/dbg.h"
 #include "../../common/mac_address.h"
@@ -18,6 +22,10 @@ using namespace std;
 
 class switch_state;
 
+// continuation for asynchronous arp resolution. receives the queried address
+// and the resolved mac address (nil on timeout or service shutdown).
+typedef function<void(const ip_address&, const mac_address&)> arp_resolve_callback;
+
 // ARP service
 //
 // this class manages the ARP table of the switch
@@ -29,6 +37,32 @@ class switch_state;
 // dynamically generated ARP entries are not persistent
 // and are subject to capacity rules. static ARP entries
 // are always inserted, regardless of capacity.
+//
+// query suppression:
+// queries for the same unresolved (ip, vlan) are spaced out by exponential
+// backoff starting at INITIAL_RETRY_MS. after MAX_QUERY_ATTEMPTS unanswered
+// queries the address is negatively cached for NEGATIVE_CACHE_TTL_MS. every
+// vlan is further capped at a configurable number of queries per second.
+//
+// asynchronous resolution:
+// resolve() registers a continuation instead of parking the caller. all
+// waiters on the same (ip, vlan) share one query. only the first waiter may
+// bypass the negative cache; later ones on a negatively cached address fail
+// at once. completions are dispatched
+// when the mapping is learned (from the ARP reply path), and timeouts from a
+// service thread. send_arp_query_blocking() is built on top of resolve().
+//
+// proxy arp (optional, per vlan):
+// requests for other hosts are normally flooded. on vlans with proxy arp
+// enabled, the controller answers on the target's behalf with a unicast reply
+// if the table has a mapping refreshed within the proxy max age. requests are
+// still flooded when answering could mask a conflict: probes and gratuitous
+// arps, a target mac equal to the sender's, or a target that is not in the CAM
+// table or sits on the requester's own port (it will answer itself).
+//
+// each vlan has its own arp_table shard. shards are reached through a flat
+// array indexed by vlan id, so lookups take no lock; removed shards are kept
+// until the service is destroyed since readers may still hold them.
 
 //
 // revision 5 (2/21/15)
@@ -41,10 +75,25 @@ public:
 	arp(service_catalog* ptr):service(ptr, service_catalog::service_type::ARP, 2, 0),
 		packet_filter(packet_in_processor::priority_class::ARP),
 		initialized(false) {
-	
+
+		for (auto& table : arp_tables) {
+			atomic_store(&table, (arp_table*) nullptr);
+		}
 		atomic_store(&requests_forwarded, (uint32_t) 0);
 		atomic_store(&requests_serviced, (uint32_t) 0);
 		atomic_store(&requests_made, (uint32_t) 0);
+		atomic_store(&queries_suppressed_inflight, (uint32_t) 0);
+		atomic_store(&queries_suppressed_negative, (uint32_t) 0);
+		atomic_store(&queries_suppressed_rate, (uint32_t) 0);
+		max_queries_per_sec = DEFAULT_MAX_QUERIES_PER_SEC;
+		last_sweep_ms = 0;
+		timeout_thread_stop = false;
+		for (auto& mask : proxy_arp_vlans) {
+			atomic_store(&mask, (uint64_t) 0);
+		}
+		atomic_store(&proxy_arp_max_age, DEFAULT_PROXY_ARP_MAX_AGE_SEC);
+		atomic_store(&proxy_replies, (uint32_t) 0);
+		atomic_store(&proxy_declined, (uint32_t) 0);
 
 		controller = ptr->get_controller();
 		if (controller != nullptr) {
@@ -53,7 +102,7 @@ public:
 	}
 
 	// destructor
-	virtual        ~arp() { shutdown(); };
+	virtual        ~arp();
 
 	// startup and shutdown functions
 	virtual bool   init();
@@ -87,14 +136,43 @@ public:
 	// retrieve a copy of the arp table for a vlan id
 	vector<arp_entry> get_arp_table(uint16_t vlan_id) const;
 
-	// arp query functions
-	void           send_arp_query(const ip_address& dest, uint16_t vlan);
+	// arp query functions. queries are subject to suppression; explicit
+	// queries may bypass the negative cache once per negative period (but not
+	// backoff or rate caps).
+	void           send_arp_query(const ip_address& dest, uint16_t vlan, bool bypass_negative_cache=false);
 	mac_address    send_arp_query_blocking(const ip_address& dest_ip, uint16_t vlan, int timeout_ms=3000);
 
+	// resolves an address without blocking. the callback runs inline if the
+	// address is already known, otherwise on the thread that learns the mapping
+	// or on the timeout thread. callbacks must not block.
+	void           resolve(const ip_address& dest_ip, uint16_t vlan, const arp_resolve_callback& callback, int timeout_ms=3000);
+
 	// housekeeping information
 	uint32_t       get_requests_forwarded() const;
 	uint32_t       get_requests_serviced() const;
 	uint32_t       get_requests_made() const;
+	uint32_t       get_queries_suppressed_inflight() const;
+	uint32_t       get_queries_suppressed_negative() const;
+	uint32_t       get_queries_suppressed_rate() const;
+
+	// per-vlan cap on queries sent per second
+	void           set_max_queries_per_sec(uint32_t max);
+	uint32_t       get_max_queries_per_sec() const;
+
+	static const uint32_t INITIAL_RETRY_MS = 1000;
+	static const uint32_t MAX_QUERY_ATTEMPTS = 5;
+	static const uint32_t NEGATIVE_CACHE_TTL_MS = 30000;
+	static const uint32_t DEFAULT_MAX_QUERIES_PER_SEC = 100;
+
+	// proxy arp setup (disabled on all vlans by default)
+	bool           set_proxy_arp(uint16_t vlan_id, bool enabled);
+	bool           is_proxy_arp_enabled(uint16_t vlan_id) const;
+	void           set_proxy_arp_max_age(uint32_t max_age_sec);
+	uint32_t       get_proxy_arp_max_age() const;
+	uint32_t       get_proxy_replies() const;
+	uint32_t       get_proxy_declined() const;
+
+	static const uint32_t DEFAULT_PROXY_ARP_MAX_AGE_SEC = 30;
 
 	// packet handling functions
 	virtual bool   filter_packet(const shared_ptr<of_message_packet_in>& packet, const raw_packet& raw_pkt);
@@ -105,37 +183,98 @@ public:
 
 private:
 
-	// a class for pending queries
+	// a class for pending queries and their waiters
 	class pending_query_t {
 	public:
-		pending_query_t():status(false) {}
-
 		ip_address         ip_to_query;
-		mac_address        result_mac;
-
-		mutex              lock;
-		condition_variable cond;
-		bool               status;
+		uint16_t           vlan_id;
+		vector<pair<chrono::steady_clock::time_point, arp_resolve_callback>> waiters;
 	};
 
 
 	// service status
 	bool                             initialized;
+
+	// per-vlan tables. table_lock serializes creation and removal only.
+	// removed tables are kept until the service is destroyed, since lock-free
+	// readers may still be inside them (removal is rare).
 	mutable mutex                    table_lock;
-	mutable map<uint16_t, arp_table> arp_tables;
+	atomic<arp_table*>               arp_tables[4096];
+	vector<unique_ptr<arp_table>>    retired_tables;
 
-	// map of lookups to their timed barrier ids
+	// suppression state of an unresolved (ip, vlan)
+	class query_state_t {
+	public:
+		query_state_t():attempts(0), next_query_ms(0), negative(false), bypassed(false) {}
+
+		uint32_t           attempts;       // queries sent without a reply
+		uint64_t           next_query_ms;  // no query before this time
+		bool               negative;       // negatively cached until next_query_ms
+		bool               bypassed;       // the negative cache was bypassed this period
+	};
+
+	// per-vlan token bucket
+	class query_rate_t {
+	public:
+		query_rate_t():tokens(0), last_refill_ms(0) {}
+
+		double             tokens;
+		uint64_t           last_refill_ms;
+	};
+
+	// query suppression state (keyed by vlan << 32 | ip)
+	mutable mutex                    suppression_lock;
+	unordered_map<uint64_t, query_state_t> query_states;
+	unordered_map<uint16_t, query_rate_t>  query_rates;
+	uint32_t                         max_queries_per_sec;
+	uint64_t                         last_sweep_ms;
+
+	// pending queries (keyed by vlan << 32 | ip) and the thread that times
+	// out their waiters
 	mutable mutex                    query_lock;
-	map<ip_address, shared_ptr<pending_query_t>> pending_queries;
+	condition_variable               query_cond;
+	unordered_map<uint64_t, pending_query_t> pending_queries;
+	thread                           timeout_thread;
+	bool                             timeout_thread_stop;
 
 	// lookup counters
 	atomic<uint32_t>                 requests_forwarded;  // number of arp requests seen flowing on the switch
 	atomic<uint32_t>                 requests_serviced;   // number of arp requests replied to
 	atomic<uint32_t>                 requests_made;       // number of arp requests made by this switch
+	atomic<uint32_t>                 queries_suppressed_inflight;  // held back by retry backoff
+	atomic<uint32_t>                 queries_suppressed_negative;  // held back by the negative cache
+	atomic<uint32_t>                 queries_suppressed_rate;      // held back by the vlan rate cap
+	atomic<uint32_t>                 proxy_replies;       // requests answered on behalf of another host
+	atomic<uint32_t>                 proxy_declined;      // requests flooded by a proxy arp safeguard
+
+	// proxy arp state (one bit per vlan id)
+	atomic<uint64_t>                 proxy_arp_vlans[4096/64];
+	atomic<uint32_t>                 proxy_arp_max_age;
 
 	// cache of the original packet processor used for ARP registration
 	packet_in_processor*  processor;
 
+	// returns the table for a vlan, or nullptr (lock-free)
+	arp_table* get_table(uint16_t vlan_id) const;
+
+	// query suppression helpers
+	bool admit_query(const ip_address& dest, uint16_t vlan_id, bool bypass_negative_cache);
+	bool is_negatively_cached(const ip_address& dest, uint16_t vlan_id, bool bypass_negative_cache) const;
+	void clear_query_state(const ip_address& dest, uint16_t vlan_id);
+
+	// unit tests (services/arp_tests.cpp)
+	friend class arp_tests;
+
+	// asynchronous resolution helpers
+	void stop_queries();
+	void add_waiter(const ip_address& dest_ip, uint16_t vlan_id, const arp_resolve_callback& callback, int timeout_ms);
+	void complete_queries(const ip_address& dest, uint16_t vlan_id, const mac_address& result);
+	void timeout_thread_entrypoint();
+	static uint64_t get_time_ms();
+
+	// answers an arp request on behalf of its target if it is safe to do so
+	bool proxy_arp_reply(const shared_ptr<of_message_packet_in>& packet, const arp_packet& arp_pkt, uint16_t vlan_id);
+
 	// helper function to accelerate flows
 	bool accelerate_flow(const mac_address& src_mac, uint16_t vlan_id, uint16_t phy_port);
 	bool forward_packet(const shared_ptr<of_message_packet_in>& packet, const raw_packet& raw_pkt);
@@ -1,37 +1,67 @@
+#include <thread>
 #include "arp_table.h"
 #include "../gui/output.h"
 
 // default constructor
-arp_table::arp_table() {
-	max_capacity = 16384;
+arp_table::arp_table(uint32_t max_capacity_) {
+	max_capacity = max_capacity_;
 	timeout_sec = 14400;
-	last_search_slot = 0;
-
-//	arp_entry entry;
-	arp_mappings.reserve(max_capacity);
-	for (uint32_t counter = 0; counter < max_capacity; ++counter) {
-		arp_mappings.emplace_back(arp_entry());
-//		arp_mappings.push_back(entry);
+	num_tombstones = 0;
+	epoch = chrono::steady_clock::now();
+	atomic_store(&sequence, (uint32_t) 0);
+	atomic_store(&num_entries, (uint32_t) 0);
+
+	storage.store(allocate_storage(max_capacity));
+	free_slots.reserve(max_capacity);
+	for (uint32_t counter = max_capacity; counter > 0; --counter) {
+		free_slots.push_back(counter-1);
 	}
 }
 
 // destructor
 arp_table::~arp_table() {
+	free_storage(storage.load());
+	for (const auto& it : retired_storage) {
+		free_storage(it);
+	}
 }
 
 // sets up the table capacity
 void arp_table::set_max_capacity(uint32_t max) {
-	if (max < max_capacity) {
-		max_capacity = max;
-		do_garbage_collection();
-	} else {
-		uint32_t difference = max - max_capacity;
+	lock_guard<mutex> g(write_lock);
+	storage_t* st = storage.load(memory_order_relaxed);
+
+	// shrinking keeps the slot array and only limits new insertions
+	if (max <= st->capacity) {
 		max_capacity = max;
-		arp_mappings.reserve(max_capacity);
-		for (uint32_t counter = 0; counter < difference; ++counter) {
-			arp_mappings.push_back(arp_entry());
-		}
+		do_garbage_collection_unsafe();
+		return;
+	}
+
+	// growing copies the slots (same positions) into larger storage
+	storage_t* new_st = allocate_storage(max);
+	for (uint32_t counter = 0; counter < st->capacity; ++counter) {
+		const slot_t& from = st->slots[counter];
+		slot_t& to = new_st->slots[counter];
+		to.dl_address.store(from.dl_address.load(memory_order_relaxed), memory_order_relaxed);
+		to.nw_address.store(from.nw_address.load(memory_order_relaxed), memory_order_relaxed);
+		to.flags.store(from.flags.load(memory_order_relaxed), memory_order_relaxed);
+		to.last_updated.store(from.last_updated.load(memory_order_relaxed), memory_order_relaxed);
+		to.update_count.store(from.update_count.load(memory_order_relaxed), memory_order_relaxed);
+		to.lookup_count.store(from.lookup_count.load(memory_order_relaxed), memory_order_relaxed);
+		to.last_lookup.store(from.last_lookup.load(memory_order_relaxed), memory_order_relaxed);
 	}
+	rebuild_indices_unsafe(new_st);
+	for (uint32_t counter = max; counter > st->capacity; --counter) {
+		free_slots.push_back(counter-1);
+	}
+
+	write_begin();
+	storage.store(new_st, memory_order_release);
+	write_end();
+
+	retired_storage.push_back(st);
+	max_capacity = max;
 }
 
 // returns the max table capacity
@@ -41,118 +71,174 @@ uint32_t arp_table::get_max_capacity() const {
 
 // checks the number of table entries left
 uint32_t arp_table::get_available_capacity() const {
-	if (max_capacity <= mac_to_idx_mapping.size()) {
+	uint32_t entries = num_entries.load(memory_order_relaxed);
+	if (max_capacity <= entries) {
 		return 0;
 	} else {
-		return max_capacity - mac_to_idx_mapping.size();
+		return max_capacity - entries;
 	}
 }
 
+// returns the number of entries held (including stale ones not yet collected)
+uint32_t arp_table::size() const {
+	return num_entries.load(memory_order_relaxed);
+}
+
 // sets the arp entry timeout
 void arp_table::set_timeout(uint32_t timeout) {
-	if (timeout_sec >= timeout_sec) {
-		timeout_sec = timeout;
-	} else {
-		timeout_sec = timeout;
+	uint32_t old_timeout = timeout_sec.exchange(timeout);
+	if (timeout < old_timeout) {
 		do_garbage_collection();
 	}
-
 }
 
 // gets the arp entry timeout
 uint32_t arp_table::get_timeout() const {
-	return timeout_sec;
+	return timeout_sec.load(memory_order_relaxed);
 }
 
 // clears all entries in the arp table, perserving only the
 // persistent ones
 void arp_table::clear() {
-
-	auto iterator = mac_to_idx_mapping.begin();
-	while (iterator != mac_to_idx_mapping.end()) {
-		if (!arp_mappings[iterator->second].persistent) {
-			ip_to_idx_mapping.erase(arp_mappings[iterator->second].nw_address);
-			iterator = mac_to_idx_mapping.erase(iterator);
-		} else {
-			++iterator;
+	lock_guard<mutex> g(write_lock);
+	storage_t* st = storage.load(memory_order_relaxed);
+
+	write_begin();
+	for (uint32_t counter = 0; counter < st->capacity; ++counter) {
+		uint32_t flags = st->slots[counter].flags.load(memory_order_relaxed);
+		if ((flags & FLAG_VALID) && !(flags & FLAG_PERSISTENT)) {
+			release_slot_unsafe(st, counter);
 		}
 	}
+	write_end();
 }
 
 // clears all entries in the arp table, including persistent ones
 void arp_table::clear_all() {
-	mac_to_idx_mapping.clear();
-	ip_to_idx_mapping.clear();
-	
-	uint32_t entries = arp_mappings.size();
-	for (uint32_t counter = 0; counter < entries; ++counter) {
-		arp_mappings[counter].valid = false;
+	lock_guard<mutex> g(write_lock);
+	storage_t* st = storage.load(memory_order_relaxed);
+
+	write_begin();
+	for (uint32_t counter = 0; counter < st->capacity; ++counter) {
+		if (st->slots[counter].flags.load(memory_order_relaxed) & FLAG_VALID) {
+			release_slot_unsafe(st, counter);
+		}
 	}
+	write_end();
 }
 
 // remove stale entries
-// TODO: compact table
 void arp_table::do_garbage_collection() {
-	
-	auto iterator = mac_to_idx_mapping.begin();
-	while (iterator != mac_to_idx_mapping.end()) {
-		arp_entry& entry = arp_mappings[iterator->second];
-		if (entry.last_updated.get_time_elapsed_ms() >= (int)timeout_sec*1000) {
-			entry.valid = false;
-			ip_to_idx_mapping.erase(entry.nw_address);
-			iterator = mac_to_idx_mapping.erase(iterator);
-		} else {
-			++iterator;
-		}
-	}
+	lock_guard<mutex> g(write_lock);
+	do_garbage_collection_unsafe();
 }
 
 // given an IP address, look up its mac address
-mac_address arp_table::lookup_mac_for(const ip_address& dest) {
+mac_address arp_table::lookup_mac_for(const ip_address& dest, uint32_t max_age_sec) const {
+
+	uint64_t key = make_ip_key(dest);
+	storage_t* st;
+	int slot;
+	uint64_t dl_address;
+	uint32_t nw_address, flags, last_updated;
+
+	// seqlock read section
+	while (true) {
+		uint32_t seq = sequence.load(memory_order_acquire);
+		if (seq & 1) {
+			this_thread::yield();
+			continue;
+		}
 
-	auto iterator = ip_to_idx_mapping.find(dest);
-	if (iterator == ip_to_idx_mapping.end()) {
-		output::log(output::loglevel::VERBOSE, "arp_table::lookup_mac() -- no entry for %s.\n", dest.to_string().c_str());
-		return mac_address();
+		st = storage.load(memory_order_acquire);
+		slot = index_find(st, st->ip_index, key);
+		if (slot >= 0) {
+			dl_address = st->slots[slot].dl_address.load(memory_order_relaxed);
+			nw_address = st->slots[slot].nw_address.load(memory_order_relaxed);
+			flags = st->slots[slot].flags.load(memory_order_relaxed);
+			last_updated = st->slots[slot].last_updated.load(memory_order_relaxed);
+		}
+
+		atomic_thread_fence(memory_order_acquire);
+		if (sequence.load(memory_order_relaxed) == seq) {
+			break;
+		}
 	}
 
 	// check validity, timeout and staleness
-	arp_entry& entry = arp_mappings[iterator->second];
-	if (!is_entry_usable(entry)) {
+	uint32_t now = now_sec();
+	if (slot < 0 || nw_address != dest.get_as_be32() || !is_slot_usable(flags, last_updated, now)) {
+		OUTPUT_LOG(VERBOSE, "arp_table::lookup_mac() -- no entry for %s.\n", dest.to_string().c_str());
+		return mac_address();
+	} else if (max_age_sec != 0 && !(flags & FLAG_PERSISTENT) && now - last_updated >= max_age_sec) {
 		return mac_address();
 	}
 
-	// update stats
-	entry.lookup_count++;
-	entry.last_lookup.reset();
+	record_lookup(st->slots[slot], now);
 
-	return entry.dl_address;
+	mac_address result;
+	result.set_from_uint64(dl_address);
+	return result;
+}
+
+// records a lookup hit in a slot's sampled statistics. the write may land on
+// a slot that was just reused, which only skews the estimates.
+void arp_table::record_lookup(const slot_t& slot, uint32_t now) {
+	static thread_local uint32_t lookup_tick = 0;
+	if ((++lookup_tick % LOOKUP_SAMPLE_RATE) == 0) {
+		slot.lookup_count.fetch_add(LOOKUP_SAMPLE_RATE, memory_order_relaxed);
+		slot.last_lookup.store(now, memory_order_relaxed);
+	}
 }
 
 // given a MAC address, look up its IP address
-ip_address arp_table::lookup_ip_for(const mac_address& dest) {
+ip_address arp_table::lookup_ip_for(const mac_address& dest) const {
+
+	uint64_t key = make_mac_key(dest);
+	storage_t* st;
+	int slot;
+	uint64_t dl_address;
+	uint32_t nw_address, flags, last_updated;
+
+	// seqlock read section
+	while (true) {
+		uint32_t seq = sequence.load(memory_order_acquire);
+		if (seq & 1) {
+			this_thread::yield();
+			continue;
+		}
 
-	auto iterator = mac_to_idx_mapping.find(dest);
-	if (iterator == mac_to_idx_mapping.end()) {
-		return ip_address();
+		st = storage.load(memory_order_acquire);
+		slot = index_find(st, st->mac_index, key);
+		if (slot >= 0) {
+			dl_address = st->slots[slot].dl_address.load(memory_order_relaxed);
+			nw_address = st->slots[slot].nw_address.load(memory_order_relaxed);
+			flags = st->slots[slot].flags.load(memory_order_relaxed);
+			last_updated = st->slots[slot].last_updated.load(memory_order_relaxed);
+		}
+
+		atomic_thread_fence(memory_order_acquire);
+		if (sequence.load(memory_order_relaxed) == seq) {
+			break;
+		}
 	}
 
 	// check validity, timeout and staleness
-	arp_entry& entry = arp_mappings[iterator->second];
-	if (!is_entry_usable(entry)) {
+	uint32_t now = now_sec();
+	if (slot < 0 || dl_address != key || !is_slot_usable(flags, last_updated, now)) {
 		return ip_address();
 	}
 
-	// update stats
-	entry.lookup_count++;
-	entry.last_lookup.reset();
+	record_lookup(st->slots[slot], now);
 
-	return entry.nw_address;
+	ip_address result;
+	result.set_from_be32(nw_address);
+	return result;
 }
 
 // inserts an nonpersistent entry into the arp table
 bool arp_table::insert(const mac_address& dl_addr, const ip_address& nw_addr) {
-	
+
 	if (dl_addr.is_nil() || nw_addr.is_nil()) {
 		output::log(output::loglevel::WARNING, "arp_table::insert() -- cannot insert [%s]/[%s] (invalid address)\n",
 			dl_addr.to_string().c_str(),
@@ -160,45 +246,8 @@ bool arp_table::insert(const mac_address& dl_addr, const ip_address& nw_addr) {
 		return false;
 	}
 
-	// TODO -- this fixes up the gateway problem. don't do rigorous mapping correctness checks for
-	// gateway addresses
-	if (nw_addr[3] == 1) {
-//		auto iterator1 = mac_to_idx_mapping.find(dl_addr);
-		auto iterator2 = ip_to_idx_mapping.find(nw_addr);
-		if (iterator2 != ip_to_idx_mapping.end()) return true;
-
-	} else {
-		// non gateway addresses.
-		// remove the old entries if they exist
-		if (is_mapping_correct(dl_addr, nw_addr)) {
-			return true;
-		}
-	}
-
-	// mapping isn't correct or doesn't exist, so update the table
-	// TODO -- this fixes up the gateway problem. only remove mappings for non-gateway
-	// IP addresses. otherwise, gateways can have multiple mappings (eg 128.253.141.1 and 10.253.141.1)
-	if (nw_addr[3] != 1) {
-		remove(dl_addr);
-		remove(nw_addr);
-	}
-
-	// add in the new entry
-	uint32_t index;
-	if (!get_free_index(&index)) {
-		output::log(output::loglevel::CRITICAL, "arp_table::insert() -- cannot find free table slot.\n");
-		return false;
-	}
-
-	mac_to_idx_mapping[dl_addr] = index;
-	ip_to_idx_mapping[nw_addr] = index;
-	arp_mappings[index] = arp_entry(dl_addr, nw_addr);
-	output::log(output::loglevel::INFO, "arp_table::insert() -- added [%s] <--> [%s] at slot %u.\n",
-		nw_addr.to_string().c_str(),
-		dl_addr.to_string().c_str(),
-		index);
-
-	return true;
+	lock_guard<mutex> g(write_lock);
+	return insert_unsafe(dl_addr, nw_addr, false);
 }
 
 // inserts a persistent entry into the arp table
@@ -211,122 +260,364 @@ bool arp_table::insert_persistent(const mac_address& dl_addr, const ip_address&
 		return false;
 	}
 
-	// remove the old entries if they exist
-	remove(dl_addr);
-	remove(nw_addr);
-
-	// add in the new entry
-	uint32_t index;
-	if (!get_free_index(&index)) {
-		output::log(output::loglevel::CRITICAL, "arp_table::insert() -- cannot find free table slot.\n");
-		return false;
-	}
-
-	mac_to_idx_mapping[dl_addr] = index;
-	ip_to_idx_mapping[nw_addr] = index;
-	arp_mappings[index] = arp_entry(dl_addr, nw_addr);
-	arp_mappings[index].persistent = true;
-
-	output::log(output::loglevel::INFO, "arp_table: inserted [%s] <--> [%s] [PERSISTENT]\n",
-		nw_addr.to_string().c_str(),
-		dl_addr.to_string().c_str());
-
-	return true;
+	lock_guard<mutex> g(write_lock);
+	return insert_unsafe(dl_addr, nw_addr, true);
 }
 
 // removes an entry from the table
 void arp_table::remove(const mac_address& dl_addr) {
-	auto iterator = mac_to_idx_mapping.find(dl_addr);
-	if (iterator != mac_to_idx_mapping.end()) {
-		arp_entry& entry = arp_mappings[iterator->second];
-		ip_to_idx_mapping.erase(entry.nw_address);
-		mac_to_idx_mapping.erase(iterator);
-		entry.valid = false;
-	}
+	lock_guard<mutex> g(write_lock);
+	remove_unsafe(dl_addr);
 }
 
 // removes an entry from the table
 void arp_table::remove(const ip_address& nw_addr) {
-	auto iterator = ip_to_idx_mapping.find(nw_addr);
-	if (iterator != ip_to_idx_mapping.end()) {
-		arp_entry& entry = arp_mappings[iterator->second];
-		mac_to_idx_mapping.erase(entry.dl_address);
-		ip_to_idx_mapping.erase(iterator);
-		entry.valid = false;
-	}
+	lock_guard<mutex> g(write_lock);
+	remove_unsafe(nw_addr);
 }
 
 // retrieves the arp table
-vector<arp_entry> arp_table::get_arp_table() {
+vector<arp_entry> arp_table::get_arp_table() const {
+	lock_guard<mutex> g(write_lock);
 
 	vector<arp_entry> result;
-	result.reserve(mac_to_idx_mapping.size());
-	for (const auto& it : mac_to_idx_mapping) {
-		arp_entry& entry = arp_mappings[it.second];
-		if (is_entry_usable(entry)) {
-			result.push_back(entry);
+	result.reserve(num_entries.load(memory_order_relaxed));
+	storage_t* st = storage.load(memory_order_relaxed);
+	uint32_t now = now_sec();
+
+	for (uint32_t counter = 0; counter < st->capacity; ++counter) {
+		const slot_t& slot = st->slots[counter];
+		uint32_t flags = slot.flags.load(memory_order_relaxed);
+		uint32_t last_updated = slot.last_updated.load(memory_order_relaxed);
+		if (!is_slot_usable(flags, last_updated, now)) {
+			continue;
 		}
+
+		arp_entry entry;
+		uint32_t last_lookup = slot.last_lookup.load(memory_order_relaxed);
+		entry.valid = true;
+		entry.persistent = (flags & FLAG_PERSISTENT) != 0;
+		entry.dl_address.set_from_uint64(slot.dl_address.load(memory_order_relaxed));
+		entry.nw_address.set_from_be32(slot.nw_address.load(memory_order_relaxed));
+		entry.lookup_count = slot.lookup_count.load(memory_order_relaxed);
+		entry.sec_since_lookup = (last_lookup == 0 ? (uint32_t) -1 : now - last_lookup);
+		entry.update_count = slot.update_count.load(memory_order_relaxed);
+		entry.sec_since_update = now - last_updated;
+		result.push_back(entry);
+	}
+
+	return result;
+}
+
+// builds the ip index key (never EMPTY_KEY or TOMBSTONE_KEY)
+uint64_t arp_table::make_ip_key(const ip_address& nw_addr) {
+	return (((uint64_t) 1) << 32) | nw_addr.get_as_be32();
+}
+
+// builds the mac index key (the nil address is never inserted)
+uint64_t arp_table::make_mac_key(const mac_address& dl_addr) {
+	return dl_addr.get_as_uint64();
+}
+
+// mixes the key bits (64-bit finalizer from murmurhash3)
+uint32_t arp_table::hash_key(uint64_t key) {
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return (uint32_t) key;
+}
+
+// allocates zeroed storage for a given capacity. indices are sized to keep
+// the load factor at or below 1/2.
+arp_table::storage_t* arp_table::allocate_storage(uint32_t capacity) {
+	uint32_t index_size = 64;
+	while (index_size < capacity * 2) {
+		index_size <<= 1;
 	}
 
+	storage_t* result = new storage_t();
+	result->capacity = capacity;
+	result->index_mask = index_size-1;
+	result->slots = new slot_t[capacity]();
+	result->ip_index = new bucket_t[index_size]();
+	result->mac_index = new bucket_t[index_size]();
 	return result;
 }
 
-// invalidates a certain entry if it is stale and is non persistent
-// returns true if the entry is still valid or persistent
-bool arp_table::is_entry_usable(arp_entry& entry) {
+// frees storage
+void arp_table::free_storage(storage_t* st) {
+	delete[] st->slots;
+	delete[] st->ip_index;
+	delete[] st->mac_index;
+	delete st;
+}
+
+// gets the current time in seconds (never 0, which means 'never')
+uint32_t arp_table::now_sec() const {
+	return (uint32_t) chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - epoch).count() + 1;
+}
 
-	if (!entry.valid) {
+// checks that an entry is valid and either persistent or fresh
+bool arp_table::is_slot_usable(uint32_t flags, uint32_t last_updated, uint32_t now) const {
+	if (!(flags & FLAG_VALID)) {
 		return false;
-	} else if (entry.persistent) {
+	} else if (flags & FLAG_PERSISTENT) {
 		return true;
-	} else if (entry.last_updated.get_time_elapsed_ms() >= (int)timeout_sec * 1000) {
-		entry.valid = false;
-		mac_to_idx_mapping.erase(entry.dl_address);
-		ip_to_idx_mapping.erase(entry.nw_address);
-		return false;
 	} else {
-		return true;
+		return now - last_updated < timeout_sec.load(memory_order_relaxed);
+	}
+}
+
+// finds the slot for a key in an index, or -1 if not present
+int arp_table::index_find(const storage_t* st, const bucket_t* index, uint64_t key) {
+	uint32_t position = hash_key(key) & st->index_mask;
+	for (uint32_t probe = 0; probe <= st->index_mask; ++probe) {
+		uint64_t current = index[position].key.load(memory_order_relaxed);
+		if (current == key) {
+			return (int) index[position].slot.load(memory_order_relaxed);
+		} else if (current == EMPTY_KEY) {
+			return -1;
+		}
+		position = (position+1) & st->index_mask;
+	}
+	return -1;
+}
+
+// maps a key to a slot, replacing any existing mapping for the key
+void arp_table::index_set(storage_t* st, bucket_t* index, uint64_t key, uint32_t slot) {
+	uint32_t position = hash_key(key) & st->index_mask;
+	int free_position = -1;
+	for (uint32_t probe = 0; probe <= st->index_mask; ++probe) {
+		uint64_t current = index[position].key.load(memory_order_relaxed);
+		if (current == key) {
+			index[position].slot.store(slot, memory_order_relaxed);
+			return;
+		} else if (current == TOMBSTONE_KEY && free_position == -1) {
+			free_position = position;
+		} else if (current == EMPTY_KEY) {
+			if (free_position == -1) {
+				free_position = position;
+			}
+			break;
+		}
+		position = (position+1) & st->index_mask;
+	}
+
+	// the index is at most half full, so a free position always exists
+	if (index[free_position].key.load(memory_order_relaxed) == TOMBSTONE_KEY) {
+		--num_tombstones;
+	}
+	index[free_position].slot.store(slot, memory_order_relaxed);
+	index[free_position].key.store(key, memory_order_relaxed);
+}
+
+// removes a key from an index if it still maps to the given slot
+void arp_table::index_erase(storage_t* st, bucket_t* index, uint64_t key, uint32_t slot) {
+	uint32_t position = hash_key(key) & st->index_mask;
+	for (uint32_t probe = 0; probe <= st->index_mask; ++probe) {
+		uint64_t current = index[position].key.load(memory_order_relaxed);
+		if (current == key) {
+			if (index[position].slot.load(memory_order_relaxed) == slot) {
+				index[position].key.store(TOMBSTONE_KEY, memory_order_relaxed);
+				++num_tombstones;
+			}
+			return;
+		} else if (current == EMPTY_KEY) {
+			return;
+		}
+		position = (position+1) & st->index_mask;
 	}
 }
 
-// finds a free index which to insert an entry
-bool arp_table::get_free_index(uint32_t* result) {
+// rebuilds both indices from the valid slots (drops tombstones). newer
+// slots win when two slots share a key, matching the order of insertion
+// closely enough for the gateway case.
+void arp_table::rebuild_indices_unsafe(storage_t* st) {
+	for (uint32_t counter = 0; counter <= st->index_mask; ++counter) {
+		st->ip_index[counter].key.store(EMPTY_KEY, memory_order_relaxed);
+		st->mac_index[counter].key.store(EMPTY_KEY, memory_order_relaxed);
+	}
+	num_tombstones = 0;
+
+	for (uint32_t counter = 0; counter < st->capacity; ++counter) {
+		const slot_t& slot = st->slots[counter];
+		if (slot.flags.load(memory_order_relaxed) & FLAG_VALID) {
+			ip_address nw_addr;
+			nw_addr.set_from_be32(slot.nw_address.load(memory_order_relaxed));
+			index_set(st, st->ip_index, make_ip_key(nw_addr), counter);
+			index_set(st, st->mac_index, slot.dl_address.load(memory_order_relaxed), counter);
+		}
+	}
+}
+
+// inserts an entry. caller holds the write lock.
+bool arp_table::insert_unsafe(const mac_address& dl_addr, const ip_address& nw_addr, bool persistent) {
+
+	storage_t* st = storage.load(memory_order_relaxed);
+	uint32_t now = now_sec();
+
+	if (!persistent) {
+
+		// TODO -- this fixes up the gateway problem. don't do rigorous mapping correctness checks for
+		// gateway addresses
+		if (nw_addr[3] == 1) {
+			int slot = index_find(st, st->ip_index, make_ip_key(nw_addr));
+			if (slot >= 0) {
+				if (st->slots[slot].dl_address.load(memory_order_relaxed) == make_mac_key(dl_addr)) {
+					st->slots[slot].last_updated.store(now, memory_order_relaxed);
+					st->slots[slot].update_count.fetch_add(1, memory_order_relaxed);
+				}
+				return true;
+			}
+
+		} else {
+			// non gateway addresses. refresh the entry if the mapping is unchanged
+			if (is_mapping_correct_unsafe(dl_addr, nw_addr)) {
+				int slot = index_find(st, st->ip_index, make_ip_key(nw_addr));
+				st->slots[slot].last_updated.store(now, memory_order_relaxed);
+				st->slots[slot].update_count.fetch_add(1, memory_order_relaxed);
+				return true;
+			}
+		}
+	}
 
-	uint32_t index = (last_search_slot+1) % max_capacity;
-	while (arp_mappings[index].valid && index != max_capacity) {
-		index = (index+1)% max_capacity;
+	// mapping isn't correct or doesn't exist, so update the table
+	// TODO -- this fixes up the gateway problem. only remove mappings for non-gateway
+	// IP addresses. otherwise, gateways can have multiple mappings (eg 128.253.141.1 and 10.253.141.1)
+	if (persistent || nw_addr[3] != 1) {
+		remove_unsafe(dl_addr);
+		remove_unsafe(nw_addr);
 	}
 
-	if (arp_mappings[index].valid) {
+	// add in the new entry
+	if (free_slots.empty() || num_entries.load(memory_order_relaxed) >= max_capacity) {
+		do_garbage_collection_unsafe();
+	}
+	if (free_slots.empty() || num_entries.load(memory_order_relaxed) >= max_capacity) {
+		output::log(output::loglevel::CRITICAL, "arp_table::insert() -- cannot find free table slot.\n");
 		return false;
 	}
 
-	*result = index;
-	last_search_slot = index;
+	uint32_t index = free_slots.back();
+	free_slots.pop_back();
+
+	write_begin();
+	slot_t& slot = st->slots[index];
+	slot.dl_address.store(make_mac_key(dl_addr), memory_order_relaxed);
+	slot.nw_address.store(nw_addr.get_as_be32(), memory_order_relaxed);
+	slot.flags.store(FLAG_VALID | (persistent ? FLAG_PERSISTENT : 0), memory_order_relaxed);
+	slot.last_updated.store(now, memory_order_relaxed);
+	slot.update_count.store(0, memory_order_relaxed);
+	slot.lookup_count.store(0, memory_order_relaxed);
+	slot.last_lookup.store(0, memory_order_relaxed);
+	index_set(st, st->ip_index, make_ip_key(nw_addr), index);
+	index_set(st, st->mac_index, make_mac_key(dl_addr), index);
+	num_entries.fetch_add(1, memory_order_relaxed);
+
+	// drop tombstones once they make up a quarter of the indices
+	if (num_tombstones * 4 > st->index_mask+1) {
+		rebuild_indices_unsafe(st);
+	}
+	write_end();
+
+	if (persistent) {
+		OUTPUT_LOG(INFO, "arp_table: inserted [%s] <--> [%s] [PERSISTENT]\n",
+			nw_addr.to_string().c_str(),
+			dl_addr.to_string().c_str());
+	} else {
+		OUTPUT_LOG(INFO, "arp_table::insert() -- added [%s] <--> [%s] at slot %u.\n",
+			nw_addr.to_string().c_str(),
+			dl_addr.to_string().c_str(),
+			index);
+	}
+
 	return true;
 }
 
-// checks if a mapping is correct
-bool arp_table::is_mapping_correct(const mac_address& dl_addr, const ip_address& nw_addr) {
+// invalidates a slot and returns it to the free list. caller holds the write
+// lock inside write_begin().
+void arp_table::release_slot_unsafe(storage_t* st, uint32_t index) {
+	slot_t& slot = st->slots[index];
+	ip_address nw_addr;
+	nw_addr.set_from_be32(slot.nw_address.load(memory_order_relaxed));
+
+	index_erase(st, st->ip_index, make_ip_key(nw_addr), index);
+	index_erase(st, st->mac_index, slot.dl_address.load(memory_order_relaxed), index);
+	slot.flags.store(0, memory_order_relaxed);
+
+	free_slots.push_back(index);
+	num_entries.fetch_sub(1, memory_order_relaxed);
+}
+
+// removes an entry by mac address. caller holds the write lock.
+void arp_table::remove_unsafe(const mac_address& dl_addr) {
+	storage_t* st = storage.load(memory_order_relaxed);
+	int slot = index_find(st, st->mac_index, make_mac_key(dl_addr));
+	if (slot >= 0) {
+		write_begin();
+		release_slot_unsafe(st, slot);
+		write_end();
+	}
+}
+
+// removes an entry by ip address. caller holds the write lock.
+void arp_table::remove_unsafe(const ip_address& nw_addr) {
+	storage_t* st = storage.load(memory_order_relaxed);
+	int slot = index_find(st, st->ip_index, make_ip_key(nw_addr));
+	if (slot >= 0) {
+		write_begin();
+		release_slot_unsafe(st, slot);
+		write_end();
+	}
+}
+
+// frees non-persistent entries that timed out. caller holds the write lock.
+void arp_table::do_garbage_collection_unsafe() {
+	storage_t* st = storage.load(memory_order_relaxed);
+	uint32_t now = now_sec();
+
+	write_begin();
+	for (uint32_t counter = 0; counter < st->capacity; ++counter) {
+		const slot_t& slot = st->slots[counter];
+		uint32_t flags = slot.flags.load(memory_order_relaxed);
+		if ((flags & FLAG_VALID) && !is_slot_usable(flags, slot.last_updated.load(memory_order_relaxed), now)) {
+			release_slot_unsafe(st, counter);
+		}
+	}
+	write_end();
+}
 
-	auto iterator1 = mac_to_idx_mapping.find(dl_addr);
-	auto iterator2 = ip_to_idx_mapping.find(nw_addr);
+// checks if a mapping is correct. caller holds the write lock.
+bool arp_table::is_mapping_correct_unsafe(const mac_address& dl_addr, const ip_address& nw_addr) {
 
-	if (iterator1 == mac_to_idx_mapping.end() || iterator2 == ip_to_idx_mapping.end()) {
-		bool mac_invalid = (iterator1 == mac_to_idx_mapping.end());
-		bool ip_invalid = (iterator2 == ip_to_idx_mapping.end());
+	storage_t* st = storage.load(memory_order_relaxed);
+	int mac_slot = index_find(st, st->mac_index, make_mac_key(dl_addr));
+	int ip_slot = index_find(st, st->ip_index, make_ip_key(nw_addr));
+
+	if (mac_slot < 0 || ip_slot < 0) {
+		bool mac_invalid = (mac_slot < 0);
+		bool ip_invalid = (ip_slot < 0);
 
 		if (!(mac_invalid && ip_invalid)) {
 			output::log(output::loglevel::WARNING, "arp_table::is_mapping_correct() invalid mapping! mac [%s]:[slot %d] <--> ip [%s]:[slot %d]\n",
 				dl_addr.to_string().c_str(),
-				mac_invalid ? -1 : iterator1->second,
+				mac_slot,
 				nw_addr.to_string().c_str(),
-				ip_invalid ? -1 : iterator2->second);
+				ip_slot);
 		}
 		return false;
 	}
 
-	if (iterator1->second != iterator2->second) {
+	if (mac_slot != ip_slot) {
+		mac_address mac_slot_dl, ip_slot_dl;
+		ip_address mac_slot_nw, ip_slot_nw;
+		mac_slot_dl.set_from_uint64(st->slots[mac_slot].dl_address.load(memory_order_relaxed));
+		mac_slot_nw.set_from_be32(st->slots[mac_slot].nw_address.load(memory_order_relaxed));
+		ip_slot_dl.set_from_uint64(st->slots[ip_slot].dl_address.load(memory_order_relaxed));
+		ip_slot_nw.set_from_be32(st->slots[ip_slot].nw_address.load(memory_order_relaxed));
+
 		output::log(output::loglevel::WARNING, "arp_table::is_mapping_correct() -- mapping mismatch!\n"
 			"proposed mapping [%s] <--> [%s]\n"
 			"conflicts with   [%s] <--> [%s]\n"
@@ -334,12 +625,23 @@ bool arp_table::is_mapping_correct(const mac_address& dl_addr, const ip_address&
 			"this could be a benign  address change, or a malicious attempt at address spoofing.\n",
 			dl_addr.to_string().c_str(),
 			nw_addr.to_string().c_str(),
-			arp_mappings[iterator1->second].dl_address.to_string().c_str(),
-			arp_mappings[iterator1->second].nw_address.to_string().c_str(),
-			arp_mappings[iterator2->second].dl_address.to_string().c_str(),
-			arp_mappings[iterator2->second].nw_address.to_string().c_str());
+			mac_slot_dl.to_string().c_str(),
+			mac_slot_nw.to_string().c_str(),
+			ip_slot_dl.to_string().c_str(),
+			ip_slot_nw.to_string().c_str());
 		return false;
 	} else {
 		return true;
 	}
 }
+
+// enters a writer critical section (sequence becomes odd)
+void arp_table::write_begin() {
+	sequence.store(sequence.load(memory_order_relaxed)+1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+}
+
+// leaves a writer critical section (sequence becomes even)
+void arp_table::write_end() {
+	sequence.store(sequence.load(memory_order_relaxed)+1, memory_order_release);
+}
@@ -1,30 +1,40 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <stdint.h>
-#include <map>
 #include <vector>
 #include "../../common/ip_address.h"
 #include "../../common/mac_address.h"
-#include "../../common/timer.h"
-
+using namespace std;
+
+// defines ARP entries and the ARP table of a single vlan (one shard of the ARP
+// service)
+//
+// entries live in a fixed slot array with a free list, so allocating and
+// releasing a slot is O(1). two open-addressing indices map IP -> slot and
+// MAC -> slot. lookups take no lock: they read atomics and validate against
+// the table's sequence counter (a seqlock), which writers make odd while they
+// modify entries or indices. writers are serialized by a per-table mutex.
+//
+// lookup statistics are sampled (one in every LOOKUP_SAMPLE_RATE hits per
+// thread is recorded) so the lookup path does not write to shared cache lines.
+//
+// revision 2 (10/19/26)
+
+// readable copy of an arp entry (returned by get_arp_table())
 class arp_entry {
 public:
 	arp_entry():valid(false),
 		persistent(false),
 		lookup_count(0),
-		update_count(0) {		
+		sec_since_lookup(0),
+		update_count(0),
+		sec_since_update(0) {
 		dl_address.clear();
 		nw_address.clear();
-		last_lookup.clear();
-		last_updated.clear();
 	};
-	arp_entry(const mac_address& dl, const ip_address& nw):
-		valid(true),
-		persistent(false),
-		dl_address(dl),
-		nw_address(nw),
-		lookup_count(0),
-		update_count(0) {};
 
 	// accessible fields
 	bool             valid;
@@ -32,24 +42,25 @@ public:
 	mac_address      dl_address;
 	ip_address       nw_address;
 
-	mutable	uint32_t lookup_count;
-	mutable timer    last_lookup;
+	uint32_t         lookup_count;      // sampled estimate
+	uint32_t         sec_since_lookup;  // -1 if never looked up
 
 	uint32_t         update_count;
-	timer            last_updated;
+	uint32_t         sec_since_update;
 };
 
 // defines the arp table class
 class arp_table {
 public:
 
-	arp_table();
+	arp_table(uint32_t max_capacity=DEFAULT_MAX_CAPACITY);
 	~arp_table();
 
 	// capacity setup
 	void     set_max_capacity(uint32_t max);
 	uint32_t get_max_capacity() const;
 	uint32_t get_available_capacity() const;
+	uint32_t size() const;
 
 	// entry timeout
 	void     set_timeout(uint32_t timeout_sec);
@@ -62,11 +73,13 @@ public:
 	// remove stale entries
 	void     do_garbage_collection();
 
-	// returns mac address for a given ip address
-	mac_address lookup_mac_for(const ip_address& dest);
+	// returns mac address for a given ip address (lock-free). if max_age_sec
+	// is set, entries not refreshed within that many seconds are treated as
+	// missing (persistent entries are always fresh).
+	mac_address lookup_mac_for(const ip_address& dest, uint32_t max_age_sec=0) const;
 
-	// returns ip address for a given mac
-	ip_address lookup_ip_for(const mac_address& dest);
+	// returns ip address for a given mac (lock-free)
+	ip_address lookup_ip_for(const mac_address& dest) const;
 
 	// insert and delete
 	bool     insert(const mac_address& dl_addr, const ip_address& nw_addr);
@@ -74,25 +87,87 @@ public:
 	void     remove(const mac_address& dl_addr);
 	void     remove(const ip_address& nw_addr);
 
-	// retrieves a copy of the arp table (expensive operation)
-	// not const because this operation invalidates old entries
-	vector<arp_entry> get_arp_table();
+	// retrieves a copy of the usable entries in the arp table (expensive operation)
+	vector<arp_entry> get_arp_table() const;
+
+	static const uint32_t DEFAULT_MAX_CAPACITY = 16384;
+	static const uint32_t LOOKUP_SAMPLE_RATE = 64;
 
 private:
 
-	uint32_t max_capacity;
-	uint32_t timeout_sec;
-	uint32_t last_search_slot;
-	
-	map<mac_address, uint32_t> mac_to_idx_mapping;
-	map<ip_address, uint32_t> ip_to_idx_mapping;
-	vector<arp_entry> arp_mappings;
+	// entry slot. all fields are atomics so that lock-free readers can copy
+	// them; consistency is checked with the sequence counter.
+	struct slot_t {
+		atomic<uint64_t>         dl_address;
+		atomic<uint32_t>         nw_address;    // big endian
+		atomic<uint32_t>         flags;
+		atomic<uint32_t>         last_updated;  // seconds since table epoch
+		atomic<uint32_t>         update_count;
+		mutable atomic<uint32_t> lookup_count;  // sampled
+		mutable atomic<uint32_t> last_lookup;   // 0 = never
+	};
 
-	// helper functions
-	bool     is_entry_usable(arp_entry& entry);
-	bool     get_free_index(uint32_t* index);
+	// index bucket (key -> slot)
+	struct bucket_t {
+		atomic<uint64_t>         key;
+		atomic<uint32_t>         slot;
+	};
 
-	// check if an existing mapping is correct
-	bool     is_mapping_correct(const mac_address& dl_addr, const ip_address& nw_addr);
+	// slot array and indices. replaced only when the capacity grows; retired
+	// storage is kept until destruction because lock-free readers may hold it.
+	struct storage_t {
+		uint32_t                 capacity;
+		uint32_t                 index_mask;
+		slot_t*                  slots;
+		bucket_t*                ip_index;
+		bucket_t*                mac_index;
+	};
+
+	static const uint32_t FLAG_VALID = 1;
+	static const uint32_t FLAG_PERSISTENT = 2;
+	static const uint64_t EMPTY_KEY = 0;
+	static const uint64_t TOMBSTONE_KEY = ~((uint64_t) 0);
+
+	uint32_t                     max_capacity;
+	atomic<uint32_t>             timeout_sec;
+
+	atomic<storage_t*>           storage;
+	vector<storage_t*>           retired_storage;
 
+	// writer state
+	mutable mutex                write_lock;
+	atomic<uint32_t>             sequence;
+	atomic<uint32_t>             num_entries;
+	uint32_t                     num_tombstones;
+	vector<uint32_t>             free_slots;
+
+	// time base for the compact timestamps
+	chrono::steady_clock::time_point epoch;
+
+	// helper functions
+	static uint64_t   make_ip_key(const ip_address& nw_addr);
+	static uint64_t   make_mac_key(const mac_address& dl_addr);
+	static uint32_t   hash_key(uint64_t key);
+	static storage_t* allocate_storage(uint32_t capacity);
+	static void       free_storage(storage_t* st);
+
+	uint32_t now_sec() const;
+	bool     is_slot_usable(uint32_t flags, uint32_t last_updated, uint32_t now) const;
+	static void record_lookup(const slot_t& slot, uint32_t now);
+
+	// index operations (writers hold the write lock inside write_begin())
+	static int  index_find(const storage_t* st, const bucket_t* index, uint64_t key);
+	void        index_set(storage_t* st, bucket_t* index, uint64_t key, uint32_t slot);
+	void        index_erase(storage_t* st, bucket_t* index, uint64_t key, uint32_t slot);
+	void        rebuild_indices_unsafe(storage_t* st);
+
+	// slot operations (caller holds the write lock)
+	bool        insert_unsafe(const mac_address& dl_addr, const ip_address& nw_addr, bool persistent);
+	void        release_slot_unsafe(storage_t* st, uint32_t slot);
+	void        remove_unsafe(const mac_address& dl_addr);
+	void        remove_unsafe(const ip_address& nw_addr);
+	void        do_garbage_collection_unsafe();
+	bool        is_mapping_correct_unsafe(const mac_address& dl_addr, const ip_address& nw_addr);
+	void        write_begin();
+	void        write_end();
 };
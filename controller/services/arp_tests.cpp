@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include "arp.h"
+#include "../hal/hal.h"
+#include "../gui/output.h"
+#include "../switch_commander/switch_commander.h"
+using namespace std;
+
+// arp service tests
+//
+// runs the arp service on a bare hal (no switch connection) and drives the
+// internal orderings that are hard to hit from the outside. every test prints
+// its result; the exit status is the number of failures.
+//
+// author: Z. Teo (zteo@cs.cornell.edu)
+// revision 1 (10/19/26)
+
+// needed by the flow tables (normally defined by the ironstack executive)
+string switch_name = "arp_tests";
+
+static const uint16_t TEST_VLAN = 10;
+
+class arp_tests {
+public:
+
+	// a reply learned between resolve()'s table lookup and the registration of
+	// its waiter must still complete the waiter
+	static bool learned_before_waiter_registers(const shared_ptr<arp>& svc) {
+		ip_address nw_address("10.0.0.20");
+		mac_address dl_address;
+		dl_address.set_from_uint64(0x020000000020ULL);
+
+		// the caller's lookup has missed. the reply arrives and its completions
+		// run (finding no waiter) before the waiter registers.
+		svc->insert(dl_address, nw_address, TEST_VLAN, false);
+
+		bool completed = false;
+		mac_address result;
+		svc->add_waiter(nw_address, TEST_VLAN, [&](const ip_address& ip, const mac_address& mac) {
+			completed = true;
+			result = mac;
+		}, 3000);
+
+		bool pending;
+		{
+			lock_guard<mutex> g(svc->query_lock);
+			pending = (svc->pending_queries.count((((uint64_t) TEST_VLAN) << 32) | nw_address.get_as_be32()) > 0);
+		}
+		return completed && result == dl_address && !pending;
+	}
+};
+
+// stands in for the switch console. answers a newline with a prompt and
+// 'show vlan' with a canned listing.
+class fake_console : public iodevice {
+public:
+
+	fake_console(const string& show_vlan):show_vlan(show_vlan) {}
+
+	bool init() { initialized = true; return true; }
+	void shutdown() { initialized = false; }
+	device_type get_device_type() const { return device_type::SERIAL; }
+	bool wait_for_input(uint32_t milliseconds) { return !pending.empty(); }
+
+	int read(autobuf& dest, uint32_t max_size) {
+		dest.create_empty_buffer(pending.size() < max_size ? pending.size() : max_size, false);
+		return read(dest.get_content_ptr_mutable(), dest.size());
+	}
+
+	int read(void* dest, uint32_t max_size) {
+		uint32_t size = pending.size() < max_size ? pending.size() : max_size;
+		memcpy(dest, pending.data(), size);
+		pending.erase(0, size);
+		return size;
+	}
+
+	status read_until_timeout(autobuf& dest, uint32_t max_size, uint32_t timeout_ms) {
+		read(dest, max_size);
+		return pending.empty() ? status::SUCCESS : status::BUFFER_FULL;
+	}
+
+	status read_until_timeout(void* dest, uint32_t max_size, uint32_t timeout_ms, int* buf_used) {
+		*buf_used = read(dest, max_size);
+		return pending.empty() ? status::SUCCESS : status::BUFFER_FULL;
+	}
+
+	int write(const autobuf& src) { return write(src.get_content_ptr(), src.size()); }
+
+	int write(const void* buf, uint32_t size) {
+		string cmd((const char*) buf, size);
+		if (cmd == "\n") {
+			pending += "\nswitch#";
+		} else if (cmd == "show vlan\n") {
+			pending += show_vlan + "switch#";
+		}
+		return size;
+	}
+
+private:
+	string show_vlan;
+	string pending;
+};
+
+// formats one line of 'show vlan' output in the switch's fixed columns
+static string show_vlan_line(uint16_t vlan_id, const string& status, const string& description, char tag, const string& ports) {
+	char buf[128];
+	sprintf(buf, "    %-7hu%-10s%-32s%c Te 0/%s\n", vlan_id, status.c_str(), description.c_str(), tag, ports.c_str());
+	return buf;
+}
+
+// a vlan whose description on the switch carries the proxy-arp tag gets proxy
+// arp turned on, the same way the ironstack executive applies it
+static bool proxy_arp_from_vlan_description(const shared_ptr<arp>& svc) {
+	string listing = "Codes: * - Default VLAN\n\n"
+		"    NUM    Status    Description                     Q Ports\n";
+	listing += show_vlan_line(TEST_VLAN, "Active", "servers proxy-arp", 'U', "0-3");
+	listing += show_vlan_line(TEST_VLAN+10, "Active", "clients", 'T', "4-7");
+
+	switch_commander commander;
+	if (!commander.init(unique_ptr<iodevice>(new fake_console(listing)), ip_port(), "", "")) {
+		return false;
+	}
+	vector<vlan_set> vlans;
+	if (!commander.get_all_vlans(vlans) || vlans.size() != 2) {
+		return false;
+	}
+	for (const auto& vlan : vlans) {
+		if (vlan.active && vlan.proxy_arp) {
+			svc->set_proxy_arp(vlan.vlan_id, true);
+		}
+	}
+	bool enabled = svc->is_proxy_arp_enabled(TEST_VLAN) && !svc->is_proxy_arp_enabled(TEST_VLAN+10);
+	svc->set_proxy_arp(TEST_VLAN, false);
+	return enabled;
+}
+
+// prints the result of a test
+static uint32_t report(const char* name, bool passed) {
+	printf("%-48s %s\n", name, passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+
+	output::set_log_level(output::loglevel::WARNING);
+
+	shared_ptr<hal> controller(new hal());
+	shared_ptr<arp> svc = make_shared<arp>(controller->get_service_catalog());
+	if (!svc->init()) {
+		printf("error: unable to start the arp service.\n");
+		return 1;
+	}
+	svc->create_arp_table(TEST_VLAN);
+
+	uint32_t failures = 0;
+	failures += report("resolve: reply learned before waiter registers", arp_tests::learned_before_waiter_registers(svc));
+	failures += report("proxy arp: enabled from the vlan description", proxy_arp_from_vlan_description(svc));
+
+	svc->shutdown();
+	return failures;
+}
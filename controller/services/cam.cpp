@@ -1,3 +1,4 @@
+#include <inttypes.h>
 #include "cam.h"
 #include "switch_state.h"
 #include "../openflow_messages/of_message_packet_in.h"
@@ -6,7 +7,7 @@
 // initializes the cam service
 // preserves existing contents
 bool cam::init() {
-	lock_guard<mutex> g(lock);
+	lock_guard<mutex> g(init_lock);
 	if (initialized) {
 		output::log(output::loglevel::WARNING, "cam::init() -- service already started.\n");
 		return true;
@@ -27,7 +28,7 @@ bool cam::init2() {
 
 // shuts down all cam activity
 void cam::shutdown() {
-	lock_guard<mutex> g(lock);
+	lock_guard<mutex> g(init_lock);
 	if (initialized) {
 		if (processor != nullptr) {
 			processor->unregister_filter(shared_from_this());
@@ -41,22 +42,17 @@ void cam::shutdown() {
 
 // creates a cam table for a vlan
 void cam::create_cam_table(uint16_t vlan_id) {
-	lock_guard<mutex> g(lock);
-	if (cam_tables.count(vlan_id) > 0) {
+	if (!table.enable_vlan(vlan_id)) {
 		output::log(output::loglevel::WARNING, "cam::create_cam_table(): cam table for vlan %hu already exists.\n", vlan_id);
 		return;
 	} else {
-		cam_tables[vlan_id] = move(cam_table());
 		output::log(output::loglevel::INFO, "cam::create_cam_table(): created new cam table for vlan %hu.\n", vlan_id);
 	}
 }
 
 // deletes a table for a vlan
 void cam::remove_cam_table(uint16_t vlan_id) {
-	lock_guard<mutex> g(lock);
-	auto iterator = cam_tables.find(vlan_id);
-	if (iterator != cam_tables.end()) {
-		cam_tables.erase(iterator);
+	if (table.disable_vlan(vlan_id)) {
 		output::log(output::loglevel::INFO,"cam::remove_cam_table(): cam table for vlan %hu dropped.\n", vlan_id);
 	} else {
 		output::log(output::loglevel::ERROR, "cam::remove_cam_table(): cam table for vlan %hu doesn't exist.\n", vlan_id);
@@ -65,85 +61,61 @@ void cam::remove_cam_table(uint16_t vlan_id) {
 
 // removes all cam tables
 void cam::remove_all_cam_tables() {
-	lock_guard<mutex> g(lock);
-	output::log(output::loglevel::INFO, "cam::remove_all_cam_tables(): %lu tables dropped.\n", cam_tables.size());
-	cam_tables.clear();
+	output::log(output::loglevel::INFO, "cam::remove_all_cam_tables(): %lu tables dropped.\n", table.get_vlans().size());
+	table.disable_all_vlans();
 }
 
 // gets the set of all vlan IDs with a cam table
 set<uint16_t> cam::get_cam_vlans() const {
-	lock_guard<mutex> g(lock);
-	set<uint16_t> result;
-	for (auto iterator = cam_tables.begin(); iterator != cam_tables.end(); ++iterator) {
-		result.insert(iterator->first);
-	}
-	return result;
+	vector<uint16_t> vlans = table.get_vlans();
+	return set<uint16_t>(vlans.begin(), vlans.end());
 }
 
 // clear a given cam table without removing it
 void cam::clear_cam_table(uint16_t vlan_id) {
-	lock_guard<mutex> g(lock);
-	auto iterator = cam_tables.find(vlan_id);
-	if (iterator == cam_tables.end()) {
+	if (!table.is_vlan_enabled(vlan_id)) {
 		output::log(output::loglevel::ERROR, "cam::clear_cam_table() -- vlan %hu doesn't exist.\n", vlan_id);
 	} else {
-		iterator->second.clear();
+		table.clear(vlan_id);
 		output::log(output::loglevel::INFO, "cam::clear_cam_table(): cam table for vlan %hu cleared.\n", vlan_id);
 	}
 }
 
 // clear all cam tables without removing them
 void cam::clear_all_tables() {
-	lock_guard<mutex> g(lock);
 	output::log(output::loglevel::INFO, "cam::clear_all_tables(): clearing all cam tables.\n");
-	for (auto iterator = cam_tables.begin(); iterator != cam_tables.end(); ++iterator) {
-		output::log(output::loglevel::INFO, "cam: clearing cam table for vlan %hu.\n", iterator->first);
-		iterator->second.clear();
-	}
+	table.clear_all();
 }
 
 // insert an entry into the right cam table
 void cam::insert(const mac_address& dl_addr, uint16_t vlan_id, uint16_t phy_port) {
-	lock_guard<mutex> g(lock);
-	auto iterator = cam_tables.find(vlan_id);
-	if (iterator == cam_tables.end()) {
+	if (!table.insert(dl_addr, vlan_id, phy_port) && !table.is_vlan_enabled(vlan_id)) {
 		output::log(output::loglevel::ERROR, "cam::insert() ERROR cannot insert dl_addr [%s] phy_port [%hu]: no cam table for vlan %hu.\n",
 			dl_addr.to_string().c_str(), phy_port, vlan_id);
-	} else {
-//		output::log(output::loglevel::INFO, "cam::insert() added dl_addr [%s] phy_port [%hu] to vlan %hu\n",
-//			dl_addr.to_string().c_str(), phy_port, vlan_id);
-		iterator->second.insert(dl_addr, phy_port);
 	}
 }
 
 // insert an entry into all cam tables
 void cam::insert_all(const mac_address& dl_addr, uint16_t phy_port) {
-	lock_guard<mutex> g(lock);
-	for (auto iterator = cam_tables.begin(); iterator != cam_tables.end(); ++iterator) {
-		iterator->second.insert(dl_addr, phy_port);
-		output::log(output::loglevel::INFO, "cam::insert_all() added dl_addr [%s] phy_port [%hu] to vlan %hu\n",
-			dl_addr.to_string().c_str(), phy_port, iterator->first);
+	vector<uint16_t> vlans = table.get_vlans();
+	for (const auto& vlan_id : vlans) {
+		table.insert(dl_addr, vlan_id, phy_port);
+		OUTPUT_LOG(INFO, "cam::insert_all() added dl_addr [%s] phy_port [%hu] to vlan %hu\n",
+			dl_addr.to_string().c_str(), phy_port, vlan_id);
 	}
 }
 
 // lookup port number for a mac address
 int cam::lookup_port_for(const mac_address& dl_address, uint16_t vlan_id) const {
-	lock_guard<mutex> g(lock);
-	auto iterator = cam_tables.find(vlan_id);
-	if (iterator != cam_tables.end()) {
-		return iterator->second.lookup_port_for(dl_address);
-	}
-	return -1;
+	return table.lookup_port_for(dl_address, vlan_id);
 }
 
 // delete a cam entry
 void cam::remove(const mac_address& dl_addr, uint16_t vlan_id) {
-	lock_guard<mutex> g(lock);
-	auto iterator = cam_tables.find(vlan_id);
-	if (iterator != cam_tables.end()) {
-		output::log(output::loglevel::INFO, "cam::remove() removed dl_addr [%s] from vlan %hu.\n",
+	if (table.is_vlan_enabled(vlan_id)) {
+		OUTPUT_LOG(INFO, "cam::remove() removed dl_addr [%s] from vlan %hu.\n",
 			dl_addr.to_string().c_str(), vlan_id);
-		iterator->second.remove(dl_addr);
+		table.remove(dl_addr, vlan_id);
 	} else {
 		output::log(output::loglevel::ERROR, "cam::remove() -- trying to remove dl_addr [%s] from non-existent vlan %hu.\n",
 			dl_addr.to_string().c_str(), vlan_id);
@@ -152,21 +124,13 @@ void cam::remove(const mac_address& dl_addr, uint16_t vlan_id) {
 
 // clear all entries associated with a port
 void cam::remove(uint16_t phy_port) {
-	lock_guard<mutex> g(lock);
-	for (auto iterator = cam_tables.begin(); iterator != cam_tables.end(); ++iterator) {
-		output::log(output::loglevel::INFO, "cam::remove() removing all cam entries on vlan %hu from port %hu.\n", iterator->first, phy_port);
-		iterator->second.remove(phy_port);
-	}
+	OUTPUT_LOG(INFO, "cam::remove() removing all cam entries from port %hu.\n", phy_port);
+	table.remove(phy_port);
 }
 
 // retrieve a copy of the cam table for a specific vlan
-map<mac_address, cam_entry> cam::get_cam_table(uint16_t vlan_id) const {
-	lock_guard<mutex> g(lock);
-	auto iterator = cam_tables.find(vlan_id);
-	if (iterator != cam_tables.end()) {
-		return iterator->second.get_cam_table();
-	}
-	return map<mac_address, cam_entry>();
+vector<cam_entry> cam::get_cam_table(uint16_t vlan_id) const {
+	return table.get_cam_table(vlan_id);
 }
 
 // packet handling function to sniff packets and vlans
@@ -175,16 +139,18 @@ bool cam::filter_packet(const shared_ptr<of_message_packet_in>& packet, const ra
 
 	shared_ptr<switch_state> switch_state_svc = static_pointer_cast<switch_state>(controller->get_service(service_catalog::service_type::SWITCH_STATE));
 	if (switch_state_svc == nullptr) {
-		output::log(output::loglevel::WARNING, "cam::filter_packet() -- switch_state service offline.\n");
+		OUTPUT_LOG_LIMITED(WARNING, "cam::filter_packet() -- switch_state service offline.\n");
 		return false;
 	}
 
 	// grab the port descriptor for this openflow vlan
-	openflow_vlan_port vlan_port;
-	if (!switch_state_svc->get_switch_port(packet->in_port, vlan_port)) {
-		output::log(output::loglevel::WARNING, "cam::filter_packet() -- could not read port listing from switch state.\n");
+	shared_ptr<const switch_port_snapshot> snapshot = switch_state_svc->get_port_snapshot();
+	const openflow_vlan_port* port_info = snapshot->get_port(packet->in_port);
+	if (port_info == nullptr || !port_info->is_valid()) {
+		OUTPUT_LOG_LIMITED(WARNING, "cam::filter_packet() -- could not read port listing from switch state.\n");
 		return false;
 	}
+	const openflow_vlan_port& vlan_port = *port_info;
 
 	// check: is this packet correctly tagged for this port?
 	if (raw_pkt.has_vlan_tag) {
@@ -195,13 +161,13 @@ bool cam::filter_packet(const shared_ptr<of_message_packet_in>& packet, const ra
 			insert(raw_pkt.src_mac, raw_pkt.vlan_id, packet->in_port);
 		} else {
 			if (!vlan_port.is_tagged_port()) {
-				output::log(output::loglevel::WARNING, "cam::filter_packet() -- packet is tagged for vlan id %hu "
+				OUTPUT_LOG_LIMITED(WARNING, "cam::filter_packet() -- packet is tagged for vlan id %hu "
 					"but the input port %hu is untagged.\n",
 					raw_pkt.vlan_id,
 					packet->in_port);
 					return true;		// drop the packet -- don't let other services see it
 			} else {
-				output::log(output::loglevel::WARNING, "cam::filter_packet() -- packet is tagged for vlan id %hu "
+				OUTPUT_LOG_LIMITED(WARNING, "cam::filter_packet() -- packet is tagged for vlan id %hu "
 					"but the input port %hu is not a member of that vlan.\n",
 					raw_pkt.vlan_id,
 					packet->in_port);
@@ -216,23 +182,26 @@ bool cam::filter_packet(const shared_ptr<of_message_packet_in>& packet, const ra
 		if (!vlan_port.is_tagged_port()) {
 
 			// does this port have a vlan id?
-			set<uint16_t> port_vlans = vlan_port.get_all_vlans();
-			if (port_vlans.empty()) {
+			const vlan_mask& port_vlans = snapshot->get_port_vlans(packet->in_port);
+			if (port_vlans.none()) {
 				insert(raw_pkt.src_mac, 1, packet->in_port);		// default vlan = 1
 			} else {
 //				output::log(output::loglevel::INFO, "learning %s --> port %hu\n", raw_pkt.src_mac.to_string().c_str(), packet->in_port);
-				insert(raw_pkt.src_mac, *port_vlans.begin(), packet->in_port);
+				insert(raw_pkt.src_mac, port_vlans.first(), packet->in_port);
 			}
 
 		} else {
 
-			output::log(output::loglevel::WARNING, "cam::filter_packet() -- packet is untagged but the input "
+			OUTPUT_LOG_LIMITED(WARNING, "cam::filter_packet() -- packet is untagged but the input "
 				"port %hu is tagged.\n",
 				packet->in_port);
 			return true;		// drop the packet -- don't let other services see it
 		}
 	}
 
+	// age out stale entries (incremental, at most once a second)
+	table.do_garbage_collection();
+
 	// always return false because the packet has to continue down the handling chain
 	// (cam passively snoops)
 //	output::log(output::loglevel::INFO, "cam::filter_packet() packet src [%s] dest [%s] no match [%s] explicit forward [%s]\n",
@@ -249,9 +218,9 @@ string cam::get_service_info() const {
 }
 
 string cam::get_running_info() const {
-	lock_guard<mutex> g(lock);
-	char buf[128];
-	sprintf(buf, "irontack cam service. number of tables: %lu. ", cam_tables.size());
+	char buf[256];
+	sprintf(buf, "irontack cam service. number of tables: %lu. entries: %u/%u. lookups (sampled): %" PRIu64 ", misses: %" PRIu64 ". ",
+		table.get_vlans().size(), table.size(), table.get_max_capacity(), table.get_lookup_count(), table.get_lookup_miss_count());
 	return string(buf);
 }
 
@@ -5,6 +5,7 @@
 #include <mutex>
 #include <set>
 #include <string>
+#include <vector>
 #include "cam_table.h"
 #include "../../common/mac_address.h"
 #include "../../common/timed_barrier.h"
@@ -18,6 +19,8 @@ using namespace std;
 // this class needs to be on the fast path since it will get called often
 // for alternate ports to destination, use the multipath class
 //
+// all vlans share one flat cam_table; lookups are lock-free.
+//
 // revision 2 (2/22/15)
 // by Z. Teo
 
@@ -62,7 +65,7 @@ public:
 	void          remove(uint16_t phy_port);
 
 	// retrieve a copy of the cam table for a vlan
-	map<mac_address, cam_entry> get_cam_table(uint16_t vlan) const;
+	vector<cam_entry> get_cam_table(uint16_t vlan) const;
 
 	// packet handling function (to sniff all packets and vlans)
 	virtual bool filter_packet(const shared_ptr<of_message_packet_in>& packet, const raw_packet& raw_pkt);
@@ -74,8 +77,8 @@ public:
 private:
 
 	bool                            initialized;
-	mutable mutex                   lock;
-	map<uint16_t, cam_table>        cam_tables;
+	mutex                           init_lock;  // serializes init() and shutdown() only
+	cam_table                       table;
 	packet_in_processor*            processor;
 };
 
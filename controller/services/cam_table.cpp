@@ -1,28 +1,64 @@
+#include <algorithm>
+#include <new>
+#include <stdlib.h>
+#include <thread>
 #include "cam_table.h"
 #include "../gui/output.h"
 
 // default constructor
-cam_table::cam_table() {
-	max_capacity = 65536;
+cam_table::cam_table(uint32_t max_capacity_) {
+	max_capacity = max_capacity_;
 	timeout_sec = 14400;
+	num_tombstones = 0;
+	epoch = chrono::steady_clock::now();
+
+	atomic_store(&sequence, (uint32_t) 0);
+	atomic_store(&num_entries, (uint32_t) 0);
+	atomic_store(&lookups, (uint64_t) 0);
+	atomic_store(&lookup_misses, (uint64_t) 0);
+	for (auto& mask : vlan_mask) {
+		atomic_store(&mask, (uint64_t) 0);
+	}
+
+	uint32_t slot_count = get_slot_count_for(max_capacity);
+	slots.store(allocate_slots(slot_count));
+	slot_mask.store(slot_count-1);
+
+	aging_wheel.clear(now_sec());
+	aging_tick.store(aging_wheel.get_current_tick());
 }
 
 // destructor
 cam_table::~cam_table() {
+	free(slots.load());
+	for (const auto& it : retired_slots) {
+		free(it);
+	}
 }
 
 // set up capacity
 void cam_table::set_max_capacity(uint32_t max) {
-	
-	// enlarging is more convenient
+	lock_guard<mutex> g(write_lock);
+
+	// enlarging may require a bigger slot array
 	if (max > max_capacity) {
 		max_capacity = max;
+		uint32_t slot_count = get_slot_count_for(max_capacity);
+		if (slot_count > slot_mask.load()+1) {
+			rebuild_unsafe(slot_count);
+		}
 
 	// reduction in size needs to be accompanied by garbage collection
 	} else {
 
 		max_capacity = max;
-		do_garbage_collection();
+		advance_aging_unsafe(now_sec());
+		int excess_entries = (int) num_entries.load() - (int) max_capacity;
+		if (excess_entries > 0) {
+			remove_if_unsafe([&excess_entries](uint64_t key, uint64_t value) {
+				return excess_entries-- > 0;
+			});
+		}
 	}
 }
 
@@ -33,114 +69,605 @@ uint32_t cam_table::get_max_capacity() const {
 
 // get number of remaining entries in the cam table
 uint32_t cam_table::get_available_capacity() const {
-	return max_capacity <= cam_mappings.size() ? 0 : max_capacity - cam_mappings.size();
+	uint32_t entries = num_entries.load(memory_order_relaxed);
+	return max_capacity <= entries ? 0 : max_capacity - entries;
+}
+
+// get number of entries in the cam table (across all vlans)
+uint32_t cam_table::size() const {
+	return num_entries.load(memory_order_relaxed);
 }
 
 // setup a cam entry timeout
 void cam_table::set_timeout(uint32_t timeout) {
-	if (timeout >= timeout_sec) {
-		timeout_sec = timeout;
-	} else {
-		timeout_sec = timeout;
-		do_garbage_collection();
+	lock_guard<mutex> g(write_lock);
+	uint32_t old_timeout = timeout_sec.exchange(timeout);
+
+	// deadlines already in the wheel are too late for a shorter timeout. longer
+	// timeouts are picked up when the old deadlines fire.
+	if (timeout < old_timeout) {
+		reschedule_all_unsafe();
+		advance_aging_unsafe(now_sec());
 	}
 }
 
 // returns the cam entry timeout
 uint32_t cam_table::get_timeout() const {
-	return timeout_sec;
+	return timeout_sec.load(memory_order_relaxed);
+}
+
+// allows entries to be learned on a vlan. returns false if already enabled
+bool cam_table::enable_vlan(uint16_t vlan_id) {
+	if (vlan_id >= 4096) return false;
+	uint64_t bit = ((uint64_t) 1) << (vlan_id % 64);
+	return (vlan_mask[vlan_id / 64].fetch_or(bit) & bit) == 0;
+}
+
+// disallows entries on a vlan and drops the existing ones. returns false if
+// the vlan was not enabled
+bool cam_table::disable_vlan(uint16_t vlan_id) {
+	if (vlan_id >= 4096) return false;
+
+	lock_guard<mutex> g(write_lock);
+	uint64_t bit = ((uint64_t) 1) << (vlan_id % 64);
+	if ((vlan_mask[vlan_id / 64].fetch_and(~bit) & bit) == 0) {
+		return false;
+	}
+
+	remove_if_unsafe([vlan_id](uint64_t key, uint64_t value) {
+		return (uint16_t) (key >> 48) == vlan_id;
+	});
+	return true;
+}
+
+// disables all vlans and drops all entries
+void cam_table::disable_all_vlans() {
+	{
+		lock_guard<mutex> g(write_lock);
+		for (auto& mask : vlan_mask) {
+			mask.store(0);
+		}
+	}
+	clear_all();
+}
+
+// checks if a vlan has been enabled
+bool cam_table::is_vlan_enabled(uint16_t vlan_id) const {
+	if (vlan_id >= 4096) return false;
+	return (vlan_mask[vlan_id / 64].load(memory_order_relaxed) >> (vlan_id % 64)) & 1;
+}
+
+// gets the list of enabled vlans
+vector<uint16_t> cam_table::get_vlans() const {
+	vector<uint16_t> result;
+	for (uint32_t vlan_id = 0; vlan_id < 4096; ++vlan_id) {
+		if (is_vlan_enabled(vlan_id)) {
+			result.push_back(vlan_id);
+		}
+	}
+	return result;
+}
+
+// clear the entries of one vlan
+void cam_table::clear(uint16_t vlan_id) {
+	lock_guard<mutex> g(write_lock);
+	remove_if_unsafe([vlan_id](uint64_t key, uint64_t value) {
+		return (uint16_t) (key >> 48) == vlan_id;
+	});
 }
 
 // clear the entire cam table
-void cam_table::clear() {
-	cam_mappings.clear();
+void cam_table::clear_all() {
+	lock_guard<mutex> g(write_lock);
+	slot_t* table = slots.load(memory_order_relaxed);
+	uint32_t slot_count = slot_mask.load(memory_order_relaxed)+1;
+
+	write_begin();
+	for (uint32_t counter = 0; counter < slot_count; ++counter) {
+		table[counter].key.store(EMPTY_KEY, memory_order_relaxed);
+		table[counter].value.store(0, memory_order_relaxed);
+	}
+	num_entries.store(0, memory_order_relaxed);
+	num_tombstones = 0;
+	write_end();
+
+	aging_wheel.clear(aging_wheel.get_current_tick());
+	port_index.clear();
 }
 
 // remove entries that are stale
 void cam_table::do_garbage_collection() {
 
-	int excess_entries = cam_mappings.size()-max_capacity;
-	auto iterator = cam_mappings.begin();
-	while (iterator != cam_mappings.end()) {
-		if (!iterator->second.valid ||
-			iterator->second.last_updated.get_time_elapsed_ms() >= (int)timeout_sec*1000) {
-			iterator = cam_mappings.erase(iterator);
-			--excess_entries;
-		} else {
-			++iterator;
-		}
+	// the wheel has a one second resolution
+	uint32_t now = now_sec();
+	if (aging_tick.load(memory_order_relaxed) == now) {
+		return;
 	}
 
-	iterator = cam_mappings.begin();
-	while(excess_entries > 0 && cam_mappings.size() > 0) {
-		iterator = cam_mappings.erase(iterator);
-		--excess_entries;
-	}
+	lock_guard<mutex> g(write_lock);
+	advance_aging_unsafe(now);
 }
 
 // returns the port number for a mac address, or -1 if not found
-int cam_table::lookup_port_for(const mac_address& dest) const {
-	auto iterator = cam_mappings.find(dest);
-	if (iterator == cam_mappings.end()) {
-		return -1;
-	} else {
+int cam_table::lookup_port_for(const mac_address& dest, uint16_t vlan_id) const {
 
-		if (!iterator->second.valid) return -1;
+	static thread_local uint32_t lookup_tick = 0;
+	uint64_t key = make_key(dest, vlan_id);
+	slot_t* slot;
+	uint64_t value;
 
-		iterator->second.lookup_count++;
-		iterator->second.last_lookup.reset();
-		return iterator->second.phy_port;
+	// seqlock read section: retry if a writer relocated entries meanwhile
+	while (true) {
+		uint32_t seq = sequence.load(memory_order_acquire);
+		if (seq & 1) {
+			this_thread::yield();
+			continue;
+		}
+
+		slot = find_slot_unsafe(key);
+		value = (slot != nullptr ? slot->value.load(memory_order_relaxed) : 0);
+
+		atomic_thread_fence(memory_order_acquire);
+		if (sequence.load(memory_order_relaxed) == seq) {
+			break;
+		}
 	}
+
+	// sampled statistics. these writes may land on a relocated slot, which only
+	// skews the estimates.
+	if ((++lookup_tick % LOOKUP_SAMPLE_RATE) == 0) {
+		lookups.fetch_add(LOOKUP_SAMPLE_RATE, memory_order_relaxed);
+		if (slot == nullptr) {
+			lookup_misses.fetch_add(LOOKUP_SAMPLE_RATE, memory_order_relaxed);
+		} else {
+			slot->lookup_count.fetch_add(LOOKUP_SAMPLE_RATE, memory_order_relaxed);
+			slot->last_lookup.store(now_sec(), memory_order_relaxed);
+		}
+	}
+
+	return slot == nullptr ? -1 : (int) (value & 0xffff);
 }
 
 // inserts a cam entry
-bool cam_table::insert(const mac_address& addr, uint16_t port) {
-	bool result = false;
-	auto iterator = cam_mappings.find(addr);
-	if (iterator == cam_mappings.end()) {
-		if (cam_mappings.size() >= max_capacity) {
-			do_garbage_collection();
-		}
-
-		if (cam_mappings.size() >= max_capacity) {
-			output::log(output::loglevel::ERROR, "cam_table::insert() ERROR failed to add entry dl_addr [%s] phy_port [%hu]. CAM table full!\n",
-				addr.to_string().c_str(), port);
-			result = false;
-		} else {
-			cam_mappings[addr] = move(cam_entry(addr, port));
-			output::log(output::loglevel::INFO, "cam_table: inserted entry dl_addr [%s] --> phy_port [%hu].\n",
-				addr.to_string().c_str(), port);
-			result = true;
+bool cam_table::insert(const mac_address& addr, uint16_t vlan_id, uint16_t port) {
+
+	if (!is_vlan_enabled(vlan_id)) {
+		return false;
+	}
+
+	uint64_t key = make_key(addr, vlan_id);
+	if (key == EMPTY_KEY || key == TOMBSTONE_KEY) {
+		output::log(output::loglevel::ERROR, "cam_table::insert() ERROR cannot add reserved dl_addr [%s] on vlan %hu.\n",
+			addr.to_string().c_str(), vlan_id);
+		return false;
+	}
+	uint32_t now = now_sec();
+
+	// fast path: an existing entry on the same port only needs a timestamp
+	// refresh, which is done without the write lock. if a writer relocated
+	// entries meanwhile, the compare-exchange can only succeed on an entry with
+	// the same port and timestamp, so at worst it refreshes a neighbor.
+	while (true) {
+		uint32_t seq = sequence.load(memory_order_acquire);
+		if (seq & 1) {
+			this_thread::yield();
+			continue;
 		}
-	} else {
-		iterator->second.valid = true;
-		iterator->second.phy_port = port;
-		iterator->second.update_count++;
-		iterator->second.last_updated.reset();
-		result = true;
+
+		slot_t* slot = find_slot_unsafe(key);
+		uint64_t value = (slot != nullptr ? slot->value.load(memory_order_relaxed) : 0);
+
+		atomic_thread_fence(memory_order_acquire);
+		if (sequence.load(memory_order_relaxed) != seq) {
+			continue;
+		}
+
+		if (slot != nullptr && (value & 0xffff) == port) {
+			if ((uint32_t) (value >> 16) == now ||
+				slot->value.compare_exchange_strong(value, make_value(port, now), memory_order_relaxed)) {
+				return true;
+			}
+		}
+		break;
 	}
 
-	return result;
+	// slow path: new entry or port change
+	lock_guard<mutex> g(write_lock);
+	if (!is_vlan_enabled(vlan_id)) {
+		return false;
+	}
+
+	// a port change is a single store to the entry's value (its key stays put),
+	// so readers see the old or the new port and need not retry
+	slot_t* slot = find_slot_unsafe(key);
+	if (slot != nullptr) {
+		uint16_t old_port = (uint16_t) (slot->value.load(memory_order_relaxed) & 0xffff);
+		slot->value.store(make_value(port, now), memory_order_relaxed);
+
+		if (old_port != port) {
+			auto iterator = port_index.find(old_port);
+			if (iterator != port_index.end()) {
+				iterator->second.erase(key);
+				if (iterator->second.empty()) {
+					port_index.erase(iterator);
+				}
+			}
+			port_index[port].insert(key);
+		}
+		return true;
+	}
+
+	// make space if the table is full
+	if (num_entries.load(memory_order_relaxed) >= max_capacity) {
+		advance_aging_unsafe(now);
+	}
+
+	if (num_entries.load(memory_order_relaxed) >= max_capacity) {
+		output::log(output::loglevel::ERROR, "cam_table::insert() ERROR failed to add entry dl_addr [%s] phy_port [%hu]. CAM table full!\n",
+			addr.to_string().c_str(), port);
+		return false;
+	}
+
+	// purge tombstones if probe chains are getting long
+	uint32_t slot_count = slot_mask.load(memory_order_relaxed)+1;
+	if ((num_entries.load(memory_order_relaxed) + num_tombstones + 1) * 4 > slot_count * 3) {
+		rebuild_unsafe(slot_count);
+	}
+
+	write_begin();
+	slot = insert_slot_unsafe(slots.load(memory_order_relaxed), slot_mask.load(memory_order_relaxed), key, make_value(port, now), 0, 0);
+	write_end();
+
+	port_index[port].insert(key);
+	schedule_aging_unsafe(slot, now + timeout_sec.load(memory_order_relaxed));
+
+	OUTPUT_LOG_LIMITED(INFO, "cam_table: inserted entry dl_addr [%s] vlan [%hu] --> phy_port [%hu].\n",
+		addr.to_string().c_str(), vlan_id, port);
+	return true;
 }
 
 // removes a cam entry
-void cam_table::remove(const mac_address& dl_addr) {
-	cam_mappings.erase(dl_addr);
+void cam_table::remove(const mac_address& dl_addr, uint16_t vlan_id) {
+	lock_guard<mutex> g(write_lock);
+	slot_t* slot = find_slot_unsafe(make_key(dl_addr, vlan_id));
+	if (slot != nullptr) {
+		write_begin();
+		erase_slot_unsafe(slot);
+		write_end();
+	}
 }
 
 // removes all cam entries on a port
 void cam_table::remove(uint16_t port) {
-	auto iterator = cam_mappings.begin();
-	while(iterator != cam_mappings.end()) {
-		if (iterator->second.phy_port == port) {
-			iterator = cam_mappings.erase(iterator);
+	lock_guard<mutex> g(write_lock);
+	auto iterator = port_index.find(port);
+	if (iterator == port_index.end()) {
+		return;
+	}
+
+	// erase_slot_unsafe() updates the index, so work from a copy
+	vector<uint64_t> keys(iterator->second.begin(), iterator->second.end());
+	write_begin();
+	for (const auto& key : keys) {
+		slot_t* slot = find_slot_unsafe(key);
+		if (slot != nullptr) {
+			erase_slot_unsafe(slot);
+		}
+	}
+	write_end();
+
+	uint32_t slot_count = slot_mask.load(memory_order_relaxed)+1;
+	if (num_tombstones * 4 > slot_count) {
+		rebuild_unsafe(slot_count);
+	}
+}
+
+// retrieves a copy of the cam entries for a vlan
+vector<cam_entry> cam_table::get_cam_table(uint16_t vlan_id) const {
+	lock_guard<mutex> g(write_lock);
+
+	vector<cam_entry> result;
+	uint32_t now = now_sec();
+	slot_t* table = slots.load(memory_order_relaxed);
+	uint32_t slot_count = slot_mask.load(memory_order_relaxed)+1;
+	for (uint32_t counter = 0; counter < slot_count; ++counter) {
+		uint64_t key = table[counter].key.load(memory_order_relaxed);
+		if (key == EMPTY_KEY || key == TOMBSTONE_KEY || (uint16_t) (key >> 48) != vlan_id) {
+			continue;
+		}
+
+		uint64_t value = table[counter].value.load(memory_order_relaxed);
+		uint32_t last_lookup = table[counter].last_lookup.load(memory_order_relaxed);
+
+		cam_entry entry;
+		entry.dl_address.set_from_uint64(key & 0xffffffffffffULL);
+		entry.vlan_id = vlan_id;
+		entry.phy_port = (uint16_t) (value & 0xffff);
+		entry.lookup_count = table[counter].lookup_count.load(memory_order_relaxed);
+		entry.sec_since_lookup = (last_lookup == 0 ? (uint32_t) -1 : now - last_lookup);
+		entry.sec_since_update = now - (uint32_t) (value >> 16);
+		result.push_back(entry);
+	}
+
+	sort(result.begin(), result.end(), [](const cam_entry& a, const cam_entry& b) { return a.dl_address < b.dl_address; });
+	return result;
+}
+
+// returns the (sampled) number of lookups
+uint64_t cam_table::get_lookup_count() const {
+	return lookups.load(memory_order_relaxed);
+}
+
+// returns the (sampled) number of lookups that did not find an entry
+uint64_t cam_table::get_lookup_miss_count() const {
+	return lookup_misses.load(memory_order_relaxed);
+}
+
+// packs a vlan and mac address into a table key
+uint64_t cam_table::make_key(const mac_address& dl_addr, uint16_t vlan_id) {
+	return (((uint64_t) vlan_id) << 48) | dl_addr.get_as_uint64();
+}
+
+// packs a port and timestamp into a table value
+uint64_t cam_table::make_value(uint16_t port, uint32_t timestamp) {
+	return (((uint64_t) timestamp) << 16) | port;
+}
+
+// mixes the key bits (64-bit finalizer from murmurhash3)
+uint32_t cam_table::hash_key(uint64_t key) {
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return (uint32_t) key;
+}
+
+// gets the number of slots (a power of two) to keep the load factor at 1/2
+uint32_t cam_table::get_slot_count_for(uint32_t capacity) {
+	uint32_t result = 1024;
+	while (result < capacity * 2) {
+		result <<= 1;
+	}
+	return result;
+}
+
+// allocates a zeroed, cache-aligned slot array
+cam_table::slot_t* cam_table::allocate_slots(uint32_t count) {
+	void* mem = nullptr;
+	if (posix_memalign(&mem, 64, sizeof(slot_t) * count) != 0) {
+		output::log(output::loglevel::CRITICAL, "cam_table::allocate_slots() -- unable to allocate %u slots.\n", count);
+		abort();
+	}
+
+	slot_t* result = (slot_t*) mem;
+	for (uint32_t counter = 0; counter < count; ++counter) {
+		new (&result[counter]) slot_t();
+		result[counter].key.store(EMPTY_KEY, memory_order_relaxed);
+		result[counter].value.store(0, memory_order_relaxed);
+		result[counter].lookup_count.store(0, memory_order_relaxed);
+		result[counter].last_lookup.store(0, memory_order_relaxed);
+		result[counter].aging_deadline = 0;
+		result[counter].reserved = 0;
+	}
+	return result;
+}
+
+// gets the current time in seconds (never 0, which means 'never')
+uint32_t cam_table::now_sec() const {
+	return (uint32_t) chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - epoch).count() + 1;
+}
+
+// checks if an entry value has not been refreshed within the timeout
+bool cam_table::is_expired(uint64_t value, uint32_t now) const {
+	return now - (uint32_t) (value >> 16) >= timeout_sec.load(memory_order_relaxed);
+}
+
+// locates the slot for a key, or nullptr if not present. readers must
+// validate the result against the sequence counter. slot_mask is read before
+// slots and the array only ever grows, so the mask never exceeds the array.
+cam_table::slot_t* cam_table::find_slot_unsafe(uint64_t key) const {
+	uint32_t mask = slot_mask.load(memory_order_acquire);
+	slot_t* table = slots.load(memory_order_acquire);
+	uint32_t index = hash_key(key) & mask;
+
+	for (uint32_t probe = 0; probe <= mask; ++probe) {
+		uint64_t current = table[index].key.load(memory_order_relaxed);
+		if (current == key) {
+			return &table[index];
+		} else if (current == EMPTY_KEY) {
+			return nullptr;
+		}
+		index = (index+1) & mask;
+	}
+	return nullptr;
+}
+
+// places a new key in the first free slot of its probe chain. caller holds
+// the write lock and has checked that the key is not present.
+cam_table::slot_t* cam_table::insert_slot_unsafe(slot_t* table, uint32_t mask, uint64_t key, uint64_t value,
+	uint32_t lookup_count, uint32_t last_lookup) {
+
+	uint32_t index = hash_key(key) & mask;
+	while (true) {
+		uint64_t current = table[index].key.load(memory_order_relaxed);
+		if (current == EMPTY_KEY || current == TOMBSTONE_KEY) {
+			if (current == TOMBSTONE_KEY) {
+				--num_tombstones;
+			}
+			table[index].value.store(value, memory_order_relaxed);
+			table[index].lookup_count.store(lookup_count, memory_order_relaxed);
+			table[index].last_lookup.store(last_lookup, memory_order_relaxed);
+			table[index].key.store(key, memory_order_relaxed);
+			num_entries.fetch_add(1, memory_order_relaxed);
+			return &table[index];
+		}
+		index = (index+1) & mask;
+	}
+}
+
+// marks a slot as deleted. caller holds the write lock inside write_begin()
+void cam_table::erase_slot_unsafe(slot_t* slot) {
+
+	// drop from the port index. any deadline left in the aging wheel goes stale
+	// and is discarded when it fires.
+	uint64_t key = slot->key.load(memory_order_relaxed);
+	auto iterator = port_index.find((uint16_t) (slot->value.load(memory_order_relaxed) & 0xffff));
+	if (iterator != port_index.end()) {
+		iterator->second.erase(key);
+		if (iterator->second.empty()) {
+			port_index.erase(iterator);
+		}
+	}
+
+	slot->key.store(TOMBSTONE_KEY, memory_order_relaxed);
+	slot->value.store(0, memory_order_relaxed);
+	num_entries.fetch_sub(1, memory_order_relaxed);
+	++num_tombstones;
+}
+
+// puts an entry's expiry deadline into the aging wheel. caller holds the
+// write lock.
+void cam_table::schedule_aging_unsafe(slot_t* slot, uint32_t deadline) {
+	slot->aging_deadline = aging_wheel.schedule(slot->key.load(memory_order_relaxed), deadline);
+}
+
+// advances the aging wheel to the current time. entries whose deadline fired
+// are removed if they were not refreshed meanwhile, or rescheduled otherwise.
+// caller holds the write lock.
+void cam_table::advance_aging_unsafe(uint32_t now) {
+
+	uint32_t timeout = timeout_sec.load(memory_order_relaxed);
+	vector<slot_t*> expired;
+	aging_wheel.advance(now, [this, now, timeout, &expired](uint64_t key, uint32_t deadline) {
+
+		// skip deadlines of removed or already rescheduled entries
+		slot_t* slot = find_slot_unsafe(key);
+		if (slot == nullptr || slot->aging_deadline != deadline) {
+			return;
+		}
+
+		uint64_t value = slot->value.load(memory_order_relaxed);
+		if (is_expired(value, now)) {
+			expired.push_back(slot);
 		} else {
-			++iterator;
+			schedule_aging_unsafe(slot, (uint32_t) (value >> 16) + timeout);
+		}
+	});
+	aging_tick.store(now, memory_order_relaxed);
+
+	if (expired.empty()) {
+		return;
+	}
+
+	write_begin();
+	for (const auto& slot : expired) {
+		erase_slot_unsafe(slot);
+	}
+	write_end();
+
+	uint32_t slot_count = slot_mask.load(memory_order_relaxed)+1;
+	if (num_tombstones * 4 > slot_count) {
+		rebuild_unsafe(slot_count);
+	}
+}
+
+// rebuilds the aging wheel from the timestamps of all live entries. caller
+// holds the write lock.
+void cam_table::reschedule_all_unsafe() {
+
+	uint32_t timeout = timeout_sec.load(memory_order_relaxed);
+	slot_t* table = slots.load(memory_order_relaxed);
+	uint32_t slot_count = slot_mask.load(memory_order_relaxed)+1;
+
+	aging_wheel.clear(aging_wheel.get_current_tick());
+	for (uint32_t counter = 0; counter < slot_count; ++counter) {
+		uint64_t key = table[counter].key.load(memory_order_relaxed);
+		if (key != EMPTY_KEY && key != TOMBSTONE_KEY) {
+			schedule_aging_unsafe(&table[counter], (uint32_t) (table[counter].value.load(memory_order_relaxed) >> 16) + timeout);
 		}
 	}
 }
 
-// retrieves a copy of the cam table
-map<mac_address, cam_entry> cam_table::get_cam_table() const {
-	return cam_mappings;
+// reinserts all live entries into a fresh array of the given size (which may
+// be the current array, to purge tombstones). caller holds the write lock.
+void cam_table::rebuild_unsafe(uint32_t new_slot_count) {
+
+	slot_t* old_table = slots.load(memory_order_relaxed);
+	uint32_t old_slot_count = slot_mask.load(memory_order_relaxed)+1;
+
+	// copy out live entries
+	struct live_entry_t { uint64_t key; uint64_t value; uint32_t lookup_count; uint32_t last_lookup; uint32_t aging_deadline; };
+	vector<live_entry_t> live_entries;
+	live_entries.reserve(num_entries.load(memory_order_relaxed));
+	for (uint32_t counter = 0; counter < old_slot_count; ++counter) {
+		uint64_t key = old_table[counter].key.load(memory_order_relaxed);
+		if (key != EMPTY_KEY && key != TOMBSTONE_KEY) {
+			live_entries.push_back({ key,
+				old_table[counter].value.load(memory_order_relaxed),
+				old_table[counter].lookup_count.load(memory_order_relaxed),
+				old_table[counter].last_lookup.load(memory_order_relaxed),
+				old_table[counter].aging_deadline });
+		}
+	}
+
+	slot_t* new_table = (new_slot_count == old_slot_count ? old_table : allocate_slots(new_slot_count));
+
+	write_begin();
+	if (new_table == old_table) {
+		for (uint32_t counter = 0; counter < old_slot_count; ++counter) {
+			old_table[counter].key.store(EMPTY_KEY, memory_order_relaxed);
+		}
+	}
+
+	num_entries.store(0, memory_order_relaxed);
+	num_tombstones = 0;
+	for (const auto& entry : live_entries) {
+		slot_t* slot = insert_slot_unsafe(new_table, new_slot_count-1, entry.key, entry.value, entry.lookup_count, entry.last_lookup);
+		slot->aging_deadline = entry.aging_deadline;
+	}
+
+	if (new_table != old_table) {
+		slots.store(new_table, memory_order_release);
+		slot_mask.store(new_slot_count-1, memory_order_release);
+		retired_slots.push_back(old_table);
+	}
+	write_end();
+}
+
+// enters a writer critical section (sequence becomes odd)
+void cam_table::write_begin() {
+	sequence.store(sequence.load(memory_order_relaxed)+1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+}
+
+// leaves a writer critical section (sequence becomes even)
+void cam_table::write_end() {
+	sequence.store(sequence.load(memory_order_relaxed)+1, memory_order_release);
+}
+
+// removes all entries for which predicate(key, value) holds. caller holds the
+// write lock.
+template <class predicate_t> uint32_t cam_table::remove_if_unsafe(predicate_t predicate) {
+
+	uint32_t removed = 0;
+	slot_t* table = slots.load(memory_order_relaxed);
+	uint32_t slot_count = slot_mask.load(memory_order_relaxed)+1;
+
+	write_begin();
+	for (uint32_t counter = 0; counter < slot_count; ++counter) {
+		uint64_t key = table[counter].key.load(memory_order_relaxed);
+		if (key != EMPTY_KEY && key != TOMBSTONE_KEY &&
+			predicate(key, table[counter].value.load(memory_order_relaxed))) {
+			erase_slot_unsafe(&table[counter]);
+			++removed;
+		}
+	}
+	write_end();
+
+	// purge tombstones if they make up a large part of the table
+	if (num_tombstones * 4 > slot_count) {
+		rebuild_unsafe(slot_count);
+	}
+	return removed;
 }
@@ -1,53 +1,65 @@
 #pragma once
 
-#include <map>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <stdint.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include "../../common/mac_address.h"
-#include "../../common/timer.h"
+#include "../../common/timer_wheel.h"
 using namespace std;
 
-// defines CAM entries and tables for use with the CAM service
-// vlan separated.
+// defines CAM entries and the flat CAM table used by the CAM service
 //
-// revision 1 (2/22/15)
-// by Z. Teo
+// all vlans share one open-addressing hash table keyed by a packed 64-bit
+// (vlan, mac) value. readers never take a lock: entries are read with atomic
+// loads and the table-wide sequence counter (a seqlock) is only made odd while
+// a writer adds, removes or relocates keys (compaction or resizing). writers
+// are serialized by a single mutex, but a refresh of an already-learned mac on
+// the same port is a lock-free timestamp update.
+//
+// entries are aged by a hierarchical timer wheel that holds each entry's
+// expiry deadline. refreshes do not touch the wheel: when a deadline fires, the
+// entry's actual timestamp is checked and the entry is either removed or
+// rescheduled. a port -> entry index lets a port flush visit only the macs
+// learned on that port.
+//
+// lookup statistics are sampled (one in every LOOKUP_SAMPLE_RATE lookups per
+// thread is recorded) so the lookup path does not write to shared cache lines.
+//
+// author: Z. Teo (zteo@cs.cornell.edu)
+// revision 2 (10/19/26)
 
+// readable copy of a cam entry (returned by get_cam_table())
 class cam_entry {
 public:
 
 	// default constructor
 	cam_entry():
-		valid(false),
+		vlan_id(0),
 		phy_port(0),
 		lookup_count(0),
-		update_count(0) {}
-
-	// shortcut constructor
-	cam_entry(const mac_address& addr, uint16_t port):
-		valid(true),
-		dl_address(addr),
-		phy_port(port),
-		lookup_count(0),
-		update_count(0) { last_updated.start(); }
+		sec_since_lookup(0),
+		sec_since_update(0) {}
 
 	// accessible fields
-	bool             valid;
 	mac_address      dl_address;
+	uint16_t         vlan_id;
 	uint16_t         phy_port;
 
-	mutable uint32_t lookup_count;
-	mutable timer    last_lookup;
-
-	uint32_t         update_count;
-	timer            last_updated;
+	uint32_t         lookup_count;      // sampled estimate
+	uint32_t         sec_since_lookup;  // -1 if never looked up
+	uint32_t         sec_since_update;
 };
 
-// an aggregation of cam entries
+// a flat table holding cam entries of all vlans
 class cam_table {
 public:
 
-	// default constructor
-	cam_table();
+	// constructor (capacity is the maximum number of entries across all vlans)
+	cam_table(uint32_t max_capacity=DEFAULT_MAX_CAPACITY);
 
 	// destructor
 	~cam_table();
@@ -56,33 +68,111 @@ public:
 	void     set_max_capacity(uint32_t max);
 	uint32_t get_max_capacity() const;
 	uint32_t get_available_capacity() const;
+	uint32_t size() const;
 
 	// entry timeout
 	void     set_timeout(uint32_t timeout_sec);
 	uint32_t get_timeout() const;
 
-	// clear the cam table (does not affect timeout or max capacity)
-	void     clear();
+	// vlan setup. entries can only be inserted into enabled vlans. disabling a
+	// vlan removes all of its entries.
+	bool     enable_vlan(uint16_t vlan_id);
+	bool     disable_vlan(uint16_t vlan_id);
+	void     disable_all_vlans();
+	bool     is_vlan_enabled(uint16_t vlan_id) const;
+	vector<uint16_t> get_vlans() const;
 
-	// remove entries that are stale
+	// clear entries (does not affect timeout, capacity or enabled vlans)
+	void     clear(uint16_t vlan_id);
+	void     clear_all();
+
+	// remove entries that are stale. cheap if called repeatedly within the same
+	// second, so it can be driven from the packet path.
 	void     do_garbage_collection();
 
-	// returns uint16_t port or -1 if no port found
-	int      lookup_port_for(const mac_address& dest) const;
-	
+	// returns uint16_t port or -1 if no port found (lock-free)
+	int      lookup_port_for(const mac_address& dest, uint16_t vlan_id) const;
+
 	// insert and delete
-	bool     insert(const mac_address& dl_addr, uint16_t port);
-	void     remove(const mac_address& dl_addr);
+	bool     insert(const mac_address& dl_addr, uint16_t vlan_id, uint16_t port);
+	void     remove(const mac_address& dl_addr, uint16_t vlan_id);
 	void     remove(uint16_t port);
-	
-	// retrieves a copy of the cam table. very expensive operation!
-	map<mac_address, cam_entry> get_cam_table() const;
+
+	// retrieves a copy of the cam entries for a vlan. expensive operation!
+	vector<cam_entry> get_cam_table(uint16_t vlan_id) const;
+
+	// sampled lookup counters (estimates)
+	uint64_t get_lookup_count() const;
+	uint64_t get_lookup_miss_count() const;
+
+	static const uint32_t DEFAULT_MAX_CAPACITY = 131072;
+	static const uint32_t LOOKUP_SAMPLE_RATE = 64;
 
 private:
 
-	uint32_t                    max_capacity;
-	uint32_t                    timeout_sec;
-	map<mac_address, cam_entry> cam_mappings;
+	// a single table slot (32 bytes, two per cache line). key changes are made
+	// inside a sequence (seqlock) write section; the value (port and
+	// timestamp) is always replaced by a single atomic store.
+	struct alignas(32) slot_t {
+		atomic<uint64_t> key;           // packed (vlan, mac), or EMPTY/TOMBSTONE
+		atomic<uint64_t> value;         // phy_port | (last_updated_sec << 16)
+		atomic<uint32_t> lookup_count;  // sampled
+		atomic<uint32_t> last_lookup;   // seconds since table epoch, 0 = never
+		uint32_t         aging_deadline;// deadline held in the aging wheel
+		uint32_t         reserved;
+	};
+
+	static const uint64_t EMPTY_KEY = 0;
+	static const uint64_t TOMBSTONE_KEY = ~((uint64_t) 0);
+
+	uint32_t                   max_capacity;
+	atomic<uint32_t>           timeout_sec;
+
+	// slot array. replaced only by resizing, in which case the retired array
+	// is kept until destruction because lock-free readers may still hold it.
+	atomic<slot_t*>            slots;
+	atomic<uint32_t>           slot_mask;
+	vector<slot_t*>            retired_slots;
+
+	// writer state
+	mutable mutex              write_lock;
+	atomic<uint32_t>           sequence;
+	atomic<uint32_t>           num_entries;
+	uint32_t                   num_tombstones;
+
+	// aging wheel (ticks are seconds since the table epoch) and port index
+	timer_wheel<uint64_t>      aging_wheel;
+	atomic<uint32_t>           aging_tick;
+	unordered_map<uint16_t, unordered_set<uint64_t>> port_index;
+
+	// enabled vlans (one bit per vlan id)
+	atomic<uint64_t>           vlan_mask[4096/64];
+
+	// sampled statistics
+	mutable atomic<uint64_t>   lookups;
+	mutable atomic<uint64_t>   lookup_misses;
+
+	// time base for the compact timestamps
+	chrono::steady_clock::time_point epoch;
+
+	// helper functions
+	static uint64_t make_key(const mac_address& dl_addr, uint16_t vlan_id);
+	static uint64_t make_value(uint16_t port, uint32_t timestamp);
+	static uint32_t hash_key(uint64_t key);
+	static uint32_t get_slot_count_for(uint32_t capacity);
+	static slot_t*  allocate_slots(uint32_t count);
+
+	uint32_t now_sec() const;
+	bool     is_expired(uint64_t value, uint32_t now) const;
+	slot_t*  find_slot_unsafe(uint64_t key) const;
+	slot_t*  insert_slot_unsafe(slot_t* table, uint32_t mask, uint64_t key, uint64_t value, uint32_t lookup_count, uint32_t last_lookup);
+	void     erase_slot_unsafe(slot_t* slot);
+	void     schedule_aging_unsafe(slot_t* slot, uint32_t deadline);
+	void     advance_aging_unsafe(uint32_t now);
+	void     reschedule_all_unsafe();
+	void     rebuild_unsafe(uint32_t new_slot_count);
+	void     write_begin();
+	void     write_end();
+	template <class predicate_t> uint32_t remove_if_unsafe(predicate_t predicate);
 };
 
-
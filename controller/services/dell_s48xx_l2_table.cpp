@@ -20,9 +20,8 @@ bool dell_s48xx_l2_table::check_table_fit(const of_match& criteria,
 		criteria.wildcard_tcpudp_src_port &&
 		criteria.wildcard_tcpudp_dest_port) {
 
-		vector<unique_ptr<of_action>> actions = action_list.get_actions();
-		if (actions.size() != 1 ||
-			actions[0]->get_action_type() != of_action::action_type::OUTPUT_TO_PORT) {
+		if (action_list.size() != 1 ||
+			action_list.get_action_type(0) != of_action::action_type::OUTPUT_TO_PORT) {
 			return false;
 		} else {
 			return true;
@@ -0,0 +1,113 @@
+#include "flood_plan_cache.h"
+#include "../ironstack_types/openflow_action_list.h"
+
+// returns the plan for a flood, building it if it is missing or stale
+shared_ptr<const flood_plan> flood_plan_cache::get_plan(const shared_ptr<const switch_port_snapshot>& snapshot,
+	uint16_t vlan_id, uint16_t in_port, bool tagged_ingress) {
+
+	uint64_t key = make_key(vlan_id, in_port, tagged_ingress);
+	{
+		lock_guard<mutex> g(lock);
+		auto iterator = plans.find(key);
+		if (iterator != plans.end() && iterator->second->version == snapshot->get_version()) {
+			return iterator->second;
+		}
+	}
+
+	// build outside the lock; a concurrent builder just produces the same plan
+	shared_ptr<const flood_plan> plan = build_plan(*snapshot, vlan_id, in_port, tagged_ingress);
+	{
+		lock_guard<mutex> g(lock);
+		shared_ptr<const flood_plan>& cached = plans[key];
+		if (cached == nullptr || cached->version < plan->version) {
+			cached = plan;
+		}
+	}
+	return plan;
+}
+
+// drops all cached plans
+void flood_plan_cache::clear() {
+	lock_guard<mutex> g(lock);
+	plans.clear();
+}
+
+// drops the cached plans of a vlan
+void flood_plan_cache::clear(uint16_t vlan_id) {
+	lock_guard<mutex> g(lock);
+	auto iterator = plans.begin();
+	while (iterator != plans.end()) {
+		if (iterator->second->vlan_id == vlan_id) {
+			iterator = plans.erase(iterator);
+		} else {
+			++iterator;
+		}
+	}
+}
+
+// returns the number of cached plans
+size_t flood_plan_cache::size() const {
+	lock_guard<mutex> g(lock);
+	return plans.size();
+}
+
+// drops the plans of the vlans a modified port belongs to
+void flood_plan_cache::switch_port_modification_callback(const openflow_vlan_port& port) {
+	port.get_vlan_mask().for_each([this](uint16_t vlan_id) {
+		clear(vlan_id);
+	});
+}
+
+// generates the cache key for a plan
+uint64_t flood_plan_cache::make_key(uint16_t vlan_id, uint16_t in_port, bool tagged_ingress) {
+	return (((uint64_t) vlan_id) << 17) | (((uint64_t) tagged_ingress) << 16) | in_port;
+}
+
+// builds a plan from the switch port snapshot
+shared_ptr<const flood_plan> flood_plan_cache::build_plan(const switch_port_snapshot& snapshot,
+	uint16_t vlan_id, uint16_t in_port, bool tagged_ingress) {
+
+	shared_ptr<flood_plan> plan(new flood_plan());
+	plan->version = snapshot.get_version();
+	plan->vlan_id = vlan_id;
+	plan->in_port = in_port;
+	plan->tagged_ingress = tagged_ingress;
+
+	// all member ports of the vlan except the ingress port
+	port_mask ingress_port = port_mask::single(in_port);
+	plan->untagged_ports = snapshot.get_untagged_ports(vlan_id).and_not(ingress_port);
+	plan->tagged_ports = snapshot.get_tagged_ports(vlan_id).and_not(ingress_port);
+
+	// output on the ports that take the packet as-is first, then retag and
+	// output on the rest
+	const port_mask& as_is_ports = (tagged_ingress ? plan->tagged_ports : plan->untagged_ports);
+	const port_mask& retagged_ports = (tagged_ingress ? plan->untagged_ports : plan->tagged_ports);
+
+	openflow_action_list action_list;
+	as_is_ports.for_each([&action_list](uint16_t port) {
+		of_action_output_to_port action;
+		action.port = port;
+		action_list.add_action(action);
+	});
+	if (retagged_ports.any()) {
+		if (tagged_ingress) {
+			action_list.add_action(of_action_strip_vlan());
+		} else {
+			of_action_set_vlan_id action;
+			action.vlan_id = vlan_id;
+			action_list.add_action(action);
+		}
+		retagged_ports.for_each([&action_list](uint16_t port) {
+			of_action_output_to_port action;
+			action.port = port;
+			action_list.add_action(action);
+		});
+	}
+	action_list.serialize(plan->actions);
+
+	// packet_outs share the refcounted bytes, so they stay valid after the plan
+	// is evicted
+	plan->actions = plan->actions.copy_as_refcounted();
+
+	return plan;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <unordered_map>
+#include "switch_state.h"
+#include "../../common/autobuf.h"
+using namespace std;
+
+// flood plans
+//
+// a flood plan is the ready-to-send form of flooding a vlan from one ingress
+// port: the untagged and tagged output ports, and a pre-serialized openflow
+// action list that outputs the packet as-is on the ports matching its ingress
+// tagging, then adds (set_vlan) or strips (strip_vlan) the tag and outputs it
+// on the other ports. a flood then costs one cache lookup and one packet_out.
+//
+// plans are built lazily from the switch port snapshot and carry the snapshot
+// version they were built from. port modifications drop the plans of the
+// affected vlans through switch_port_modification_callbacks; vlan setup
+// changes, which do not raise callbacks, are caught by the version check.
+//
+// revision 1 (10/19/26)
+
+// a precomputed flood
+class flood_plan {
+public:
+	flood_plan():version(0), vlan_id(0), in_port(0), tagged_ingress(false) {}
+
+	uint64_t        version;          // switch port snapshot version
+	uint16_t        vlan_id;
+	uint16_t        in_port;
+	bool            tagged_ingress;   // the packet to flood carries the vlan tag
+
+	port_mask       untagged_ports;
+	port_mask       tagged_ports;
+	autobuf         actions;          // serialized openflow actions, refcounted (empty if nothing to flood)
+};
+
+// cache of flood plans keyed by (vlan, ingress port, ingress tagging)
+class flood_plan_cache : public switch_port_modification_callbacks {
+public:
+
+	// ingress port used for packets originating from the controller
+	static const uint16_t NO_INGRESS_PORT = 0xffff;
+
+	// returns the plan for a flood, building it if it is missing or stale
+	shared_ptr<const flood_plan> get_plan(const shared_ptr<const switch_port_snapshot>& snapshot,
+		uint16_t vlan_id, uint16_t in_port, bool tagged_ingress);
+
+	// drops cached plans
+	void   clear();
+	void   clear(uint16_t vlan_id);
+	size_t size() const;
+
+	// drops the plans of the vlans a modified port belongs to
+	virtual void switch_port_modification_callback(const openflow_vlan_port& port);
+
+private:
+
+	mutable mutex lock;
+	unordered_map<uint64_t, shared_ptr<const flood_plan>> plans;
+
+	static uint64_t make_key(uint16_t vlan_id, uint16_t in_port, bool tagged_ingress);
+	static shared_ptr<const flood_plan> build_plan(const switch_port_snapshot& snapshot,
+		uint16_t vlan_id, uint16_t in_port, bool tagged_ingress);
+};
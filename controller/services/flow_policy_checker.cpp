@@ -33,33 +33,8 @@ void flow_policy_checker::shutdown() {
 // installs an accelerating rule for the src mac --> phy port pair
 bool flow_policy_checker::accelerate_flow(const mac_address& src_mac, uint16_t vlan_id, uint16_t phy_port) {
 
-	//char buf[128];
-	of_match criteria;
-	openflow_action_list actions;
-
-	// set dl_dest and vlan
-	criteria.wildcard_all();
-	criteria.wildcard_ethernet_dest = false;
-	criteria.ethernet_dest = src_mac;
-	criteria.wildcard_vlan_id = false;
-	criteria.vlan_id = vlan_id;
-
-	// output to single port
-	of_action_output_to_port action;
-	action.send_to_controller = false;
-	action.port = phy_port;
-	actions.add_action(action);
-
-	/* old code disabled
-	// make this faster by instantiating the right subclasses
-	sprintf(buf, "dl_dest=%s vlan_id=%hu", src_mac.to_string().c_str(), vlan_id);
-	criteria.from_string(buf);
-	sprintf(buf, "out_port=%hu", phy_port);
-	actions.from_string(buf);
-	*/
-
 	/* debugging only
-	output::log(output::loglevel::INFO, "flow_policy: installing acceleration rule for [%s] --> phy_port [%hu] on vlan [%hu]\n",
+	OUTPUT_LOG(INFO, "flow_policy: installing acceleration rule for [%s] --> phy_port [%hu] on vlan [%hu]\n",
 		src_mac.to_string().c_str(),
 		phy_port,
 		vlan_id);
@@ -71,7 +46,8 @@ bool flow_policy_checker::accelerate_flow(const mac_address& src_mac, uint16_t v
 		return false;
 	}
 
-	return (flow_svc->add_flow_auto(criteria, actions, "l2 accelerator", false, 0)) != ((uint64_t) -1);
+	// dl_dest + vlan --> single output port, written from the l2 template
+	return (flow_svc->add_l2_flow(src_mac, vlan_id, phy_port, "l2 accelerator", false, 0)) != ((uint64_t) -1);
 }
 
 // fowards a packet after doing policy checks
@@ -122,7 +98,7 @@ bool flow_policy_checker::filter_packet(const shared_ptr<of_message_packet_in>&
 
 	// can't process packets if any of these services are offline
 	if (cam_svc == nullptr || switch_state_svc == nullptr) {
-		output::log(output::loglevel::WARNING, "flow_policy_checker::filter_packet() failed -- CAM/switch state service offline. packet ignored.\n");
+		OUTPUT_LOG_LIMITED(WARNING, "flow_policy_checker::filter_packet() failed -- CAM/switch state service offline. packet ignored.\n");
 		return false;
 	}
 
@@ -132,7 +108,7 @@ bool flow_policy_checker::filter_packet(const shared_ptr<of_message_packet_in>&
 		// construct L2 flow rule for the given source
 		int vlan_id = ironstack::net_utils::get_vlan_from_packet(switch_state_svc, packet, raw_pkt);
 		if (!accelerate_flow(raw_pkt.src_mac, vlan_id, packet->in_port)) {
-			output::log(output::loglevel::WARNING, "flow_poicy_checker::filter_packet() -- cannot accelerate the L2 flow.\n");
+			OUTPUT_LOG_LIMITED(WARNING, "flow_poicy_checker::filter_packet() -- cannot accelerate the L2 flow.\n");
 		}
 /*
 		char buf[128];
@@ -143,7 +119,7 @@ bool flow_policy_checker::filter_packet(const shared_ptr<of_message_packet_in>&
 		sprintf(buf, "out_port=%hu", (uint16_t) packet->in_port);
 		actions.from_string(buf);
 
-		output::log(output::loglevel::INFO, "flow_policy: installing rule for [%s] vlan [%hu] to out_port [%hu]\n",
+		OUTPUT_LOG(INFO, "flow_policy: installing rule for [%s] vlan [%hu] to out_port [%hu]\n",
 			raw_pkt.src_mac.to_string().c_str(),
 			vlan_id,
 			packet->in_port);
@@ -24,6 +24,23 @@ bool flow_service::init() {
 		assert(0);
 		abort();
 	}
+
+	// template for the l2 rules installed with the default priority and timeouts
+	// (dl_dest + vlan --> output port)
+	if (l2_template == nullptr) {
+		openflow_flow_description prototype;
+		prototype.criteria.wildcard_all();
+		prototype.criteria.wildcard_ethernet_dest = false;
+		prototype.criteria.wildcard_vlan_id = false;
+		of_action_output_to_port output;
+		prototype.action_list.add_action(output);
+		prototype.priority = default_priority;
+
+		shared_ptr<of_flow_mod_template> result = make_shared<of_flow_mod_template>();
+		if (result->set(*get_install_request(prototype, default_idle_timeout, default_hard_timeout))) {
+			l2_template = result;
+		}
+	}
 	
 	return true;
 }
@@ -293,6 +310,32 @@ uint64_t flow_service::add_flow_auto(const of_match& criteria, const openflow_ac
 
 // adds a fully specified flow with custom idle and hard timeout
 uint64_t flow_service::add_flow(const openflow_flow_description& description, const string& reason, uint16_t idle_timeout, uint16_t hard_timeout, bool is_static, int install_timeout_ms) {
+	return install_flow(description, reason, idle_timeout, hard_timeout, is_static, install_timeout_ms, false);
+}
+
+// adds an l2 rule with the default priority and timeouts
+uint64_t flow_service::add_l2_flow(const mac_address& dl_dest, uint16_t vlan_id, uint16_t out_port, const string& reason, bool is_static, int install_timeout_ms) {
+	openflow_flow_description description;
+	description.criteria.wildcard_all();
+	description.criteria.wildcard_ethernet_dest = false;
+	description.criteria.ethernet_dest = dl_dest;
+	description.criteria.wildcard_vlan_id = false;
+	description.criteria.vlan_id = vlan_id;
+
+	of_action_output_to_port output;
+	output.send_to_controller = false;
+	output.port = out_port;
+	description.action_list.add_action(output);
+	description.priority = default_priority;
+	description.cookie = flow_table::get_next_available_cookie_id();
+
+	return install_flow(description, reason, default_idle_timeout, default_hard_timeout, is_static, install_timeout_ms, true);
+}
+
+// adds a flow. flows built to the l2 template's shape are serialized from it
+// without being checked
+uint64_t flow_service::install_flow(const openflow_flow_description& description, const string& reason, uint16_t idle_timeout,
+	uint16_t hard_timeout, bool is_static, int install_timeout_ms, bool l2_shape) {
 
 	{
 		lock_guard<mutex> g(lock);
@@ -334,17 +377,8 @@ uint64_t flow_service::add_flow(const openflow_flow_description& description, co
 			}
 
 			// construct the hal request
-			output::log(output::loglevel::INFO, "flow_service::add_flow() adding flow:\n[%s]\n", description.to_string().c_str());
-			shared_ptr<of_message_modify_flow> request(new of_message_modify_flow());
-			request->flow_description = description;
-			request->command = OFPFC_MODIFY_STRICT;
-			request->idle_timeout = idle_timeout;
-			request->hard_timeout = hard_timeout;
-			request->buffer_id = -1;
-			request->use_out_port = false;
-			request->flag_send_flow_removal_message = true;
-			request->flag_check_overlap = true;
-			request->flag_emergency_flow = false;
+			shared_ptr<of_message_modify_flow> request = get_install_request(description, idle_timeout, hard_timeout);
+			request->template_shape_known = l2_shape && l2_template != nullptr;
 
 			// setup for timed callback params
 			shared_ptr<hal_transaction> transaction;
@@ -384,6 +418,25 @@ uint64_t flow_service::add_flow(const openflow_flow_description& description, co
 	return ((uint64_t) -1);
 }
 
+// builds the flow_mod that installs a flow. l2 rules of the template's shape
+// are serialized from the template
+shared_ptr<of_message_modify_flow> flow_service::get_install_request(const openflow_flow_description& description,
+	uint16_t idle_timeout, uint16_t hard_timeout) const {
+
+	shared_ptr<of_message_modify_flow> request(new of_message_modify_flow());
+	request->flow_description = description;
+	request->command = OFPFC_MODIFY_STRICT;
+	request->idle_timeout = idle_timeout;
+	request->hard_timeout = hard_timeout;
+	request->buffer_id = -1;
+	request->use_out_port = false;
+	request->flag_send_flow_removal_message = true;
+	request->flag_check_overlap = true;
+	request->flag_emergency_flow = false;
+	request->serialization_template = l2_template;
+	return request;
+}
+
 // removes a flow from the flow table. strict matching criteria
 uint64_t flow_service::remove_flow_strict(const openflow_flow_description& flow) {
 	return remove_flow(flow.cookie);
@@ -537,7 +590,7 @@ void flow_service::flow_update_handler(const of_message_stats_reply_flow_stats&
 	uint32_t flows_received = pending_flows.size();
 	for (auto& flow_table : flow_tables) {
 		flows_installed = flow_table->update_entries(pending_flows);
-		output::log(output::loglevel::INFO, "flow service: %u flow(s) updated in table %s.\n", flows_installed, flow_table->get_table_name().c_str());
+		OUTPUT_LOG(INFO, "flow service: %u flow(s) updated in table %s.\n", flows_installed, flow_table->get_table_name().c_str());
 		total_flows_installed += flows_installed;
 	}
 
@@ -621,7 +674,8 @@ void flow_service_port_mod_callback::switch_port_modification_callback(const ope
 					continue;
 				}
 
-				auto action_list = flow.description.action_list.get_actions();
+				const openflow_action_list& action_list = flow.description.action_list;
+				of_action_output_to_port output;
 				bool to_delete = false;
 				bool is_l2_flow = false;
 				uint16_t vlan_id=0;
@@ -630,9 +684,8 @@ void flow_service_port_mod_callback::switch_port_modification_callback(const ope
 				// check if this flow should be deleted on the basis of its port getting invalidated
 				// TODO -- to be more generic, should analyze each action set and remove only the action that outputs to this port
 				if (action_list.size() == 1) {
-					if (action_list.front()->get_action_type() == of_action::action_type::OUTPUT_TO_PORT) {
-						of_action_output_to_port* ptr = (of_action_output_to_port*) action_list.front().get();
-						if (ptr->port == port.get_openflow_port().port_number) {
+					if (action_list.get_action(0, output)) {
+						if (output.port == port.get_openflow_port().port_number) {
 							// should delete this flow
 							to_delete = true;
 
@@ -659,7 +712,7 @@ void flow_service_port_mod_callback::switch_port_modification_callback(const ope
 
 						// remove affected flow since output port is the port that has been taken down
 						if (to_delete) {
-							output::log(output::loglevel::INFO, "removing [%s] because port %hu is down.\n", flow.to_string().c_str(), port.get_openflow_port().port_number);
+							OUTPUT_LOG(INFO, "removing [%s] because port %hu is down.\n", flow.to_string().c_str(), port.get_openflow_port().port_number);
 							flow_svc->remove_flow(flow.description.cookie);
 						}
 
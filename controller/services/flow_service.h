@@ -7,6 +7,7 @@
 #include "flow_table.h"
 #include "switch_state.h"
 #include "../ironstack_types/openflow_flow_entry.h"
+#include "../openflow_messages/of_flow_mod_template.h"
 #include "../openflow_messages/of_message_flow_removed.h"
 #include "../openflow_messages/of_message_stats_reply.h"
 #include "../hal/hal.h"
@@ -86,6 +87,11 @@ public:
 	// adds a flow (completely specified). returns cookie ID
 	uint64_t add_flow(const openflow_flow_description& flow, const string& reason, uint16_t idle_timeout, uint16_t hard_timeout, bool is_static=false, int install_timeout_ms=-1);
 
+	// adds an l2 rule (dl_dest + vlan --> output port) with the default priority
+	// and timeouts. the rule is written straight from the l2 template, so this
+	// is the fast path for the accelerators. returns cookie ID
+	uint64_t add_l2_flow(const mac_address& dl_dest, uint16_t vlan_id, uint16_t out_port, const string& reason, bool is_static=false, int install_timeout_ms=-1);
+
 	// removes a specific flow. this is the strict matching criteria
 	uint64_t remove_flow_strict(const openflow_flow_description& flow);
 
@@ -130,6 +136,17 @@ private:
 
 	shared_ptr<flow_service_port_mod_callback>  port_cob;       // callback object for port changes
 
+	shared_ptr<const of_flow_mod_template>      l2_template;    // serialized form of the l2 rules the
+	                                                            // accelerators install (built by init())
+
+	// adds a flow. l2_shape is set if the flow was built to the l2 template's shape
+	uint64_t install_flow(const openflow_flow_description& description, const string& reason, uint16_t idle_timeout,
+		uint16_t hard_timeout, bool is_static, int install_timeout_ms, bool l2_shape);
+
+	// builds the flow_mod that installs a flow
+	shared_ptr<of_message_modify_flow> get_install_request(const openflow_flow_description& description,
+		uint16_t idle_timeout, uint16_t hard_timeout) const;
+
 	const uint16_t default_priority       = 100;
 	const uint16_t default_idle_timeout   = 0; // TODO: made permanent for now  // 10 minutes
 	const uint16_t default_hard_timeout   = 0; // TODO: made permanent for now // half an hour
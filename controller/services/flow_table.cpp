@@ -31,7 +31,7 @@ uint32_t flow_table::get_used_capacity() {
 			++iterator;
 			++result;
 		} else if (iterator->second.get_time_since_update_ms() >= DELETED_ENTRY_TIMEOUT) {
-			iterator = flows.erase(iterator);
+			iterator = erase_entry(iterator);
 		}
 	}
 
@@ -49,7 +49,7 @@ uint32_t flow_table::get_available_capacity() {
 			++iterator;
 			++used;
 		} else if (iterator->second.get_time_since_update_ms() >= DELETED_ENTRY_TIMEOUT) {
-			iterator = flows.erase(iterator);
+			iterator = erase_entry(iterator);
 		}
 	}
 
@@ -64,12 +64,12 @@ uint32_t flow_table::get_available_capacity() {
 void flow_table::clear_table(bool include_static) {
 	lock_guard<mutex> g(table_lock);
 	if (!include_static) {
-		flows.clear();
+		clear_entries();
 	} else {
 		auto iterator = flows.begin();
 		while (iterator != flows.end()) {
 			if (!iterator->second.is_static()) {
-				iterator = flows.erase(iterator);
+				iterator = erase_entry(iterator);
 			} else {
 				++iterator;
 			}
@@ -115,27 +115,29 @@ openflow_flow_entry flow_table::get_flow_entry_status(uint64_t cookie) const {
 }
 */
 
-// returns the cookie id for a given flow description. if the cookie is set,
-// the search will check based on the cookie ID. otherwise this is a linear search
-// and is potentially very slow!
+// returns the cookie id for a given flow description. the flows with the same
+// packed criteria are looked up in the criteria index, then compared in full.
 uint64_t flow_table::get_cookie_for_flow(const openflow_flow_description& flow) const {
 
+	of_packed_match criteria(flow.criteria);
 	lock_guard<mutex> g(table_lock);
 
 	// look for the most recent flow matching the description
 	uint64_t result = ((uint64_t) -1);
 	bool found = false;
-	for (const auto& one_flow : flows) {
-		if (one_flow.second.description == flow) {
+	auto candidates = criteria_index.equal_range(criteria);
+	for (auto candidate = candidates.first; candidate != candidates.second; ++candidate) {
+		auto one_flow = flows.find(candidate->second);
+		if (one_flow != flows.end() && one_flow->second.description == flow) {
 			if (!found) {
 				found = true;
-				result = one_flow.second.description.cookie;
-//				output::log(output::loglevel::INFO, "flow_table::get_cookie_for_flow() -- found cookie %" PRIu64 " state: %s\n", result, one_flow.second.get_state_string().c_str());
+				result = one_flow->second.description.cookie;
+//				output::log(output::loglevel::INFO, "flow_table::get_cookie_for_flow() -- found cookie %" PRIu64 " state: %s\n", result, one_flow->second.get_state_string().c_str());
 
 			// take the latest cookie ID, since that is the most recent flow entry
-			} else if (one_flow.second.description.cookie > result) {
-				result = one_flow.second.description.cookie;
-//				output::log(output::loglevel::INFO, "flow_table::get_cookie_for_flow() -- found cookie %" PRIu64 " state: %s\n", result, one_flow.second.get_state_string().c_str());
+			} else if (one_flow->second.description.cookie > result) {
+				result = one_flow->second.description.cookie;
+//				output::log(output::loglevel::INFO, "flow_table::get_cookie_for_flow() -- found cookie %" PRIu64 " state: %s\n", result, one_flow->second.get_state_string().c_str());
 			}
 		}
 	}
@@ -168,7 +170,7 @@ bool flow_table::add_entry(const openflow_flow_entry& entry) {
 	if (flows.size() >= max_capacity) {
 		return false;
 	} else {
-		flows[entry.description.cookie] = entry;
+		insert_entry(entry);
 		return true;
 	}
 }
@@ -222,7 +224,7 @@ uint32_t flow_table::update_entries(vector<openflow_flow_description_and_stats>&
 			entry.install_reason = "inherited";
 			entry.is_updated = true;
 			
-			flows[cookie] = move(entry);
+			insert_entry(entry);
 		}
 
 		// the flow has been processed for this table and should be removed so the next table won't see this flow
@@ -244,13 +246,13 @@ uint32_t flow_table::update_entries(vector<openflow_flow_description_and_stats>&
 
 			// let deleted flows linger around for a while until we purge them (after 5 seconds)
 			} else if (current_flow.state == openflow_flow_entry::flow_state::DELETED && current_flow.last_updated.get_time_elapsed_ms() > DELETED_ENTRY_TIMEOUT) {
-				flow_iterator = flows.erase(flow_iterator);
+				flow_iterator = erase_entry(flow_iterator);
 
 			// flow wasn't marked as deleted, but it disappeared!
 			} else {
 				output::log(output::loglevel::BUG, "flow_table::update_entries() -- flow was not designated for removal but does not appear in update list! the flow was [%s].\n",
 					current_flow.to_string().c_str());
-				flow_iterator = flows.erase(flow_iterator);
+				flow_iterator = erase_entry(flow_iterator);
 			}
 
 		// reset the flag for the next refresh cycle
@@ -364,6 +366,36 @@ map<uint64_t, openflow_flow_entry> flow_table::get_all_flows_map() const {
 	return flows;
 }
 
+// stores an entry under its cookie and indexes its criteria (table lock must
+// be held)
+void flow_table::insert_entry(const openflow_flow_entry& entry) {
+	auto iterator = flows.find(entry.description.cookie);
+	if (iterator != flows.end()) {
+		erase_entry(iterator);
+	}
+	flows[entry.description.cookie] = entry;
+	criteria_index.emplace(of_packed_match(entry.description.criteria), entry.description.cookie);
+}
+
+// removes an entry and its index record. returns the next entry (table lock
+// must be held)
+map<uint64_t, openflow_flow_entry>::iterator flow_table::erase_entry(map<uint64_t, openflow_flow_entry>::iterator iterator) {
+	auto candidates = criteria_index.equal_range(of_packed_match(iterator->second.description.criteria));
+	for (auto candidate = candidates.first; candidate != candidates.second; ++candidate) {
+		if (candidate->second == iterator->first) {
+			criteria_index.erase(candidate);
+			break;
+		}
+	}
+	return flows.erase(iterator);
+}
+
+// removes all entries (table lock must be held)
+void flow_table::clear_entries() {
+	flows.clear();
+	criteria_index.clear();
+}
+
 // handles callbacks from HAL to update transactions that have completed
 void flow_table::hal_callback(const shared_ptr<hal_transaction>& transaction,
 	const shared_ptr<of_message>& reply, bool status) {
@@ -378,7 +410,7 @@ void flow_table::hal_callback(const shared_ptr<hal_transaction>& transaction,
 
 				// add or modify rule was successful. set the openflow entry flag
 				if (mark_entry_as_installed(msg->flow_description.cookie)) {
-					output::log(output::loglevel::INFO, "flow_table::hal_callback() -- flow added successfully:\n%s.\n",
+					OUTPUT_LOG(INFO, "flow_table::hal_callback() -- flow added successfully:\n%s.\n",
 						msg->flow_description.to_string().c_str());
 				} else {
 					output::log(output::loglevel::BUG, "flow_table::hal_callback() add flow successful, but could not mark table entry as active:\n%s.\n",
@@ -403,7 +435,7 @@ void flow_table::hal_callback(const shared_ptr<hal_transaction>& transaction,
 			if (reply == nullptr || reply->msg_type == OFPT_FLOW_REMOVED) {
 
 				// remove was successful. mark the flow as deleted in the table
-				output::log(output::loglevel::INFO, "flow_table::hal_callback() -- flow removed:\n%s\n", msg->flow_description.to_string().c_str());
+				OUTPUT_LOG(INFO, "flow_table::hal_callback() -- flow removed:\n%s\n", msg->flow_description.to_string().c_str());
 				mark_entry_as_deleted(msg->flow_description.cookie);
 
 			} else if (reply->msg_type == OFPT_ERROR) {
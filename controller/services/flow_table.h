@@ -4,7 +4,9 @@
 
 #include <map>
 #include <stdint.h>
+#include <unordered_map>
 #include "../ironstack_types/openflow_flow_entry.h"
+#include "../openflow_types/of_packed_match.h"
 #include "../openflow_messages/of_message_error.h"
 #include "../openflow_messages/of_message_flow_removed.h"
 #include "../openflow_messages/of_message_modify_flow.h"
@@ -42,6 +44,7 @@ public:
 	// checks if a flow is currently installed with the flow descriptions
 	// flows that are pending delete or pending install will still be considered
 	// installed. cookie IDs are 0xffffffffffffffff (ie -1) if not installed.
+	// candidates are found through a hashed index on the packed criteria.
 	uint64_t     get_cookie_for_flow(const openflow_flow_description& flow) const;
 	uint64_t     get_cookie_for_flow(const of_match& criteria,
                  const openflow_action_list& action_list) const;
@@ -100,6 +103,14 @@ protected:
 	uint32_t                           max_capacity;
 	map<uint64_t, openflow_flow_entry> flows;
 
+	// cookies of the flows, keyed by packed criteria (kept in step with flows)
+	unordered_multimap<of_packed_match, uint64_t, of_packed_match::hasher> criteria_index;
+
+	// helpers that keep the criteria index in step (table lock must be held)
+	void                               insert_entry(const openflow_flow_entry& entry);
+	map<uint64_t, openflow_flow_entry>::iterator erase_entry(map<uint64_t, openflow_flow_entry>::iterator iterator);
+	void                               clear_entries();
+
 	// static cookie counters for all flow tables
 	static mutex                       cookie_lock;
 	static uint64_t                    next_available_cookie_id;
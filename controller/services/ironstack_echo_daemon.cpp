@@ -47,6 +47,7 @@ void ironstack::echo_daemon::shutdown() {
 	for (const auto& it : wait_queue) {
 		unique_lock<mutex> m(it.second->lock);
 		it.second->status = false;
+		it.second->completed = true;
 		it.second->cond.notify_all();
 	}
 
@@ -120,6 +121,7 @@ bool ironstack::echo_daemon::filter_packet(const shared_ptr<of_message_packet_in
 		// notify the caller
 		unique_lock<mutex> m(request->lock);
 		request->status = true;
+		request->completed = true;
 		request->cond.notify_all();
 		return true;
 
@@ -189,23 +191,6 @@ int ironstack::echo_daemon::ping(const ip_address& dest, uint16_t vlan_id, int t
 		return 0;
 	}
 
-	// lookup ARP table for mac address
-	mac_address dest_mac = arp_svc->lookup_mac_for(dest, vlan_id);
-	if (dest_mac.is_nil()) {
-//		output::log(output::loglevel::VERBOSE, "ironstack echo daemon::ping() no ARP entry for [%s]. performing ARP query.\n",
-//			dest.to_string().c_str());
-		dest_mac = arp_svc->send_arp_query_blocking(dest, vlan_id, timeout_ms);
-	}
-
-	// lookup physical port number for the mac address
-	set<uint16_t> ports_to_use;
-	int phy_port = cam_svc->lookup_port_for(dest_mac, vlan_id);
-	if (phy_port == -1) {
-		ports_to_use = switch_state_svc->get_flood_ports(vlan_id);
-	} else {
-		ports_to_use.insert(phy_port);
-	}
-
 	// setup request
 	shared_ptr<echo_daemon_request> request;
 	{
@@ -214,26 +199,51 @@ int ironstack::echo_daemon::ping(const ip_address& dest, uint16_t vlan_id, int t
 		wait_queue[request->seq] = request;
 	}
 
-	// construct packet and send through hal
-	uint32_t local_seq = htonl(request->seq);
-	icmp_packet pkt;
-	pkt.icmp_pkt_type = 8;
-	pkt.code = 0;
-	pkt.icmp_hdr_rest = 0x01001601;
-	pkt.data.inherit_read_only(&local_seq, sizeof(local_seq));
-	pkt.src_ip = switch_ip;
-	pkt.dest_ip = dest;
-	pkt.src_mac = switch_mac;
-	pkt.dest_mac = dest_mac;
-
-	autobuf serialized_msg;
-	pkt.serialize(serialized_msg);
-	controller->send_packet(serialized_msg, ports_to_use);
+	// resolve the destination asynchronously. the echo request is sent from
+	// the ARP completion, so concurrent pings to one host share a single query.
+	hal* ctrl = controller;
+	arp_svc->resolve(dest, vlan_id, [=](const ip_address& ip, const mac_address& dest_mac) {
+
+		// unresolvable: fail the request
+		if (dest_mac.is_nil()) {
+			unique_lock<mutex> m(request->lock);
+			request->status = false;
+			request->completed = true;
+			request->cond.notify_all();
+			return;
+		}
+
+		// lookup physical port number for the mac address
+		set<uint16_t> ports_to_use;
+		int phy_port = cam_svc->lookup_port_for(dest_mac, vlan_id);
+		if (phy_port == -1) {
+			ports_to_use = switch_state_svc->get_flood_ports(vlan_id);
+		} else {
+			ports_to_use.insert(phy_port);
+		}
+
+		// construct packet and send through hal
+		uint32_t local_seq = htonl(request->seq);
+		icmp_packet pkt;
+		pkt.icmp_pkt_type = 8;
+		pkt.code = 0;
+		pkt.icmp_hdr_rest = 0x01001601;
+		pkt.data.inherit_read_only(&local_seq, sizeof(local_seq));
+		pkt.src_ip = switch_ip;
+		pkt.dest_ip = dest;
+		pkt.src_mac = switch_mac;
+		pkt.dest_mac = dest_mac;
+
+		autobuf serialized_msg;
+		pkt.serialize(serialized_msg);
+		request->request_timer.reset();
+		ctrl->send_packet(serialized_msg, ports_to_use);
+	}, timeout_ms);
 
 	// block waiting for the response
 	{
 		unique_lock<mutex> m(request->lock);
-		request->cond.wait_for(m, chrono::milliseconds(timeout_ms));
+		request->cond.wait_for(m, chrono::milliseconds(timeout_ms), [&request]() { return request->completed; });
 	}
 
 	// remove from table
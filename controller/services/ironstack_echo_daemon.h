@@ -62,12 +62,13 @@ private:
 	// internal class to track echo daemon requests
 	class echo_daemon_request {
 	public:
-		echo_daemon_request(uint32_t seq_in):status(false),seq(seq_in) {}
+		echo_daemon_request(uint32_t seq_in):status(false),completed(false),seq(seq_in) {}
 
 		timer              request_timer;
 		mutex              lock;
 		condition_variable cond;
 		bool               status;
+		bool               completed;
 		uint32_t           seq;
 	};
 
@@ -1,5 +1,6 @@
 #include "arp.h"
 #include "cam.h"
+#include "flood_plan_cache.h"
 #include "switch_db.h"
 #include "switch_state.h"
 #include "../gui/output.h"
@@ -142,6 +143,7 @@ void switch_state::set_switch_features(const of_message_features_reply& features
 	for (const auto& of_port : of_ports) {
 		create_or_update_openflow_vlan_port_unsafe(of_port);
 	}
+	publish_port_snapshot_unsafe();
 
 	// output to screen list of ports
 	output::log(output::loglevel::INFO, "switch_state::set_switch_features(): the following switch ports were added:\n");
@@ -210,7 +212,7 @@ void switch_state::update_switch_port(const of_message_port_status& status) {
 				bool new_port_up = of_port.is_up();
 
 				if (original_port_up != new_port_up) {
-					output::log(output::loglevel::INFO, "switch_state::update_switch_port() switch port %hu: status changed from %s to %s.\n",
+					OUTPUT_LOG(INFO, "switch_state::update_switch_port() switch port %hu: status changed from %s to %s.\n",
 						of_port.port_number,
 						original_port_up ? "UP" : "DOWN",
 						new_port_up ? "UP" : "DOWN");
@@ -232,6 +234,7 @@ void switch_state::update_switch_port(const of_message_port_status& status) {
 		}
 
 		// make a copy for the callback
+		publish_port_snapshot_unsafe();
 		vlan_port_copy = ports[of_port.port_number];
 	}
 
@@ -346,18 +349,25 @@ aux_switch_info switch_state::get_aux_switch_info() const {
 void switch_state::set_vlan_ports(const set<uint16_t>& vlan_ports, uint16_t vlan_id) {
 
 	if (vlan_ports.empty()) return;
-	lock_guard<mutex> g(lock);
-
-	// create the ports of they don't exist
-	char buf[1024] = {0};
-	char buf2[16];
-	for (const auto& vlan_port : vlan_ports) {
-		maybe_create_openflow_vlan_port_unsafe(vlan_port);
-		ports[vlan_port].add_to_vlan_membership(vlan_id);
-		sprintf(buf2, "[%hu] ", vlan_port);
-		strcat(buf, buf2);
+	{
+		lock_guard<mutex> g(lock);
+
+		// create the ports of they don't exist
+		char buf[1024] = {0};
+		char buf2[16];
+		for (const auto& vlan_port : vlan_ports) {
+			maybe_create_openflow_vlan_port_unsafe(vlan_port);
+			ports[vlan_port].add_to_vlan_membership(vlan_id);
+			sprintf(buf2, "[%hu] ", vlan_port);
+			strcat(buf, buf2);
+		}
+		publish_port_snapshot_unsafe();
+		output::log(output::loglevel::INFO, "switch_state::set_vlan_ports() the following ports have been added to vlan %hu:\n  %s", vlan_id, buf);
 	}
-	output::log(output::loglevel::INFO, "switch_state::set_vlan_ports() the following ports have been added to vlan %hu:\n  %s", vlan_id, buf);
+
+	// keep the vlan's flood plans in step with port changes (registered
+	// outside the lock since callbacks may read the switch state)
+	register_port_modification_callback(flood_plans, vlan_id);
 }
 
 // set up vlan tagging for a given port
@@ -365,6 +375,7 @@ void switch_state::set_vlan_port_tagging(uint16_t dest_port, bool state) {
 	lock_guard<mutex> g(lock);
 	maybe_create_openflow_vlan_port_unsafe(dest_port);
 	ports[dest_port].set_vlan_tagging(state);
+	publish_port_snapshot_unsafe();
 
 	output::log(output::loglevel::INFO, "switch_state::set_vlan_port_tagging(): port %hu is now marked as %s.\n",
 		dest_port,
@@ -383,6 +394,7 @@ void switch_state::set_vlan_port_tagging(const set<uint16_t> dest_ports, bool st
 		sprintf(buf2, "[%hu] ", vlan_port);
 		strcat(buf, buf2);
 	}
+	publish_port_snapshot_unsafe();
 
 	output::log(output::loglevel::INFO, "switch_state::set_vlan_port_tagging(): the following ports are marked as %s:\n  %s",
 		state ? "tagged" : "untagged", buf);
@@ -395,65 +407,32 @@ void switch_state::set_vlan_flood_ports(const set<uint16_t>& dest_ports, uint16_
 		maybe_create_openflow_vlan_port_unsafe(vlan_port);
 		ports[vlan_port].add_as_flood_port_for_vlan(vlan_id);
 	}
+	publish_port_snapshot_unsafe();
 }
 
 // gets the list of flood ports for a given vlan
 set<uint16_t> switch_state::get_flood_ports(uint16_t vlan_id) const {
-	set<uint16_t> result;
-	lock_guard<mutex> g(lock);
-	for (const auto& port : ports) {
-		if (port.second.is_valid() && port.second.is_flood_port_for_vlan(vlan_id)) {
-			result.insert(port.first);
-		}
-	}
-	return result;
+	return get_port_snapshot()->get_flood_ports(vlan_id).to_set();
 }
 
 // gets the list of stp ports for a given vlan
 set<uint16_t> switch_state::get_stp_ports(uint16_t vlan_id) const {
-	set<uint16_t> result;
-	lock_guard<mutex> g(lock);
-	for (const auto& port : ports) {
-		if (port.second.is_valid() && port.second.is_stp_port_for_vlan(vlan_id)) {
-			result.insert(port.first);
-		}
-	}
-	return result;
+	return get_port_snapshot()->get_stp_ports(vlan_id).to_set();
 }
 
 // gets the set of untagged ports on a given vlan
 set<uint16_t> switch_state::get_untagged_ports(uint16_t vlan_id) const {
-	set<uint16_t> result;
-	lock_guard<mutex> g(lock);
-	for (const auto& port : ports) {
-		if (port.second.is_valid() && port.second.is_member_of_vlan(vlan_id) && !port.second.is_tagged_port()) {
-			result.insert(port.first);
-		}
-	}
-	return result;
+	return get_port_snapshot()->get_untagged_ports(vlan_id).to_set();
 }
 
 // gets the set of tagged ports on a given vlan
 set<uint16_t> switch_state::get_tagged_ports(uint16_t vlan_id) const {
-	set<uint16_t> result;
-	lock_guard<mutex> g(lock);
-	for (const auto& port : ports) {
-		if (port.second.is_valid() && port.second.is_member_of_vlan(vlan_id) && port.second.is_tagged_port()) {
-			result.insert(port.first);
-		}
-	}
-	return result;
+	return get_port_snapshot()->get_tagged_ports(vlan_id).to_set();
 }
 
 // gets the set of all vlans used on the switch
 set<uint16_t> switch_state::get_vlan_ids() const {
-	set<uint16_t> result;
-	lock_guard<mutex> g(lock);
-	for (const auto& port : ports) {
-		set<uint16_t> vlan_for_this_port = port.second.get_all_vlans();
-		result.insert(vlan_for_this_port.begin(), vlan_for_this_port.end());
-	}
-	return result;
+	return get_port_snapshot()->get_vlan_ids().to_set();
 }
 
 // gets a vector of ports associated with a vlan
@@ -481,12 +460,41 @@ vector<openflow_vlan_port> switch_state::get_all_switch_ports() const {
 	return result;
 }
 
-// retrieve a switch port
+// retrieve a switch port. unknown ports are returned as invalid placeholders.
 bool switch_state::get_switch_port(uint16_t port, openflow_vlan_port& result) {
-	lock_guard<mutex> g(lock);
-	maybe_create_openflow_vlan_port_unsafe(port);
-	result = ports[port];
-	return ports[port].is_valid();
+	shared_ptr<const switch_port_snapshot> snapshot = get_port_snapshot();
+	const openflow_vlan_port* vlan_port = snapshot->get_port(port);
+	if (vlan_port == nullptr) {
+		result.clear();
+		result.get_openflow_port().port_number = port;
+		return false;
+	}
+	result = *vlan_port;
+	return vlan_port->is_valid();
+}
+
+// gets the current port snapshot. each thread caches the last snapshot it saw
+// and only goes through the (internally locked) shared_ptr atomic load when
+// the published version changes.
+shared_ptr<const switch_port_snapshot> switch_state::get_port_snapshot() const {
+
+	class snapshot_cache_t {
+	public:
+		snapshot_cache_t():owner(nullptr), version(0) {}
+		const switch_state*                    owner;
+		uint64_t                               version;
+		shared_ptr<const switch_port_snapshot> snapshot;
+	};
+	static thread_local snapshot_cache_t cache;
+
+	if (cache.owner == this && cache.version == port_snapshot_version.load(memory_order_acquire)) {
+		return cache.snapshot;
+	}
+
+	cache.snapshot = atomic_load(&port_snapshot);
+	cache.version = cache.snapshot->get_version();
+	cache.owner = this;
+	return cache.snapshot;
 }
 
 // set switch port status
@@ -620,6 +628,25 @@ void switch_state::remove_openflow_vlan_port_unsafe(const uint16_t port_num) {
 	}
 }
 
+// gets the precomputed flood of a vlan from an ingress port
+shared_ptr<const flood_plan> switch_state::get_flood_plan(uint16_t vlan_id, uint16_t in_port, bool tagged_ingress) const {
+	return flood_plans->get_plan(get_port_snapshot(), vlan_id, in_port, tagged_ingress);
+}
+
+// creates the flood plan cache (defined here, where the type is complete)
+shared_ptr<flood_plan_cache> switch_state::create_flood_plan_cache() {
+	return make_shared<flood_plan_cache>();
+}
+
+// rebuilds and publishes the port snapshot. called with the lock held after
+// every change to the port map.
+void switch_state::publish_port_snapshot_unsafe() {
+	shared_ptr<switch_port_snapshot> snapshot(new switch_port_snapshot());
+	snapshot->build(ports, port_snapshot_version.load(memory_order_relaxed)+1);
+	atomic_store(&port_snapshot, shared_ptr<const switch_port_snapshot>(snapshot));
+	port_snapshot_version.store(snapshot->get_version(), memory_order_release);
+}
+
 // perform port modification callbacks -- warning: holds the callback lock
 // so port mods cannot be unregistered from within
 void switch_state::perform_port_mod_callbacks(const openflow_vlan_port& port) {
@@ -724,7 +751,7 @@ bool switch_state::setup_switch_vlans(const string& filename) {
 		// end of previous vlan section; update as needed
 		if (strcmp(buf, "vlan") == 0) {
 			if (!tagged_ports.empty() || !untagged_ports.empty()) {
-				output::log(output::loglevel::INFO, "finished parsing vlan %hu\n", vlan);
+				OUTPUT_LOG(INFO, "finished parsing vlan %hu\n", vlan);
 				set_vlan_ports(all_ports, vlan);
 				set_vlan_port_tagging(tagged_ports, true);
 				set_vlan_port_tagging(untagged_ports, false);
@@ -753,7 +780,7 @@ bool switch_state::setup_switch_vlans(const string& filename) {
 			if (vlan_is_set) {
 				vlan = id;
 				vlan_is_set = false;
-				output::log(output::loglevel::VERBOSE, "seen vlan %hu\n", vlan);
+				OUTPUT_LOG(VERBOSE, "seen vlan %hu\n", vlan);
 
 			// is it for a tagged port?
 			} else if (tagged) {
@@ -791,3 +818,88 @@ done:
 	fclose(fp);
 	return result;
 }
+
+// out-of-class definitions for the shared empty masks
+const vlan_mask switch_port_snapshot::empty_vlans;
+const port_mask switch_port_snapshot::empty_ports;
+
+// returns the version of the switch port state
+uint64_t switch_port_snapshot::get_version() const {
+	return version;
+}
+
+// returns a port, or nullptr if the port is not known
+const openflow_vlan_port* switch_port_snapshot::get_port(uint16_t port) const {
+	auto iterator = ports.find(port);
+	return (iterator == ports.end() ? nullptr : &iterator->second);
+}
+
+// returns the vlans a port is a member of
+const vlan_mask& switch_port_snapshot::get_port_vlans(uint16_t port) const {
+	auto iterator = ports.find(port);
+	return (iterator == ports.end() ? empty_vlans : iterator->second.get_vlan_mask());
+}
+
+// returns all vlans used on the switch
+const vlan_mask& switch_port_snapshot::get_vlan_ids() const {
+	return vlan_ids;
+}
+
+// returns the flood ports of a vlan
+const port_mask& switch_port_snapshot::get_flood_ports(uint16_t vlan_id) const {
+	return (vlan_id < vlans.size() ? vlans[vlan_id].flood_ports : empty_ports);
+}
+
+// returns the stp ports of a vlan
+const port_mask& switch_port_snapshot::get_stp_ports(uint16_t vlan_id) const {
+	return (vlan_id < vlans.size() ? vlans[vlan_id].stp_ports : empty_ports);
+}
+
+// returns the untagged member ports of a vlan
+const port_mask& switch_port_snapshot::get_untagged_ports(uint16_t vlan_id) const {
+	return (vlan_id < vlans.size() ? vlans[vlan_id].untagged_ports : empty_ports);
+}
+
+// returns the tagged member ports of a vlan
+const port_mask& switch_port_snapshot::get_tagged_ports(uint16_t vlan_id) const {
+	return (vlan_id < vlans.size() ? vlans[vlan_id].tagged_ports : empty_ports);
+}
+
+// builds the snapshot from the switch state port map
+void switch_port_snapshot::build(const map<uint16_t, openflow_vlan_port>& switch_ports, uint64_t new_version) {
+
+	version = new_version;
+	ports = switch_ports;
+	vlans.resize(vlan_mask::WIDTH);
+	for (const auto& it : ports) {
+		const openflow_vlan_port& vlan_port = it.second;
+		const vlan_mask& port_vlans = vlan_port.get_vlan_mask();
+
+		// vlan ids include those of invalid ports (matches get_vlan_ids())
+		vlan_ids |= port_vlans;
+		if (!vlan_port.is_valid()) {
+			continue;
+		}
+
+		if (it.first >= port_mask::WIDTH) {
+			output::log(output::loglevel::BUG, "switch_port_snapshot::build() -- port %hu does not fit in a port mask "
+				"and is excluded from vlan port sets.\n", it.first);
+			continue;
+		}
+
+		port_vlans.for_each([&](uint16_t vlan_id) {
+			vlan_entry_t& vlan = vlans[vlan_id];
+			if (vlan_port.is_tagged_port()) {
+				vlan.tagged_ports.set(it.first);
+			} else {
+				vlan.untagged_ports.set(it.first);
+			}
+			if (vlan_port.is_flood_port_for_vlan(vlan_id)) {
+				vlan.flood_ports.set(it.first);
+			}
+			if (vlan_port.is_stp_port_for_vlan(vlan_id)) {
+				vlan.stp_ports.set(it.first);
+			}
+		});
+	}
+}
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
+#include <map>
 #include <mutex>
 #include <memory>
+#include <set>
+#include <vector>
 #include "switch_db.h"
 #include "aux_switch_info.h"
 #include "../../common/dbg.h"
@@ -16,6 +20,9 @@
 #include "../openflow_messages/of_message_stats_reply.h"
 using namespace std;
 
+class flood_plan;
+class flood_plan_cache;
+
 // subclass this to receive callbacks whenever an openflow port changes in
 // status
 class switch_port_modification_callbacks {
@@ -23,12 +30,72 @@ public:
 	virtual void switch_port_modification_callback(const openflow_vlan_port& port)=0;
 };
 
+// immutable, versioned view of the switch ports and vlans for the packet path.
+// switch_state publishes a new snapshot whenever ports or vlans change; readers
+// hold a shared_ptr to a snapshot and read it without locking or allocating.
+//
+// vlan membership is kept as bit masks: a vlan mask per port, and tagged,
+// untagged, flood and stp port masks per vlan, so a flood set is computed with
+// a few word-wide and/and-not operations.
+class switch_port_snapshot {
+public:
+
+	// constructor
+	switch_port_snapshot():version(0) {}
+
+	// version of the switch port state this snapshot was built from
+	uint64_t             get_version() const;
+
+	// returns a port, or nullptr if the port is not known. the port may be a
+	// placeholder that is not valid.
+	const openflow_vlan_port* get_port(uint16_t port) const;
+
+	// returns the vlans a port is a member of (empty if the port is not known)
+	const vlan_mask&     get_port_vlans(uint16_t port) const;
+
+	// vlan information (same semantics as the switch_state getters)
+	const vlan_mask&     get_vlan_ids() const;
+	const port_mask&     get_flood_ports(uint16_t vlan_id) const;
+	const port_mask&     get_stp_ports(uint16_t vlan_id) const;
+	const port_mask&     get_untagged_ports(uint16_t vlan_id) const;
+	const port_mask&     get_tagged_ports(uint16_t vlan_id) const;
+
+private:
+	friend class switch_state;
+
+	class vlan_entry_t {
+	public:
+		port_mask            flood_ports;
+		port_mask            stp_ports;
+		port_mask            untagged_ports;
+		port_mask            tagged_ports;
+	};
+
+	uint64_t                          version;
+	map<uint16_t, openflow_vlan_port> ports;
+	vector<vlan_entry_t>              vlans;     // indexed by vlan id
+	vlan_mask                         vlan_ids;
+
+	static const vlan_mask            empty_vlans;
+	static const port_mask            empty_ports;
+
+	// builds the snapshot from the switch state port map
+	void build(const map<uint16_t, openflow_vlan_port>& switch_ports, uint64_t new_version);
+};
+
 // switch state class
 // provides management of ports (changing up/down status) callbacks for port
 // status changes central location for switch information (ip address, mac
 // address, desc, features)
 //
 // init depends on the CAM and ARP services being already active
+//
+// port and vlan reads are served from an immutable snapshot (see
+// switch_port_snapshot) that is rebuilt under the lock by every function that
+// changes a port. the packet path calls get_port_snapshot(), which costs one
+// atomic load per call once the calling thread has seen the current version.
+// floods are served from a cache of flood plans built from the snapshot (see
+// flood_plan_cache).
 class switch_state : public service {
 public:
 
@@ -44,6 +111,10 @@ public:
 
 		dependencies = { service_catalog::service_type::CAM, service_catalog::service_type::ARP };
 
+		atomic_store(&port_snapshot, shared_ptr<const switch_port_snapshot>(new switch_port_snapshot()));
+		atomic_store(&port_snapshot_version, (uint64_t) 0);
+		flood_plans = create_flood_plan_cache();
+
 		controller = ptr->get_controller(); 
 	};
 
@@ -103,6 +174,14 @@ public:
 	vector<openflow_vlan_port>  get_all_switch_ports() const;
 	bool                        get_switch_port(uint16_t port, openflow_vlan_port& result);
 
+	// gets the current port snapshot (lock-free and allocation-free once the
+	// calling thread has seen the current version)
+	shared_ptr<const switch_port_snapshot> get_port_snapshot() const;
+
+	// gets the precomputed flood of a vlan from an ingress port (use
+	// flood_plan_cache::NO_INGRESS_PORT for packets from the controller)
+	shared_ptr<const flood_plan> get_flood_plan(uint16_t vlan_id, uint16_t in_port, bool tagged_ingress) const;
+
 	// activate or deactivate port
 	void                        set_port_enabled(uint16_t port, bool status);
 	bool                        is_port_enabled(uint16_t port) const;
@@ -156,6 +235,14 @@ private:
 	// maps from port number to object
 	map<uint16_t, openflow_vlan_port>  ports;
 
+	// published snapshot of the ports (replaced whole, never modified)
+	shared_ptr<const switch_port_snapshot> port_snapshot;
+	atomic<uint64_t>            port_snapshot_version;
+
+	// flood plans (registered for port modification callbacks on every vlan)
+	shared_ptr<flood_plan_cache> flood_plans;
+	static shared_ptr<flood_plan_cache> create_flood_plan_cache();
+
 	// callbacks and their locks
 	mutex callback_lock;
 	vector<pair<uint16_t, weak_ptr<switch_port_modification_callbacks>>> port_mod_callbacks;
@@ -165,6 +252,7 @@ private:
 	void create_or_update_openflow_vlan_port_unsafe(const openflow_port& port);
 	void remove_openflow_vlan_port_unsafe(uint16_t port);
 
+	void publish_port_snapshot_unsafe();
 	void perform_port_mod_callbacks(const openflow_vlan_port& port);
 	void check_init_state_unsafe();
 
@@ -0,0 +1,386 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "hal/hal.h"
+#include "hal/session_capture.h"
+#include "gui/output.h"
+#include "services/arp.h"
+#include "services/cam.h"
+#include "services/flow_service.h"
+#include "services/flow_policy_checker.h"
+#include "services/ironstack_echo_daemon.h"
+#include "services/operational_stats.h"
+#include "services/switch_state.h"
+#include "services/dell_s48xx_acl_table.h"
+#include "services/dell_s48xx_l2_table.h"
+#include "utils/of_common_utils.h"
+#include "../common/openflow.h"
+#include "../common/tcp.h"
+using namespace std;
+
+// replays a recorded openflow session (see session_capture) into the hal
+//
+// the controller runs in this process with the services of the ironstack
+// executive. a fake switch endpoint connects to it over localhost and writes
+// the messages the switch sent in the capture, with their original timing (or
+// scaled, or as fast as possible). the messages the controller sends are read
+// and counted so that they can be compared with the capture.
+//
+// replies are kept deterministic: a reply from the switch is held back until
+// the replayed controller has sent the request it answers (matched by message
+// type and order), and its xid is rewritten to the xid of that request.
+
+// needed by the flow tables (normally defined by the ironstack executive)
+string switch_name = "session_replay";
+
+// type and position of a controller message among the messages of its type
+typedef pair<uint8_t, uint32_t> request_key;
+
+// the fake switch side of the replayed session
+class capture_endpoint {
+public:
+
+	capture_endpoint():received(0), last_received_ns(0), shutdown_flag(false) {
+		for (auto& count : type_counts) {
+			count = 0;
+		}
+	}
+
+	~capture_endpoint() {
+		shutdown_flag = true;
+		connection.close();
+		if (recv_tid.joinable()) {
+			recv_tid.join();
+		}
+	}
+
+	// connects to the controller and starts reading what it sends
+	bool connect(uint16_t port) {
+		bool connected = false;
+		for (int attempt = 0; attempt < 50 && !connected; ++attempt) {
+			this_thread::sleep_for(chrono::milliseconds(100));
+			connected = connection.connect("127.0.0.1", port);
+		}
+		if (!connected) {
+			return false;
+		}
+		connection.set_no_delay(true);
+		recv_tid = thread(&capture_endpoint::recv_loop, this);
+		return true;
+	}
+
+	// sends a recorded switch message
+	bool send(const void* message, uint32_t length) {
+		return connection.send_raw(message, length);
+	}
+
+	// waits until the controller has sent a given request and gets its xid
+	bool wait_for_request(const request_key& key, uint32_t& xid, int timeout_ms) {
+		unique_lock<mutex> g(lock);
+		bool found = cond.wait_for(g, chrono::milliseconds(timeout_ms), [&]() { return live_xids.count(key) > 0; });
+		if (found) {
+			xid = live_xids[key];
+		}
+		return found;
+	}
+
+	// nanoseconds since the controller last sent something
+	uint64_t get_idle_ns() const {
+		return get_time_ns() - last_received_ns;
+	}
+
+	static uint64_t get_time_ns() {
+		return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	atomic<uint64_t> received;
+	atomic<uint64_t> type_counts[256];
+	atomic<uint64_t> last_received_ns;
+
+private:
+
+	// reads messages from the controller and notes the xid of every request
+	void recv_loop() {
+		autobuf buf;
+		while (!shutdown_flag) {
+			if (!connection.recv_fixed_bytes(buf, sizeof(struct ofp_header))) {
+				break;
+			}
+			const struct ofp_header* header = (const struct ofp_header*) buf.get_content_ptr();
+			uint8_t type = header->type;
+			uint32_t xid = ntohl(header->xid);
+			uint32_t length = ntohs(header->length);
+			if (length > sizeof(struct ofp_header)) {
+				autobuf body;
+				if (!connection.recv_fixed_bytes(body, length - sizeof(struct ofp_header))) {
+					break;
+				}
+			}
+
+			last_received_ns = get_time_ns();
+			++received;
+			lock_guard<mutex> g(lock);
+			live_xids[request_key(type, (uint32_t) type_counts[type]++)] = xid;
+			cond.notify_all();
+		}
+	}
+
+	tcp                          connection;
+	thread                       recv_tid;
+	atomic<bool>                 shutdown_flag;
+	mutex                        lock;
+	condition_variable           cond;
+	map<request_key, uint32_t>   live_xids;
+};
+
+// checks if a switch message answers an earlier controller message
+static bool is_reply(uint8_t type) {
+	switch (type) {
+		case OFPT_ERROR:
+		case OFPT_ECHO_REPLY:
+		case OFPT_FEATURES_REPLY:
+		case OFPT_GET_CONFIG_REPLY:
+		case OFPT_STATS_REPLY:
+		case OFPT_BARRIER_REPLY:
+		case OFPT_QUEUE_GET_CONFIG_REPLY:
+			return true;
+		default:
+			return false;
+	}
+}
+
+// gets the user + system cpu time of this process in nanoseconds
+static uint64_t get_cpu_time_ns() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ULL +
+		(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ULL;
+}
+
+static void usage(const char* name) {
+	printf("usage: %s [options] [capture file]\n"
+		"  --speed [x]           speedup factor applied to the recorded timing (default 1.0)\n"
+		"  --fast                ignore the recorded timing (replies still wait for their requests)\n"
+		"  --reply-timeout [ms]  how long a reply waits for its request (default 5000)\n"
+		"  --native-vlan [n]     vlan of untagged packet_ins (default 1)\n"
+		"  --port [n]            local openflow port (default 16635)\n"
+		"  --verbose             keep the per-flow log messages\n", name);
+}
+
+int main(int argc, char** argv) {
+
+	string capture_filename;
+	double speed = 1.0;
+	bool fast = false;
+	int reply_timeout_ms = 5000;
+	uint16_t native_vlan = 1;
+	uint16_t port = 16635;
+	bool verbose = false;
+
+	for (int counter = 1; counter < argc; ++counter) {
+		const char* option = argv[counter];
+		if (strcmp(option, "--fast") == 0) {
+			fast = true;
+			continue;
+		} else if (strcmp(option, "--verbose") == 0) {
+			verbose = true;
+			continue;
+		} else if (option[0] != '-') {
+			capture_filename = option;
+			continue;
+		}
+		if (counter+1 >= argc) {
+			usage(argv[0]);
+			return 1;
+		}
+		const char* value = argv[++counter];
+
+		bool valid = true;
+		if (strcmp(option, "--speed") == 0) {
+			speed = atof(value);
+			valid = speed > 0.0;
+		} else if (strcmp(option, "--reply-timeout") == 0) {
+			reply_timeout_ms = atoi(value);
+		} else if (strcmp(option, "--native-vlan") == 0) {
+			native_vlan = atoi(value);
+		} else if (strcmp(option, "--port") == 0) {
+			port = atoi(value);
+		} else {
+			valid = false;
+		}
+		if (!valid) {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (capture_filename.empty() || port == 0 || reply_timeout_ms < 0 || native_vlan == 0 || native_vlan > 4095) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	// 1. index the capture: the order of controller requests by type, and the
+	// vlans and ports seen in packet_ins (to configure the switch state)
+	session_capture_reader reader;
+	if (!reader.open(capture_filename)) {
+		printf("error: unable to read %s.\n", capture_filename.c_str());
+		return 1;
+	}
+	vector<session_capture_reader::record> records;
+	unordered_map<uint32_t, request_key> recorded_requests;
+	uint64_t recorded_counts[256] = { 0 };
+	set<uint16_t> vlans;
+	uint16_t max_port = 0;
+	bool untagged = false;
+	session_capture_reader::record entry;
+	while (reader.next(entry)) {
+		if (entry.length < sizeof(struct ofp_header)) {
+			continue;
+		}
+		const struct ofp_header* header = (const struct ofp_header*) entry.message;
+		if (entry.direction == session_capture::TO_SWITCH) {
+			recorded_requests[ntohl(header->xid)] = request_key(header->type, (uint32_t) recorded_counts[header->type]++);
+		} else if (header->type == OFPT_PACKET_IN && entry.length >= offsetof(struct ofp_packet_in, data) + 16) {
+			const struct ofp_packet_in* packet_in = (const struct ofp_packet_in*) entry.message;
+			uint16_t in_port = ntohs(packet_in->in_port);
+			if (in_port < OFPP_MAX) {
+				max_port = max(max_port, in_port);
+			}
+			if (packet_in->data[12] == 0x81 && packet_in->data[13] == 0x00) {
+				vlans.insert(((packet_in->data[14] << 8) | packet_in->data[15]) & 0x0fff);
+			} else {
+				untagged = true;
+			}
+		}
+		records.push_back(entry);
+	}
+	if (records.empty()) {
+		printf("error: %s holds no messages.\n", capture_filename.c_str());
+		return 1;
+	}
+	uint64_t first_timestamp = records.front().timestamp;
+	printf("session replay: %zu messages spanning %.3f s from %s.\n", records.size(),
+		(records.back().timestamp - first_timestamp) / 1e9, capture_filename.c_str());
+
+	if (!verbose) {
+		output::set_log_level(output::loglevel::WARNING);
+	}
+
+	// 2. controller and services, set up as the ironstack executive does. the
+	// vlan configuration is not part of the capture, so every port seen is made a
+	// member of every vlan seen (tagged, unless all packet_ins were untagged)
+	shared_ptr<hal> controller(new hal());
+	shared_ptr<cam> cam_service = make_shared<cam>(controller->get_service_catalog());
+	shared_ptr<arp> arp_service = make_shared<arp>(controller->get_service_catalog());
+	shared_ptr<switch_state> sw_state = make_shared<switch_state>(controller->get_service_catalog());
+	shared_ptr<flow_service> flow_svc = make_shared<flow_service>(controller->get_service_catalog());
+	shared_ptr<ironstack::echo_daemon> echo_daemon = make_shared<ironstack::echo_daemon>(controller->get_service_catalog());
+	shared_ptr<operational_stats> op_stats = make_shared<operational_stats>(controller->get_service_catalog());
+	shared_ptr<flow_policy_checker> flow_policy_svc = make_shared<flow_policy_checker>(controller->get_service_catalog());
+	set<shared_ptr<service>> services = { cam_service, arp_service, sw_state, flow_svc, echo_daemon, op_stats, flow_policy_svc };
+
+	sw_state->set_switch_ip(ip_address("10.255.255.254"));
+	sw_state->set_name("ironstack_session_replay");
+	bool tagged_ports = !vlans.empty() && !untagged;
+	if (vlans.empty() || untagged) {
+		vlans.insert(native_vlan);
+	}
+	set<uint16_t> all_ports;
+	for (uint16_t counter = 1; counter <= max(max_port, (uint16_t) 48); ++counter) {
+		all_ports.insert(counter);
+	}
+	for (const auto& vlan_id : vlans) {
+		sw_state->set_vlan_ports(all_ports, vlan_id);
+		sw_state->set_vlan_flood_ports(all_ports, vlan_id);
+		cam_service->create_cam_table(vlan_id);
+		arp_service->create_arp_table(vlan_id);
+	}
+	sw_state->set_vlan_port_tagging(all_ports, tagged_ports);
+
+	shared_ptr<dell_s48xx_l2_table> l2_table = make_shared<dell_s48xx_l2_table>();
+	shared_ptr<dell_s48xx_acl_table> acl_table = make_shared<dell_s48xx_acl_table>();
+	l2_table->set_max_capacity(10000);
+	acl_table->set_max_capacity(100);
+	flow_svc->attach_flow_table(l2_table);
+	flow_svc->attach_flow_table(acl_table);
+
+	atomic<bool> init_ok(false);
+	thread init_tid([&]() {
+		init_ok = controller->init(port, services, set<ip_address>{ ip_address("127.0.0.1") });
+	});
+
+	// 3. replay the switch side of the session
+	capture_endpoint endpoint;
+	if (!endpoint.connect(port)) {
+		printf("error: unable to connect to the controller on port %hu.\n", port);
+		_exit(1);
+	}
+
+	uint64_t sent = 0, held = 0, unmatched = 0;
+	uint64_t cpu_start = get_cpu_time_ns();
+	auto start = chrono::steady_clock::now();
+	autobuf message;
+	for (const auto& record : records) {
+		if (record.direction != session_capture::FROM_SWITCH) {
+			continue;
+		}
+		if (!fast) {
+			this_thread::sleep_until(start + chrono::nanoseconds((uint64_t) ((record.timestamp - first_timestamp) / speed)));
+		}
+
+		message.set_content(record.message, record.length);
+		struct ofp_header* header = (struct ofp_header*) message.get_content_ptr_mutable();
+		if (is_reply(header->type)) {
+			auto iterator = recorded_requests.find(ntohl(header->xid));
+			uint32_t xid;
+			if (iterator == recorded_requests.end()) {
+				++unmatched;
+			} else if (endpoint.wait_for_request(iterator->second, xid, reply_timeout_ms)) {
+				header->xid = htonl(xid);
+				++held;
+			} else {
+				++unmatched;
+			}
+		}
+		if (!endpoint.send(message.get_content_ptr(), message.size())) {
+			printf("error: the controller closed the connection after %" PRIu64 " messages.\n", sent);
+			break;
+		}
+		++sent;
+	}
+
+	// 4. wait for the controller to go quiet and compare what it sent
+	while (endpoint.get_idle_ns() < 500000000ULL) {
+		this_thread::sleep_for(chrono::milliseconds(50));
+	}
+	double elapsed_sec = chrono::duration<double>(chrono::steady_clock::now() - start).count() - 0.5;
+	uint64_t cpu_ns = get_cpu_time_ns() - cpu_start;
+	init_tid.join();
+
+	printf("replayed   : %" PRIu64 " switch messages (%" PRIu64 " replies matched to requests, %" PRIu64 " unmatched)\n",
+		sent, held, unmatched);
+	printf("wall time  : %.3f s, cpu time %.3f s%s\n", elapsed_sec, cpu_ns / 1e9, init_ok ? "" : " (controller initialization failed)");
+	printf("%-28s %12s %12s\n", "controller messages", "recorded", "replayed");
+	for (uint32_t type = 0; type < 256; ++type) {
+		if (recorded_counts[type] != 0 || endpoint.type_counts[type] != 0) {
+			printf("%-28s %12" PRIu64 " %12" PRIu64 "\n", of_common::msg_type_to_string((enum ofp_type) type).c_str(),
+				recorded_counts[type], (uint64_t) endpoint.type_counts[type]);
+		}
+	}
+
+	fflush(stdout);
+	_exit(0);
+}
@@ -11,10 +11,12 @@ string vlan_set::to_string() const {
 	string result;
 	sprintf(buf, "vlan %hu\n"
 		"description   : [%s]\n"
-		"status        : [%s]\n",
+		"status        : [%s]\n"
+		"proxy arp     : [%s]\n",
 		vlan_id,
 		description.c_str(),
-		active ? "active" : "inactive");
+		active ? "active" : "inactive",
+		proxy_arp ? "on" : "off");
 
 	result = buf;
 	result += "tagged ports  : ";
@@ -273,6 +275,7 @@ bool switch_commander::get_all_vlans(vector<vlan_set>& result) {
 			vlan.vlan_id = vlan_id;
 			vlan.active = vlan_active;
 			vlan.description = description;
+			vlan.proxy_arp = (description.find(vlan_set::PROXY_ARP_TAG) != string::npos);
 			result.push_back(vlan);
 		}
 
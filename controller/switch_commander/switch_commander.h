@@ -9,6 +9,9 @@ using namespace std;
  * this class describes a vlan set, which contains information about the
  * tagged/untagged ports for a given vlan ID.
  *
+ * proxy arp is turned on for a vlan by putting the PROXY_ARP_TAG keyword
+ * into its description on the switch (e.g. "servers proxy-arp").
+ *
  */
 class vlan_set {
 public:
@@ -17,6 +20,9 @@ public:
 	string        description;
 	set<uint16_t> tagged_ports;
 	set<uint16_t> untagged_ports;
+	bool          proxy_arp = false;
+
+	static constexpr const char* PROXY_ARP_TAG = "proxy-arp";
 
 	// displays a readable version of the object
 	string        to_string() const;
@@ -0,0 +1,141 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "emulator/emulated_switch.h"
+#include "emulator/host_population.h"
+using namespace std;
+
+// openflow 1.0 switch emulator
+//
+// connects to the controller like a real switch and feeds it packet_ins drawn
+// from a synthetic host population, so that hal and service changes can be
+// load tested on localhost. prints one line of counters per second.
+
+static void usage(const char* name) {
+	printf("usage: %s [options]\n"
+		"  --controller [address]    controller address (default 127.0.0.1)\n"
+		"  --port [n]                controller port (default 6633)\n"
+		"  --rate [n]                packets generated per second (default 1000, 0 = none)\n"
+		"  --duration [n]            seconds to run (default 0 = until killed)\n"
+		"  --hosts [n]               number of hosts (default 1000)\n"
+		"  --ports [n]               number of switch ports (default 48)\n"
+		"  --vlans [n]               number of vlans (default 1)\n"
+		"  --first-vlan [n]          first vlan id (default 1)\n"
+		"  --untagged                send untagged frames\n"
+		"  --host-dist [uniform|zipf] sender distribution (default uniform)\n"
+		"  --vlan-dist [uniform|zipf] host to vlan distribution (default uniform)\n"
+		"  --zipf-exponent [x]       zipf exponent (default 1.0)\n"
+		"  --arp-fraction [x]        fraction of arp requests (default 0.1)\n"
+		"  --max-flows [n]           flow table size (default 4096)\n"
+		"  --dpid [n]                datapath id (default 0x20000000001)\n"
+		"  --seed [n]                random seed (default 1)\n", name);
+}
+
+int main(int argc, char** argv) {
+
+	string controller_address = "127.0.0.1";
+	uint16_t controller_port = 6633;
+	uint32_t rate = 1000;
+	uint32_t duration = 0;
+	host_population::config population_settings;
+	emulated_switch::config switch_settings;
+
+	for (int counter = 1; counter < argc; ++counter) {
+		const char* option = argv[counter];
+		if (strcmp(option, "--untagged") == 0) {
+			population_settings.tagged = false;
+			continue;
+		}
+		if (counter+1 >= argc) {
+			usage(argv[0]);
+			return 1;
+		}
+		const char* value = argv[++counter];
+
+		bool ok = true;
+		if (strcmp(option, "--controller") == 0) {
+			controller_address = value;
+		} else if (strcmp(option, "--port") == 0) {
+			controller_port = atoi(value);
+		} else if (strcmp(option, "--rate") == 0) {
+			rate = atoi(value);
+		} else if (strcmp(option, "--duration") == 0) {
+			duration = atoi(value);
+		} else if (strcmp(option, "--hosts") == 0) {
+			population_settings.num_hosts = atoi(value);
+		} else if (strcmp(option, "--ports") == 0) {
+			population_settings.num_ports = atoi(value);
+			switch_settings.num_ports = population_settings.num_ports;
+		} else if (strcmp(option, "--vlans") == 0) {
+			population_settings.num_vlans = atoi(value);
+		} else if (strcmp(option, "--first-vlan") == 0) {
+			population_settings.first_vlan = atoi(value);
+		} else if (strcmp(option, "--host-dist") == 0) {
+			ok = host_population::parse_distribution(value, population_settings.host_distribution);
+		} else if (strcmp(option, "--vlan-dist") == 0) {
+			ok = host_population::parse_distribution(value, population_settings.vlan_distribution);
+		} else if (strcmp(option, "--zipf-exponent") == 0) {
+			population_settings.zipf_exponent = atof(value);
+		} else if (strcmp(option, "--arp-fraction") == 0) {
+			population_settings.arp_fraction = atof(value);
+		} else if (strcmp(option, "--max-flows") == 0) {
+			switch_settings.max_flows = atoi(value);
+		} else if (strcmp(option, "--dpid") == 0) {
+			switch_settings.datapath_id = strtoull(value, nullptr, 0);
+		} else if (strcmp(option, "--seed") == 0) {
+			population_settings.seed = atoi(value);
+		} else {
+			ok = false;
+		}
+		if (!ok) {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	shared_ptr<host_population> population(new host_population());
+	if (controller_port == 0 || switch_settings.num_ports == 0 || switch_settings.num_ports > 0xff00 ||
+		!population->init(population_settings)) {
+		printf("error: invalid host population or switch parameters.\n");
+		return 1;
+	}
+	printf("switch emulator: %s\n", population->to_string().c_str());
+
+	emulated_switch sw(switch_settings);
+	if (!sw.connect(controller_address, controller_port)) {
+		printf("error: unable to complete the handshake with %s:%hu.\n", controller_address.c_str(), controller_port);
+		return 1;
+	}
+	printf("connected to %s:%hu, generating %u packets/s.\n", controller_address.c_str(), controller_port, rate);
+	sw.start(population, rate);
+
+	// report once a second
+	const emulated_switch::stats& stats = sw.get_stats();
+	uint64_t last_generated = 0, last_packet_ins = 0, last_packet_outs = 0, last_flow_mods = 0;
+	auto start = chrono::steady_clock::now();
+	for (uint32_t seconds = 1; duration == 0 || seconds <= duration; ++seconds) {
+		this_thread::sleep_until(start + chrono::seconds(seconds));
+		if (!sw.is_connected()) {
+			printf("connection to the controller lost.\n");
+			break;
+		}
+
+		uint64_t generated = stats.packets_generated, packet_ins = stats.packet_ins_sent;
+		uint64_t packet_outs = stats.packet_outs_received, flow_mods = stats.flow_mods_received;
+		printf("[%5us] generated %8" PRIu64 "/s  packet_in %8" PRIu64 "/s  packet_out %8" PRIu64 "/s  flow_mod %8" PRIu64 "/s  flows %u\n",
+			seconds, generated - last_generated, packet_ins - last_packet_ins, packet_outs - last_packet_outs,
+			flow_mods - last_flow_mods, sw.get_flow_table().size());
+		last_generated = generated;
+		last_packet_ins = packet_ins;
+		last_packet_outs = packet_outs;
+		last_flow_mods = flow_mods;
+	}
+
+	sw.shutdown();
+	printf("totals: %s\n", stats.to_string().c_str());
+	return 0;
+}
@@ -75,13 +75,13 @@ uint32_t flow_parser::translate_to_l2(vector<openflow_flow_description>& transla
 			criteria.wildcard_tcpudp_dest_port) {
 
 			// seems to be a candidate for L2 flow
-			vector<unique_ptr<of_action>> actions = flow.action_list.get_actions();
+			const openflow_action_list& actions = flow.action_list;
 
 			// a candidate flow must be wildcarded in all fields except the eth dest field.
 			// the action must be an output to a port.
 			if (!criteria.wildcard_ethernet_dest
 				&& actions.size() == 1
-				&& actions[0]->get_action_type() == of_action::action_type::OUTPUT_TO_PORT) {
+				&& actions.get_action_type(0) == of_action::action_type::OUTPUT_TO_PORT) {
 
 				// create translated flows
 				openflow_flow_description description;
@@ -1,34 +1,56 @@
 #include "openflow_utils.h"
+#include "../services/flood_plan_cache.h"
+#include "../../common/latency_histogram.h"
 #include "../gui/output.h"
 
+// lists the vlans of a mask as "[1] [20] [30]"
+static string vlan_list_to_string(const vlan_mask& vlans) {
+	string result;
+	char buf[16];
+	vlans.for_each([&](uint16_t vlan_id) {
+		snprintf(buf, sizeof(buf), "[%hu] ", vlan_id);
+		result += buf;
+	});
+	return result;
+}
+
 // gets the next openflow message from the socket and deserializes it
-shared_ptr<of_message> ironstack::net_utils::get_next_openflow_message(tcp& connection, autobuf& buf) {
+shared_ptr<of_message> ironstack::net_utils::get_next_openflow_message(tcp& connection, autobuf& buf, packet_in_trace* trace) {
 
 	// read in the common openflow header
-	if (!connection.recv_fixed_bytes(buf, sizeof(struct ofp_header))) {
+	struct ofp_header header;
+	if (!connection.recv_fixed_bytes(&header, sizeof(header))) {
 		output::log(output::loglevel::ERROR, "net_utils::get_next_openflow_message() unable to read msghdr from connection.\n");
 		return nullptr;
 	}
+	if (trace != nullptr) trace->read = cycle_clock::now();
 
-	// read in the balance of the openflow message
-	uint32_t bytes_to_read = ntohs(((const struct ofp_header*)(buf.get_content_ptr()))->length) - sizeof(struct ofp_header);
-	if (bytes_to_read == 0) {
+	uint32_t message_len = ntohs(header.length);
+	if (message_len < sizeof(header)) {
+		output::log(output::loglevel::ERROR, "net_utils::get_next_openflow_message() invalid message length %u.\n", message_len);
+		return nullptr;
+	}
 
-		// deserialize buffer
-		return of_message_factory::deserialize_message(buf);
+	// the message is received into a refcounted block, so that the messages
+	// deserialized from it (e.g. the frame of a packet_in) share it instead of
+	// copying. the block is reused once nothing holds on to it anymore.
+	buf.create_empty_refcounted_buffer(message_len);
+	memcpy(buf.get_content_ptr_mutable(), &header, sizeof(header));
 
-	} else {
-		
-		// read remaining bytes
-		buf.create_empty_buffer(bytes_to_read + sizeof(struct ofp_header), false);
-		if (!connection.recv_fixed_bytes(buf.ptr_offset_mutable(sizeof(struct ofp_header)), bytes_to_read)) {
+	// read in the balance of the openflow message
+	uint32_t bytes_to_read = message_len - sizeof(header);
+	if (bytes_to_read != 0) {
+		if (!connection.recv_fixed_bytes(buf.ptr_offset_mutable(sizeof(header)), bytes_to_read)) {
 			output::log(output::loglevel::ERROR, "net_utils::get_next_openflow_message() unable to read msgbody from connection.\n");
 			return nullptr;
 		}
-
-		// deserialize buffer
-		return of_message_factory::deserialize_message(buf);
 	}
+	if (trace != nullptr) trace->framed = cycle_clock::now();
+
+	// deserialize buffer
+	shared_ptr<of_message> result = of_message_factory::deserialize_message(buf);
+	if (trace != nullptr) trace->decoded = cycle_clock::now();
+	return result;
 }
 
 // gets the vlan tag from a given ingress packet. consults switch state for information if
@@ -43,30 +65,31 @@ int ironstack::net_utils::get_vlan_from_packet(const shared_ptr<switch_state>& s
   }
 
   // if the packet is untagged, check the port tag settings
-  openflow_vlan_port vlan_port;
-  if (!switch_state_svc->get_switch_port(packet->in_port, vlan_port)) {
-    output::log(output::loglevel::ERROR, "ironstack::net_utils::get_vlan_from_packet() could not locate port %hu in the switch state.\n", packet->in_port);
+  shared_ptr<const switch_port_snapshot> snapshot = switch_state_svc->get_port_snapshot();
+  const openflow_vlan_port* vlan_port = snapshot->get_port(packet->in_port);
+  if (vlan_port == nullptr || !vlan_port->is_valid()) {
+    OUTPUT_LOG_LIMITED(ERROR, "ironstack::net_utils::get_vlan_from_packet() could not locate port %hu in the switch state.\n", packet->in_port);
     return -1;
   }
 
   // an untagged packet on a tagged port is not allowed!
-  if (vlan_port.is_tagged_port()) {
-    output::log(output::loglevel::ERROR, "ironstack::net_utils::get_vlan_from_packet() an untagged packet has surfaced on tagged port %hu!\n", packet->in_port);
+  if (vlan_port->is_tagged_port()) {
+    OUTPUT_LOG_LIMITED(ERROR, "ironstack::net_utils::get_vlan_from_packet() an untagged packet has surfaced on tagged port %hu!\n", packet->in_port);
     return -1;
 
   } else {
 
     // make sure the vlan port has only one tag or we don't know which vlan to send it out on
-    set<uint16_t> member_ports = vlan_port.get_all_vlans();
-    if (member_ports.size() == 1) {
-      return *member_ports.begin();
+    const vlan_mask& member_ports = snapshot->get_port_vlans(packet->in_port);
+    if (member_ports.count() == 1) {
+      return member_ports.first();
 
-    } else if (member_ports.empty()) {
-      output::log(output::loglevel::BUG, "ironstack::net_utils::get_vlan_from_packet() error -- untagged packet on non vlan port is not implemented. please contact the ironstack dev team.\n");
+    } else if (member_ports.none()) {
+      OUTPUT_LOG_LIMITED(BUG, "ironstack::net_utils::get_vlan_from_packet() error -- untagged packet on non vlan port is not implemented. please contact the ironstack dev team.\n");
       return -1;
 
     } else {
-      output::log(output::loglevel::ERROR, "ironstack::net_utils::get_vlan_from_packet() error -- multiple vlan ports available for an untagged packet.\n");
+      OUTPUT_LOG_LIMITED(ERROR, "ironstack::net_utils::get_vlan_from_packet() error -- multiple vlan ports available for an untagged packet.\n");
       return -1;
     }
   }
@@ -86,81 +109,46 @@ void ironstack::net_utils::flood_packet(hal* controller,
   // get the vlan set of the ingress packet and make sure the packet is 'as expected'
   // ie. tagged with a member set vlan from a tagged port
   //     or untagged from an untagged port
-  openflow_vlan_port vlan_port_info;
-  if (!switch_state_svc->get_switch_port(packet->in_port, vlan_port_info)) {
-    output::log(output::loglevel::ERROR, "ironstack::net_utils::flood_packet() could not locate port information from switch state. packet dropped.\n");
+  shared_ptr<const switch_port_snapshot> snapshot = switch_state_svc->get_port_snapshot();
+  const openflow_vlan_port* port_info = snapshot->get_port(packet->in_port);
+  if (port_info == nullptr || !port_info->is_valid()) {
+    OUTPUT_LOG_LIMITED(ERROR, "ironstack::net_utils::flood_packet() could not locate port information from switch state. packet dropped.\n");
     return;
   }
-  set<uint16_t> port_vlans = vlan_port_info.get_all_vlans();
+  const openflow_vlan_port& vlan_port_info = *port_info;
+  const vlan_mask& port_vlans = snapshot->get_port_vlans(packet->in_port);
 
   // verify sanity here
-  if ((raw_pkt.has_vlan_tag && port_vlans.count(pkt_vlan_id) == 0)) {
+  if ((raw_pkt.has_vlan_tag && !port_vlans.test(pkt_vlan_id))) {
 
     // packet has vlan tag but the port doesn't have this vlan tag
-    output::log(output::loglevel::ERROR, "ironstack::net_utils::flood_packet() on ingress port %hu, packet_in has vlan tag %hu but port vlan does not include this vlan.\n", packet->in_port, pkt_vlan_id);
-    output::log(output::loglevel::ERROR, "the valid vlan tags for port %hu are:\n", packet->in_port);
-    for (const auto& p : port_vlans) {
-      output::log(output::loglevel::ERROR, "[%hu] ", p);
-    }
-    output::log(output::loglevel::ERROR, "\nthe packet has been dropped from propagation.\n");
+    OUTPUT_LOG_LIMITED(ERROR, "ironstack::net_utils::flood_packet() on ingress port %hu, packet_in has vlan tag %hu but port vlan does not include this vlan.\n"
+      "the valid vlan tags for port %hu are:\n%s\nthe packet has been dropped from propagation.\n", packet->in_port, pkt_vlan_id, packet->in_port, vlan_list_to_string(port_vlans).c_str());
     return;
 
   } else if (!raw_pkt.has_vlan_tag && vlan_port_info.is_tagged_port()) {
 
     // packet has no vlan tag but the port is tagged
-    output::log(output::loglevel::ERROR, "ironstack::net_utils::flood_packet() on ingress port %hu, packet_in is untagged but the port requires a vlan tag.\n", packet->in_port);
-    output::log(output::loglevel::ERROR, "the packet has been dropped from propagation.\n");
+    OUTPUT_LOG_LIMITED(ERROR, "ironstack::net_utils::flood_packet() on ingress port %hu, packet_in is untagged but the port requires a vlan tag.\n"
+      "the packet has been dropped from propagation.\n", packet->in_port);
     return;
   }
 
   // TODO: right now, if a port has no vlan tags and the packet is untagged, we don't handle them (they should be forwarded to
   // other non-vlan ports).
-  if (!raw_pkt.has_vlan_tag && port_vlans.empty()) {
-    output::log(output::loglevel::BUG, "ironstack::net_utils::flood_packet() unimplemented functionality. please contact the ironstack dev team.\n");
+  if (!raw_pkt.has_vlan_tag && port_vlans.none()) {
+    OUTPUT_LOG_LIMITED(BUG, "ironstack::net_utils::flood_packet() unimplemented functionality. please contact the ironstack dev team.\n");
     return;
   }
 
-  uint16_t actual_vlan = (raw_pkt.has_vlan_tag ? pkt_vlan_id : *port_vlans.begin());
-
-  // TODO -- may want to consider using openflow actions to add/remove tags using hardware
-  // handle untagged packet
-  if (!raw_pkt.has_vlan_tag) {
-
-		// send untagged packet as-is to untagged ports
-    set<uint16_t> untagged_ports = switch_state_svc->get_untagged_ports(actual_vlan);
-    untagged_ports.erase(packet->in_port);
-    if (!untagged_ports.empty()) {
-      controller->send_packet(packet->pkt_data, untagged_ports);
-    }
+  uint16_t actual_vlan = (raw_pkt.has_vlan_tag ? pkt_vlan_id : port_vlans.first());
 
-		// tag packet and send tagged packet to tagged ports
-    set<uint16_t> tagged_ports = switch_state_svc->get_tagged_ports(actual_vlan);
-    tagged_ports.erase(packet->in_port);  // technically not necessary (since packet entered on an untagged port)
-    if (!tagged_ports.empty()) {
-      autobuf tagged_packet;
-      std_packet_utils::set_vlan_tag(packet->pkt_data, tagged_packet, actual_vlan);
-
-      controller->send_packet(tagged_packet, tagged_ports);
-    }
-
-  // handle tagged packet
-  } else {
-
-		// untag packet and send untagged packet to untagged ports
-    set<uint16_t> untagged_ports = switch_state_svc->get_untagged_ports(actual_vlan);
-    untagged_ports.erase(packet->in_port); // technically not necessary (since packet entered on tagged port)
-    if (!untagged_ports.empty()) {
-      autobuf untagged_packet;
-      std_packet_utils::strip_vlan_tag(packet->pkt_data, untagged_packet);
-      controller->send_packet(untagged_packet, untagged_ports);
-    }
-
-		// send tagged packet as-is to tagged ports
-    set<uint16_t> tagged_ports = switch_state_svc->get_tagged_ports(actual_vlan);
-    tagged_ports.erase(packet->in_port);
-    if (!tagged_ports.empty()) {
-      controller->send_packet(packet->pkt_data, tagged_ports);
-    }
+  // send using the precomputed flood plan: one packet_out whose actions output
+  // the packet as-is on ports matching its tagging, then retag it in hardware
+  // (set_vlan/strip_vlan) for the remaining ports
+  shared_ptr<const flood_plan> plan = switch_state_svc->get_flood_plan(actual_vlan, packet->in_port, raw_pkt.has_vlan_tag);
+  if (plan->actions.size() > 0) {
+    controller->send_packet_with_actions(packet->pkt_data, plan->actions);
   }
 }
 
@@ -169,16 +157,8 @@ void ironstack::net_utils::flood_packet(hal* controller,
 // sending them out the ports.
 void ironstack::net_utils::flood_packet(hal* controller, const shared_ptr<switch_state>& sw_state, const autobuf& contents, uint16_t vlan_id) {
 	
-	set<uint16_t> tagged_ports = sw_state->get_tagged_ports(vlan_id);
-	set<uint16_t> untagged_ports = sw_state->get_untagged_ports(vlan_id);
-
-	if (!tagged_ports.empty()) {
-		autobuf tagged_packet;
-		std_packet_utils::set_vlan_tag(contents, tagged_packet, vlan_id);
-		controller->send_packet(tagged_packet, tagged_ports);
+	shared_ptr<const flood_plan> plan = sw_state->get_flood_plan(vlan_id, flood_plan_cache::NO_INGRESS_PORT, false);
+	if (plan->actions.size() > 0) {
+		controller->send_packet_with_actions(contents, plan->actions);
 	}
-	if (!untagged_ports.empty()) {
-		controller->send_packet(contents, untagged_ports);
-	}
-
 }
@@ -34,8 +34,9 @@ namespace ironstack {
 namespace net_utils {
 
 	// reads out an integral number of bytes corresponding to the next full openflow message
-	// and then deserializes it into the appropriate message subclass.
-	shared_ptr<of_message> get_next_openflow_message(tcp& connection, autobuf& sock_buf);
+	// and then deserializes it into the appropriate message subclass. if trace is given,
+	// the read, framing and decode times are recorded into it.
+	shared_ptr<of_message> get_next_openflow_message(tcp& connection, autobuf& sock_buf, packet_in_trace* trace=nullptr);
 
 	// for a given ingress packet, get the vlan associated with the packet. sometimes
 	// the packet may come encoded with the vlan. othertimes the vlan has to be deduced
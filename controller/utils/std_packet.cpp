@@ -1470,19 +1470,19 @@ bool std_packet_utils::strip_vlan_tag(const autobuf& input, autobuf& output) {
 	}
 
 	const raw_packet::tagged_ethernet_hdr_t* src_hdr = (const raw_packet::tagged_ethernet_hdr_t*) input.get_content_ptr();
-	if (unpack_uint16(src_hdr->ethertype) != 0x8100) {
+	if (input.size() < sizeof(raw_packet::tagged_ethernet_hdr_t) || unpack_uint16(src_hdr->vlan_8100) != 0x8100) {
 
 		// packet is already untagged
 		output.full_copy_from(input);
 
 	} else {
 
-		output.create_empty_buffer(input.size() - sizeof(raw_packet::tagged_ethernet_hdr_t) - sizeof(raw_packet::untagged_ethernet_hdr_t), false);
+		output.create_empty_buffer(input.size() - (sizeof(raw_packet::tagged_ethernet_hdr_t) - sizeof(raw_packet::untagged_ethernet_hdr_t)), false);
 		raw_packet::untagged_ethernet_hdr_t* dest_hdr = (raw_packet::untagged_ethernet_hdr_t*) output.get_content_ptr_mutable();
 
 		memcpy(dest_hdr, src_hdr, 12);
 		memcpy(dest_hdr->ethertype, src_hdr->ethertype, 2);
-		memcpy(output.ptr_offset_mutable(sizeof(raw_packet::untagged_ethernet_hdr_t)),\
+		memcpy(output.ptr_offset_mutable(sizeof(raw_packet::untagged_ethernet_hdr_t)),
 			input.ptr_offset_const(sizeof(raw_packet::tagged_ethernet_hdr_t)),
 			input.size()-sizeof(raw_packet::tagged_ethernet_hdr_t));
 	}